@@ -9,6 +9,9 @@
  * PURPOSE.
  * See the Mulan PSL v2 for more details.
  */
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "teeverifier.h"
 #include "enclave_log.h"
 
@@ -26,14 +29,139 @@ static int convert_cctype_to_gptype(cc_ra_verify_type_t type)
     }
 }
 
+/*
+ * Parsed basevalue files, keyed by path. A file is parsed again only if its mtime or size changes, so verifying
+ * the reports of the same TA over and over does not read the file each time.
+ */
+#define GP_BASEVALUE_CACHE_NUM 8
+#define GP_UUID_STR_LEN 36
+#define GP_HASH_STR_LEN (HASH_SIZE * 2)
+typedef struct {
+    char path[PATH_MAX];
+    struct timespec mtime;
+    off_t size;
+    base_value value;
+} gp_basevalue_cache_t;
+
+static gp_basevalue_cache_t g_basevalue_cache[GP_BASEVALUE_CACHE_NUM];
+static size_t g_basevalue_cache_next = 0;
+static pthread_mutex_t g_basevalue_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int hex_to_bytes(const char *hex, uint8_t *bytes, size_t bytes_len)
+{
+    for (size_t i = 0; i < bytes_len; i++) {
+        unsigned int byte = 0;
+        if (!isxdigit(hex[i * 2]) || !isxdigit(hex[i * 2 + 1]) || sscanf(hex + i * 2, "%2x", &byte) != 1) {
+            return -1;
+        }
+        bytes[i] = (uint8_t)byte;
+    }
+    return 0;
+}
+
+// uuid string to the TEE_UUID layout, whose first three fields are little endian
+static int uuid_to_bytes(const char *str, uint8_t *uuid)
+{
+    // 8-4-4-4-12
+    char hex[UUID_SIZE * 2 + 1] = {0};
+    uint8_t tmp[UUID_SIZE] = {0};
+    if (strlen(str) != GP_UUID_STR_LEN || str[8] != '-' || str[13] != '-' || str[18] != '-' || str[23] != '-') {
+        return -1;
+    }
+    (void)snprintf(hex, sizeof(hex), "%.8s%.4s%.4s%.4s%.12s", str, str + 9, str + 14, str + 19, str + 24);
+    if (hex_to_bytes(hex, tmp, UUID_SIZE) != 0) {
+        return -1;
+    }
+    const size_t order[UUID_SIZE] = {3, 2, 1, 0, 5, 4, 7, 6, 8, 9, 10, 11, 12, 13, 14, 15};
+    for (size_t i = 0; i < UUID_SIZE; i++) {
+        uuid[i] = tmp[order[i]];
+    }
+    return 0;
+}
+
+// basevalue file has one line: taid img_hash mem_hash
+static cc_enclave_result_t parse_basevalue_file(const char *path, base_value *value)
+{
+    char taid[GP_UUID_STR_LEN + 1] = {0};
+    char img_hash[GP_HASH_STR_LEN + 1] = {0};
+    char mem_hash[GP_HASH_STR_LEN + 1] = {0};
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("open basevalue file failed\n");
+        return CC_ERROR_RA_REPORT_VERIFY_HASH;
+    }
+    int ret = fscanf(fp, "%36s %64s %64s", taid, img_hash, mem_hash);
+    fclose(fp);
+    if (ret != 3 || strlen(img_hash) != GP_HASH_STR_LEN || strlen(mem_hash) != GP_HASH_STR_LEN ||  // 3 fields
+        uuid_to_bytes(taid, value->uuid) != 0 || hex_to_bytes(img_hash, value->valueinfo[0], HASH_SIZE) != 0 ||
+        hex_to_bytes(mem_hash, value->valueinfo[1], HASH_SIZE) != 0) {
+        printf("parse basevalue file failed\n");
+        return CC_ERROR_RA_REPORT_VERIFY_HASH;
+    }
+    return CC_SUCCESS;
+}
+
+static cc_enclave_result_t get_basevalue(const char *path, base_value *value)
+{
+    struct stat st;
+    gp_basevalue_cache_t *entry = NULL;
+
+    if (path == NULL || strlen(path) >= PATH_MAX || stat(path, &st) != 0) {
+        printf("stat basevalue file failed\n");
+        return CC_ERROR_RA_REPORT_VERIFY_HASH;
+    }
+    pthread_mutex_lock(&g_basevalue_cache_lock);
+    for (size_t i = 0; i < GP_BASEVALUE_CACHE_NUM; i++) {
+        if (strcmp(g_basevalue_cache[i].path, path) == 0) {
+            entry = &g_basevalue_cache[i];
+            break;
+        }
+    }
+    if (entry != NULL && entry->size == st.st_size && entry->mtime.tv_sec == st.st_mtim.tv_sec &&
+        entry->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+        *value = entry->value;
+        pthread_mutex_unlock(&g_basevalue_cache_lock);
+        return CC_SUCCESS;
+    }
+    cc_enclave_result_t ret = parse_basevalue_file(path, value);
+    if (ret != CC_SUCCESS) {
+        if (entry != NULL) {
+            (void)memset(entry, 0, sizeof(gp_basevalue_cache_t));
+        }
+        pthread_mutex_unlock(&g_basevalue_cache_lock);
+        return ret;
+    }
+    if (entry == NULL) {
+        entry = &g_basevalue_cache[g_basevalue_cache_next];
+        g_basevalue_cache_next = (g_basevalue_cache_next + 1) % GP_BASEVALUE_CACHE_NUM;
+        (void)strcpy(entry->path, path);
+    }
+    entry->mtime = st.st_mtim;
+    entry->size = st.st_size;
+    entry->value = *value;
+    pthread_mutex_unlock(&g_basevalue_cache_lock);
+
+    return CC_SUCCESS;
+}
+
 static cc_enclave_result_t gp_verify_report(cc_ra_buf_t *report, cc_ra_buf_t *nonce,
     cc_ra_verify_type_t type, char *basevalue)
 {
+    base_value value;
     int gp_type = convert_cctype_to_gptype(type);
     if (gp_type == (int)CC_ERROR_RA_REPORT_VERIFY_INVALID_TYPE) {
         return CC_FAIL;
     }
-    int ret = tee_verify_report((buffer_data *)report, (buffer_data *)nonce, gp_type, basevalue);
+    cc_enclave_result_t cc_ret = get_basevalue(basevalue, &value);
+    if (cc_ret != CC_SUCCESS) {
+        return cc_ret;
+    }
+    // same checks as tee_verify_report, with the basevalue from the cache instead of the file
+    int ret = tee_validate_report((buffer_data *)report, (buffer_data *)nonce);
+    if (ret == TVS_ALL_SUCCESSED) {
+        ret = tee_verify_report2((buffer_data *)report, gp_type, &value);
+    }
     switch (ret) {
         case TVS_ALL_SUCCESSED:
             return CC_SUCCESS;
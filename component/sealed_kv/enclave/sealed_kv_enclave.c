@@ -0,0 +1,1129 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "sealed_kv_enclave.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "secgear_dataseal.h"
+#include "secgear_random.h"
+#include "sealed_kv_t.h"
+
+#ifdef SGX_ENCLAVE
+    #include "sgx_thread.h"
+    typedef sgx_thread_rwlock_t skv_lock_t;
+#else
+    #include <pthread.h>
+    typedef pthread_rwlock_t skv_lock_t;
+#endif
+
+/*
+ * The store is an append-only log of frames, a frame holds the records of one write batch sealed together by
+ * cc_enclave_seal_data_batch:
+ *
+ *   +--------------+-------------------------+---------------------------------------------+
+ *   | frame header | record offsets, aligned | sealed records, CC_SEAL_BATCH_ALIGN aligned |
+ *   +--------------+-------------------------+---------------------------------------------+
+ *
+ * A sealed record carries the store id, the sequence number of its frame and its index in the frame, so the host can
+ * neither move records between stores, frames or positions, nor drop records from the middle of the log. The frame
+ * sequence numbers of a log go up by one, the first frame holds a single header record with the store id. The host
+ * can still roll the whole log back to an older version, which takes a monotonic counter to detect.
+ *
+ * The enclave keeps a hash index of the keys with the location of the current record of each key, a lookup reads
+ * that record only. A write appends one frame, which the host syncs before returning. A crash in the middle of an
+ * append leaves a partial frame at the end of the log, which is cut off at open.
+ */
+#define SKV_FRAME_MAGIC 0x564b4c53U /* "SLKV" */
+#define SKV_MAX_FRAME_LEN (64U * 1024 * 1024)
+#define SKV_STORE_ID_LEN 16
+#define SKV_OP_HEADER 0
+#define SKV_READ_AHEAD_LEN (64 * 1024)
+#define SKV_COMPACT_FLUSH_LEN (256 * 1024)
+#define SKV_DEFAULT_COMPACT_MIN_SIZE (1024 * 1024)
+#define SKV_MIN_COMPACT_RATIO 2
+#define SKV_MIN_BUCKET_NUM 64
+#define SKV_MAX_BUCKET_NUM (1U << 24)
+#define SKV_ALIGN_UP(len) (((len) + CC_SEAL_BATCH_ALIGN - 1) & ~(uint64_t)(CC_SEAL_BATCH_ALIGN - 1))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t rec_num;
+    uint32_t body_len;  // length of the sealed records
+    uint32_t reserved;
+} skv_frame_hdr_t;
+
+typedef struct {
+    uint8_t store_id[SKV_STORE_ID_LEN];
+    uint64_t seq;  // sequence number of the frame
+    uint32_t index;  // index of the record in the frame
+    uint32_t rec_num;  // records in the frame
+    uint32_t op;
+    uint32_t key_len;
+    uint32_t value_len;
+    uint32_t reserved;
+    uint8_t data[];  // key, then value
+} skv_rec_t;
+
+/* A frame read back from the log, the records are unsealed and checked */
+typedef struct {
+    uint64_t body_pos;  // file offset of the sealed records
+    uint8_t *body;
+    uint32_t *offsets;
+    uint32_t rec_num;
+    uint8_t *plain;
+    uint32_t plain_len;
+    skv_rec_t **recs;
+} skv_frame_t;
+
+typedef struct {
+    uint64_t pos;  // file offset of the sealed record
+    uint64_t seq;
+    uint32_t index;
+    uint32_t sealed_len;
+} skv_loc_t;
+
+typedef struct skv_entry {
+    struct skv_entry *next;
+    skv_loc_t loc;
+    skv_loc_t new_loc;  // location in the log being compacted
+    uint32_t hash;
+    uint32_t value_len;
+    uint32_t key_len;
+    uint8_t key[];
+} skv_entry_t;
+
+struct _sealed_kv {
+    skv_lock_t lock;
+    int handle;
+    cc_enclave_seal_ctx_t *seal_ctx;
+    uint8_t store_id[SKV_STORE_ID_LEN];
+    uint64_t seq;  // sequence number of the last frame
+    uint64_t file_len;
+    uint64_t live_bytes;
+    uint64_t compact_min_size;
+    uint32_t compact_ratio;
+    uint64_t compact_num;
+    uint64_t compact_fail_num;
+    uint64_t compact_retry_len;  // need_compact waits for this log length after a failed compaction
+    skv_entry_t **buckets;
+    uint32_t bucket_mask;
+    uint64_t key_num;
+};
+
+typedef struct {
+    int handle;
+    uint64_t file_len;
+    uint8_t *buf;
+    uint32_t cap;
+    uint64_t pos;  // file offset of buf
+    uint32_t len;
+} skv_reader_t;
+
+/* The ocall stub returns cc_enclave_result_t in GP and sgx_status_t in SGX, both are 0 on success */
+#define SKV_OCALL(call, res) ((int)(call) == 0 ? (cc_enclave_result_t)(res) : CC_ERROR_COMMUNICATION)
+
+static void skv_wtlock(skv_lock_t *lock)
+{
+#ifdef SGX_ENCLAVE
+    (void)sgx_thread_rwlock_wrlock(lock);
+#else
+    (void)pthread_rwlock_wrlock(lock);
+#endif
+}
+
+static void skv_wtunlock(skv_lock_t *lock)
+{
+#ifdef SGX_ENCLAVE
+    (void)sgx_thread_rwlock_wrunlock(lock);
+#else
+    (void)pthread_rwlock_unlock(lock);
+#endif
+}
+
+static void skv_rdlock(skv_lock_t *lock)
+{
+#ifdef SGX_ENCLAVE
+    (void)sgx_thread_rwlock_rdlock(lock);
+#else
+    (void)pthread_rwlock_rdlock(lock);
+#endif
+}
+
+static void skv_rdunlock(skv_lock_t *lock)
+{
+#ifdef SGX_ENCLAVE
+    (void)sgx_thread_rwlock_rdunlock(lock);
+#else
+    (void)pthread_rwlock_unlock(lock);
+#endif
+}
+
+static void skv_init_rwlock(skv_lock_t *lock)
+{
+#ifdef SGX_ENCLAVE
+    (void)sgx_thread_rwlock_init(lock, NULL);
+#else
+    (void)pthread_rwlock_init(lock, NULL);
+#endif
+}
+
+static void skv_fini_rwlock(skv_lock_t *lock)
+{
+#ifdef SGX_ENCLAVE
+    (void)sgx_thread_rwlock_destroy(lock);
+#else
+    (void)pthread_rwlock_destroy(lock);
+#endif
+}
+
+static void free_plain(uint8_t *plain, uint32_t plain_len)
+{
+    if (plain != NULL) {
+        (void)memset(plain, 0, plain_len);
+        free(plain);
+    }
+}
+
+static uint32_t skv_hash(const uint8_t *key, uint32_t key_len)
+{
+    uint32_t hash = 2166136261U;  // FNV-1a
+
+    for (uint32_t i = 0; i < key_len; i++) {
+        hash = (hash ^ key[i]) * 16777619U;
+    }
+    return hash;
+}
+
+/* Returns the link pointing to the entry of key, or to the NULL at the end of its bucket */
+static skv_entry_t **find_entry(cc_sealed_kv_t *kv, const uint8_t *key, uint32_t key_len, uint32_t hash)
+{
+    skv_entry_t **link = &kv->buckets[hash & kv->bucket_mask];
+
+    while (*link != NULL) {
+        skv_entry_t *entry = *link;
+        if (entry->hash == hash && entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) {
+            break;
+        }
+        link = &entry->next;
+    }
+    return link;
+}
+
+/* Double the buckets when the table gets full, a failed allocation only keeps the chains longer */
+static void grow_buckets(cc_sealed_kv_t *kv)
+{
+    uint32_t bucket_num = kv->bucket_mask + 1;
+    if (kv->key_num <= bucket_num || bucket_num >= SKV_MAX_BUCKET_NUM) {
+        return;
+    }
+    skv_entry_t **buckets = (skv_entry_t **)calloc(bucket_num * 2, sizeof(skv_entry_t *));
+    if (buckets == NULL) {
+        return;
+    }
+    uint32_t mask = bucket_num * 2 - 1;
+    for (uint32_t i = 0; i < bucket_num; i++) {
+        skv_entry_t *entry = kv->buckets[i];
+        while (entry != NULL) {
+            skv_entry_t *next = entry->next;
+            entry->next = buckets[entry->hash & mask];
+            buckets[entry->hash & mask] = entry;
+            entry = next;
+        }
+    }
+    free(kv->buckets);
+    kv->buckets = buckets;
+    kv->bucket_mask = mask;
+}
+
+static skv_entry_t *new_entry(const uint8_t *key, uint32_t key_len)
+{
+    skv_entry_t *entry = (skv_entry_t *)calloc(1, sizeof(skv_entry_t) + key_len);
+    if (entry == NULL) {
+        return NULL;
+    }
+    entry->hash = skv_hash(key, key_len);
+    entry->key_len = key_len;
+    (void)memcpy(entry->key, key, key_len);
+    return entry;
+}
+
+/* Point the key to its new record, spare is a new entry of the key which is used if the key is not in the index */
+static void index_put(cc_sealed_kv_t *kv, skv_entry_t *spare, uint32_t value_len, const skv_loc_t *loc)
+{
+    skv_entry_t **link = find_entry(kv, spare->key, spare->key_len, spare->hash);
+    skv_entry_t *entry = *link;
+
+    if (entry == NULL) {
+        entry = spare;
+        *link = entry;
+        kv->key_num++;
+    } else {
+        kv->live_bytes -= entry->loc.sealed_len;
+        free(spare);
+    }
+    entry->loc = *loc;
+    entry->value_len = value_len;
+    kv->live_bytes += loc->sealed_len;
+    grow_buckets(kv);
+}
+
+static void index_delete(cc_sealed_kv_t *kv, const uint8_t *key, uint32_t key_len)
+{
+    skv_entry_t **link = find_entry(kv, key, key_len, skv_hash(key, key_len));
+    skv_entry_t *entry = *link;
+
+    if (entry != NULL) {
+        *link = entry->next;
+        kv->live_bytes -= entry->loc.sealed_len;
+        kv->key_num--;
+        free(entry);
+    }
+}
+
+static void free_index(cc_sealed_kv_t *kv)
+{
+    for (uint32_t i = 0; kv->buckets != NULL && i <= kv->bucket_mask; i++) {
+        skv_entry_t *entry = kv->buckets[i];
+        while (entry != NULL) {
+            skv_entry_t *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(kv->buckets);
+    kv->buckets = NULL;
+}
+
+static uint32_t get_offsets_len(uint32_t rec_num)
+{
+    return (uint32_t)SKV_ALIGN_UP(sizeof(uint32_t) * rec_num);
+}
+
+static uint32_t get_rec_plain_len(const cc_sealed_kv_op_t *op)
+{
+    return (uint32_t)sizeof(skv_rec_t) + op->key_len + (op->op == CC_SEALED_KV_OP_PUT ? op->value_len : 0);
+}
+
+/* Seal ops into a new frame of sequence number seq, the frame is zeroed first so that no padding leaks out */
+static cc_enclave_result_t seal_frame(cc_sealed_kv_t *kv, uint64_t seq, const cc_sealed_kv_op_t *ops, uint32_t op_num,
+    uint8_t **frame, uint32_t *frame_len)
+{
+    cc_enclave_result_t ret = CC_ERROR_OUT_OF_MEMORY;
+    uint64_t plain_total = 0;
+    uint64_t body_len = 0;
+
+    for (uint32_t i = 0; i < op_num; i++) {
+        uint32_t plain_len = get_rec_plain_len(&ops[i]);
+        plain_total += SKV_ALIGN_UP(plain_len);
+        body_len += SKV_ALIGN_UP(cc_enclave_get_sealed_data_size(0, plain_len));
+    }
+    uint64_t total = sizeof(skv_frame_hdr_t) + get_offsets_len(op_num) + body_len;
+    if (total > SKV_MAX_FRAME_LEN) {
+        return CC_ERROR_EXCESS_DATA;
+    }
+
+    uint8_t *plain = (uint8_t *)malloc(plain_total);
+    cc_enclave_seal_record_t *records = (cc_enclave_seal_record_t *)calloc(op_num, sizeof(cc_enclave_seal_record_t));
+    cc_enclave_result_t *status = (cc_enclave_result_t *)calloc(op_num, sizeof(cc_enclave_result_t));
+    uint8_t *buf = (uint8_t *)calloc(1, total);
+    if (plain == NULL || records == NULL || status == NULL || buf == NULL) {
+        goto end;
+    }
+
+    uint8_t *cur = plain;
+    for (uint32_t i = 0; i < op_num; i++) {
+        skv_rec_t *rec = (skv_rec_t *)cur;
+        (void)memcpy(rec->store_id, kv->store_id, SKV_STORE_ID_LEN);
+        rec->seq = seq;
+        rec->index = i;
+        rec->rec_num = op_num;
+        rec->op = (uint32_t)ops[i].op;
+        rec->key_len = ops[i].key_len;
+        rec->value_len = ops[i].op == CC_SEALED_KV_OP_PUT ? ops[i].value_len : 0;
+        rec->reserved = 0;
+        if (rec->key_len != 0) {
+            (void)memcpy(rec->data, ops[i].key, rec->key_len);
+        }
+        if (rec->value_len != 0) {
+            (void)memcpy(rec->data + rec->key_len, ops[i].value, rec->value_len);
+        }
+        records[i].data = cur;
+        records[i].data_len = get_rec_plain_len(&ops[i]);
+        cur += SKV_ALIGN_UP(records[i].data_len);
+    }
+
+    skv_frame_hdr_t *hdr = (skv_frame_hdr_t *)buf;
+    uint32_t offsets_len = get_offsets_len(op_num);
+    uint32_t sealed_len = (uint32_t)body_len;
+    hdr->magic = SKV_FRAME_MAGIC;
+    hdr->rec_num = op_num;
+    hdr->body_len = (uint32_t)body_len;
+    ret = cc_enclave_seal_data_batch(kv->seal_ctx, records, op_num, buf + sizeof(skv_frame_hdr_t) + offsets_len,
+        &sealed_len, (uint32_t *)(buf + sizeof(skv_frame_hdr_t)), status);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    *frame = buf;
+    *frame_len = (uint32_t)total;
+    buf = NULL;
+end:
+    free_plain(plain, (uint32_t)plain_total);
+    free(records);
+    free(status);
+    free(buf);
+    return ret;
+}
+
+static void free_frame(skv_frame_t *frame)
+{
+    free_plain(frame->plain, frame->plain_len);
+    free(frame->recs);
+    frame->plain = NULL;
+    frame->recs = NULL;
+}
+
+static bool check_rec(const skv_rec_t *rec, uint32_t plain_len)
+{
+    if (plain_len < sizeof(skv_rec_t)) {
+        return false;
+    }
+    if (rec->op != SKV_OP_HEADER && rec->op != CC_SEALED_KV_OP_PUT && rec->op != CC_SEALED_KV_OP_DELETE) {
+        return false;
+    }
+    if (rec->key_len > CC_SEALED_KV_MAX_KEY_LEN || rec->value_len > CC_SEALED_KV_MAX_VALUE_LEN) {
+        return false;
+    }
+    return sizeof(skv_rec_t) + rec->key_len + rec->value_len == plain_len;
+}
+
+/*
+ * Unseal rec_num records packed in body_len bytes at body, at the given offsets. Records which fail to unseal or are
+ * malformed make CC_ERROR_CORRUPT_OBJECT, the caller checks where the records claim to be.
+ */
+static cc_enclave_result_t open_frame(cc_sealed_kv_t *kv, uint8_t *body, uint32_t body_len, uint32_t *offsets,
+    uint32_t rec_num, skv_frame_t *frame)
+{
+    cc_enclave_result_t ret = CC_ERROR_OUT_OF_MEMORY;
+
+    for (uint32_t i = 0; i < rec_num; i++) {
+        if (offsets[i] >= body_len || (i + 1 < rec_num && offsets[i] >= offsets[i + 1])) {
+            return CC_ERROR_CORRUPT_OBJECT;
+        }
+    }
+    // a plain record is shorter than its sealed record, so the body length is enough for all of them
+    frame->plain = (uint8_t *)malloc(body_len);
+    frame->plain_len = body_len;
+    frame->recs = (skv_rec_t **)calloc(rec_num, sizeof(skv_rec_t *));
+    cc_enclave_seal_record_t *records = (cc_enclave_seal_record_t *)calloc(rec_num, sizeof(cc_enclave_seal_record_t));
+    cc_enclave_result_t *status = (cc_enclave_result_t *)calloc(rec_num, sizeof(cc_enclave_result_t));
+    if (frame->plain == NULL || frame->recs == NULL || records == NULL || status == NULL) {
+        goto end;
+    }
+    for (uint32_t i = 0; i < rec_num; i++) {
+        records[i].data = frame->plain + offsets[i];
+        records[i].data_len = (i + 1 < rec_num ? offsets[i + 1] : body_len) - offsets[i];
+    }
+    ret = cc_enclave_unseal_data_batch(kv->seal_ctx, body, body_len, offsets, rec_num, records, status);
+    if (ret != CC_SUCCESS) {
+        ret = ret == CC_ERROR_OUT_OF_MEMORY ? ret : CC_ERROR_CORRUPT_OBJECT;
+        goto end;
+    }
+    for (uint32_t i = 0; i < rec_num; i++) {
+        frame->recs[i] = (skv_rec_t *)records[i].data;
+        if (records[i].additional_text_len != 0 || !check_rec(frame->recs[i], records[i].data_len)) {
+            ret = CC_ERROR_CORRUPT_OBJECT;
+            goto end;
+        }
+    }
+    frame->body = body;
+    frame->offsets = offsets;
+    frame->rec_num = rec_num;
+end:
+    if (ret != CC_SUCCESS) {
+        free_frame(frame);
+    }
+    free(records);
+    free(status);
+    return ret;
+}
+
+static uint32_t get_sealed_rec_len(const skv_frame_t *frame, uint32_t index)
+{
+    return ((cc_enclave_sealed_data_t *)(frame->body + frame->offsets[index]))->data_body_len;
+}
+
+/* Get len bytes of the log at pos, reading ahead so that a scan of the log takes few ocalls */
+static cc_enclave_result_t reader_get(skv_reader_t *reader, uint64_t pos, uint32_t len, uint8_t **data)
+{
+    if (pos >= reader->pos && pos + len <= reader->pos + reader->len) {
+        *data = reader->buf + (pos - reader->pos);
+        return CC_SUCCESS;
+    }
+    if (len > reader->file_len || pos > reader->file_len - len) {
+        return CC_ERROR_CORRUPT_OBJECT;
+    }
+    uint64_t want = len > SKV_READ_AHEAD_LEN ? len : SKV_READ_AHEAD_LEN;
+    if (want > reader->file_len - pos) {
+        want = reader->file_len - pos;
+    }
+    if (want > reader->cap) {
+        uint8_t *buf = (uint8_t *)malloc(want);
+        if (buf == NULL) {
+            return CC_ERROR_OUT_OF_MEMORY;
+        }
+        free(reader->buf);
+        reader->buf = buf;
+        reader->cap = (uint32_t)want;
+    }
+    reader->len = 0;
+    int res = CC_FAIL;
+    cc_enclave_result_t ret = SKV_OCALL(sealed_kv_file_read(&res, reader->handle, pos, reader->buf, want), res);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    reader->pos = pos;
+    reader->len = (uint32_t)want;
+    *data = reader->buf;
+    return CC_SUCCESS;
+}
+
+/* Read and unseal the frame at pos, the caller frees the frame */
+static cc_enclave_result_t read_frame(cc_sealed_kv_t *kv, skv_reader_t *reader, uint64_t pos, skv_frame_t *frame,
+    uint32_t *frame_len)
+{
+    uint8_t *data = NULL;
+    cc_enclave_result_t ret = reader_get(reader, pos, sizeof(skv_frame_hdr_t), &data);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    skv_frame_hdr_t hdr = *(skv_frame_hdr_t *)data;
+    if (hdr.magic != SKV_FRAME_MAGIC || hdr.rec_num == 0 || hdr.rec_num > CC_SEALED_KV_MAX_BATCH_NUM ||
+        hdr.body_len > SKV_MAX_FRAME_LEN || hdr.body_len % CC_SEAL_BATCH_ALIGN != 0) {
+        return CC_ERROR_CORRUPT_OBJECT;
+    }
+    uint32_t offsets_len = get_offsets_len(hdr.rec_num);
+    uint64_t len = sizeof(skv_frame_hdr_t) + offsets_len + (uint64_t)hdr.body_len;
+    if (len > SKV_MAX_FRAME_LEN) {
+        return CC_ERROR_CORRUPT_OBJECT;
+    }
+    ret = reader_get(reader, pos, (uint32_t)len, &data);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    ret = open_frame(kv, data + sizeof(skv_frame_hdr_t) + offsets_len, hdr.body_len,
+        (uint32_t *)(data + sizeof(skv_frame_hdr_t)), hdr.rec_num, frame);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    frame->body_pos = pos + sizeof(skv_frame_hdr_t) + offsets_len;
+    *frame_len = (uint32_t)len;
+    return CC_SUCCESS;
+}
+
+/*
+ * A write interrupted by a crash leaves a prefix of its frame at the end of the log, possibly with zeros where the
+ * file grew before the data reached the disk. A bad frame which is complete, the last one or not, is real damage.
+ */
+static bool is_torn_tail(skv_reader_t *reader, uint64_t pos)
+{
+    uint64_t remain = reader->file_len - pos;
+    uint8_t *data = NULL;
+
+    if (remain < sizeof(skv_frame_hdr_t)) {
+        return true;
+    }
+    if (remain > SKV_MAX_FRAME_LEN || reader_get(reader, pos, sizeof(skv_frame_hdr_t), &data) != CC_SUCCESS) {
+        return false;
+    }
+    skv_frame_hdr_t *hdr = (skv_frame_hdr_t *)data;
+    if (hdr->magic == SKV_FRAME_MAGIC && hdr->rec_num <= CC_SEALED_KV_MAX_BATCH_NUM) {
+        return sizeof(skv_frame_hdr_t) + get_offsets_len(hdr->rec_num) + (uint64_t)hdr->body_len > remain;
+    }
+    if (reader_get(reader, pos, (uint32_t)remain, &data) != CC_SUCCESS) {
+        return false;
+    }
+    for (uint64_t i = 0; i < remain; i++) {
+        if (data[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef cc_enclave_result_t (*skv_frame_cb_t)(cc_sealed_kv_t *kv, skv_frame_t *frame, void *arg);
+
+/*
+ * Call cb on each frame of the log, which must start with a header record of the store and go on with frames of
+ * increasing sequence numbers. With is_recover the store id is taken from the log, and the scan stops without error
+ * at a torn tail. Returns the end of the valid frames in end and the last sequence number in seq.
+ */
+static cc_enclave_result_t scan_log(cc_sealed_kv_t *kv, uint64_t file_len, bool is_recover, skv_frame_cb_t cb,
+    void *arg, uint64_t *end, uint64_t *seq)
+{
+    cc_enclave_result_t ret = CC_SUCCESS;
+    skv_reader_t reader = { .handle = kv->handle, .file_len = file_len };
+    uint64_t pos = 0;
+    uint64_t last_seq = 0;
+
+    while (pos < file_len) {
+        skv_frame_t frame = {0};
+        uint32_t frame_len = 0;
+        ret = read_frame(kv, &reader, pos, &frame, &frame_len);
+        if (ret == CC_SUCCESS && pos == 0) {
+            if (frame.rec_num != 1 || frame.recs[0]->op != SKV_OP_HEADER ||
+                (!is_recover && memcmp(frame.recs[0]->store_id, kv->store_id, SKV_STORE_ID_LEN) != 0)) {
+                ret = CC_ERROR_CORRUPT_OBJECT;
+            } else {
+                (void)memcpy(kv->store_id, frame.recs[0]->store_id, SKV_STORE_ID_LEN);
+                last_seq = frame.recs[0]->seq;
+            }
+        } else if (ret == CC_SUCCESS) {
+            last_seq++;
+            for (uint32_t i = 0; i < frame.rec_num; i++) {
+                if (frame.recs[i]->op == SKV_OP_HEADER) {
+                    ret = CC_ERROR_CORRUPT_OBJECT;
+                    break;
+                }
+            }
+        }
+        for (uint32_t i = 0; ret == CC_SUCCESS && i < frame.rec_num; i++) {
+            skv_rec_t *rec = frame.recs[i];
+            if (rec->seq != last_seq || rec->index != i || rec->rec_num != frame.rec_num ||
+                memcmp(rec->store_id, kv->store_id, SKV_STORE_ID_LEN) != 0) {
+                ret = CC_ERROR_CORRUPT_OBJECT;
+            }
+        }
+        if (ret == CC_SUCCESS) {
+            ret = cb(kv, &frame, arg);
+        }
+        free_frame(&frame);
+        if (ret == CC_ERROR_CORRUPT_OBJECT && is_recover && is_torn_tail(&reader, pos)) {
+            ret = CC_SUCCESS;
+            break;
+        }
+        if (ret != CC_SUCCESS) {
+            break;
+        }
+        pos += frame_len;
+    }
+    free(reader.buf);
+    *end = pos;
+    *seq = last_seq;
+    return ret;
+}
+
+static cc_enclave_result_t recover_frame(cc_sealed_kv_t *kv, skv_frame_t *frame, void *arg)
+{
+    (void)arg;
+    for (uint32_t i = 0; i < frame->rec_num; i++) {
+        skv_rec_t *rec = frame->recs[i];
+        if (rec->op == CC_SEALED_KV_OP_DELETE) {
+            index_delete(kv, rec->data, rec->key_len);
+        } else if (rec->op == CC_SEALED_KV_OP_PUT) {
+            skv_entry_t *spare = new_entry(rec->data, rec->key_len);
+            if (spare == NULL) {
+                return CC_ERROR_OUT_OF_MEMORY;
+            }
+            skv_loc_t loc = { frame->body_pos + frame->offsets[i], rec->seq, i, get_sealed_rec_len(frame, i) };
+            index_put(kv, spare, rec->value_len, &loc);
+        }
+    }
+    return CC_SUCCESS;
+}
+
+static cc_enclave_result_t file_append(cc_sealed_kv_t *kv, uint8_t *buf, uint32_t len)
+{
+    int res = CC_FAIL;
+    return SKV_OCALL(sealed_kv_file_append(&res, kv->handle, kv->file_len, buf, len), res);
+}
+
+static cc_enclave_result_t write_header_frame(cc_sealed_kv_t *kv, uint64_t seq, uint8_t **frame, uint32_t *frame_len)
+{
+    cc_sealed_kv_op_t op = { .op = (cc_sealed_kv_op_type_t)SKV_OP_HEADER };
+    return seal_frame(kv, seq, &op, 1, frame, frame_len);
+}
+
+/* Start a new log of the store, with a new store id */
+static cc_enclave_result_t init_log(cc_sealed_kv_t *kv)
+{
+    uint8_t *frame = NULL;
+    uint32_t frame_len = 0;
+
+    cc_enclave_result_t ret = cc_enclave_generate_random(kv->store_id, SKV_STORE_ID_LEN);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    ret = write_header_frame(kv, 1, &frame, &frame_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    ret = file_append(kv, frame, frame_len);
+    free(frame);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    kv->seq = 1;
+    kv->file_len = frame_len;
+    return CC_SUCCESS;
+}
+
+static cc_enclave_result_t recover_log(cc_sealed_kv_t *kv, uint64_t file_len)
+{
+    uint64_t end = 0;
+    uint64_t seq = 0;
+
+    cc_enclave_result_t ret = scan_log(kv, file_len, true, recover_frame, NULL, &end, &seq);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    if (end == 0) {
+        // nothing but a torn header frame, the store was never written
+        return init_log(kv);
+    }
+    if (end < file_len) {
+        int res = CC_FAIL;
+        ret = SKV_OCALL(sealed_kv_file_truncate(&res, kv->handle, end), res);
+        if (ret != CC_SUCCESS) {
+            return ret;
+        }
+    }
+    kv->seq = seq;
+    kv->file_len = end;
+    return CC_SUCCESS;
+}
+
+static bool is_valid_name(const char *name)
+{
+    size_t len = 0;
+
+    if (name == NULL || name[0] == '.') {
+        return false;
+    }
+    for (; name[len] != '\0' && len <= CC_SEALED_KV_MAX_NAME_LEN; len++) {
+        char c = name[len];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' ||
+            c == '-')) {
+            return false;
+        }
+    }
+    return len != 0 && len <= CC_SEALED_KV_MAX_NAME_LEN;
+}
+
+cc_enclave_result_t cc_sealed_kv_open(const char *name, const cc_sealed_kv_config_t *config, cc_sealed_kv_t **kv)
+{
+    if (!is_valid_name(name) || kv == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    cc_sealed_kv_t *tmp = (cc_sealed_kv_t *)calloc(1, sizeof(cc_sealed_kv_t));
+    if (tmp == NULL) {
+        return CC_ERROR_OUT_OF_MEMORY;
+    }
+    tmp->handle = -1;
+    tmp->compact_min_size = SKV_DEFAULT_COMPACT_MIN_SIZE;
+    tmp->compact_ratio = SKV_MIN_COMPACT_RATIO;
+    if (config != NULL && config->compact_min_size != 0) {
+        tmp->compact_min_size = config->compact_min_size;
+    }
+    if (config != NULL && config->compact_ratio > SKV_MIN_COMPACT_RATIO) {
+        tmp->compact_ratio = config->compact_ratio;
+    }
+    skv_init_rwlock(&tmp->lock);
+
+    cc_enclave_result_t ret = CC_ERROR_OUT_OF_MEMORY;
+    int res = CC_FAIL;
+    uint64_t file_len = 0;
+    tmp->buckets = (skv_entry_t **)calloc(SKV_MIN_BUCKET_NUM, sizeof(skv_entry_t *));
+    if (tmp->buckets == NULL) {
+        goto end;
+    }
+    tmp->bucket_mask = SKV_MIN_BUCKET_NUM - 1;
+    ret = cc_enclave_seal_ctx_create(0, &tmp->seal_ctx);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+
+    ret = SKV_OCALL(sealed_kv_file_open(&res, (char *)name, strlen(name) + 1, &tmp->handle, &file_len), res);
+    if (ret != CC_SUCCESS) {
+        tmp->handle = -1;
+        goto end;
+    }
+    ret = file_len == 0 ? init_log(tmp) : recover_log(tmp, file_len);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    *kv = tmp;
+    return CC_SUCCESS;
+end:
+    cc_sealed_kv_close(tmp);
+    return ret;
+}
+
+void cc_sealed_kv_close(cc_sealed_kv_t *kv)
+{
+    if (kv == NULL) {
+        return;
+    }
+    if (kv->handle >= 0) {
+        int res = CC_FAIL;
+        (void)sealed_kv_file_close(&res, kv->handle);
+    }
+    free_index(kv);
+    cc_enclave_seal_ctx_destroy(kv->seal_ctx);
+    skv_fini_rwlock(&kv->lock);
+    free(kv);
+}
+
+typedef struct {
+    uint64_t seq;  // sequence number of the last frame of the new log
+    uint64_t file_len;  // length of the new log, including the unflushed part
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t cap;
+    uint64_t moved_num;
+} skv_compact_t;
+
+static cc_enclave_result_t compact_flush(cc_sealed_kv_t *kv, skv_compact_t *compact)
+{
+    if (compact->len == 0) {
+        return CC_SUCCESS;
+    }
+    int res = CC_FAIL;
+    cc_enclave_result_t ret = SKV_OCALL(sealed_kv_file_compact_append(&res, kv->handle, compact->buf, compact->len),
+        res);
+    compact->len = 0;
+    return ret;
+}
+
+static cc_enclave_result_t compact_add(cc_sealed_kv_t *kv, skv_compact_t *compact, uint8_t *frame, uint32_t frame_len)
+{
+    if (compact->len + frame_len > compact->cap) {
+        cc_enclave_result_t ret = compact_flush(kv, compact);
+        if (ret != CC_SUCCESS) {
+            return ret;
+        }
+    }
+    if (frame_len > compact->cap) {
+        int res = CC_FAIL;
+        return SKV_OCALL(sealed_kv_file_compact_append(&res, kv->handle, frame, frame_len), res);
+    }
+    (void)memcpy(compact->buf + compact->len, frame, frame_len);
+    compact->len += frame_len;
+    return CC_SUCCESS;
+}
+
+/* Copy the records of the frame which are still in the index into a frame of the new log */
+static cc_enclave_result_t compact_frame(cc_sealed_kv_t *kv, skv_frame_t *frame, void *arg)
+{
+    skv_compact_t *compact = (skv_compact_t *)arg;
+    cc_enclave_result_t ret = CC_ERROR_OUT_OF_MEMORY;
+    uint8_t *buf = NULL;
+    uint32_t buf_len = 0;
+    uint32_t num = 0;
+
+    cc_sealed_kv_op_t *ops = (cc_sealed_kv_op_t *)calloc(frame->rec_num, sizeof(cc_sealed_kv_op_t));
+    skv_entry_t **entries = (skv_entry_t **)calloc(frame->rec_num, sizeof(skv_entry_t *));
+    if (ops == NULL || entries == NULL) {
+        goto end;
+    }
+    for (uint32_t i = 0; i < frame->rec_num; i++) {
+        skv_rec_t *rec = frame->recs[i];
+        if (rec->op != CC_SEALED_KV_OP_PUT) {
+            continue;
+        }
+        skv_entry_t *entry = *find_entry(kv, rec->data, rec->key_len, skv_hash(rec->data, rec->key_len));
+        if (entry == NULL || entry->loc.seq != rec->seq || entry->loc.index != i) {
+            continue;
+        }
+        ops[num] = (cc_sealed_kv_op_t){ CC_SEALED_KV_OP_PUT, rec->data, rec->key_len, rec->data + rec->key_len,
+            rec->value_len };
+        entries[num++] = entry;
+    }
+    ret = CC_SUCCESS;
+    if (num == 0) {
+        goto end;
+    }
+
+    ret = seal_frame(kv, compact->seq + 1, ops, num, &buf, &buf_len);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    uint32_t *offsets = (uint32_t *)(buf + sizeof(skv_frame_hdr_t));
+    uint64_t body_pos = compact->file_len + sizeof(skv_frame_hdr_t) + get_offsets_len(num);
+    for (uint32_t i = 0; i < num; i++) {
+        entries[i]->new_loc = (skv_loc_t){ body_pos + offsets[i], compact->seq + 1, i,
+            cc_enclave_get_sealed_data_size(0, get_rec_plain_len(&ops[i])) };
+    }
+    ret = compact_add(kv, compact, buf, buf_len);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    compact->seq++;
+    compact->file_len += buf_len;
+    compact->moved_num += num;
+end:
+    free(buf);
+    free(ops);
+    free(entries);
+    return ret;
+}
+
+/* The caller holds the write lock */
+static cc_enclave_result_t compact_log(cc_sealed_kv_t *kv)
+{
+    skv_compact_t compact = { .seq = kv->seq + 1 };
+    uint8_t *frame = NULL;
+    uint32_t frame_len = 0;
+    uint64_t end = 0;
+    uint64_t seq = 0;
+    int res = CC_FAIL;
+
+    cc_enclave_result_t ret = SKV_OCALL(sealed_kv_file_compact_begin(&res, kv->handle), res);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    compact.buf = (uint8_t *)malloc(SKV_COMPACT_FLUSH_LEN);
+    if (compact.buf == NULL) {
+        ret = CC_ERROR_OUT_OF_MEMORY;
+        goto end;
+    }
+    compact.cap = SKV_COMPACT_FLUSH_LEN;
+    ret = write_header_frame(kv, compact.seq, &frame, &frame_len);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    ret = compact_add(kv, &compact, frame, frame_len);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    compact.file_len = frame_len;
+    ret = scan_log(kv, kv->file_len, false, compact_frame, &compact, &end, &seq);
+    if (ret == CC_SUCCESS && compact.moved_num != kv->key_num) {
+        ret = CC_ERROR_CORRUPT_OBJECT;
+    }
+    if (ret == CC_SUCCESS) {
+        ret = compact_flush(kv, &compact);
+    }
+end:
+    free(frame);
+    free(compact.buf);
+    int is_commit = ret == CC_SUCCESS ? 1 : 0;
+    cc_enclave_result_t end_ret = SKV_OCALL(sealed_kv_file_compact_end(&res, kv->handle, is_commit), res);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    if (end_ret != CC_SUCCESS) {
+        return end_ret;
+    }
+    for (uint32_t i = 0; i <= kv->bucket_mask; i++) {
+        for (skv_entry_t *entry = kv->buckets[i]; entry != NULL; entry = entry->next) {
+            entry->loc = entry->new_loc;
+        }
+    }
+    kv->seq = compact.seq;
+    kv->file_len = compact.file_len;
+    kv->compact_num++;
+    return CC_SUCCESS;
+}
+
+static bool need_compact(cc_sealed_kv_t *kv)
+{
+    return kv->file_len >= kv->compact_min_size && kv->file_len >= kv->compact_retry_len &&
+        kv->file_len / kv->compact_ratio > kv->live_bytes;
+}
+
+static cc_enclave_result_t check_ops(const cc_sealed_kv_op_t *ops, uint32_t op_num)
+{
+    if (ops == NULL || op_num == 0 || op_num > CC_SEALED_KV_MAX_BATCH_NUM) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    for (uint32_t i = 0; i < op_num; i++) {
+        if (ops[i].key == NULL || ops[i].key_len == 0 || ops[i].key_len > CC_SEALED_KV_MAX_KEY_LEN) {
+            return CC_ERROR_BAD_PARAMETERS;
+        }
+        if (ops[i].op == CC_SEALED_KV_OP_PUT) {
+            if (ops[i].value_len > CC_SEALED_KV_MAX_VALUE_LEN || (ops[i].value == NULL && ops[i].value_len != 0)) {
+                return CC_ERROR_BAD_PARAMETERS;
+            }
+        } else if (ops[i].op != CC_SEALED_KV_OP_DELETE) {
+            return CC_ERROR_BAD_PARAMETERS;
+        }
+    }
+    return CC_SUCCESS;
+}
+
+cc_enclave_result_t cc_sealed_kv_write(cc_sealed_kv_t *kv, const cc_sealed_kv_op_t *ops, uint32_t op_num)
+{
+    if (kv == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    cc_enclave_result_t ret = check_ops(ops, op_num);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+
+    uint8_t *frame = NULL;
+    uint32_t frame_len = 0;
+    // allocate the index entries up front, a batch which is in the log must get into the index
+    skv_entry_t **spares = (skv_entry_t **)calloc(op_num, sizeof(skv_entry_t *));
+    if (spares == NULL) {
+        return CC_ERROR_OUT_OF_MEMORY;
+    }
+    for (uint32_t i = 0; i < op_num; i++) {
+        if (ops[i].op == CC_SEALED_KV_OP_PUT && (spares[i] = new_entry(ops[i].key, ops[i].key_len)) == NULL) {
+            ret = CC_ERROR_OUT_OF_MEMORY;
+            goto end;
+        }
+    }
+
+    skv_wtlock(&kv->lock);
+    ret = seal_frame(kv, kv->seq + 1, ops, op_num, &frame, &frame_len);
+    if (ret == CC_SUCCESS) {
+        ret = file_append(kv, frame, frame_len);
+    }
+    if (ret == CC_SUCCESS) {
+        uint32_t *offsets = (uint32_t *)(frame + sizeof(skv_frame_hdr_t));
+        uint64_t body_pos = kv->file_len + sizeof(skv_frame_hdr_t) + get_offsets_len(op_num);
+        for (uint32_t i = 0; i < op_num; i++) {
+            if (ops[i].op == CC_SEALED_KV_OP_DELETE) {
+                index_delete(kv, ops[i].key, ops[i].key_len);
+                continue;
+            }
+            skv_loc_t loc = { body_pos + offsets[i], kv->seq + 1, i,
+                cc_enclave_get_sealed_data_size(0, get_rec_plain_len(&ops[i])) };
+            index_put(kv, spares[i], ops[i].value_len, &loc);
+            spares[i] = NULL;
+        }
+        kv->seq++;
+        kv->file_len += frame_len;
+    }
+    skv_wtunlock(&kv->lock);
+    free(frame);
+end:
+    for (uint32_t i = 0; i < op_num; i++) {
+        free(spares[i]);
+    }
+    free(spares);
+    return ret;
+}
+
+cc_enclave_result_t cc_sealed_kv_put(cc_sealed_kv_t *kv, const uint8_t *key, uint32_t key_len, const uint8_t *value,
+    uint32_t value_len)
+{
+    cc_sealed_kv_op_t op = { CC_SEALED_KV_OP_PUT, key, key_len, value, value_len };
+    return cc_sealed_kv_write(kv, &op, 1);
+}
+
+cc_enclave_result_t cc_sealed_kv_delete(cc_sealed_kv_t *kv, const uint8_t *key, uint32_t key_len)
+{
+    cc_sealed_kv_op_t op = { CC_SEALED_KV_OP_DELETE, key, key_len, NULL, 0 };
+    return cc_sealed_kv_write(kv, &op, 1);
+}
+
+/* Read the record of entry and copy its value out, the record must be the one the index points to */
+static cc_enclave_result_t read_value(cc_sealed_kv_t *kv, const skv_entry_t *entry, uint8_t *value)
+{
+    uint32_t sealed_len = entry->loc.sealed_len;
+    uint32_t offset = 0;
+    skv_frame_t frame = {0};
+    int res = CC_FAIL;
+
+    uint8_t *buf = (uint8_t *)malloc(sealed_len);
+    if (buf == NULL) {
+        return CC_ERROR_OUT_OF_MEMORY;
+    }
+    cc_enclave_result_t ret = SKV_OCALL(sealed_kv_file_read(&res, kv->handle, entry->loc.pos, buf, sealed_len), res);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    ret = open_frame(kv, buf, sealed_len, &offset, 1, &frame);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    skv_rec_t *rec = frame.recs[0];
+    if (rec->op != CC_SEALED_KV_OP_PUT || rec->seq != entry->loc.seq || rec->index != entry->loc.index ||
+        memcmp(rec->store_id, kv->store_id, SKV_STORE_ID_LEN) != 0 || rec->key_len != entry->key_len ||
+        rec->value_len != entry->value_len || memcmp(rec->data, entry->key, entry->key_len) != 0) {
+        ret = CC_ERROR_CORRUPT_OBJECT;
+        goto end;
+    }
+    if (rec->value_len != 0) {
+        (void)memcpy(value, rec->data + rec->key_len, rec->value_len);
+    }
+end:
+    free_frame(&frame);
+    free(buf);
+    return ret;
+}
+
+cc_enclave_result_t cc_sealed_kv_get(cc_sealed_kv_t *kv, const uint8_t *key, uint32_t key_len, uint8_t *value,
+    uint32_t *value_len)
+{
+    cc_enclave_result_t ret = CC_SUCCESS;
+    if (kv == NULL || key == NULL || key_len == 0 || key_len > CC_SEALED_KV_MAX_KEY_LEN || value_len == NULL ||
+        (value == NULL && *value_len != 0)) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    skv_rdlock(&kv->lock);
+    skv_entry_t *entry = *find_entry(kv, key, key_len, skv_hash(key, key_len));
+    if (entry == NULL) {
+        ret = CC_ERROR_ITEM_NOT_FOUND;
+    } else if (value == NULL) {
+        // a size probe
+        *value_len = entry->value_len;
+    } else if (*value_len < entry->value_len) {
+        *value_len = entry->value_len;
+        ret = CC_ERROR_SHORT_BUFFER;
+    } else {
+        ret = read_value(kv, entry, value);
+        if (ret == CC_SUCCESS) {
+            *value_len = entry->value_len;
+        }
+    }
+    skv_rdunlock(&kv->lock);
+    return ret;
+}
+
+cc_enclave_result_t cc_sealed_kv_compact(cc_sealed_kv_t *kv)
+{
+    if (kv == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    skv_wtlock(&kv->lock);
+    cc_enclave_result_t ret = compact_log(kv);
+    if (ret == CC_SUCCESS) {
+        kv->compact_retry_len = 0;
+    } else {
+        kv->compact_fail_num++;
+        kv->compact_retry_len = kv->file_len + kv->compact_min_size;
+    }
+    skv_wtunlock(&kv->lock);
+    return ret;
+}
+
+cc_enclave_result_t cc_sealed_kv_get_stats(cc_sealed_kv_t *kv, cc_sealed_kv_stats_t *stats)
+{
+    if (kv == NULL || stats == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    skv_rdlock(&kv->lock);
+    stats->key_num = kv->key_num;
+    stats->live_bytes = kv->live_bytes;
+    stats->log_bytes = kv->file_len;
+    stats->compact_num = kv->compact_num;
+    stats->compact_fail_num = kv->compact_fail_num;
+    stats->need_compact = need_compact(kv);
+    skv_rdunlock(&kv->lock);
+    return CC_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef SEALED_KV_ENCLAVE_H
+#define SEALED_KV_ENCLAVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "status.h"
+#include "sealed_kv.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct _sealed_kv cc_sealed_kv_t;
+
+typedef struct {
+    uint64_t compact_min_size;  // need_compact is never set below this log size, 0 means 1MB
+    uint32_t compact_ratio;  // need_compact is set when the log grows to ratio times the live records, 0 means 2
+} cc_sealed_kv_config_t;
+
+typedef struct {
+    cc_sealed_kv_op_type_t op;
+    const uint8_t *key;
+    uint32_t key_len;
+    const uint8_t *value;  // not used by CC_SEALED_KV_OP_DELETE
+    uint32_t value_len;
+} cc_sealed_kv_op_t;
+
+typedef struct {
+    uint64_t key_num;  // keys in the store
+    uint64_t live_bytes;  // sealed bytes of the current values
+    uint64_t log_bytes;  // length of the log file
+    uint64_t compact_num;  // compactions since the store was opened
+    uint64_t compact_fail_num;  // failed compactions since the store was opened
+    bool need_compact;  // the log has outgrown the compaction policy, call cc_sealed_kv_compact
+} cc_sealed_kv_stats_t;
+
+/**
+* Open a sealed key-value store, a new empty store is created if the host has no file of the name. The log is read
+* and checked once to rebuild the index in the enclave, a write interrupted by a crash at the end of the log is
+* dropped, any other damage fails the open.
+*
+* @param[in] name, The name of the store, see CC_SEALED_KV_MAX_NAME_LEN
+*
+* @param[in] config, The compaction policy, NULL for the default
+*
+* @param[out] kv, The opened store
+*
+* @retval On success, 0 is returned.
+*         CC_ERROR_CORRUPT_OBJECT, the log is damaged or does not belong to the enclave.
+*         On other error, cc_enclave_result_t errorno is returned.
+*/
+cc_enclave_result_t cc_sealed_kv_open(const char *name, const cc_sealed_kv_config_t *config, cc_sealed_kv_t **kv);
+
+/**
+* Close the store and free the index
+*
+* @param[in] kv, The store
+*/
+void cc_sealed_kv_close(cc_sealed_kv_t *kv);
+
+/**
+* Apply a batch of puts and deletes atomically, the batch is sealed and appended to the log by one ocall and is
+* durable when the function returns. The ops are applied in order, a later op of the same key wins. A write never
+* compacts the log, see need_compact of cc_sealed_kv_stats_t.
+*
+* @param[in] kv, The store
+*
+* @param[in] ops, The ops, at most CC_SEALED_KV_MAX_BATCH_NUM
+*
+* @param[in] op_num, The number of ops
+*
+* @retval On success, 0 is returned.
+*         CC_ERROR_EXCESS_DATA, the sealed batch is larger than a log frame.
+*         On other error, cc_enclave_result_t errorno is returned and none of the ops is applied.
+*/
+cc_enclave_result_t cc_sealed_kv_write(cc_sealed_kv_t *kv, const cc_sealed_kv_op_t *ops, uint32_t op_num);
+
+/**
+* Put one key, a write batch of a single op
+*/
+cc_enclave_result_t cc_sealed_kv_put(cc_sealed_kv_t *kv, const uint8_t *key, uint32_t key_len, const uint8_t *value,
+    uint32_t value_len);
+
+/**
+* Delete one key, a write batch of a single op. Deleting a missing key succeeds.
+*/
+cc_enclave_result_t cc_sealed_kv_delete(cc_sealed_kv_t *kv, const uint8_t *key, uint32_t key_len);
+
+/**
+* Get the value of a key, which costs one ocall to read its sealed record
+*
+* @param[in] kv, The store
+*
+* @param[in] key, The key
+*
+* @param[in] key_len, The length of key
+*
+* @param[out] value, The buf of the value, NULL with *value_len 0 to get the length only
+*
+* @param[in/out] value_len, The length of value buf, returns the length of the value
+*
+* @retval On success, 0 is returned, a size probe returns the length of the value in value_len.
+*         CC_ERROR_BAD_PARAMETERS, value is NULL and *value_len is not 0.
+*         CC_ERROR_ITEM_NOT_FOUND, the key is not in the store.
+*         CC_ERROR_SHORT_BUFFER, value_len is not enough, the needed length is assigned to value_len.
+*         CC_ERROR_CORRUPT_OBJECT, the record read from the host is not the one in the index.
+*/
+cc_enclave_result_t cc_sealed_kv_get(cc_sealed_kv_t *kv, const uint8_t *key, uint32_t key_len, uint8_t *value,
+    uint32_t *value_len);
+
+/**
+* Rewrite the log with the live records only, the new log replaces the old one atomically. Reads and writes of the
+* store wait for the compaction. After a failure need_compact is not set again until the log has grown by another
+* compact_min_size, so that a lasting error of the host is not retried on every poll.
+*
+* @param[in] kv, The store
+*
+* @retval On success, 0 is returned. On error the old log is kept and cc_enclave_result_t errorno is returned.
+*/
+cc_enclave_result_t cc_sealed_kv_compact(cc_sealed_kv_t *kv);
+
+cc_enclave_result_t cc_sealed_kv_get_stats(cc_sealed_kv_t *kv, cc_sealed_kv_stats_t *stats);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "sealed_kv_host.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "sealed_kv_u.h"
+
+/*
+ * The file store behind the ocalls of the sealed key-value stores. The enclave addresses an open store by a handle,
+ * the host writes where the enclave says and syncs before returning, so that a write which returned success survives
+ * a crash. A compaction writes the new log to <name>.skv.compact and renames it over the store, a crash leaves either
+ * the old or the new log and the leftover is removed at the next open.
+ */
+#define SKV_MAX_FILE_NUM 64
+
+typedef struct {
+    int fd;
+    int compact_fd;
+    char path[PATH_MAX];
+    char compact_path[PATH_MAX];
+} skv_file_t;
+
+static pthread_mutex_t g_skv_lock = PTHREAD_MUTEX_INITIALIZER;
+static char g_skv_dir[PATH_MAX];
+static skv_file_t g_skv_files[SKV_MAX_FILE_NUM];
+static bool g_skv_init = false;
+
+cc_enclave_result_t cc_sealed_kv_host_init(const char *dir)
+{
+    struct stat st;
+
+    if (dir == NULL || strlen(dir) == 0 || strlen(dir) >= sizeof(g_skv_dir)) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return CC_ERROR_STORAGE_ENOTDIR;
+    }
+    pthread_mutex_lock(&g_skv_lock);
+    if (!g_skv_init) {
+        for (int i = 0; i < SKV_MAX_FILE_NUM; i++) {
+            g_skv_files[i].fd = -1;
+            g_skv_files[i].compact_fd = -1;
+        }
+        g_skv_init = true;
+    }
+    (void)strcpy(g_skv_dir, dir);
+    pthread_mutex_unlock(&g_skv_lock);
+    return CC_SUCCESS;
+}
+
+static void close_file(skv_file_t *file)
+{
+    if (file->compact_fd >= 0) {
+        (void)close(file->compact_fd);
+        (void)unlink(file->compact_path);
+        file->compact_fd = -1;
+    }
+    if (file->fd >= 0) {
+        (void)close(file->fd);
+        file->fd = -1;
+    }
+}
+
+void cc_sealed_kv_host_fini(void)
+{
+    pthread_mutex_lock(&g_skv_lock);
+    for (int i = 0; g_skv_init && i < SKV_MAX_FILE_NUM; i++) {
+        close_file(&g_skv_files[i]);
+    }
+    pthread_mutex_unlock(&g_skv_lock);
+}
+
+static skv_file_t *get_file(int handle)
+{
+    if (!g_skv_init || handle < 0 || handle >= SKV_MAX_FILE_NUM || g_skv_files[handle].fd < 0) {
+        return NULL;
+    }
+    return &g_skv_files[handle];
+}
+
+static bool is_valid_name(const char *name, size_t name_len)
+{
+    // name_len counts the terminating '\0'
+    if (name_len < 2 || name_len > CC_SEALED_KV_MAX_NAME_LEN + 1 || name[name_len - 1] != '\0' || name[0] == '.') {
+        return false;
+    }
+    for (size_t i = 0; i < name_len - 1; i++) {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' ||
+            c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int sync_dir(void)
+{
+    int fd = open(g_skv_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return CC_ERROR_STORAGE_EIO;
+    }
+    int ret = fsync(fd) == 0 ? CC_SUCCESS : CC_ERROR_STORAGE_EIO;
+    (void)close(fd);
+    return ret;
+}
+
+static int errno_to_result(int err)
+{
+    switch (err) {
+        case EMFILE:
+            return CC_ERROR_STORAGE_EMFILE;
+        case ENFILE:
+            return CC_ERROR_STORAGE_ENFILE;
+        case EROFS:
+            return CC_ERROR_STORAGE_EROFS;
+        case ENOENT:
+            return CC_ERROR_STORAGE_NOT_FOUND;
+        default:
+            return CC_ERROR_STORAGE_EIO;
+    }
+}
+
+int sealed_kv_file_open(char *name, size_t name_len, int *handle, uint64_t *file_len)
+{
+    int ret = CC_ERROR_STORAGE_EMFILE;
+    struct stat st;
+
+    if (name == NULL || !is_valid_name(name, name_len) || handle == NULL || file_len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    pthread_mutex_lock(&g_skv_lock);
+    if (!g_skv_init) {
+        ret = CC_ERROR_BAD_STATE;
+        goto end;
+    }
+    char path[PATH_MAX];
+    char compact_path[PATH_MAX];
+    int len = snprintf(path, sizeof(path), "%s/%s%s", g_skv_dir, name, CC_SEALED_KV_FILE_SUFFIX);
+    if (len < 0 || (size_t)len >= sizeof(path)) {
+        ret = CC_ERROR_BAD_PARAMETERS;
+        goto end;
+    }
+    len = snprintf(compact_path, sizeof(compact_path), "%s%s", path, CC_SEALED_KV_COMPACT_SUFFIX);
+    if (len < 0 || (size_t)len >= sizeof(compact_path)) {
+        ret = CC_ERROR_BAD_PARAMETERS;
+        goto end;
+    }
+    // two writers of one log would overwrite each other
+    for (int i = 0; i < SKV_MAX_FILE_NUM; i++) {
+        if (g_skv_files[i].fd >= 0 && strcmp(g_skv_files[i].path, path) == 0) {
+            ret = CC_ERROR_ACCESS_CONFLICT;
+            goto end;
+        }
+    }
+    for (int i = 0; i < SKV_MAX_FILE_NUM; i++) {
+        skv_file_t *file = &g_skv_files[i];
+        if (file->fd >= 0) {
+            continue;
+        }
+        (void)strcpy(file->path, path);
+        (void)strcpy(file->compact_path, compact_path);
+        // a compaction which did not commit
+        (void)unlink(file->compact_path);
+        file->fd = open(file->path, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        if (file->fd < 0) {
+            ret = errno_to_result(errno);
+            goto end;
+        }
+        if (fstat(file->fd, &st) != 0 || sync_dir() != CC_SUCCESS) {
+            close_file(file);
+            ret = CC_ERROR_STORAGE_EIO;
+            goto end;
+        }
+        *handle = i;
+        *file_len = (uint64_t)st.st_size;
+        ret = CC_SUCCESS;
+        break;
+    }
+end:
+    pthread_mutex_unlock(&g_skv_lock);
+    return ret;
+}
+
+int sealed_kv_file_close(int handle)
+{
+    pthread_mutex_lock(&g_skv_lock);
+    skv_file_t *file = get_file(handle);
+    if (file != NULL) {
+        close_file(file);
+    }
+    pthread_mutex_unlock(&g_skv_lock);
+    return file == NULL ? CC_ERROR_BAD_PARAMETERS : CC_SUCCESS;
+}
+
+static int write_all(int fd, const uint8_t *buf, size_t len, off_t offset)
+{
+    while (len > 0) {
+        ssize_t n = offset < 0 ? write(fd, buf, len) : pwrite(fd, buf, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return CC_ERROR_STORAGE_EIO;
+        }
+        buf += n;
+        len -= (size_t)n;
+        offset = offset < 0 ? offset : offset + n;
+    }
+    return CC_SUCCESS;
+}
+
+int sealed_kv_file_append(int handle, uint64_t file_len, uint8_t *buf, size_t len)
+{
+    skv_file_t *file = get_file(handle);
+    struct stat st;
+
+    if (file == NULL || buf == NULL || file_len > (uint64_t)LLONG_MAX - len) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    // drop what a failed append may have left behind file_len
+    if (fstat(file->fd, &st) != 0 || ((uint64_t)st.st_size != file_len && ftruncate(file->fd, (off_t)file_len) != 0)) {
+        return CC_ERROR_STORAGE_EIO;
+    }
+    if (write_all(file->fd, buf, len, (off_t)file_len) != CC_SUCCESS || fdatasync(file->fd) != 0) {
+        // if this fails too, the next append truncates to file_len again
+        if (ftruncate(file->fd, (off_t)file_len) != 0) {
+            return CC_ERROR_STORAGE_EIO;
+        }
+        return CC_ERROR_STORAGE_EIO;
+    }
+    return CC_SUCCESS;
+}
+
+int sealed_kv_file_read(int handle, uint64_t offset, uint8_t *buf, size_t len)
+{
+    skv_file_t *file = get_file(handle);
+
+    if (file == NULL || buf == NULL || offset > (uint64_t)LLONG_MAX - len) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    while (len > 0) {
+        ssize_t n = pread(file->fd, buf, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return CC_ERROR_STORAGE_EIO;
+        }
+        buf += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return CC_SUCCESS;
+}
+
+int sealed_kv_file_truncate(int handle, uint64_t file_len)
+{
+    skv_file_t *file = get_file(handle);
+
+    if (file == NULL || file_len > (uint64_t)LLONG_MAX) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (ftruncate(file->fd, (off_t)file_len) != 0 || fdatasync(file->fd) != 0) {
+        return CC_ERROR_STORAGE_EIO;
+    }
+    return CC_SUCCESS;
+}
+
+int sealed_kv_file_compact_begin(int handle)
+{
+    skv_file_t *file = get_file(handle);
+
+    if (file == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (file->compact_fd >= 0) {
+        (void)close(file->compact_fd);
+    }
+    file->compact_fd = open(file->compact_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    return file->compact_fd < 0 ? errno_to_result(errno) : CC_SUCCESS;
+}
+
+int sealed_kv_file_compact_append(int handle, uint8_t *buf, size_t len)
+{
+    skv_file_t *file = get_file(handle);
+
+    if (file == NULL || file->compact_fd < 0 || buf == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    return write_all(file->compact_fd, buf, len, -1);
+}
+
+int sealed_kv_file_compact_end(int handle, int is_commit)
+{
+    skv_file_t *file = get_file(handle);
+    int ret = CC_SUCCESS;
+
+    if (file == NULL || file->compact_fd < 0) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (is_commit && (fsync(file->compact_fd) != 0 || rename(file->compact_path, file->path) != 0)) {
+        ret = CC_ERROR_STORAGE_EIO;
+    }
+    if (!is_commit || ret != CC_SUCCESS) {
+        (void)close(file->compact_fd);
+        (void)unlink(file->compact_path);
+        file->compact_fd = -1;
+        return ret;
+    }
+    (void)close(file->fd);
+    file->fd = file->compact_fd;
+    file->compact_fd = -1;
+    // the new log is in place and the enclave must follow it, a failed sync only risks the old log after a crash
+    (void)sync_dir();
+    return CC_SUCCESS;
+}
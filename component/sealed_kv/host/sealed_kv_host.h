@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef SEALED_KV_HOST_H
+#define SEALED_KV_HOST_H
+
+#include "status.h"
+#include "sealed_kv.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+* Set the directory of the store files, which the ocalls of the sealed key-value stores of all enclaves in the
+* process use. Must be called before any enclave opens a store.
+*
+* @param[in] dir, The directory, which must exist
+*
+* @retval On success, return 0.
+*         On error, cc_enclave_result_t errorno is returned.
+*/
+cc_enclave_result_t cc_sealed_kv_host_init(const char *dir);
+
+/**
+* Close the store files left open by the enclaves
+*/
+void cc_sealed_kv_host_fini(void);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef SEALED_KV_H
+#define SEALED_KV_H
+
+#include <stdint.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A store name is 1 to CC_SEALED_KV_MAX_NAME_LEN characters of [A-Za-z0-9_.-] not starting with '.', the host keeps
+ * the store in the file <dir>/<name>.skv
+ */
+#define CC_SEALED_KV_MAX_NAME_LEN 64
+#define CC_SEALED_KV_FILE_SUFFIX ".skv"
+#define CC_SEALED_KV_COMPACT_SUFFIX ".compact"
+
+#define CC_SEALED_KV_MAX_KEY_LEN 1024
+#define CC_SEALED_KV_MAX_VALUE_LEN (1024 * 1024)
+#define CC_SEALED_KV_MAX_BATCH_NUM 4096
+
+typedef enum {
+    CC_SEALED_KV_OP_PUT = 1,
+    CC_SEALED_KV_OP_DELETE,
+} cc_sealed_kv_op_type_t;
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
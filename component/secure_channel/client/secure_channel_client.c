@@ -13,9 +13,14 @@
 
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
+#include <errno.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <openssl/rand.h>
 #include <openssl/pem.h>
+#include <openssl/sha.h>
+#include <openssl/evp.h>
 
 #include "status.h"
 #include "enclave_log.h"
@@ -29,14 +34,31 @@
 struct cc_sec_chl_handle {
     sec_chl_ecdh_ctx_t *ecdh_ctx;   // key exchange context
     pthread_mutex_t lock;           // proctect recv_buf and recv_buf_len
+    pthread_cond_t recv_cond;       // signaled by the callback when a msg is put into recv_buf
+    size_t fsm_step;                // next action of the init fsm
+    bool is_resume;                 // handshake by a resumption ticket instead of a full handshake
     uint8_t recv_buf[SEC_CHL_RECV_BUF_MAX_LEN];  // secure channel init msg max len
     size_t  recv_buf_len;                        // secure channel init msg real len
     cc_sec_chl_algo_t algo;
     sec_chl_ra_req_t ra_req;
     char *b64_enc_key;
     RSA *rsa_svr_pubkey;
+    bool has_ticket;                               // server issued a resumption ticket
+    uint8_t ticket[SEC_CHL_TICKET_LEN];
+    uint8_t resume_secret[SECURE_KEY_LEN];         // derived from session key, the server keeps it in the ticket
+    uint8_t cli_random[RANDOM_LEN];                // random of the resumption request
+    uint8_t report_digest[SHA256_DIGEST_LENGTH];   // key of the report in the verified report cache
+    bool is_report_verified;                       // report verified in full, to be cached
+    bool is_report_cached;                         // report found in the cache, the exch param must be signed
 };
 
+/* the ticket exported to the user, which has to keep it as secret as the data it protects */
+typedef struct {
+    uint8_t resume_secret[SECURE_KEY_LEN];
+    uint8_t ticket[SEC_CHL_TICKET_LEN];
+    int32_t algo;  // cipher suite of the session the ticket is issued for, the resumed session keeps it
+} sec_chl_client_ticket_t;
+
 typedef enum {
     STATE_ORIGIN = 0,
     STATE_WAIT_SVRPUBKEY,
@@ -87,6 +109,7 @@ static cc_enclave_result_t sec_chl_send_request(cc_conn_kit_t *conn_kit, sec_chl
 
 static void del_local_sec_chl_ctx(cc_sec_chl_ctx_t *ctx)
 {
+    pthread_cond_destroy(&ctx->handle->recv_cond);
     pthread_mutex_destroy(&ctx->handle->lock);
     if (ctx->handle->ecdh_ctx != NULL) {
         del_ecdh_ctx(ctx->handle->ecdh_ctx);
@@ -97,6 +120,7 @@ static void del_local_sec_chl_ctx(cc_sec_chl_ctx_t *ctx)
     if (ctx->handle->rsa_svr_pubkey != NULL) {
         RSA_free(ctx->handle->rsa_svr_pubkey);
     }
+    memset(ctx->handle->resume_secret, 0, SECURE_KEY_LEN);
     free(ctx->handle);
     ctx->handle = NULL;
     return;
@@ -142,6 +166,137 @@ cc_enclave_result_t cc_sec_chl_client_decrypt(cc_sec_chl_ctx_t *ctx, void *encry
     return sec_chl_decrypt(ctx->handle->ecdh_ctx, ctx->session_id, encrypt, encrypt_len, plain, plain_len);
 }
 
+cc_enclave_result_t cc_sec_chl_client_encryptv(cc_sec_chl_ctx_t *ctx, const cc_sec_chl_iovec_t *plain,
+    size_t plain_cnt, void *encrypt, size_t *encrypt_len)
+{
+    size_t plain_len = 0;
+
+    if (ctx == NULL || encrypt_len == NULL || !get_iovec_len(plain, plain_cnt, &plain_len) || plain_len == 0) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (ctx->handle == NULL) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+
+    size_t need_len = get_encrypted_buf_len(plain_len);
+    if (encrypt == NULL || *encrypt_len < need_len) {
+        *encrypt_len = need_len;
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
+
+    return sec_chl_encryptv(ctx->handle->ecdh_ctx, ctx->session_id, plain, plain_cnt, encrypt, encrypt_len);
+}
+
+cc_enclave_result_t cc_sec_chl_client_decryptv(cc_sec_chl_ctx_t *ctx, void *encrypt, size_t encrypt_len,
+    const cc_sec_chl_iovec_t *plain, size_t plain_cnt, size_t *plain_len)
+{
+    if (ctx == NULL || encrypt == NULL || encrypt_len == 0 || plain_len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (ctx->handle == NULL) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+
+    return sec_chl_decryptv(ctx->handle->ecdh_ctx, ctx->session_id, encrypt, encrypt_len, plain, plain_cnt,
+        plain_len);
+}
+
+cc_enclave_result_t cc_sec_chl_client_encrypt_inplace(cc_sec_chl_ctx_t *ctx, void *buf, size_t buf_len,
+    size_t plain_len)
+{
+    if (ctx == NULL || buf == NULL || plain_len == 0 || buf_len < get_encrypted_buf_len(plain_len)) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (ctx->handle == NULL) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+
+    size_t encrypt_len = 0;
+    cc_sec_chl_iovec_t data = {(uint8_t *)buf + CC_SEC_CHL_HEADER_LEN, plain_len};
+    return sec_chl_encryptv(ctx->handle->ecdh_ctx, ctx->session_id, &data, 1, buf, &encrypt_len);
+}
+
+cc_enclave_result_t cc_sec_chl_client_decrypt_inplace(cc_sec_chl_ctx_t *ctx, void *buf, size_t buf_len,
+    size_t *plain_len)
+{
+    if (ctx == NULL || buf == NULL || buf_len <= CC_SEC_CHL_HEADER_LEN || plain_len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (ctx->handle == NULL) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+
+    cc_sec_chl_iovec_t data = {(uint8_t *)buf + CC_SEC_CHL_HEADER_LEN, buf_len - CC_SEC_CHL_HEADER_LEN};
+    return sec_chl_decryptv(ctx->handle->ecdh_ctx, ctx->session_id, buf, buf_len, &data, 1, plain_len);
+}
+
+static cc_enclave_result_t sec_chl_client_stream_init(cc_sec_chl_ctx_t *ctx, bool is_encrypt, void *header,
+    size_t header_len, cc_sec_chl_stream_t **stream)
+{
+    if (ctx == NULL || header == NULL || header_len < CC_SEC_CHL_STREAM_HEADER_LEN || stream == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (ctx->handle == NULL) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+
+    return sec_chl_stream_init(ctx->handle->ecdh_ctx, ctx->session_id, is_encrypt, header, stream);
+}
+
+cc_enclave_result_t cc_sec_chl_client_stream_encrypt_init(cc_sec_chl_ctx_t *ctx, void *header, size_t header_len,
+    cc_sec_chl_stream_t **stream)
+{
+    return sec_chl_client_stream_init(ctx, true, header, header_len, stream);
+}
+
+cc_enclave_result_t cc_sec_chl_client_stream_decrypt_init(cc_sec_chl_ctx_t *ctx, void *header, size_t header_len,
+    cc_sec_chl_stream_t **stream)
+{
+    return sec_chl_client_stream_init(ctx, false, header, header_len, stream);
+}
+
+cc_enclave_result_t cc_sec_chl_client_stream_encrypt(cc_sec_chl_stream_t *stream, void *plain, size_t plain_len,
+    bool is_last, void *chunk, size_t *chunk_len)
+{
+    if (stream == NULL || (plain == NULL && plain_len != 0) || plain_len > CC_SEC_CHL_STREAM_MAX_CHUNK_LEN ||
+        chunk_len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    size_t need_len = CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN + plain_len;
+    if (chunk == NULL || *chunk_len < need_len) {
+        *chunk_len = need_len;
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
+
+    return sec_chl_stream_encrypt(stream, plain, plain_len, is_last, chunk, chunk_len);
+}
+
+cc_enclave_result_t cc_sec_chl_client_stream_decrypt(cc_sec_chl_ctx_t *ctx, cc_sec_chl_stream_t *stream,
+    void *chunk, size_t chunk_len, void *plain, size_t *plain_len, bool *is_last)
+{
+    if (ctx == NULL || stream == NULL || chunk == NULL || plain_len == NULL || is_last == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (ctx->handle == NULL) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    size_t need_len = get_stream_plain_len(chunk, chunk_len);
+    if (need_len == SIZE_MAX) {
+        return CC_ERROR_SEC_CHL_ENCRYPTED_LEN_INVALID;
+    }
+    if ((plain == NULL && need_len != 0) || *plain_len < need_len) {
+        *plain_len = need_len;
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
+
+    return sec_chl_stream_decrypt(ctx->handle->ecdh_ctx, stream, chunk, plain, plain_len, is_last);
+}
+
+void cc_sec_chl_client_stream_fini(cc_sec_chl_stream_t *stream)
+{
+    sec_chl_stream_free(stream);
+}
+
 static cc_enclave_result_t sec_chl_destroy_svr(cc_sec_chl_ctx_t *ctx)
 {
     sec_chl_msg_t msg = {0};
@@ -177,6 +332,7 @@ cc_enclave_result_t cc_sec_chl_client_callback(cc_sec_chl_ctx_t *ctx, void *buf,
     memset(ctx->handle->recv_buf, 0, sizeof(ctx->handle->recv_buf));
     memcpy(ctx->handle->recv_buf, buf, len);
     ctx->handle->recv_buf_len = len;
+    pthread_cond_signal(&ctx->handle->recv_cond);
     pthread_mutex_unlock(&ctx->handle->lock);
 
     return CC_SUCCESS;
@@ -248,6 +404,111 @@ static cc_enclave_result_t get_svr_pubkey(cc_sec_chl_ctx_t *ctx)
     return request_report(ctx, SEC_CHL_MSG_GET_SVR_PUBKEY, true);
 }
 
+/*
+ * Process wide cache of verified reports. Verifying a report checks the certificate chain and the measurements of
+ * the server TA, which costs far more than the rest of the handshake. A report whose server pubkey and
+ * measurements are in the cache is not verified again until the entry expires. The nonce of such a report is not
+ * checked either, instead the server has to prove that it holds the private key by signing its exch param.
+ */
+#define SEC_CHL_REPORT_CACHE_NUM 64
+#define SEC_CHL_REPORT_CACHE_TTL 300  // seconds
+typedef struct {
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    time_t expire;
+} sec_chl_report_cache_t;
+
+static sec_chl_report_cache_t g_report_cache[SEC_CHL_REPORT_CACHE_NUM];
+static pthread_mutex_t g_report_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static time_t get_monotonic_sec(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static bool is_report_in_cache(const uint8_t *digest)
+{
+    bool is_found = false;
+    time_t now = get_monotonic_sec();
+
+    pthread_mutex_lock(&g_report_cache_lock);
+    for (size_t i = 0; i < SEC_CHL_REPORT_CACHE_NUM; i++) {
+        if (g_report_cache[i].expire > now && memcmp(g_report_cache[i].digest, digest, SHA256_DIGEST_LENGTH) == 0) {
+            is_found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_report_cache_lock);
+    return is_found;
+}
+
+// cache the report once the server has signed its exch param, a server which does not sign is never cached
+static void add_report_to_cache(cc_sec_chl_handle_t *handle)
+{
+    if (!handle->is_report_verified) {
+        return;
+    }
+    time_t now = get_monotonic_sec();
+
+    pthread_mutex_lock(&g_report_cache_lock);
+    sec_chl_report_cache_t *victim = &g_report_cache[0];
+    for (size_t i = 0; i < SEC_CHL_REPORT_CACHE_NUM; i++) {
+        sec_chl_report_cache_t *entry = &g_report_cache[i];
+        if (memcmp(entry->digest, handle->report_digest, SHA256_DIGEST_LENGTH) == 0) {
+            victim = entry;
+            break;
+        }
+        if (entry->expire < victim->expire) {
+            victim = entry;
+        }
+    }
+    memcpy(victim->digest, handle->report_digest, SHA256_DIGEST_LENGTH);
+    victim->expire = now + SEC_CHL_REPORT_CACHE_TTL;
+    pthread_mutex_unlock(&g_report_cache_lock);
+}
+
+static int digest_update_str(EVP_MD_CTX *md_ctx, const char *str)
+{
+    // the terminating null separates the fields
+    return EVP_DigestUpdate(md_ctx, str, strlen(str) + 1);
+}
+
+/*
+ * The report is cached by the server pubkey, the uuid and measurements of the server TA, and the basevalue file
+ * it is verified against, so that changing the file invalidates the entries verified by the old one.
+ */
+static cc_enclave_result_t calc_report_digest(cc_sec_chl_ctx_t *ctx, cJSON *cj_payload, char *b64_n, char *b64_e)
+{
+    struct stat st;
+    char *uuid = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cj_payload, "uuid"));
+    char *ta_img = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cj_payload, "ta_img"));
+    char *ta_mem = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cj_payload, "ta_mem"));
+    if (uuid == NULL || ta_img == NULL || ta_mem == NULL || stat(ctx->basevalue, &st) != 0) {
+        printf("report measurement failed!\n");
+        return CC_ERROR_SEC_CHL_INVALID_REPORT;
+    }
+
+    EVP_MD_CTX *md_ctx = EVP_MD_CTX_new();
+    if (md_ctx == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    cc_enclave_result_t ret = CC_FAIL;
+    if (EVP_DigestInit_ex(md_ctx, EVP_sha256(), NULL) <= 0 || digest_update_str(md_ctx, b64_n) <= 0 ||
+        digest_update_str(md_ctx, b64_e) <= 0 || digest_update_str(md_ctx, uuid) <= 0 ||
+        digest_update_str(md_ctx, ta_img) <= 0 || digest_update_str(md_ctx, ta_mem) <= 0 ||
+        digest_update_str(md_ctx, ctx->basevalue) <= 0 ||
+        EVP_DigestUpdate(md_ctx, &st.st_mtim, sizeof(st.st_mtim)) <= 0 ||
+        EVP_DigestUpdate(md_ctx, &st.st_size, sizeof(st.st_size)) <= 0 ||
+        EVP_DigestFinal_ex(md_ctx, ctx->handle->report_digest, NULL) <= 0) {
+        goto end;
+    }
+    ret = CC_SUCCESS;
+end:
+    EVP_MD_CTX_free(md_ctx);
+    return ret;
+}
+
 static cc_enclave_result_t get_svr_key_from_report(cc_sec_chl_ctx_t *ctx, cc_ra_buf_t *report)
 {
     cc_enclave_result_t ret = CC_ERROR_SEC_CHL_INVALID_REPORT;
@@ -289,6 +550,11 @@ static cc_enclave_result_t get_svr_key_from_report(cc_sec_chl_ctx_t *ctx, cc_ra_
     }
     size_t e_len = 0;
     e = kpsecl_base64urldecode(b64_e, strlen(b64_e), &e_len);
+    ret = calc_report_digest(ctx, cj_payload, b64_n, b64_e);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    ret = CC_ERROR_SEC_CHL_INVALID_REPORT;
 
     RSA *svr_pub_key = RSA_new();
     BIGNUM *modulus = BN_new();
@@ -367,16 +633,22 @@ static cc_enclave_result_t parse_svrpubkey_from_recv_msg(cc_sec_chl_ctx_t *ctx,
         nonce.len = SEC_CHL_REQ_NONCE_LEN;
         nonce.buf = ctx->handle->ra_req.nonce;
 
-        ret = cc_verify_report(&report, &nonce, CC_RA_VERIFY_TYPE_STRICT, ctx->basevalue);
+        // the pubkey is not trusted until the report is verified, or found in the cache of verified reports
+        ret = get_svr_key_from_report(ctx, &report);
         if (ret != CC_SUCCESS) {
-            printf("verify report failed ret:%u\n", ret);
-            return CC_ERROR_SEC_CHL_INIT_VERIFY_REPORT;
+            return ret;
+        }
+        if (is_report_in_cache(ctx->handle->report_digest)) {
+            ctx->handle->is_report_cached = true;
+            return CC_SUCCESS;
         }
 
-        ret = get_svr_key_from_report(ctx, &report);
+        ret = cc_verify_report(&report, &nonce, CC_RA_VERIFY_TYPE_STRICT, ctx->basevalue);
         if (ret != CC_SUCCESS) {
-            return ret;
+            printf("verify report failed ret:%u\n", ret);
+            return CC_ERROR_SEC_CHL_INIT_VERIFY_REPORT;
         }
+        ctx->handle->is_report_verified = true;
     } else {
         RSA *rsa_pubkey = get_rsakey_from_buffer(msg->data, msg->data_len, false);
         if (rsa_pubkey == NULL) {
@@ -467,10 +739,17 @@ static cc_enclave_result_t recv_set_enc_key_ret(cc_sec_chl_ctx_t *ctx)
 
 static cc_enclave_result_t get_svr_param(cc_sec_chl_ctx_t *ctx)
 {
-    sec_chl_msg_t msg = {0};
-    msg.msg_type = SEC_CHL_MSG_GET_SVR_EXCH_PARAM;
-    msg.session_id = ctx->session_id;
-    cc_enclave_result_t ret = sec_chl_send_request(&(ctx->conn_kit), &msg);
+    uint8_t buf[sizeof(sec_chl_msg_t) + sizeof(int32_t)] = {0};
+    sec_chl_msg_t *msg = (sec_chl_msg_t *)buf;
+    msg->msg_type = SEC_CHL_MSG_GET_SVR_EXCH_PARAM;
+    msg->session_id = ctx->session_id;
+    // propose a suite other than the default one, which an old server does not expect
+    if (ctx->handle->algo != CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM) {
+        int32_t algo = (int32_t)ctx->handle->algo;
+        memcpy(msg->data, &algo, sizeof(algo));
+        msg->data_len = sizeof(algo);
+    }
+    cc_enclave_result_t ret = sec_chl_send_request(&(ctx->conn_kit), msg);
     if (ret != CC_SUCCESS) {
         return CC_ERROR_SEC_CHL_GET_PEER_EXCH_PARAM;
     }
@@ -491,7 +770,16 @@ static cc_enclave_result_t recv_svr_param(cc_sec_chl_ctx_t *ctx)
     msg = (sec_chl_msg_t *)ctx->handle->recv_buf;
     memcpy(&ec_nid, msg->data + RANDOM_LEN, sizeof(int));
 
-    ret = verify_signature(ctx->handle->rsa_svr_pubkey, msg->data, msg->data_len);
+    ret = verify_signature(ctx->handle->rsa_svr_pubkey, msg->data, msg->data_len, true);
+    if (ret == CC_SUCCESS) {
+        add_report_to_cache(ctx->handle);
+    } else if (!ctx->handle->is_report_cached) {
+        ret = verify_signature(ctx->handle->rsa_svr_pubkey, msg->data, msg->data_len, false);
+    }
+    if (ret == CC_SUCCESS && ctx->handle->algo != CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM &&
+        ec_nid != get_sec_chl_algo_ec_nid(ctx->handle->algo)) {
+        ret = CC_ERROR_SEC_CHL_ALGO_NOT_SUPPORTED;
+    }
     if (ret != CC_SUCCESS) {
         pthread_mutex_unlock(&ctx->handle->lock);
         return ret;
@@ -502,6 +790,7 @@ static cc_enclave_result_t recv_svr_param(cc_sec_chl_ctx_t *ctx)
         pthread_mutex_unlock(&ctx->handle->lock);
         return CC_ERROR_SEC_CHL_GEN_LOCAL_EXCH_PARAM;
     }
+    ecdh_ctx->algo = ctx->handle->algo;
 
     ecdh_ctx->svr_exch_param_buf = (uint8_t *)calloc(1, msg->data_len);
     if (ecdh_ctx->svr_exch_param_buf == NULL) {
@@ -562,6 +851,11 @@ static cc_enclave_result_t recv_set_param_ret(cc_sec_chl_ctx_t *ctx)
     }
     msg = (sec_chl_msg_t *)ctx->handle->recv_buf;
     ret = msg->ret;
+    // a server without resumption sends no ticket
+    if (ret == CC_SUCCESS && msg->data_len == SEC_CHL_TICKET_LEN) {
+        memcpy(ctx->handle->ticket, msg->data, SEC_CHL_TICKET_LEN);
+        ctx->handle->has_ticket = true;
+    }
     ctx->handle->recv_buf_len = 0;
     pthread_mutex_unlock(&ctx->handle->lock);
 
@@ -584,12 +878,16 @@ static cc_enclave_result_t sec_chl_compute_session_key(cc_sec_chl_ctx_t *ctx)
         del_exch_param(svr_exch_param_buf);
         return ret;
     }
-    ret = compute_session_key(ctx->handle->ecdh_ctx, local_exch_param, svr_exch_param_buf);
+    ret = compute_session_key(ctx->handle->ecdh_ctx, local_exch_param, svr_exch_param_buf, true);
     if (ret != CC_SUCCESS) {
         del_exch_param(svr_exch_param_buf);
         del_exch_param(local_exch_param);
         return ret;
     }
+    if (ctx->handle->has_ticket &&
+        get_resume_secret(ctx->handle->ecdh_ctx, ctx->handle->resume_secret) != CC_SUCCESS) {
+        ctx->handle->has_ticket = false;
+    }
 
     del_exch_param(svr_exch_param_buf);
     del_exch_param(local_exch_param);
@@ -609,28 +907,245 @@ static sec_chl_fsm_state_transform_t g_state_transform_table[] = {
     {sec_chl_compute_session_key},
 };
 
-#define RECV_MSG_TIMEOUT_CNT 1000
-#define RECV_MSG_INTERVAL (60 * 1000)
-cc_enclave_result_t sec_chl_run_fsm(cc_sec_chl_ctx_t *ctx)
+static cc_enclave_result_t send_resume_req(cc_sec_chl_ctx_t *ctx)
+{
+    size_t len = sizeof(sec_chl_msg_t) + sizeof(sec_chl_resume_msg_t);
+    sec_chl_msg_t *msg = (sec_chl_msg_t *)calloc(1, len);
+    if (msg == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    if (RAND_bytes(ctx->handle->cli_random, RANDOM_LEN) != 1) {
+        free(msg);
+        return CC_ERROR_SEC_CHL_GEN_RANDOM;
+    }
+    sec_chl_resume_msg_t *req = (sec_chl_resume_msg_t *)msg->data;
+    memcpy(req->random, ctx->handle->cli_random, RANDOM_LEN);
+    memcpy(req->ticket, ctx->handle->ticket, SEC_CHL_TICKET_LEN);
+    msg->data_len = sizeof(sec_chl_resume_msg_t);
+    msg->msg_type = SEC_CHL_MSG_RESUME;
+
+    cc_enclave_result_t ret = sec_chl_send_request(&ctx->conn_kit, msg);
+    free(msg);
+    return ret;
+}
+
+static cc_enclave_result_t compute_resume_key(cc_sec_chl_ctx_t *ctx, sec_chl_resume_msg_t *rsp)
+{
+    sec_chl_ecdh_ctx_t *ecdh_ctx = (sec_chl_ecdh_ctx_t *)calloc(1, sizeof(sec_chl_ecdh_ctx_t));
+    if (ecdh_ctx == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    ecdh_ctx->algo = ctx->handle->algo;
+    cc_enclave_result_t ret = compute_resume_session_key(ecdh_ctx, ctx->handle->resume_secret,
+        ctx->handle->cli_random, rsp->random, true);
+    if (ret == CC_SUCCESS) {
+        // the server issued a ticket of the resumed session, it replaces the presented one
+        ret = get_resume_secret(ecdh_ctx, ctx->handle->resume_secret);
+    }
+    if (ret != CC_SUCCESS) {
+        del_ecdh_ctx(ecdh_ctx);
+        return ret;
+    }
+    memcpy(ctx->handle->ticket, rsp->ticket, SEC_CHL_TICKET_LEN);
+    ctx->handle->ecdh_ctx = ecdh_ctx;
+    return CC_SUCCESS;
+}
+
+static cc_enclave_result_t recv_resume_rsp(cc_sec_chl_ctx_t *ctx)
 {
     cc_enclave_result_t ret;
-    int cnt = 0;
-    for (size_t i = 0; i < sizeof(g_state_transform_table) / sizeof(g_state_transform_table[0]);) {
-        ret = g_state_transform_table[i].action(ctx);
-        if (ret == CC_ERROR_SEC_CHL_WAITING_RECV_MSG && cnt < RECV_MSG_TIMEOUT_CNT) {
-            cnt++;
-            usleep(RECV_MSG_INTERVAL);
-            continue;
-        }
+
+    pthread_mutex_lock(&ctx->handle->lock);
+    if (ctx->handle->recv_buf_len == 0) {
+        pthread_mutex_unlock(&ctx->handle->lock);
+        return CC_ERROR_SEC_CHL_WAITING_RECV_MSG;
+    }
+    sec_chl_msg_t *msg = (sec_chl_msg_t *)ctx->handle->recv_buf;
+    ret = msg->ret;
+    if (ret == CC_SUCCESS && (msg->data_len != sizeof(sec_chl_resume_msg_t) ||
+        ctx->handle->recv_buf_len < sizeof(sec_chl_msg_t) + sizeof(sec_chl_resume_msg_t))) {
+        ret = CC_ERROR_SEC_CHL_RECV_MSG_LEN_INVALID;
+    }
+    if (ret == CC_SUCCESS) {
+        ret = compute_resume_key(ctx, (sec_chl_resume_msg_t *)msg->data);
+    }
+    if (ret == CC_SUCCESS) {
+        ctx->session_id = msg->session_id;
+    }
+    ctx->handle->recv_buf_len = 0;
+    pthread_mutex_unlock(&ctx->handle->lock);
+
+    return ret;
+}
+
+/*
+ * The compact handshake takes two round trips: the client picks the default curve instead of asking the server,
+ * and sends the enc key together with its exch param. The server exch param comes back signed, so it must be.
+ */
+static cc_enclave_result_t gen_compact_param(cc_sec_chl_ctx_t *ctx)
+{
+    if (ctx->handle->rsa_svr_pubkey == NULL) {
+        return CC_ERROR_SEC_CHL_GET_SVR_PUBKEY;
+    }
+    sec_chl_ecdh_ctx_t *ecdh_ctx = new_local_ecdh_ctx(get_sec_chl_algo_ec_nid(ctx->handle->algo));
+    if (ecdh_ctx == NULL) {
+        return CC_ERROR_SEC_CHL_GEN_LOCAL_EXCH_PARAM;
+    }
+    ecdh_ctx->algo = ctx->handle->algo;
+    ctx->handle->ecdh_ctx = ecdh_ctx;
+    return gen_local_exch_buf(ecdh_ctx);
+}
+
+static cc_enclave_result_t send_compact_finish(cc_sec_chl_ctx_t *ctx)
+{
+    sec_chl_ecdh_ctx_t *ecdh_ctx = ctx->handle->ecdh_ctx;
+    size_t enc_key_len = ctx->handle->b64_enc_key == NULL ? 0 : strlen(ctx->handle->b64_enc_key);
+    size_t data_len = sizeof(sec_chl_compact_msg_t) + enc_key_len + ecdh_ctx->local_exch_param_buf_len;
+
+    sec_chl_msg_t *msg = (sec_chl_msg_t *)calloc(1, sizeof(sec_chl_msg_t) + data_len);
+    if (msg == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    sec_chl_compact_msg_t *req = (sec_chl_compact_msg_t *)msg->data;
+    req->algo = (int32_t)ctx->handle->algo;
+    req->len = enc_key_len;
+    if (enc_key_len > 0) {
+        memcpy(req->data, ctx->handle->b64_enc_key, enc_key_len);
+    }
+    memcpy(req->data + enc_key_len, ecdh_ctx->local_exch_param_buf, ecdh_ctx->local_exch_param_buf_len);
+    msg->data_len = data_len;
+    msg->session_id = ctx->session_id;
+    msg->msg_type = SEC_CHL_MSG_COMPACT_FINISH;
+
+    cc_enclave_result_t ret = sec_chl_send_request(&ctx->conn_kit, msg);
+    free(msg);
+    if (ret != CC_SUCCESS) {
+        ret = CC_ERROR_SEC_CHL_SET_PARAM_TO_PEER;
+    }
+    return ret;
+}
+
+static cc_enclave_result_t parse_compact_finish_rsp(cc_sec_chl_ctx_t *ctx, sec_chl_msg_t *msg)
+{
+    sec_chl_compact_msg_t *rsp = (sec_chl_compact_msg_t *)msg->data;
+
+    if (msg->data_len < sizeof(sec_chl_compact_msg_t) ||
+        ctx->handle->recv_buf_len < sizeof(sec_chl_msg_t) + msg->data_len ||
+        rsp->len == 0 || rsp->len > msg->data_len - sizeof(sec_chl_compact_msg_t)) {
+        return CC_ERROR_SEC_CHL_RECV_MSG_LEN_INVALID;
+    }
+    if (rsp->algo != (int32_t)ctx->handle->algo) {
+        return CC_ERROR_SEC_CHL_ALGO_NOT_SUPPORTED;
+    }
+    cc_enclave_result_t ret = verify_signature(ctx->handle->rsa_svr_pubkey, rsp->data, rsp->len, true);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    add_report_to_cache(ctx->handle);
+    sec_chl_ecdh_ctx_t *ecdh_ctx = ctx->handle->ecdh_ctx;
+    ecdh_ctx->svr_exch_param_buf = (uint8_t *)calloc(1, rsp->len);
+    if (ecdh_ctx->svr_exch_param_buf == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    memcpy(ecdh_ctx->svr_exch_param_buf, rsp->data, rsp->len);
+    ecdh_ctx->svr_exch_param_buf_len = rsp->len;
+
+    // a server without resumption sends no ticket
+    if (msg->data_len - sizeof(sec_chl_compact_msg_t) - rsp->len == SEC_CHL_TICKET_LEN) {
+        memcpy(ctx->handle->ticket, rsp->data + rsp->len, SEC_CHL_TICKET_LEN);
+        ctx->handle->has_ticket = true;
+    }
+    return CC_SUCCESS;
+}
+
+static cc_enclave_result_t recv_compact_finish_rsp(cc_sec_chl_ctx_t *ctx)
+{
+    cc_enclave_result_t ret;
+
+    pthread_mutex_lock(&ctx->handle->lock);
+    if (ctx->handle->recv_buf_len == 0) {
+        pthread_mutex_unlock(&ctx->handle->lock);
+        return CC_ERROR_SEC_CHL_WAITING_RECV_MSG;
+    }
+    sec_chl_msg_t *msg = (sec_chl_msg_t *)ctx->handle->recv_buf;
+    ret = msg->ret;
+    if (ret == CC_SUCCESS) {
+        ret = parse_compact_finish_rsp(ctx, msg);
+    }
+    ctx->handle->recv_buf_len = 0;
+    pthread_mutex_unlock(&ctx->handle->lock);
+
+    return ret;
+}
+
+static sec_chl_fsm_state_transform_t g_compact_transform_table[] = {
+    {get_svr_pubkey},
+    {recv_svr_pubkey},
+    {gen_compact_param},
+    {send_compact_finish},
+    {recv_compact_finish_rsp},
+    {sec_chl_compute_session_key},
+};
+
+// one round trip, no ra report and no asymmetric operation
+static sec_chl_fsm_state_transform_t g_resume_transform_table[] = {
+    {send_resume_req},
+    {recv_resume_rsp},
+};
+
+// run the actions from the current step, until one waits for a msg from server or all of them are done
+static cc_enclave_result_t sec_chl_step_fsm(cc_sec_chl_ctx_t *ctx)
+{
+    sec_chl_fsm_state_transform_t *table = g_state_transform_table;
+    size_t step_num = sizeof(g_state_transform_table) / sizeof(g_state_transform_table[0]);
+    if (ctx->handle->is_resume) {
+        table = g_resume_transform_table;
+        step_num = sizeof(g_resume_transform_table) / sizeof(g_resume_transform_table[0]);
+    } else if (ctx->is_compact) {
+        table = g_compact_transform_table;
+        step_num = sizeof(g_compact_transform_table) / sizeof(g_compact_transform_table[0]);
+    }
+
+    while (ctx->handle->fsm_step < step_num) {
+        cc_enclave_result_t ret = table[ctx->handle->fsm_step].action(ctx);
         if (ret != CC_SUCCESS) {
             return ret;
         }
-        i++;
-        cnt = 0;
+        ctx->handle->fsm_step++;
     }
     return CC_SUCCESS;
 }
 
+#define RECV_MSG_TIMEOUT_SEC 60
+static bool wait_recv_msg(cc_sec_chl_handle_t *handle)
+{
+    struct timespec deadline;
+    int rc = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += RECV_MSG_TIMEOUT_SEC;
+
+    pthread_mutex_lock(&handle->lock);
+    while (handle->recv_buf_len == 0 && rc != ETIMEDOUT) {
+        rc = pthread_cond_timedwait(&handle->recv_cond, &handle->lock, &deadline);
+    }
+    bool is_ready = handle->recv_buf_len != 0;
+    pthread_mutex_unlock(&handle->lock);
+
+    return is_ready;
+}
+
+cc_enclave_result_t sec_chl_run_fsm(cc_sec_chl_ctx_t *ctx)
+{
+    cc_enclave_result_t ret;
+    while ((ret = sec_chl_step_fsm(ctx)) == CC_ERROR_SEC_CHL_WAITING_RECV_MSG) {
+        if (!wait_recv_msg(ctx->handle)) {
+            break;
+        }
+    }
+    return ret;
+}
+
 static bool is_valid_algo(cc_sec_chl_algo_t algo)
 {
     if (algo >= 0 && algo < CC_SEC_CHL_ALGO_MAX) {
@@ -639,6 +1154,28 @@ static bool is_valid_algo(cc_sec_chl_algo_t algo)
     return false;
 }
 
+static cc_enclave_result_t new_local_sec_chl_ctx(cc_sec_chl_algo_t algo, cc_sec_chl_ctx_t *ctx)
+{
+    pthread_condattr_t attr;
+
+    if (!is_sec_chl_algo_supported(algo)) {
+        return CC_ERROR_SEC_CHL_ALGO_NOT_SUPPORTED;
+    }
+    ctx->handle = (cc_sec_chl_handle_t *)calloc(1, sizeof(cc_sec_chl_handle_t));
+    if (ctx->handle == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    ctx->handle->algo = algo;
+    pthread_mutex_init(&ctx->handle->lock, NULL);
+    // the wait for server msg must not be affected by wall clock changes
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ctx->handle->recv_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    return CC_SUCCESS;
+}
+
 cc_enclave_result_t cc_sec_chl_client_init(cc_sec_chl_algo_t algo, cc_sec_chl_ctx_t *ctx)
 {
     if (ctx == NULL || !is_valid_algo(algo)) {
@@ -648,17 +1185,97 @@ cc_enclave_result_t cc_sec_chl_client_init(cc_sec_chl_algo_t algo, cc_sec_chl_ct
     if (!is_valid_conn_kit(&ctx->conn_kit)) {
         return CC_ERROR_SEC_CHL_INVALID_CONN;
     }
-    ctx->handle = (cc_sec_chl_handle_t *)calloc(1, sizeof(cc_sec_chl_handle_t));
-    if (ctx->handle == NULL) {
-        return CC_ERROR_SEC_CHL_MEMORY;
+    cc_enclave_result_t ret = new_local_sec_chl_ctx(algo, ctx);
+    if (ret != CC_SUCCESS) {
+        return ret;
     }
-    ctx->handle->algo = algo;
-    pthread_mutex_init(&ctx->handle->lock, NULL);
 
-    cc_enclave_result_t ret = sec_chl_run_fsm(ctx);
+    ret = sec_chl_run_fsm(ctx);
     if (ret != CC_SUCCESS) {
         cc_sec_chl_client_fini(ctx);
     }
 
     return ret;
 }
+
+cc_enclave_result_t cc_sec_chl_client_init_start(cc_sec_chl_algo_t algo, cc_sec_chl_ctx_t *ctx)
+{
+    if (ctx == NULL || !is_valid_algo(algo)) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    if (!is_valid_conn_kit(&ctx->conn_kit)) {
+        return CC_ERROR_SEC_CHL_INVALID_CONN;
+    }
+    cc_enclave_result_t ret = new_local_sec_chl_ctx(algo, ctx);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+
+    return cc_sec_chl_client_init_continue(ctx);
+}
+
+cc_enclave_result_t cc_sec_chl_client_init_continue(cc_sec_chl_ctx_t *ctx)
+{
+    if (ctx == NULL || ctx->handle == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    cc_enclave_result_t ret = sec_chl_step_fsm(ctx);
+    if (ret != CC_SUCCESS && ret != CC_ERROR_SEC_CHL_WAITING_RECV_MSG) {
+        cc_sec_chl_client_fini(ctx);
+    }
+
+    return ret;
+}
+
+cc_enclave_result_t cc_sec_chl_client_resume(cc_sec_chl_algo_t algo, cc_sec_chl_ctx_t *ctx,
+    void *ticket, size_t ticket_len)
+{
+    if (ctx == NULL || !is_valid_algo(algo) || ticket == NULL || ticket_len != sizeof(sec_chl_client_ticket_t) ||
+        ((sec_chl_client_ticket_t *)ticket)->algo != (int32_t)algo) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    if (!is_valid_conn_kit(&ctx->conn_kit)) {
+        return CC_ERROR_SEC_CHL_INVALID_CONN;
+    }
+    cc_enclave_result_t ret = new_local_sec_chl_ctx(algo, ctx);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    sec_chl_client_ticket_t *in = (sec_chl_client_ticket_t *)ticket;
+    memcpy(ctx->handle->resume_secret, in->resume_secret, SECURE_KEY_LEN);
+    memcpy(ctx->handle->ticket, in->ticket, SEC_CHL_TICKET_LEN);
+    ctx->handle->has_ticket = true;
+    ctx->handle->is_resume = true;
+
+    ret = sec_chl_run_fsm(ctx);
+    if (ret != CC_SUCCESS) {
+        cc_sec_chl_client_fini(ctx);
+    }
+
+    return ret;
+}
+
+cc_enclave_result_t cc_sec_chl_client_export_ticket(cc_sec_chl_ctx_t *ctx, void *ticket, size_t *ticket_len)
+{
+    if (ctx == NULL || ticket_len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (ctx->handle == NULL || ctx->handle->ecdh_ctx == NULL || !ctx->handle->has_ticket) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    if (ticket == NULL || *ticket_len < sizeof(sec_chl_client_ticket_t)) {
+        *ticket_len = sizeof(sec_chl_client_ticket_t);
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
+
+    sec_chl_client_ticket_t *out = (sec_chl_client_ticket_t *)ticket;
+    memcpy(out->resume_secret, ctx->handle->resume_secret, SECURE_KEY_LEN);
+    memcpy(out->ticket, ctx->handle->ticket, SEC_CHL_TICKET_LEN);
+    out->algo = (int32_t)ctx->handle->algo;
+    *ticket_len = sizeof(sec_chl_client_ticket_t);
+
+    return CC_SUCCESS;
+}
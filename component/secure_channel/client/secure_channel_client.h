@@ -42,17 +42,9 @@ typedef struct cc_sec_chl_ctx {
     cc_conn_kit_t conn_kit;         // network transmission connection kit need register by user
     cc_sec_chl_handle_t *handle;
     char *basevalue; // target ta basevalue file path
+    bool is_compact; // two round trips handshake instead of four, the server must support it
 } cc_sec_chl_ctx_t;
 
-typedef enum {
-    CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM,   // international Data Encryption Algorithm suite
-    // some algos suite to implement below
-    // CC_SEC_CHL_ALGO_SM2_ECDH_SM4,       // shang mi suite
-    // CC_SEC_CHL_ALGO_RSA,                // RSA public private key
-    // CC_SEC_CHL_ALGO_SM2,                // SM2 public private key
-    CC_SEC_CHL_ALGO_MAX
-} cc_sec_chl_algo_t;
-
 /**
 * secure channel init function
 * [Warning] because TA report is big, the conn_kit must have bigger read buffer
@@ -70,6 +62,70 @@ typedef enum {
 */
 cc_enclave_result_t cc_sec_chl_client_init(cc_sec_chl_algo_t algo, cc_sec_chl_ctx_t *ctx);
 
+/**
+* non-blocking variant of cc_sec_chl_client_init, which lets one thread drive many handshakes from an event loop.
+* it sends the first request and returns without waiting for the reply of server.
+* the conn_kit send hook must not call cc_sec_chl_client_callback itself in this mode, the caller passes each
+* server msg to cc_sec_chl_client_callback and then calls cc_sec_chl_client_init_continue.
+*
+* @param[in] algo, The algorithm suite of secure channel
+*
+* @param[in/out] ctx, The pointer of secure channel context, same as cc_sec_chl_client_init
+*
+* @retval, CC_ERROR_SEC_CHL_WAITING_RECV_MSG, the handshake waits for a msg from server.
+*          On success, return 0. generate session_key between client and enclave.
+*          On error, cc_enclave_result_t errorno is returned, and the context is destroyed.
+*/
+cc_enclave_result_t cc_sec_chl_client_init_start(cc_sec_chl_algo_t algo, cc_sec_chl_ctx_t *ctx);
+
+/**
+* advance the handshake started by cc_sec_chl_client_init_start after a server msg has been passed to
+* cc_sec_chl_client_callback, never blocks.
+*
+* @param[in/out] ctx, The pointer of secure channel context
+*
+* @retval, CC_ERROR_SEC_CHL_WAITING_RECV_MSG, the handshake waits for the next msg from server.
+*          On success, return 0. generate session_key between client and enclave.
+*          On error, cc_enclave_result_t errorno is returned, and the context is destroyed.
+*/
+cc_enclave_result_t cc_sec_chl_client_init_continue(cc_sec_chl_ctx_t *ctx);
+
+/**
+* resume a secure channel by the resumption ticket of a previous session, it costs one round trip,
+* no ra report and no asymmetric operation. The server rejects a ticket issued by another server enclave
+* instance or older than the ticket lifetime, then the caller falls back to cc_sec_chl_client_init.
+*
+* @param[in] algo, The algorithm suite of secure channel
+*
+* @param[in/out] ctx, The pointer of secure channel context, same as cc_sec_chl_client_init
+*
+* @param[in] ticket, The ticket exported by cc_sec_chl_client_export_ticket
+*
+* @param[in] ticket_len, The length of ticket
+*
+* @retval, On success, return 0. generate session_key between client and enclave.
+*          CC_ERROR_SEC_CHL_TICKET_INVALID, the ticket is expired or unknown to the server.
+*          On error, cc_enclave_result_t errorno is returned, and the context is destroyed.
+*/
+cc_enclave_result_t cc_sec_chl_client_resume(cc_sec_chl_algo_t algo, cc_sec_chl_ctx_t *ctx,
+    void *ticket, size_t ticket_len);
+
+/**
+* export the resumption ticket of an established secure channel, a resumed channel has a new ticket.
+* [Warning] the ticket includes the resumption secret, keep it as secret as the data the channel protects.
+*
+* @param[in] ctx, The secure channel connection context
+*
+* @param[out] ticket, The buf of ticket. If NULL return error, and assign the needed length to ticket_len
+*
+* @param[in/out] ticket_len, The pointer of ticket buffer length. If ticket_len is not enough, will return error,
+* and assign the needed length to ticket_len
+*
+* @retval On success, 0 is returned. CC_ERROR_SEC_CHL_NOTREADY, the server issued no ticket.
+*         On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_client_export_ticket(cc_sec_chl_ctx_t *ctx, void *ticket, size_t *ticket_len);
+
 /**
 * secure channel uninit function, destory secure channel resource
 *
@@ -129,6 +185,163 @@ cc_enclave_result_t cc_sec_chl_client_encrypt(cc_sec_chl_ctx_t *ctx, void *plain
 cc_enclave_result_t cc_sec_chl_client_decrypt(cc_sec_chl_ctx_t *ctx, void *encrypt, size_t encrypt_len,
     void *plain, size_t *plain_len);
 
+/**
+* This function will encrypt the plain data gathered from several segments into one encrypted msg
+*
+* @param[in] ctx, The secure channel connection context
+*
+* @param[in] plain, The segments to be encrypt, in order
+*
+* @param[in] plain_cnt, The number of segments
+*
+* @param[out] encrypt, The buf of encrypted. If NULL return error, and assign the needed length to encrypt_len
+*
+* @param[in/out] encrypt_len, The pointer of encrypted buffer length. If encrypt_len is not enough, will return error,
+* and assign the needed length to encrypt_len
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_client_encryptv(cc_sec_chl_ctx_t *ctx, const cc_sec_chl_iovec_t *plain,
+    size_t plain_cnt, void *encrypt, size_t *encrypt_len);
+
+/**
+* This function will decrypt one encrypted msg and scatter the plain data into several segments
+*
+* @param[in] ctx, The secure channel connection context
+*
+* @param[in] encrypt, The buf to be decrypt.
+*
+* @param[in] encrypt_len, The length of encrypted buffer.
+*
+* @param[in] plain, The segments to store decrypt data, filled in order. On error they are cleared
+*
+* @param[in] plain_cnt, The number of segments
+*
+* @param[out] plain_len, The length of decrypt data. If the segments are not enough, will return error,
+* and assign the needed length to plain_len
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_client_decryptv(cc_sec_chl_ctx_t *ctx, void *encrypt, size_t encrypt_len,
+    const cc_sec_chl_iovec_t *plain, size_t plain_cnt, size_t *plain_len);
+
+/**
+* This function will encrypt data in place, the caller puts the plain data at buf + CC_SEC_CHL_HEADER_LEN,
+* after return buf holds the encrypted msg of CC_SEC_CHL_HEADER_LEN + plain_len bytes, ready to send
+*
+* @param[in] ctx, The secure channel connection context
+*
+* @param[in/out] buf, The buf of header area followed by the plain data
+*
+* @param[in] buf_len, The length of buf, at least CC_SEC_CHL_HEADER_LEN + plain_len
+*
+* @param[in] plain_len, The length of plain data
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_client_encrypt_inplace(cc_sec_chl_ctx_t *ctx, void *buf, size_t buf_len,
+    size_t plain_len);
+
+/**
+* This function will decrypt an encrypted msg in place, after return the plain data is at buf + CC_SEC_CHL_HEADER_LEN
+*
+* @param[in] ctx, The secure channel connection context
+*
+* @param[in/out] buf, The encrypted msg
+*
+* @param[in] buf_len, The length of encrypted msg
+*
+* @param[out] plain_len, The length of plain data
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_client_decrypt_inplace(cc_sec_chl_ctx_t *ctx, void *buf, size_t buf_len,
+    size_t *plain_len);
+
+/**
+* This function will start a stream to send a large payload as a series of chunks, the stream takes one msg counter
+* of the secure channel. Send the header first and then each chunk, the peer decrypts them in the same order
+*
+* @param[in] ctx, The secure channel connection context
+*
+* @param[out] header, The buf of stream header
+*
+* @param[in] header_len, The length of header buf, at least CC_SEC_CHL_STREAM_HEADER_LEN
+*
+* @param[out] stream, The stream, release it by cc_sec_chl_client_stream_fini
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_client_stream_encrypt_init(cc_sec_chl_ctx_t *ctx, void *header, size_t header_len,
+    cc_sec_chl_stream_t **stream);
+
+/**
+* This function will start a stream to receive a large payload from the stream header sent by the peer
+*
+* @param[in] ctx, The secure channel connection context
+*
+* @param[in] header, The stream header
+*
+* @param[in] header_len, The length of stream header, at least CC_SEC_CHL_STREAM_HEADER_LEN
+*
+* @param[out] stream, The stream, release it by cc_sec_chl_client_stream_fini
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_client_stream_decrypt_init(cc_sec_chl_ctx_t *ctx, void *header, size_t header_len,
+    cc_sec_chl_stream_t **stream);
+
+/**
+* This function will encrypt the next chunk of a stream
+*
+* @param[in] stream, The stream started by cc_sec_chl_client_stream_encrypt_init
+*
+* @param[in] plain, The plain data of the chunk
+*
+* @param[in] plain_len, The length of plain data, at most CC_SEC_CHL_STREAM_MAX_CHUNK_LEN, 0 is allowed
+*
+* @param[in] is_last, Whether it is the last chunk, no chunk can follow it
+*
+* @param[out] chunk, The buf of encrypted chunk. If NULL return error, and assign the needed length to chunk_len
+*
+* @param[in/out] chunk_len, The length of chunk buf, CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN + plain_len is needed
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_client_stream_encrypt(cc_sec_chl_stream_t *stream, void *plain, size_t plain_len,
+    bool is_last, void *chunk, size_t *chunk_len);
+
+/**
+* This function will decrypt the next chunk of a stream. Each chunk is authentic on its own, but the payload is
+* complete only after the last chunk is decrypted. Once a chunk fails, the stream can not go on
+*
+* @param[in] ctx, The secure channel connection context
+*
+* @param[in] stream, The stream started by cc_sec_chl_client_stream_decrypt_init
+*
+* @param[in] chunk, The encrypted chunk
+*
+* @param[in] chunk_len, The length of encrypted chunk
+*
+* @param[out] plain, The buf to store decrypt data, cleared on error
+*
+* @param[in/out] plain_len, The length of plain buf, and the length of decrypt data on return. If plain_len is
+* not enough, will return error, and assign the needed length to plain_len
+*
+* @param[out] is_last, Whether the chunk is the last one of the stream
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_client_stream_decrypt(cc_sec_chl_ctx_t *ctx, cc_sec_chl_stream_t *stream,
+    void *chunk, size_t chunk_len, void *plain, size_t *plain_len, bool *is_last);
+
+/**
+* This function will release the stream, which may stop at any chunk
+*
+* @param[in] stream, The stream
+*/
+void cc_sec_chl_client_stream_fini(cc_sec_chl_stream_t *stream);
+
 # ifdef  __cplusplus
 }
 # endif
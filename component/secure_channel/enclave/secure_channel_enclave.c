@@ -33,6 +33,7 @@ static int eccurve_support[] = {
     NID_brainpoolP320r1, // brainpoolP320r1
     NID_brainpoolP384r1, // brainpoolP384r1
     NID_brainpoolP512r1, // brainpoolP512r1
+    NID_sm2,             // sm2
     NID_X25519,          // X25519
     NID_X448,            // X448
 };
@@ -103,18 +104,88 @@ static void sc_fini_rwlock(sc_lock_t *lock)
 
 typedef struct sec_chl_node {
     size_t session_id;
-    time_t inactive_cnt;   // the inactive count of session
+    uint64_t active_tick;   // tick of the last msg, accessed atomically
+    uint64_t deadline;      // tick of the next check
+    struct sec_chl_node *wheel_next;
+    struct sec_chl_node **wheel_pprev;
+    struct sec_chl_node *lru_prev;  // towards the more recently active sessions of the shard
+    struct sec_chl_node *lru_next;
+    bool is_ready;          // session key is computed, a resumption ticket can be issued
+    uint64_t ticket_tick;   // tick of the full handshake, inherited by the sessions resumed from it
+    size_t bytes;           // charged to the memory budget of the sessions
     sec_chl_ecdh_ctx_t *ecdh_ctx;
     struct sec_chl_node *next;
 } SEC_CHL_NODE;
 
-/* The max secure channel connection number at the same time */
+/*
+ * Sessions are kept in a hash table sharded by session id, a shard has its own lock and buckets. Session ids are
+ * random, so the low bits select the shard and the next bits select the bucket. Encrypt and decrypt only take the
+ * read lock of one shard.
+ */
+#define SEC_CHL_SHARD_BITS 6
+#define SEC_CHL_SHARD_NUM (1U << SEC_CHL_SHARD_BITS)
+#define SEC_CHL_MIN_BUCKET_NUM 16
+#define SEC_CHL_MAX_BUCKET_NUM (1U << 16)
+#define SEC_CHL_CACHE_LINE_SIZE 64
+
+/*
+ * secure channel connection timeout SEL_CHL_CONN_TIMEOUT_CNT * TIMER_INTERVAL seconds of the host.
+ * Each shard has a timing wheel of SEC_CHL_WHEEL_SLOT_NUM slots, one slot per timer tick, and a session is linked in
+ * the slot of its deadline. A msg only records the tick in the session. When the deadline comes, a session with a msg
+ * since the last check moves to the slot of the next period and an idle one is released, so a session is released
+ * after one to two periods without msg. A timer tick only touches the sessions whose deadline comes.
+ */
+static const uint64_t SEL_CHL_CONN_TIMEOUT_CNT = 15;
+#define SEC_CHL_CHECK_PERIOD (SEL_CHL_CONN_TIMEOUT_CNT + 1)
+#define SEC_CHL_WHEEL_SLOT_NUM 32  // more than SEC_CHL_CHECK_PERIOD, a deadline never laps the wheel
+/*
+ * The host skips the ticks with nothing due and tells the number of skipped ticks later, the enclave tick lags
+ * behind during the skipped ticks. The lag is bounded, since the ticket lifetime is counted in the enclave tick.
+ * A check counts at most SEC_CHL_MAX_ELAPSED ticks, far past a lap of the wheel and the ticket lifetime, so the
+ * host can not wrap the tick around.
+ */
+#define SEC_CHL_MAX_CHECK_INTERVAL 4
+#define SEC_CHL_MAX_ELAPSED 1024
+
+typedef struct {
+    sc_lock_t     lock;
+    SEC_CHL_NODE  **buckets;
+    SEC_CHL_NODE  *wheel[SEC_CHL_WHEEL_SLOT_NUM];
+    int           lru_lock;  // guards the lru list, which msgs reorder under the read lock of the shard
+    SEC_CHL_NODE  *lru_head;  // most recently active session
+    SEC_CHL_NODE  *lru_tail;  // least recently active session
+} __attribute__((aligned(SEC_CHL_CACHE_LINE_SIZE))) SEC_CHL_SHARD;
+
+/*
+ * The default max secure channel connection number at the same time. A new session which exceeds the max number
+ * or the memory budget of the sessions evicts the least recently active one, unless all of them got a msg in the
+ * current tick. Each shard keeps its sessions in a list ordered by activity, a session moves to the head at its
+ * first msg of a tick. The victim is the oldest of the tails of the shards.
+ */
 #define MAX_SEL_CHL_NUM 1031
+#define SEC_CHL_MAX_EVICT_TRY 4
+// memory of the ec key of a handshake and of the cipher ctxs cached by a session, which openssl does not tell
+#define SEC_CHL_EC_KEY_BYTES 1024
+#define SEC_CHL_CIPHER_CTX_BYTES 1024
+#define RSA_PUBKEY_LEN 640
 typedef struct {
     bool          is_init;
-    sc_lock_t     sec_chl_list_lock;
-    SEC_CHL_NODE  sec_chl_list_head;
-    size_t        count;  // secure channel connection number
+    SEC_CHL_SHARD shards[SEC_CHL_SHARD_NUM];
+    size_t        bucket_mask;  // bucket number of a shard minus one
+    size_t        max_num;  // max secure channel connection number
+    size_t        count;  // secure channel connection number, accessed atomically
+    size_t        max_bytes;  // memory budget of the sessions, 0 means no budget
+    size_t        bytes;  // memory charged by the sessions, accessed atomically
+    uint64_t      evictions;  // accessed atomically
+    uint64_t      rejections;  // accessed atomically
+    sc_lock_t     svr_key_lock;
+    RSA           *svr_rsa_key;  // shared by all sessions, each of them holds a reference
+    uint8_t       svr_pubkey[RSA_PUBKEY_LEN];
+    size_t        svr_pubkey_len;
+    uint8_t       ticket_key[SECURE_KEY_LEN];  // seals resumption tickets, generated when the service starts
+    uint64_t      ticket_seq;  // nonce counter of ticket_key, accessed atomically
+    uint64_t      tick;  // number of session timer ticks since the service starts, accessed atomically
+    cc_sec_chl_batch_handler_t batch_handler;  // handles the msgs of a batch, kept across restarts
 } SEC_CHL_MNG;
 
 static SEC_CHL_MNG g_sec_chl_manager = {
@@ -128,7 +199,7 @@ static SEC_CHL_NODE *new_sec_chl_node()
         PrintInfo(PRINT_ERROR, "malloc failed\n");
         return NULL;
     }
-    node->ecdh_ctx = new_local_ecdh_ctx(NID_brainpoolP256r1);
+    node->ecdh_ctx = new_local_ecdh_ctx(SEC_CHL_DEFAULT_EC_NID);
     if (node->ecdh_ctx == NULL) {
         free(node);
         PrintInfo(PRINT_ERROR, "new local ecdh ctx failed\n");
@@ -142,8 +213,23 @@ static SEC_CHL_NODE *new_sec_chl_node()
         return NULL;
     }
 
-    node->inactive_cnt = 0;
+    return node;
+}
 
+// a resumed session derives its key from the ticket, it needs no ecdh key
+static SEC_CHL_NODE *new_resumed_sec_chl_node()
+{
+    SEC_CHL_NODE *node = (SEC_CHL_NODE *)calloc(1, sizeof(SEC_CHL_NODE));
+    if (node == NULL) {
+        PrintInfo(PRINT_ERROR, "malloc failed\n");
+        return NULL;
+    }
+    node->ecdh_ctx = (sec_chl_ecdh_ctx_t *)calloc(1, sizeof(sec_chl_ecdh_ctx_t));
+    if (node->ecdh_ctx == NULL) {
+        free(node);
+        PrintInfo(PRINT_ERROR, "malloc failed\n");
+        return NULL;
+    }
     return node;
 }
 
@@ -230,67 +316,369 @@ static int gen_rsa_key(RSA **rsa_key)
     return CC_SUCCESS;
 }
 
-static int add_to_sec_chl_list(SEC_CHL_NODE *node)
+static SEC_CHL_SHARD *get_shard(size_t session_id)
+{
+    return &g_sec_chl_manager.shards[session_id & (SEC_CHL_SHARD_NUM - 1)];
+}
+
+static SEC_CHL_NODE **get_bucket(SEC_CHL_SHARD *shard, size_t session_id)
+{
+    return &shard->buckets[(session_id >> SEC_CHL_SHARD_BITS) & g_sec_chl_manager.bucket_mask];
+}
+
+/* The caller holds the write lock of the shard */
+static void wheel_add(SEC_CHL_SHARD *shard, SEC_CHL_NODE *node, uint64_t deadline)
+{
+    SEC_CHL_NODE **slot = &shard->wheel[deadline % SEC_CHL_WHEEL_SLOT_NUM];
+
+    node->deadline = deadline;
+    node->wheel_next = *slot;
+    if (*slot != NULL) {
+        (*slot)->wheel_pprev = &node->wheel_next;
+    }
+    node->wheel_pprev = slot;
+    __atomic_store_n(slot, node, __ATOMIC_RELAXED);
+}
+
+/* The caller holds the write lock of the shard */
+static void wheel_del(SEC_CHL_NODE *node)
+{
+    if (node->wheel_pprev == NULL) {
+        return;
+    }
+    if (node->wheel_next != NULL) {
+        node->wheel_next->wheel_pprev = node->wheel_pprev;
+    }
+    __atomic_store_n(node->wheel_pprev, node->wheel_next, __ATOMIC_RELAXED);
+    node->wheel_next = NULL;
+    node->wheel_pprev = NULL;
+}
+
+static void lru_lock(SEC_CHL_SHARD *shard)
+{
+    while (__atomic_exchange_n(&shard->lru_lock, 1, __ATOMIC_ACQUIRE) != 0) {
+        // the lock is held for a few instructions, wait for it to be released before trying again
+        while (__atomic_load_n(&shard->lru_lock, __ATOMIC_RELAXED) != 0) {
+#if defined(__aarch64__)
+            __asm__ __volatile__("yield" ::: "memory");
+#elif defined(__x86_64__)
+            __asm__ __volatile__("pause" ::: "memory");
+#else
+            __asm__ __volatile__("" ::: "memory");
+#endif
+        }
+    }
+}
+
+static void lru_unlock(SEC_CHL_SHARD *shard)
+{
+    __atomic_store_n(&shard->lru_lock, 0, __ATOMIC_RELEASE);
+}
+
+/* The caller holds the lru lock of the shard */
+static void lru_push(SEC_CHL_SHARD *shard, SEC_CHL_NODE *node)
+{
+    node->lru_prev = NULL;
+    node->lru_next = shard->lru_head;
+    if (shard->lru_head != NULL) {
+        shard->lru_head->lru_prev = node;
+    } else {
+        shard->lru_tail = node;
+    }
+    shard->lru_head = node;
+}
+
+/* The caller holds the lru lock of the shard */
+static void lru_unlink(SEC_CHL_SHARD *shard, SEC_CHL_NODE *node)
+{
+    if (node->lru_prev != NULL) {
+        node->lru_prev->lru_next = node->lru_next;
+    } else {
+        shard->lru_head = node->lru_next;
+    }
+    if (node->lru_next != NULL) {
+        node->lru_next->lru_prev = node->lru_prev;
+    } else {
+        shard->lru_tail = node->lru_prev;
+    }
+    node->lru_prev = NULL;
+    node->lru_next = NULL;
+}
+
+/* The caller holds the write lock of the shard */
+static void lru_del(SEC_CHL_SHARD *shard, SEC_CHL_NODE *node)
+{
+    lru_lock(shard);
+    lru_unlink(shard, node);
+    lru_unlock(shard);
+}
+
+// approximate memory held by the session, the buffers of the handshake are released once the session is ready
+static size_t get_node_bytes(SEC_CHL_NODE *node)
 {
-    sc_wtlock(&g_sec_chl_manager.sec_chl_list_lock);
+    sec_chl_ecdh_ctx_t *ecdh_ctx = node->ecdh_ctx;
+    size_t bytes = sizeof(SEC_CHL_NODE) + sizeof(sec_chl_ecdh_ctx_t) + ecdh_ctx->local_exch_param_buf_len +
+        ecdh_ctx->svr_exch_param_buf_len + ecdh_ctx->shared_key_len;
 
-    if (g_sec_chl_manager.count > MAX_SEL_CHL_NUM) {
-        sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
-        PrintInfo(PRINT_ERROR, "secure channel client num exceed the max limit:%u\n", MAX_SEL_CHL_NUM);
-        return CC_ERROR_SEC_CHL_CLI_NUM_EXCEED_MAX_LIMIT;
+    if (ecdh_ctx->ecdh_key != NULL) {
+        bytes += SEC_CHL_EC_KEY_BYTES;
     }
-    g_sec_chl_manager.count++;
+    return bytes + 2 * SEC_CHL_CIPHER_CTX_NUM * SEC_CHL_CIPHER_CTX_BYTES; // ctx pools of both directions
+}
+
+static void uncharge_node(SEC_CHL_NODE *node)
+{
+    (void)__atomic_sub_fetch(&g_sec_chl_manager.bytes, node->bytes, __ATOMIC_RELAXED);
+    (void)__atomic_sub_fetch(&g_sec_chl_manager.count, 1, __ATOMIC_RELAXED);
+}
+
+/* The size of the session changes, the caller holds the write lock of the shard */
+static void recharge_node(SEC_CHL_NODE *node)
+{
+    size_t bytes = get_node_bytes(node);
+    (void)__atomic_add_fetch(&g_sec_chl_manager.bytes, bytes, __ATOMIC_RELAXED);
+    (void)__atomic_sub_fetch(&g_sec_chl_manager.bytes, node->bytes, __ATOMIC_RELAXED);
+    node->bytes = bytes;
+}
+
+static bool try_charge_node(SEC_CHL_NODE *node)
+{
+    size_t count = __atomic_add_fetch(&g_sec_chl_manager.count, 1, __ATOMIC_RELAXED);
+    size_t bytes = __atomic_add_fetch(&g_sec_chl_manager.bytes, node->bytes, __ATOMIC_RELAXED);
+    if (count > g_sec_chl_manager.max_num ||
+        (g_sec_chl_manager.max_bytes != 0 && bytes > g_sec_chl_manager.max_bytes)) {
+        uncharge_node(node);
+        return false;
+    }
+    return true;
+}
+
+/* The caller holds the write lock of the shard */
+static void del_from_bucket(SEC_CHL_SHARD *shard, SEC_CHL_NODE *node)
+{
+    SEC_CHL_NODE **pre = get_bucket(shard, node->session_id);
+    while (*pre != NULL && *pre != node) {
+        pre = &(*pre)->next;
+    }
+    if (*pre != NULL) {
+        *pre = node->next;
+    }
+}
+
+/* The caller holds the lock of the shard, the read lock is enough */
+static SEC_CHL_NODE *find_node(SEC_CHL_SHARD *shard, size_t session_id)
+{
+    SEC_CHL_NODE *p = *get_bucket(shard, session_id);
+    while (p != NULL && p->session_id != session_id) {
+        p = p->next;
+    }
+    return p;
+}
+
+static bool evict_lru_session(void)
+{
+    SEC_CHL_SHARD *victim_shard = NULL;
+    uint64_t now = __atomic_load_n(&g_sec_chl_manager.tick, __ATOMIC_RELAXED);
+    uint64_t victim_tick = now;
+
+    // a session in a list is only released under the lru lock, its tick can be read without the shard lock
+    for (size_t i = 0; i < SEC_CHL_SHARD_NUM; i++) {
+        SEC_CHL_SHARD *shard = &g_sec_chl_manager.shards[i];
+        lru_lock(shard);
+        SEC_CHL_NODE *tail = shard->lru_tail;
+        if (tail != NULL && __atomic_load_n(&tail->active_tick, __ATOMIC_RELAXED) < victim_tick) {
+            victim_shard = shard;
+            victim_tick = __atomic_load_n(&tail->active_tick, __ATOMIC_RELAXED);
+        }
+        lru_unlock(shard);
+    }
+    if (victim_shard == NULL) {
+        return false;
+    }
+
+    // the tail may have got a msg or been released since, the shard gives its current tail unless it is active
+    sc_wtlock(&victim_shard->lock);
+    SEC_CHL_NODE *node = victim_shard->lru_tail;
+    if (node != NULL && __atomic_load_n(&node->active_tick, __ATOMIC_RELAXED) < now) {
+        PrintInfo(PRINT_WARNING, "sec chl node evicted, session_id:%llu\n", node->session_id);
+        lru_del(victim_shard, node);
+        del_from_bucket(victim_shard, node);
+        wheel_del(node);
+        uncharge_node(node);
+        free_sec_chl_node(node);
+        (void)__atomic_add_fetch(&g_sec_chl_manager.evictions, 1, __ATOMIC_RELAXED);
+    }
+    sc_wtunlock(&victim_shard->lock);
+    return true;
+}
+
+static int charge_node(SEC_CHL_NODE *node)
+{
+    node->bytes = get_node_bytes(node);
+    for (int i = 0; i < SEC_CHL_MAX_EVICT_TRY; i++) {
+        if (try_charge_node(node)) {
+            return CC_SUCCESS;
+        }
+        if (!evict_lru_session()) {
+            break;
+        }
+    }
+    (void)__atomic_add_fetch(&g_sec_chl_manager.rejections, 1, __ATOMIC_RELAXED);
+    PrintInfo(PRINT_ERROR, "secure channel client num exceed the max limit:%llu or the memory budget:%llu\n",
+        g_sec_chl_manager.max_num, g_sec_chl_manager.max_bytes);
+    return CC_ERROR_SEC_CHL_CLI_NUM_EXCEED_MAX_LIMIT;
+}
 
-    SEC_CHL_NODE *temp = g_sec_chl_manager.sec_chl_list_head.next;
-    g_sec_chl_manager.sec_chl_list_head.next = node;
-    node->next = temp;
+static int add_to_sec_chl_table(SEC_CHL_NODE *node)
+{
+    int ret = charge_node(node);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
 
-    sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    SEC_CHL_SHARD *shard = get_shard(node->session_id);
+    sc_wtlock(&shard->lock);
+    SEC_CHL_NODE **bucket = get_bucket(shard, node->session_id);
+    if (find_node(shard, node->session_id) != NULL) {
+        sc_wtunlock(&shard->lock);
+        uncharge_node(node);
+        PrintInfo(PRINT_ERROR, "secure channel session_id:%llu already exists\n", node->session_id);
+        return CC_FAIL;
+    }
+    node->next = *bucket;
+    *bucket = node;
+    uint64_t now = __atomic_load_n(&g_sec_chl_manager.tick, __ATOMIC_RELAXED);
+    node->active_tick = now;
+    wheel_add(shard, node, now + SEC_CHL_CHECK_PERIOD);
+    lru_lock(shard);
+    lru_push(shard, node);
+    lru_unlock(shard);
+    sc_wtunlock(&shard->lock);
 
     return CC_SUCCESS;
 }
 
-int init_session(size_t *session_id)
+static int insert_session(SEC_CHL_NODE *node, size_t *session_id)
 {
     size_t random_id = 0;
     int ret = cc_enclave_generate_random(&random_id, sizeof(size_t));
     if (ret != CC_SUCCESS) {
-        PrintInfo(PRINT_ERROR, "get enclave pubkey gen random failed\n");
+        PrintInfo(PRINT_ERROR, "insert session gen random failed\n");
         return CC_ERROR_SEC_CHL_GEN_RANDOM;
     }
+    node->session_id = random_id;
+    ret = add_to_sec_chl_table(node);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    *session_id = random_id;
+    return CC_SUCCESS;
+}
+
+int init_session(size_t *session_id)
+{
+    if (!g_sec_chl_manager.is_init) {
+        PrintInfo(PRINT_ERROR, "init session failed, not inited\n");
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
 
     SEC_CHL_NODE *node = new_sec_chl_node();
     if (node == NULL) {
         PrintInfo(PRINT_ERROR, "get enclave pubkey new sec chl node failed\n");
         return CC_FAIL;
     }
+    node->ticket_tick = __atomic_load_n(&g_sec_chl_manager.tick, __ATOMIC_RELAXED);
 
-    node->session_id = random_id;
-    *session_id = random_id;
-    ret = add_to_sec_chl_list(node);
+    int ret = insert_session(node, session_id);
     if (ret != CC_SUCCESS) {
         free_sec_chl_node(node);
     }
     return ret;
 }
 
-static sec_chl_ecdh_ctx_t *get_ecdh_ctx_by_session_id(size_t session_id);
+static sec_chl_ecdh_ctx_t *get_ecdh_ctx_by_session_id(SEC_CHL_SHARD *shard, size_t session_id);
 
 static int cache_rsa_key(size_t session_id, RSA *rsa_key)
 {
-    sc_wtlock(&g_sec_chl_manager.sec_chl_list_lock);
-    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(session_id);
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_wtlock(&shard->lock);
+    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(shard, session_id);
     if (ecdh_ctx == NULL) {
-        sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
+        sc_wtunlock(&shard->lock);
         return CC_FAIL;
     }
     ecdh_ctx->svr_rsa_key = rsa_key;
     ecdh_ctx->signature_len = RSA_size(rsa_key);
 
-    sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    sc_wtunlock(&shard->lock);
+    return CC_SUCCESS;
+}
+
+static int gen_svr_rsa_key(void)
+{
+    RSA *r = NULL;
+    uint8_t *pubkey = g_sec_chl_manager.svr_pubkey;
+    size_t pubkey_len = sizeof(g_sec_chl_manager.svr_pubkey);
+
+    int ret = gen_rsa_key(&r);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    ret = get_pubkey_buffer(r, &pubkey, &pubkey_len);
+    if (ret != CC_SUCCESS) {
+        RSA_free(r);
+        PrintInfo(PRINT_ERROR, "gen svr rsa key get buffer failed\n");
+        return ret;
+    }
+    g_sec_chl_manager.svr_rsa_key = r;
+    g_sec_chl_manager.svr_pubkey_len = pubkey_len;
+    return CC_SUCCESS;
+}
+
+static int ref_svr_rsa_key(RSA **rsa_key, uint8_t *pubkey, size_t *pubkey_len)
+{
+    if (*pubkey_len < g_sec_chl_manager.svr_pubkey_len) {
+        PrintInfo(PRINT_ERROR, "ref svr rsa key pubkey_len:%llu is not enough\n", *pubkey_len);
+        return CC_FAIL;
+    }
+    if (RSA_up_ref(g_sec_chl_manager.svr_rsa_key) != 1) {
+        PrintInfo(PRINT_ERROR, "ref svr rsa key up ref failed\n");
+        return CC_FAIL;
+    }
+    (void)memcpy(pubkey, g_sec_chl_manager.svr_pubkey, g_sec_chl_manager.svr_pubkey_len);
+    *pubkey_len = g_sec_chl_manager.svr_pubkey_len;
+    *rsa_key = g_sec_chl_manager.svr_rsa_key;
     return CC_SUCCESS;
 }
 
+/*
+ * Generating a 3072 bits rsa key costs hundreds of milliseconds, so it is generated by the first handshake
+ * and reused by the later ones until the secure channel service stops. A handshake only pays for ECDH.
+ */
+static int get_svr_rsa_key(RSA **rsa_key, uint8_t *pubkey, size_t *pubkey_len)
+{
+    int ret;
+
+    sc_rdlock(&g_sec_chl_manager.svr_key_lock);
+    if (g_sec_chl_manager.svr_rsa_key != NULL) {
+        ret = ref_svr_rsa_key(rsa_key, pubkey, pubkey_len);
+        sc_rdunlock(&g_sec_chl_manager.svr_key_lock);
+        return ret;
+    }
+    sc_rdunlock(&g_sec_chl_manager.svr_key_lock);
+
+    sc_wtlock(&g_sec_chl_manager.svr_key_lock);
+    ret = CC_SUCCESS;
+    if (g_sec_chl_manager.svr_rsa_key == NULL) {
+        ret = gen_svr_rsa_key();
+    }
+    if (ret == CC_SUCCESS) {
+        ret = ref_svr_rsa_key(rsa_key, pubkey, pubkey_len);
+    }
+    sc_wtunlock(&g_sec_chl_manager.svr_key_lock);
+    return ret;
+}
+
 int get_enclave_pubkey(size_t *session_id, uint8_t *pubkey, size_t *pubkey_len)
 {
     RSA *r = NULL;
@@ -307,17 +695,10 @@ int get_enclave_pubkey(size_t *session_id, uint8_t *pubkey, size_t *pubkey_len)
         return ret;
     }
 
-    // generate rsa key
-    ret = gen_rsa_key(&r);
-    if (ret != CC_SUCCESS) {
-        // node will free by sec_chl_destroy
-        return ret;
-    }
-
-    ret = get_pubkey_buffer(r, &pubkey, pubkey_len);
+    // take a reference of the long-lived rsa key
+    ret = get_svr_rsa_key(&r, pubkey, pubkey_len);
     if (ret != CC_SUCCESS) {
-        RSA_free(r);
-        PrintInfo(PRINT_ERROR, "get enclave pubkey get buffer failed\n");
+        PrintInfo(PRINT_ERROR, "get enclave pubkey get svr rsa key failed\n");
         // node will free by sec_chl_destroy
         return ret;
     }
@@ -331,52 +712,80 @@ int get_enclave_pubkey(size_t *session_id, uint8_t *pubkey, size_t *pubkey_len)
     return ret;
 }
 
-static sec_chl_ecdh_ctx_t *get_ecdh_ctx_by_session_id(size_t session_id)
+/* The caller holds the lock of the shard, the read lock is enough */
+static SEC_CHL_NODE *get_node_by_session_id(SEC_CHL_SHARD *shard, size_t session_id)
 {
-    SEC_CHL_NODE *p = g_sec_chl_manager.sec_chl_list_head.next;
-    while (p != NULL) {
-        if (p->session_id == session_id) {
-            p->inactive_cnt = 0;
-            break;
-        }
-        p = p->next;
-    }
+    SEC_CHL_NODE *p = find_node(shard, session_id);
     if (p == NULL) {
         PrintInfo(PRINT_ERROR, "not found ecdh ctx by session_id:%llu\n", session_id);
         return NULL;
     }
-    return p->ecdh_ctx;
+    // skip the update if it is set already, the tick is read far more often than it changes
+    uint64_t now = __atomic_load_n(&g_sec_chl_manager.tick, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&p->active_tick, __ATOMIC_RELAXED) != now) {
+        lru_lock(shard);
+        if (__atomic_load_n(&p->active_tick, __ATOMIC_RELAXED) != now) {
+            __atomic_store_n(&p->active_tick, now, __ATOMIC_RELAXED);
+            lru_unlink(shard, p);
+            lru_push(shard, p);
+        }
+        lru_unlock(shard);
+    }
+    return p;
+}
+
+static sec_chl_ecdh_ctx_t *get_ecdh_ctx_by_session_id(SEC_CHL_SHARD *shard, size_t session_id)
+{
+    SEC_CHL_NODE *node = get_node_by_session_id(shard, session_id);
+    return node == NULL ? NULL : node->ecdh_ctx;
 }
 
 int get_enclave_exch_param_len(size_t session_id, size_t *exch_param_len)
 {
-    sc_rdlock(&g_sec_chl_manager.sec_chl_list_lock);
-    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(session_id);
-    if (ecdh_ctx == NULL) {
-        sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_rdlock(&shard->lock);
+    SEC_CHL_NODE *node = get_node_by_session_id(shard, session_id);
+    // a ready session has released its exch param
+    if (node == NULL || node->is_ready) {
+        sc_rdunlock(&shard->lock);
         return CC_FAIL;
     }
     // *exch_param_len = get_exch_buf_len(ecdh_ctx);
-    *exch_param_len = ecdh_ctx->local_exch_param_buf_len;
-    sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    *exch_param_len = node->ecdh_ctx->local_exch_param_buf_len;
+    sc_rdunlock(&shard->lock);
 
     return CC_SUCCESS;
 }
 
 int get_enclave_exch_param(size_t session_id, uint8_t *exch_param, size_t exch_param_len)
 {
-    sc_rdlock(&g_sec_chl_manager.sec_chl_list_lock);
-    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(session_id);
-    if (ecdh_ctx == NULL) {
-        sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_rdlock(&shard->lock);
+    SEC_CHL_NODE *node = get_node_by_session_id(shard, session_id);
+    if (node == NULL || node->is_ready) {
+        sc_rdunlock(&shard->lock);
         return CC_FAIL;
     }
 
-    int ret = get_exch_buf(ecdh_ctx, exch_param, exch_param_len);
-    sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    int ret = get_exch_buf(node->ecdh_ctx, exch_param, exch_param_len);
+    sc_rdunlock(&shard->lock);
     return ret;
 }
 
+// regenerate the local exch param with a signature by the rsa key of the session
+static int regen_signed_exch_buf(sec_chl_ecdh_ctx_t *ecdh_ctx)
+{
+    ecdh_ctx->signature_len = RSA_size(ecdh_ctx->svr_rsa_key);
+    free(ecdh_ctx->local_exch_param_buf);
+    ecdh_ctx->local_exch_param_buf = NULL;
+    ecdh_ctx->local_exch_param_buf_len = 0;
+    if (gen_local_exch_buf(ecdh_ctx) != CC_SUCCESS) {
+        PrintInfo(PRINT_ERROR, "gen signed local exch param failed\n");
+        return CC_FAIL;
+    }
+    return CC_SUCCESS;
+}
+
 #define RSA_MAX_LEN 1024
 int set_enc_key(size_t session_id, uint8_t* data, size_t data_len)
 {
@@ -424,17 +833,23 @@ int set_enc_key(size_t session_id, uint8_t* data, size_t data_len)
     BN_hex2bn(&pri_exponent, (char *)d);
     RSA_set0_key(rsa_key, modulus, pub_exponent, pri_exponent);
     
-    sc_wtlock(&g_sec_chl_manager.sec_chl_list_lock);
-    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(session_id);
-    if (ecdh_ctx == NULL) {
-        sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_wtlock(&shard->lock);
+    SEC_CHL_NODE *node = get_node_by_session_id(shard, session_id);
+    if (node == NULL || node->is_ready) {
+        sc_wtunlock(&shard->lock);
         RSA_free(rsa_key);
         ret = CC_ERROR_SEC_CHL_INVALID_SESSION;
         PrintInfo(PRINT_ERROR, "get ecdh ctx by session id\n");
         goto end;
     }
-    ecdh_ctx->svr_rsa_key = rsa_key;
-    sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    // drop the reference to the shared key, the session signs with the key from the host from now on
+    RSA_free(node->ecdh_ctx->svr_rsa_key);
+    node->ecdh_ctx->svr_rsa_key = rsa_key;
+    // the signature proves to a client which takes the report from its cache that the session holds the key
+    ret = regen_signed_exch_buf(node->ecdh_ctx);
+    recharge_node(node);
+    sc_wtunlock(&shard->lock);
 end:
     free(enc_key);
     free(dec_key);
@@ -443,129 +858,517 @@ end:
     return ret;
 }
 
-int set_peer_exch_param(size_t session_id, uint8_t* data, size_t data_len)
+// compute the session key of the node from the peer exch param, with the shard lock held for write
+static int compute_node_session_key(SEC_CHL_NODE *node, sec_chl_exch_param_t *peer_exch_param)
 {
-    int ret;
-    sec_chl_exch_param_t *peer_exch_param = NULL;
     sec_chl_exch_param_t *local_exch_param = NULL;
+    sec_chl_ecdh_ctx_t *ecdh_ctx = node->ecdh_ctx;
 
-    ret = get_exch_param_from_buf(data, data_len, &peer_exch_param);
-    if (ret != CC_SUCCESS) {
-        return CC_FAIL;
-    }
-    sc_wtlock(&g_sec_chl_manager.sec_chl_list_lock);
-    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(session_id);
-    ret = get_exch_param_from_buf(ecdh_ctx->local_exch_param_buf,
+    int ret = get_exch_param_from_buf(ecdh_ctx->local_exch_param_buf,
         ecdh_ctx->local_exch_param_buf_len, &local_exch_param);
     if (ret != CC_SUCCESS) {
-        sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
-        del_exch_param(peer_exch_param);
         PrintInfo(PRINT_ERROR, "set peer exch param get from buf failed\n");
         return CC_FAIL;
     }
-    ret = compute_session_key(ecdh_ctx, local_exch_param, peer_exch_param);
-    sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
-
-    del_exch_param(peer_exch_param);
+    ret = compute_session_key(ecdh_ctx, local_exch_param, peer_exch_param, false);
+    node->is_ready = (ret == CC_SUCCESS);
     del_exch_param(local_exch_param);
     if (ret < 0) {
         PrintInfo(PRINT_ERROR, "compute session key failed\n");
         return CC_FAIL;
     }
+    // a ready session only keeps its keys and counters
+    free_handshake_state(ecdh_ctx);
+    recharge_node(node);
 
     return CC_SUCCESS;
 }
 
-void del_enclave_sec_chl(size_t session_id)
+int set_peer_exch_param(size_t session_id, uint8_t* data, size_t data_len)
 {
-    sc_wtlock(&g_sec_chl_manager.sec_chl_list_lock);
+    int ret;
+    sec_chl_exch_param_t *peer_exch_param = NULL;
 
-    SEC_CHL_NODE *cur = g_sec_chl_manager.sec_chl_list_head.next;
-    SEC_CHL_NODE *pre = &(g_sec_chl_manager.sec_chl_list_head);
-    while (cur != NULL) {
-        if (cur->session_id == session_id) {
-            // remove
-            pre->next = cur->next;
-            free_sec_chl_node(cur);
-            g_sec_chl_manager.count--;
-            break;
-        }
-        pre = cur;
-        cur = cur->next;
+    ret = get_exch_param_from_buf(data, data_len, &peer_exch_param);
+    if (ret != CC_SUCCESS) {
+        return CC_FAIL;
     }
-
-    sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
-}
-
-static void del_enclave_all_sec_chl()
-{
-    sc_wtlock(&g_sec_chl_manager.sec_chl_list_lock);
-
-    SEC_CHL_NODE *head = &(g_sec_chl_manager.sec_chl_list_head);
-    SEC_CHL_NODE *cur = head->next;
-    while (cur != NULL) {
-        head->next = cur->next;
-        free_sec_chl_node(cur);
-        cur = head->next;
-        g_sec_chl_manager.count--;
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_wtlock(&shard->lock);
+    SEC_CHL_NODE *node = get_node_by_session_id(shard, session_id);
+    if (node == NULL || node->is_ready) {
+        sc_wtunlock(&shard->lock);
+        del_exch_param(peer_exch_param);
+        return CC_ERROR_SEC_CHL_INVALID_SESSION;
     }
-    sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    ret = compute_node_session_key(node, peer_exch_param);
+    sc_wtunlock(&shard->lock);
 
-    return;
+    del_exch_param(peer_exch_param);
+    return ret;
 }
 
-int enclave_start_sec_chl()
+/*
+ * Switch the session to the cipher suite proposed by the client, before the server exch param is handed out. A suite
+ * on another curve needs a new ecdh key, which is signed like the one it replaces.
+ */
+static int set_node_algo(SEC_CHL_NODE *node, cc_sec_chl_algo_t algo)
 {
-    sc_init_rwlock(&g_sec_chl_manager.sec_chl_list_lock);
-    g_sec_chl_manager.is_init = true;
+    sec_chl_ecdh_ctx_t *old_ctx = node->ecdh_ctx;
+    int ec_nid = get_sec_chl_algo_ec_nid(algo);
+
+    if (ec_nid != old_ctx->ec_nid) {
+        sec_chl_ecdh_ctx_t *ecdh_ctx = new_local_ecdh_ctx(ec_nid);
+        if (ecdh_ctx == NULL) {
+            PrintInfo(PRINT_ERROR, "new local ecdh ctx failed\n");
+            return CC_ERROR_SEC_CHL_GEN_LOCAL_EXCH_PARAM;
+        }
+        ecdh_ctx->svr_rsa_key = old_ctx->svr_rsa_key;
+        ecdh_ctx->signature_len = old_ctx->signature_len;
+        if (gen_local_exch_buf(ecdh_ctx) != CC_SUCCESS) {
+            ecdh_ctx->svr_rsa_key = NULL;
+            del_ecdh_ctx(ecdh_ctx);
+            PrintInfo(PRINT_ERROR, "gen local ecdh param failed\n");
+            return CC_ERROR_SEC_CHL_GEN_LOCAL_EXCH_PARAM;
+        }
+        old_ctx->svr_rsa_key = NULL;
+        del_ecdh_ctx(old_ctx);
+        node->ecdh_ctx = ecdh_ctx;
+    }
+    node->ecdh_ctx->algo = algo;
     return CC_SUCCESS;
 }
 
-void enclave_stop_sec_chl()
+int set_session_algo(size_t session_id, int algo)
 {
-    del_enclave_all_sec_chl();
-    sc_fini_rwlock(&g_sec_chl_manager.sec_chl_list_lock);
-    g_sec_chl_manager.is_init = false;
-    return;
+    if (!is_sec_chl_algo_supported((cc_sec_chl_algo_t)algo)) {
+        PrintInfo(PRINT_ERROR, "cipher suite %d not supported\n", algo);
+        return CC_ERROR_SEC_CHL_ALGO_NOT_SUPPORTED;
+    }
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_wtlock(&shard->lock);
+    SEC_CHL_NODE *node = get_node_by_session_id(shard, session_id);
+    if (node == NULL || node->is_ready) {
+        sc_wtunlock(&shard->lock);
+        return CC_ERROR_SEC_CHL_INVALID_SESSION;
+    }
+    int ret = set_node_algo(node, (cc_sec_chl_algo_t)algo);
+    recharge_node(node);
+    sc_wtunlock(&shard->lock);
+    return ret;
 }
 
-int cc_sec_chl_enclave_encrypt(size_t session_id, void *plain, size_t plain_len, void *encrypt, size_t *encrypt_len)
+/*
+ * The compact handshake gets the server exch param and sets the client one in a single call. The server exch param
+ * is regenerated here with a signature by the rsa key of the session, which the client has verified in the first
+ * round trip, so the client can authenticate the server without asking for the param separately.
+ */
+static int sign_local_exch_buf(sec_chl_ecdh_ctx_t *ecdh_ctx, uint8_t *exch_param, size_t exch_param_len,
+    size_t *real_len)
 {
-    if (plain == NULL || plain_len == 0 || encrypt_len == NULL) {
-        PrintInfo(PRINT_ERROR, "sec chl encrypt param error\n");
-        return -1;
-    }
-    size_t need_len = get_encrypted_buf_len(plain_len);
-    if (encrypt == NULL || *encrypt_len < need_len) {
-        *encrypt_len = need_len;
-        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
-    }
-    sc_rdlock(&g_sec_chl_manager.sec_chl_list_lock);
-    if (!g_sec_chl_manager.is_init) {
-        sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
-        PrintInfo(PRINT_ERROR, "sec chl encrypt failed, not inited\n");
-        return CC_ERROR_SEC_CHL_NOTREADY;
-    }
-    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(session_id);
-    if (ecdh_ctx == NULL) {
-        sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
-        return -1;
+    if (ecdh_ctx->svr_rsa_key == NULL) {
+        PrintInfo(PRINT_ERROR, "compact handshake without rsa key of the session\n");
+        return CC_ERROR_SEC_CHL_INVALID_SESSION;
     }
-    int ret = sec_chl_encrypt(ecdh_ctx, session_id, plain, plain_len, encrypt, encrypt_len);
-
-    sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    int ret = regen_signed_exch_buf(ecdh_ctx);
     if (ret != CC_SUCCESS) {
-        PrintInfo(PRINT_ERROR, "sec chl encrypt failed, ret:%d\n", ret);
         return ret;
     }
+    if (ecdh_ctx->local_exch_param_buf_len > exch_param_len) {
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
+    memcpy(exch_param, ecdh_ctx->local_exch_param_buf, ecdh_ctx->local_exch_param_buf_len);
+    *real_len = ecdh_ctx->local_exch_param_buf_len;
 
-    return 0;
+    return CC_SUCCESS;
 }
 
-int cc_sec_chl_enclave_decrypt(size_t session_id, void *encrypt, size_t encrypt_len, void *plain, size_t *plain_len)
+int compact_set_peer_exch_param(size_t session_id, uint8_t *data, size_t data_len, uint8_t *exch_param,
+    size_t exch_param_len, size_t *real_len)
 {
-    if (encrypt == NULL || encrypt_len == 0 || plain_len == NULL) {
-        PrintInfo(PRINT_ERROR, "sec chl decrypt param error\n");
+    int ret;
+    sec_chl_exch_param_t *peer_exch_param = NULL;
+
+    if (exch_param == NULL || real_len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    ret = get_exch_param_from_buf(data, data_len, &peer_exch_param);
+    if (ret != CC_SUCCESS) {
+        return CC_FAIL;
+    }
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_wtlock(&shard->lock);
+    SEC_CHL_NODE *node = get_node_by_session_id(shard, session_id);
+    if (node == NULL || node->is_ready) {
+        sc_wtunlock(&shard->lock);
+        del_exch_param(peer_exch_param);
+        return CC_ERROR_SEC_CHL_INVALID_SESSION;
+    }
+    ret = sign_local_exch_buf(node->ecdh_ctx, exch_param, exch_param_len, real_len);
+    if (ret == CC_SUCCESS) {
+        ret = compute_node_session_key(node, peer_exch_param);
+    }
+    sc_wtunlock(&shard->lock);
+
+    del_exch_param(peer_exch_param);
+    return ret;
+}
+
+/*
+ * Resumption tickets. The ticket key never leaves the enclave and lives as long as the secure channel service, so
+ * a ticket is only accepted by the enclave instance which issued it. The lifetime of a ticket is counted in ticks
+ * of the session timer, from the full handshake the ticket descends from, so resuming again does not extend it.
+ * The ticks are driven by the host, which can delay the expiry but not make an expired ticket valid again.
+ */
+#define SEC_CHL_TICKET_LIFETIME_CNT 60  // about one hour with the 60 seconds session timer
+
+static int ticket_cipher(bool is_seal, uint8_t *nonce, uint8_t *tag, uint8_t *in, uint8_t *out)
+{
+    int len = 0;
+    int ret = CC_FAIL;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    if (EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), NULL, g_sec_chl_manager.ticket_key, nonce, is_seal) <= 0) {
+        goto end;
+    }
+    if (EVP_CipherUpdate(ctx, out, &len, in, SEC_CHL_TICKET_STATE_LEN) <= 0) {
+        goto end;
+    }
+    if (!is_seal && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, GCM_TAG_LEN, tag) <= 0) {
+        goto end;
+    }
+    if (EVP_CipherFinal_ex(ctx, out + len, &len) <= 0) {
+        goto end;
+    }
+    if (is_seal && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, GCM_TAG_LEN, tag) <= 0) {
+        goto end;
+    }
+    ret = CC_SUCCESS;
+end:
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+static int seal_ticket(uint64_t ticket_tick, cc_sec_chl_algo_t algo, uint8_t *secret, uint8_t *ticket)
+{
+    uint8_t state[SEC_CHL_TICKET_STATE_LEN];
+    uint8_t *nonce = ticket;
+    uint8_t *tag = ticket + SEC_CHL_NONCE_LEN;
+
+    // nonces come from a counter, ticket_key never seals two tickets with the same nonce
+    uint64_t seq = __atomic_fetch_add(&g_sec_chl_manager.ticket_seq, 1, __ATOMIC_RELAXED);
+    memset(nonce, 0, SEC_CHL_NONCE_LEN);
+    for (size_t i = 0; i < sizeof(seq); i++) {
+        nonce[SEC_CHL_NONCE_LEN - 1 - i] = (uint8_t)(seq >> (i * BYTE_TO_BIT_LEN));
+    }
+    int32_t algo_id = (int32_t)algo;
+    memcpy(state, &ticket_tick, sizeof(ticket_tick));
+    memcpy(state + sizeof(ticket_tick), secret, SECURE_KEY_LEN);
+    memcpy(state + sizeof(ticket_tick) + SECURE_KEY_LEN, &algo_id, sizeof(algo_id));
+
+    int ret = ticket_cipher(true, nonce, tag, state, tag + GCM_TAG_LEN);
+    memset(state, 0, sizeof(state));
+    return ret;
+}
+
+static int open_ticket(uint8_t *ticket, uint64_t *ticket_tick, cc_sec_chl_algo_t *algo, uint8_t *secret)
+{
+    uint8_t state[SEC_CHL_TICKET_STATE_LEN];
+    int32_t algo_id;
+    uint8_t *tag = ticket + SEC_CHL_NONCE_LEN;
+
+    if (ticket_cipher(false, ticket, tag, tag + GCM_TAG_LEN, state) != CC_SUCCESS) {
+        PrintInfo(PRINT_ERROR, "open ticket failed\n");
+        return CC_ERROR_SEC_CHL_TICKET_INVALID;
+    }
+    memcpy(ticket_tick, state, sizeof(*ticket_tick));
+    memcpy(secret, state + sizeof(*ticket_tick), SECURE_KEY_LEN);
+    memcpy(&algo_id, state + sizeof(*ticket_tick) + SECURE_KEY_LEN, sizeof(algo_id));
+    memset(state, 0, sizeof(state));
+    *algo = (cc_sec_chl_algo_t)algo_id;
+
+    uint64_t now = __atomic_load_n(&g_sec_chl_manager.tick, __ATOMIC_RELAXED);
+    if (now < *ticket_tick || now - *ticket_tick > SEC_CHL_TICKET_LIFETIME_CNT) {
+        memset(secret, 0, SECURE_KEY_LEN);
+        PrintInfo(PRINT_WARNING, "ticket expired\n");
+        return CC_ERROR_SEC_CHL_TICKET_INVALID;
+    }
+    return CC_SUCCESS;
+}
+
+int get_enclave_ticket(size_t session_id, uint8_t *ticket, size_t ticket_len)
+{
+    uint8_t secret[SECURE_KEY_LEN];
+
+    if (ticket == NULL || ticket_len != SEC_CHL_TICKET_LEN) {
+        PrintInfo(PRINT_ERROR, "get enclave ticket param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (!g_sec_chl_manager.is_init) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_rdlock(&shard->lock);
+    SEC_CHL_NODE *node = get_node_by_session_id(shard, session_id);
+    if (node == NULL || !node->is_ready) {
+        sc_rdunlock(&shard->lock);
+        return CC_ERROR_SEC_CHL_INVALID_SESSION;
+    }
+    uint64_t ticket_tick = node->ticket_tick;
+    cc_sec_chl_algo_t algo = node->ecdh_ctx->algo;
+    int ret = get_resume_secret(node->ecdh_ctx, secret);
+    sc_rdunlock(&shard->lock);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+
+    ret = seal_ticket(ticket_tick, algo, secret, ticket);
+    memset(secret, 0, sizeof(secret));
+    return ret;
+}
+
+static int resume_sec_chl_node(SEC_CHL_NODE *node, sec_chl_resume_msg_t *req, sec_chl_resume_msg_t *rsp)
+{
+    uint8_t secret[SECURE_KEY_LEN];
+
+    int ret = open_ticket(req->ticket, &node->ticket_tick, &node->ecdh_ctx->algo, secret);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    ret = cc_enclave_generate_random(rsp->random, RANDOM_LEN);
+    if (ret != CC_SUCCESS) {
+        ret = CC_ERROR_SEC_CHL_GEN_RANDOM;
+        goto end;
+    }
+    ret = compute_resume_session_key(node->ecdh_ctx, secret, req->random, rsp->random, false);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    // the resumed session gets a ticket of its own, which keeps the tick of the full handshake
+    ret = get_resume_secret(node->ecdh_ctx, secret);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    ret = seal_ticket(node->ticket_tick, node->ecdh_ctx->algo, secret, rsp->ticket);
+    if (ret != CC_SUCCESS) {
+        goto end;
+    }
+    node->is_ready = true;
+end:
+    memset(secret, 0, sizeof(secret));
+    return ret;
+}
+
+int resume_session(size_t *session_id, uint8_t *req, size_t req_len, uint8_t *rsp, size_t rsp_len)
+{
+    if (session_id == NULL || req == NULL || req_len != sizeof(sec_chl_resume_msg_t) ||
+        rsp == NULL || rsp_len != sizeof(sec_chl_resume_msg_t)) {
+        PrintInfo(PRINT_ERROR, "resume session param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (!g_sec_chl_manager.is_init) {
+        PrintInfo(PRINT_ERROR, "resume session failed, not inited\n");
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+
+    SEC_CHL_NODE *node = new_resumed_sec_chl_node();
+    if (node == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    int ret = resume_sec_chl_node(node, (sec_chl_resume_msg_t *)req, (sec_chl_resume_msg_t *)rsp);
+    if (ret == CC_SUCCESS) {
+        ret = insert_session(node, session_id);
+    }
+    if (ret != CC_SUCCESS) {
+        free_sec_chl_node(node);
+        memset(rsp, 0, rsp_len);
+    }
+    return ret;
+}
+
+void del_enclave_sec_chl(size_t session_id)
+{
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_wtlock(&shard->lock);
+
+    SEC_CHL_NODE **pre = get_bucket(shard, session_id);
+    SEC_CHL_NODE *cur = *pre;
+    while (cur != NULL) {
+        if (cur->session_id == session_id) {
+            // remove
+            *pre = cur->next;
+            wheel_del(cur);
+            lru_del(shard, cur);
+            uncharge_node(cur);
+            free_sec_chl_node(cur);
+            break;
+        }
+        pre = &cur->next;
+        cur = cur->next;
+    }
+
+    sc_wtunlock(&shard->lock);
+}
+
+/*
+ * Walk all sessions shard by shard, expire returns true if the session is to be released. A shard is write locked
+ * only while it is walked.
+ */
+static void del_enclave_sec_chl_if(bool (*expire)(SEC_CHL_NODE *node))
+{
+    for (size_t i = 0; i < SEC_CHL_SHARD_NUM; i++) {
+        SEC_CHL_SHARD *shard = &g_sec_chl_manager.shards[i];
+        sc_wtlock(&shard->lock);
+        for (size_t j = 0; j <= g_sec_chl_manager.bucket_mask; j++) {
+            SEC_CHL_NODE **pre = &shard->buckets[j];
+            SEC_CHL_NODE *cur = *pre;
+            while (cur != NULL) {
+                if (expire(cur)) {
+                    *pre = cur->next;
+                    wheel_del(cur);
+                    lru_del(shard, cur);
+                    uncharge_node(cur);
+                    free_sec_chl_node(cur);
+                    cur = *pre;
+                    continue;
+                }
+                pre = &cur->next;
+                cur = cur->next;
+            }
+        }
+        sc_wtunlock(&shard->lock);
+    }
+}
+
+static bool expire_all(SEC_CHL_NODE *node)
+{
+    (void)node;
+    return true;
+}
+
+static void free_sec_chl_shards(size_t shard_num)
+{
+    for (size_t i = 0; i < shard_num; i++) {
+        sc_fini_rwlock(&g_sec_chl_manager.shards[i].lock);
+        free(g_sec_chl_manager.shards[i].buckets);
+        g_sec_chl_manager.shards[i].buckets = NULL;
+    }
+}
+
+int enclave_start_sec_chl(size_t max_session_num, size_t max_session_bytes)
+{
+    if (g_sec_chl_manager.is_init) {
+        return CC_SUCCESS;
+    }
+    g_sec_chl_manager.max_num = max_session_num == 0 ? MAX_SEL_CHL_NUM : max_session_num;
+    g_sec_chl_manager.count = 0;
+    g_sec_chl_manager.max_bytes = max_session_bytes;
+    g_sec_chl_manager.bytes = 0;
+    g_sec_chl_manager.evictions = 0;
+    g_sec_chl_manager.rejections = 0;
+
+    // about one session per bucket when the table is full
+    size_t bucket_num = SEC_CHL_MIN_BUCKET_NUM;
+    while (bucket_num * SEC_CHL_SHARD_NUM < g_sec_chl_manager.max_num && bucket_num < SEC_CHL_MAX_BUCKET_NUM) {
+        bucket_num <<= 1;
+    }
+    g_sec_chl_manager.bucket_mask = bucket_num - 1;
+    for (size_t i = 0; i < SEC_CHL_SHARD_NUM; i++) {
+        g_sec_chl_manager.shards[i].buckets = (SEC_CHL_NODE **)calloc(bucket_num, sizeof(SEC_CHL_NODE *));
+        if (g_sec_chl_manager.shards[i].buckets == NULL) {
+            free_sec_chl_shards(i);
+            PrintInfo(PRINT_ERROR, "start sec chl malloc failed\n");
+            return CC_ERROR_SEC_CHL_MEMORY;
+        }
+        memset(g_sec_chl_manager.shards[i].wheel, 0, sizeof(g_sec_chl_manager.shards[i].wheel));
+        g_sec_chl_manager.shards[i].lru_lock = 0;
+        g_sec_chl_manager.shards[i].lru_head = NULL;
+        g_sec_chl_manager.shards[i].lru_tail = NULL;
+        sc_init_rwlock(&g_sec_chl_manager.shards[i].lock);
+    }
+    if (cc_enclave_generate_random(g_sec_chl_manager.ticket_key, SECURE_KEY_LEN) != CC_SUCCESS) {
+        free_sec_chl_shards(SEC_CHL_SHARD_NUM);
+        PrintInfo(PRINT_ERROR, "start sec chl gen ticket key failed\n");
+        return CC_ERROR_SEC_CHL_GEN_RANDOM;
+    }
+    g_sec_chl_manager.ticket_seq = 0;
+    g_sec_chl_manager.tick = 0;
+    sc_init_rwlock(&g_sec_chl_manager.svr_key_lock);
+    g_sec_chl_manager.is_init = true;
+    return CC_SUCCESS;
+}
+
+void enclave_stop_sec_chl()
+{
+    if (!g_sec_chl_manager.is_init) {
+        return;
+    }
+    g_sec_chl_manager.is_init = false;
+    del_enclave_sec_chl_if(expire_all);
+    free_sec_chl_shards(SEC_CHL_SHARD_NUM);
+
+    // sessions have dropped their references, this frees the key
+    RSA_free(g_sec_chl_manager.svr_rsa_key);
+    g_sec_chl_manager.svr_rsa_key = NULL;
+    g_sec_chl_manager.svr_pubkey_len = 0;
+    // tickets issued so far can not be opened any more
+    memset(g_sec_chl_manager.ticket_key, 0, SECURE_KEY_LEN);
+    sc_fini_rwlock(&g_sec_chl_manager.svr_key_lock);
+    return;
+}
+
+int get_session_stats(uint8_t *stats, size_t stats_len)
+{
+    if (stats == NULL || stats_len != sizeof(cc_sec_chl_svr_stats_t)) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    cc_sec_chl_svr_stats_t *out = (cc_sec_chl_svr_stats_t *)stats;
+    out->session_num = __atomic_load_n(&g_sec_chl_manager.count, __ATOMIC_RELAXED);
+    out->session_bytes = __atomic_load_n(&g_sec_chl_manager.bytes, __ATOMIC_RELAXED);
+    out->evictions = __atomic_load_n(&g_sec_chl_manager.evictions, __ATOMIC_RELAXED);
+    out->rejections = __atomic_load_n(&g_sec_chl_manager.rejections, __ATOMIC_RELAXED);
+    return CC_SUCCESS;
+}
+
+int cc_sec_chl_enclave_encrypt(size_t session_id, void *plain, size_t plain_len, void *encrypt, size_t *encrypt_len)
+{
+    if (plain == NULL || plain_len == 0 || encrypt_len == NULL) {
+        PrintInfo(PRINT_ERROR, "sec chl encrypt param error\n");
+        return -1;
+    }
+    size_t need_len = get_encrypted_buf_len(plain_len);
+    if (encrypt == NULL || *encrypt_len < need_len) {
+        *encrypt_len = need_len;
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
+    if (!g_sec_chl_manager.is_init) {
+        PrintInfo(PRINT_ERROR, "sec chl encrypt failed, not inited\n");
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_rdlock(&shard->lock);
+    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(shard, session_id);
+    if (ecdh_ctx == NULL) {
+        sc_rdunlock(&shard->lock);
+        return -1;
+    }
+    int ret = sec_chl_encrypt(ecdh_ctx, session_id, plain, plain_len, encrypt, encrypt_len);
+
+    sc_rdunlock(&shard->lock);
+    if (ret != CC_SUCCESS) {
+        PrintInfo(PRINT_ERROR, "sec chl encrypt failed, ret:%d\n", ret);
+        return ret;
+    }
+
+    return 0;
+}
+
+int cc_sec_chl_enclave_decrypt(size_t session_id, void *encrypt, size_t encrypt_len, void *plain, size_t *plain_len)
+{
+    if (encrypt == NULL || encrypt_len == 0 || plain_len == NULL) {
+        PrintInfo(PRINT_ERROR, "sec chl decrypt param error\n");
         return -1;
     }
     size_t need_len = get_plain_buf_len((uint8_t *)encrypt, encrypt_len);
@@ -576,20 +1379,20 @@ int cc_sec_chl_enclave_decrypt(size_t session_id, void *encrypt, size_t encrypt_
         *plain_len = need_len;
         return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
     }
-    sc_rdlock(&g_sec_chl_manager.sec_chl_list_lock);
     if (!g_sec_chl_manager.is_init) {
-        sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
         PrintInfo(PRINT_ERROR, "sec chl decrypt failed, not inited\n");
         return CC_ERROR_SEC_CHL_NOTREADY;
     }
-    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(session_id);
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_rdlock(&shard->lock);
+    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(shard, session_id);
     if (ecdh_ctx == NULL) {
-        sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
+        sc_rdunlock(&shard->lock);
         return -1;
     }
     int ret = sec_chl_decrypt(ecdh_ctx, session_id, encrypt, encrypt_len, plain, plain_len);
 
-    sc_rdunlock(&g_sec_chl_manager.sec_chl_list_lock);
+    sc_rdunlock(&shard->lock);
     if (ret != CC_SUCCESS) {
         PrintInfo(PRINT_ERROR, "sec chl decrypt failed, ret:%d\n", ret);
         return ret;
@@ -598,33 +1401,342 @@ int cc_sec_chl_enclave_decrypt(size_t session_id, void *encrypt, size_t encrypt_
     return CC_SUCCESS;
 }
 
-/** secure channel connection timeout SEL_CHL_CONN_TIMEOUT_CNT * TIMER_INTERVAL seconds
-* secure channel receive any msg, reset the counter. When the counter reaches SEL_CHL_CONN_TIMEOUT_CNT
-* release the secure channel and resource
-*/
-static const int64_t SEL_CHL_CONN_TIMEOUT_CNT = 15;
+int cc_sec_chl_enclave_encryptv(size_t session_id, const cc_sec_chl_iovec_t *plain, size_t plain_cnt,
+    void *encrypt, size_t *encrypt_len)
+{
+    size_t plain_len = 0;
+
+    if (encrypt_len == NULL || !get_iovec_len(plain, plain_cnt, &plain_len) || plain_len == 0) {
+        PrintInfo(PRINT_ERROR, "sec chl encryptv param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    size_t need_len = get_encrypted_buf_len(plain_len);
+    if (encrypt == NULL || *encrypt_len < need_len) {
+        *encrypt_len = need_len;
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
+    if (!g_sec_chl_manager.is_init) {
+        PrintInfo(PRINT_ERROR, "sec chl encrypt failed, not inited\n");
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_rdlock(&shard->lock);
+    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(shard, session_id);
+    if (ecdh_ctx == NULL) {
+        sc_rdunlock(&shard->lock);
+        return CC_ERROR_SEC_CHL_INVALID_SESSION;
+    }
+    int ret = sec_chl_encryptv(ecdh_ctx, session_id, plain, plain_cnt, encrypt, encrypt_len);
+    sc_rdunlock(&shard->lock);
+    if (ret != CC_SUCCESS) {
+        PrintInfo(PRINT_ERROR, "sec chl encrypt failed, ret:%d\n", ret);
+    }
+    return ret;
+}
+
+int cc_sec_chl_enclave_decryptv(size_t session_id, void *encrypt, size_t encrypt_len,
+    const cc_sec_chl_iovec_t *plain, size_t plain_cnt, size_t *plain_len)
+{
+    if (encrypt == NULL || encrypt_len == 0 || plain_len == NULL) {
+        PrintInfo(PRINT_ERROR, "sec chl decryptv param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (!g_sec_chl_manager.is_init) {
+        PrintInfo(PRINT_ERROR, "sec chl decrypt failed, not inited\n");
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_rdlock(&shard->lock);
+    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(shard, session_id);
+    if (ecdh_ctx == NULL) {
+        sc_rdunlock(&shard->lock);
+        return CC_ERROR_SEC_CHL_INVALID_SESSION;
+    }
+    int ret = sec_chl_decryptv(ecdh_ctx, session_id, encrypt, encrypt_len, plain, plain_cnt, plain_len);
+    sc_rdunlock(&shard->lock);
+    if (ret != CC_SUCCESS && ret != CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH) {
+        PrintInfo(PRINT_ERROR, "sec chl decrypt failed, ret:%d\n", ret);
+    }
+    return ret;
+}
+
+int cc_sec_chl_enclave_encrypt_inplace(size_t session_id, void *buf, size_t buf_len, size_t plain_len)
+{
+    if (buf == NULL || plain_len == 0 || buf_len < get_encrypted_buf_len(plain_len)) {
+        PrintInfo(PRINT_ERROR, "sec chl encrypt inplace param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    size_t encrypt_len = buf_len;
+    cc_sec_chl_iovec_t data = {(uint8_t *)buf + CC_SEC_CHL_HEADER_LEN, plain_len};
+    return cc_sec_chl_enclave_encryptv(session_id, &data, 1, buf, &encrypt_len);
+}
+
+int cc_sec_chl_enclave_decrypt_inplace(size_t session_id, void *buf, size_t buf_len, size_t *plain_len)
+{
+    if (buf == NULL || buf_len <= CC_SEC_CHL_HEADER_LEN) {
+        PrintInfo(PRINT_ERROR, "sec chl decrypt inplace param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    cc_sec_chl_iovec_t data = {(uint8_t *)buf + CC_SEC_CHL_HEADER_LEN, buf_len - CC_SEC_CHL_HEADER_LEN};
+    return cc_sec_chl_enclave_decryptv(session_id, buf, buf_len, &data, 1, plain_len);
+}
+
+static int sec_chl_enclave_stream_init(size_t session_id, bool is_encrypt, void *header, size_t header_len,
+    cc_sec_chl_stream_t **stream)
+{
+    if (header == NULL || header_len < CC_SEC_CHL_STREAM_HEADER_LEN || stream == NULL) {
+        PrintInfo(PRINT_ERROR, "sec chl stream init param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (!g_sec_chl_manager.is_init) {
+        PrintInfo(PRINT_ERROR, "sec chl stream init failed, not inited\n");
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_rdlock(&shard->lock);
+    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(shard, session_id);
+    if (ecdh_ctx == NULL) {
+        sc_rdunlock(&shard->lock);
+        return CC_ERROR_SEC_CHL_INVALID_SESSION;
+    }
+    int ret = sec_chl_stream_init(ecdh_ctx, session_id, is_encrypt, header, stream);
+    sc_rdunlock(&shard->lock);
+    if (ret != CC_SUCCESS) {
+        PrintInfo(PRINT_ERROR, "sec chl stream init failed, ret:%d\n", ret);
+    }
+    return ret;
+}
+
+int cc_sec_chl_enclave_stream_encrypt_init(size_t session_id, void *header, size_t header_len,
+    cc_sec_chl_stream_t **stream)
+{
+    return sec_chl_enclave_stream_init(session_id, true, header, header_len, stream);
+}
 
-void enclave_check_session_timeout()
+int cc_sec_chl_enclave_stream_decrypt_init(size_t session_id, void *header, size_t header_len,
+    cc_sec_chl_stream_t **stream)
 {
-    sc_wtlock(&g_sec_chl_manager.sec_chl_list_lock);
+    return sec_chl_enclave_stream_init(session_id, false, header, header_len, stream);
+}
 
-    SEC_CHL_NODE *pre = &(g_sec_chl_manager.sec_chl_list_head);
-    SEC_CHL_NODE *cur = pre->next;
+int cc_sec_chl_enclave_stream_encrypt(cc_sec_chl_stream_t *stream, void *plain, size_t plain_len, bool is_last,
+    void *chunk, size_t *chunk_len)
+{
+    if (stream == NULL || (plain == NULL && plain_len != 0) || plain_len > CC_SEC_CHL_STREAM_MAX_CHUNK_LEN ||
+        chunk_len == NULL) {
+        PrintInfo(PRINT_ERROR, "sec chl stream encrypt param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    size_t need_len = CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN + plain_len;
+    if (chunk == NULL || *chunk_len < need_len) {
+        *chunk_len = need_len;
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
+    int ret = sec_chl_stream_encrypt(stream, plain, plain_len, is_last, chunk, chunk_len);
+    if (ret != CC_SUCCESS) {
+        PrintInfo(PRINT_ERROR, "sec chl stream encrypt failed, ret:%d\n", ret);
+    }
+    return ret;
+}
+
+/* the session is looked up for every chunk, a stream outliving its session fails instead of touching freed keys */
+int cc_sec_chl_enclave_stream_decrypt(size_t session_id, cc_sec_chl_stream_t *stream, void *chunk, size_t chunk_len,
+    void *plain, size_t *plain_len, bool *is_last)
+{
+    if (stream == NULL || chunk == NULL || plain_len == NULL || is_last == NULL) {
+        PrintInfo(PRINT_ERROR, "sec chl stream decrypt param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    size_t need_len = get_stream_plain_len(chunk, chunk_len);
+    if (need_len == SIZE_MAX) {
+        return CC_ERROR_SEC_CHL_ENCRYPTED_LEN_INVALID;
+    }
+    if ((plain == NULL && need_len != 0) || *plain_len < need_len) {
+        *plain_len = need_len;
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
+    if (!g_sec_chl_manager.is_init) {
+        PrintInfo(PRINT_ERROR, "sec chl stream decrypt failed, not inited\n");
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    SEC_CHL_SHARD *shard = get_shard(session_id);
+    sc_rdlock(&shard->lock);
+    sec_chl_ecdh_ctx_t *ecdh_ctx = get_ecdh_ctx_by_session_id(shard, session_id);
+    if (ecdh_ctx == NULL) {
+        sc_rdunlock(&shard->lock);
+        return CC_ERROR_SEC_CHL_INVALID_SESSION;
+    }
+    int ret = sec_chl_stream_decrypt(ecdh_ctx, stream, chunk, plain, plain_len, is_last);
+    sc_rdunlock(&shard->lock);
+    if (ret != CC_SUCCESS) {
+        PrintInfo(PRINT_ERROR, "sec chl stream decrypt failed, ret:%d\n", ret);
+    }
+    return ret;
+}
+
+void cc_sec_chl_enclave_stream_fini(cc_sec_chl_stream_t *stream)
+{
+    sec_chl_stream_free(stream);
+}
+
+void cc_sec_chl_enclave_set_batch_handler(cc_sec_chl_batch_handler_t handler)
+{
+    __atomic_store_n(&g_sec_chl_manager.batch_handler, handler, __ATOMIC_RELEASE);
+}
+
+/* All records must lie inside the batch before any of them is handled */
+static int check_batch(uint8_t *batch, size_t batch_len, size_t rec_num)
+{
+    size_t offset = 0;
+
+    for (size_t i = 0; i < rec_num; i++) {
+        if (batch_len - offset < sizeof(cc_sec_chl_batch_rec_t)) {
+            return CC_ERROR_BAD_PARAMETERS;
+        }
+        cc_sec_chl_batch_rec_t *rec = (cc_sec_chl_batch_rec_t *)(batch + offset);
+        if (rec->data_cap > batch_len || rec->data_len > rec->data_cap ||
+            CC_SEC_CHL_BATCH_REC_SIZE(rec->data_cap) > batch_len - offset) {
+            return CC_ERROR_BAD_PARAMETERS;
+        }
+        offset += CC_SEC_CHL_BATCH_REC_SIZE(rec->data_cap);
+    }
+    return CC_SUCCESS;
+}
+
+static int handle_batch_rec(cc_sec_chl_batch_handler_t handler, cc_sec_chl_batch_rec_t *rec)
+{
+    size_t plain_len = 0;
+    size_t reply_len = 0;
+    size_t reply_cap = rec->data_cap > CC_SEC_CHL_HEADER_LEN ? rec->data_cap - CC_SEC_CHL_HEADER_LEN : 0;
+    uint8_t *plain = rec->data + CC_SEC_CHL_HEADER_LEN;
+
+    int ret = cc_sec_chl_enclave_decrypt_inplace(rec->session_id, rec->data, rec->data_len, &plain_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    // data holds plain text from now on, it is cleared unless a reply is encrypted into it
+    rec->data_len = 0;
+    ret = handler(rec->session_id, plain, reply_cap, plain_len, &reply_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    if (reply_len > reply_cap) {
+        return CC_ERROR_SHORT_BUFFER;
+    }
+    if (reply_len == 0) {
+        return CC_SUCCESS;
+    }
+    ret = cc_sec_chl_enclave_encrypt_inplace(rec->session_id, rec->data, rec->data_cap, reply_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    rec->data_len = CC_SEC_CHL_HEADER_LEN + reply_len;
+    return CC_SUCCESS;
+}
+
+int cc_sec_chl_enclave_process_batch(void *batch, size_t batch_len, size_t rec_num)
+{
+    cc_sec_chl_batch_handler_t handler = __atomic_load_n(&g_sec_chl_manager.batch_handler, __ATOMIC_ACQUIRE);
+    uint8_t *p = (uint8_t *)batch;
+
+    if (batch == NULL || rec_num == 0 || rec_num > CC_SEC_CHL_BATCH_MAX_REC_NUM) {
+        PrintInfo(PRINT_ERROR, "sec chl process batch param error\n");
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (!g_sec_chl_manager.is_init || handler == NULL) {
+        PrintInfo(PRINT_ERROR, "sec chl process batch failed, not inited or no handler\n");
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    int ret = check_batch(p, batch_len, rec_num);
+    if (ret != CC_SUCCESS) {
+        PrintInfo(PRINT_ERROR, "sec chl process batch, malformed batch\n");
+        return ret;
+    }
+
+    for (size_t i = 0; i < rec_num; i++) {
+        cc_sec_chl_batch_rec_t *rec = (cc_sec_chl_batch_rec_t *)p;
+        rec->result = handle_batch_rec(handler, rec);
+        if (rec->result != CC_SUCCESS) {
+            rec->data_len = 0;
+        }
+        // the batch goes back to the host, nothing but the encrypted reply may be left in data
+        memset(rec->data + rec->data_len, 0, rec->data_cap - rec->data_len);
+        p += CC_SEC_CHL_BATCH_REC_SIZE(rec->data_cap);
+    }
+    return CC_SUCCESS;
+}
+
+int sec_chl_process_batch(uint8_t *batch, size_t batch_len, size_t rec_num)
+{
+    return cc_sec_chl_enclave_process_batch(batch, batch_len, rec_num);
+}
+
+/* Check the sessions in the slot whose deadline has come, the caller holds the write lock of the shard */
+static void check_wheel_slot(SEC_CHL_SHARD *shard, size_t slot, uint64_t now)
+{
+    SEC_CHL_NODE *cur = shard->wheel[slot];
 
     while (cur != NULL) {
-        if (cur->inactive_cnt > SEL_CHL_CONN_TIMEOUT_CNT) {
-            pre->next = cur->next;
-            PrintInfo(PRINT_WARNING, "sec chl node timeout, session_id:%llu\n", cur->session_id);
-            free_sec_chl_node(cur);
-            cur = pre->next;
-            g_sec_chl_manager.count--;
-            continue;
+        SEC_CHL_NODE *next = cur->wheel_next;
+        if (cur->deadline <= now) {
+            wheel_del(cur);
+            // the last check was at deadline - SEC_CHL_CHECK_PERIOD
+            if (__atomic_load_n(&cur->active_tick, __ATOMIC_RELAXED) + SEC_CHL_CHECK_PERIOD >= cur->deadline) {
+                wheel_add(shard, cur, now + SEC_CHL_CHECK_PERIOD);
+            } else {
+                PrintInfo(PRINT_WARNING, "sec chl node timeout, session_id:%llu\n", cur->session_id);
+                lru_del(shard, cur);
+                del_from_bucket(shard, cur);
+                uncharge_node(cur);
+                free_sec_chl_node(cur);
+            }
         }
-        cur->inactive_cnt++;
-        pre = cur;
-        cur = cur->next;
+        cur = next;
     }
-    sc_wtunlock(&g_sec_chl_manager.sec_chl_list_lock);
+}
 
-    return;
+/* Nodes are linked into a slot under the write lock, a slot just linked is always more than a tick ahead */
+static bool is_slot_empty(SEC_CHL_SHARD *shard, uint64_t tick)
+{
+    return __atomic_load_n(&shard->wheel[tick % SEC_CHL_WHEEL_SLOT_NUM], __ATOMIC_RELAXED) == NULL;
+}
+
+static int get_check_interval(uint64_t now)
+{
+    for (int interval = 1; interval < SEC_CHL_MAX_CHECK_INTERVAL; interval++) {
+        for (size_t i = 0; i < SEC_CHL_SHARD_NUM; i++) {
+            if (!is_slot_empty(&g_sec_chl_manager.shards[i], now + interval)) {
+                return interval;
+            }
+        }
+    }
+    return SEC_CHL_MAX_CHECK_INTERVAL;
+}
+
+int enclave_check_session_timeout(uint64_t elapsed)
+{
+    if (!g_sec_chl_manager.is_init) {
+        return SEC_CHL_MAX_CHECK_INTERVAL;
+    }
+    elapsed = elapsed == 0 ? 1 : (elapsed > SEC_CHL_MAX_ELAPSED ? SEC_CHL_MAX_ELAPSED : elapsed);
+    uint64_t now = __atomic_add_fetch(&g_sec_chl_manager.tick, elapsed, __ATOMIC_RELAXED);
+    // each slot is checked once even if the host is late by a whole lap
+    uint64_t slot_cnt = elapsed < SEC_CHL_WHEEL_SLOT_NUM ? elapsed : SEC_CHL_WHEEL_SLOT_NUM;
+
+    for (size_t i = 0; i < SEC_CHL_SHARD_NUM; i++) {
+        SEC_CHL_SHARD *shard = &g_sec_chl_manager.shards[i];
+        bool is_due = false;
+        for (uint64_t t = now - slot_cnt + 1; t <= now && !is_due; t++) {
+            is_due = !is_slot_empty(shard, t);
+        }
+        if (!is_due) {
+            continue;
+        }
+        sc_wtlock(&shard->lock);
+        for (uint64_t t = now - slot_cnt + 1; t <= now; t++) {
+            check_wheel_slot(shard, t % SEC_CHL_WHEEL_SLOT_NUM, now);
+        }
+        sc_wtunlock(&shard->lock);
+    }
+    return get_check_interval(now);
 }
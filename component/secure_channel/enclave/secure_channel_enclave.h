@@ -14,11 +14,30 @@
 #define SECURE_CHANNEL_ENCLAVE_H
 
 #include <stddef.h>
+#include "secure_channel.h"
 
 #ifdef  __cplusplus
 extern "C" {
 #endif
 
+/**
+* The handler of the msgs in a batch, it is called for each record which is decrypted successfully
+*
+* @param[in] session_id, The secure channel index of the record
+*
+* @param[in/out] buf, Holds the plain msg on input, and the plain reply on output
+*
+* @param[in] buf_len, The capacity of buf
+*
+* @param[in] msg_len, The length of plain msg
+*
+* @param[out] reply_len, The length of plain reply, 0 if there is no reply
+*
+* @retval On success, 0 is returned, others are stored as the result of the record
+*/
+typedef int (*cc_sec_chl_batch_handler_t)(size_t session_id, uint8_t *buf, size_t buf_len, size_t msg_len,
+    size_t *reply_len);
+
 /**
 * This function will encrypt data by secure channel's shared key
 *
@@ -55,6 +74,184 @@ int cc_sec_chl_enclave_encrypt(size_t session_id, void *plain, size_t plain_len,
 */
 int cc_sec_chl_enclave_decrypt(size_t session_id, void *encrypt, size_t encrypt_len, void *plain, size_t *plain_len);
 
+/**
+* This function will encrypt the plain data gathered from several segments into one encrypted msg
+*
+* @param[in] session_id, The secure channel index
+*
+* @param[in] plain, The segments to be encrypt, in order
+*
+* @param[in] plain_cnt, The number of segments
+*
+* @param[out] encrypt, The buf of encrypted. If NULL return error, and assign the needed length to encrypt_len
+*
+* @param[in/out] encrypt_len, The length of encrypted buffer. If encrypt_len is not enough, will return error,
+* and assign the needed length to encrypt_len
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+int cc_sec_chl_enclave_encryptv(size_t session_id, const cc_sec_chl_iovec_t *plain, size_t plain_cnt,
+    void *encrypt, size_t *encrypt_len);
+
+/**
+* This function will decrypt one encrypted msg and scatter the plain data into several segments
+*
+* @param[in] session_id, The secure channel index
+*
+* @param[in] encrypt, The buf to be decrypt.
+*
+* @param[in] encrypt_len, The length of encrypted buffer.
+*
+* @param[in] plain, The segments to store decrypt data, filled in order. On error they are cleared
+*
+* @param[in] plain_cnt, The number of segments
+*
+* @param[out] plain_len, The length of decrypt data. If the segments are not enough, will return error,
+* and assign the needed length to plain_len
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+int cc_sec_chl_enclave_decryptv(size_t session_id, void *encrypt, size_t encrypt_len,
+    const cc_sec_chl_iovec_t *plain, size_t plain_cnt, size_t *plain_len);
+
+/**
+* This function will encrypt data in place, the caller puts the plain data at buf + CC_SEC_CHL_HEADER_LEN,
+* after return buf holds the encrypted msg of CC_SEC_CHL_HEADER_LEN + plain_len bytes
+*
+* @param[in] session_id, The secure channel index
+*
+* @param[in/out] buf, The buf of header area followed by the plain data
+*
+* @param[in] buf_len, The length of buf, at least CC_SEC_CHL_HEADER_LEN + plain_len
+*
+* @param[in] plain_len, The length of plain data
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+int cc_sec_chl_enclave_encrypt_inplace(size_t session_id, void *buf, size_t buf_len, size_t plain_len);
+
+/**
+* This function will decrypt an encrypted msg in place, after return the plain data is at buf + CC_SEC_CHL_HEADER_LEN
+*
+* @param[in] session_id, The secure channel index
+*
+* @param[in/out] buf, The encrypted msg
+*
+* @param[in] buf_len, The length of encrypted msg
+*
+* @param[out] plain_len, The length of plain data
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+int cc_sec_chl_enclave_decrypt_inplace(size_t session_id, void *buf, size_t buf_len, size_t *plain_len);
+
+/**
+* This function will start a stream to send a large payload as a series of chunks, the stream takes one msg counter
+* of the secure channel. Send the header first and then each chunk, the peer decrypts them in the same order
+*
+* @param[in] session_id, The secure channel index
+*
+* @param[out] header, The buf of stream header
+*
+* @param[in] header_len, The length of header buf, at least CC_SEC_CHL_STREAM_HEADER_LEN
+*
+* @param[out] stream, The stream, release it by cc_sec_chl_enclave_stream_fini
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+int cc_sec_chl_enclave_stream_encrypt_init(size_t session_id, void *header, size_t header_len,
+    cc_sec_chl_stream_t **stream);
+
+/**
+* This function will start a stream to receive a large payload from the stream header sent by the peer
+*
+* @param[in] session_id, The secure channel index
+*
+* @param[in] header, The stream header
+*
+* @param[in] header_len, The length of stream header, at least CC_SEC_CHL_STREAM_HEADER_LEN
+*
+* @param[out] stream, The stream, release it by cc_sec_chl_enclave_stream_fini
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+int cc_sec_chl_enclave_stream_decrypt_init(size_t session_id, void *header, size_t header_len,
+    cc_sec_chl_stream_t **stream);
+
+/**
+* This function will encrypt the next chunk of a stream
+*
+* @param[in] stream, The stream started by cc_sec_chl_enclave_stream_encrypt_init
+*
+* @param[in] plain, The plain data of the chunk
+*
+* @param[in] plain_len, The length of plain data, at most CC_SEC_CHL_STREAM_MAX_CHUNK_LEN, 0 is allowed
+*
+* @param[in] is_last, Whether it is the last chunk, no chunk can follow it
+*
+* @param[out] chunk, The buf of encrypted chunk. If NULL return error, and assign the needed length to chunk_len
+*
+* @param[in/out] chunk_len, The length of chunk buf, CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN + plain_len is needed
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+int cc_sec_chl_enclave_stream_encrypt(cc_sec_chl_stream_t *stream, void *plain, size_t plain_len, bool is_last,
+    void *chunk, size_t *chunk_len);
+
+/**
+* This function will decrypt the next chunk of a stream. Each chunk is authentic on its own, but the payload is
+* complete only after the last chunk is decrypted. Once a chunk fails, the stream can not go on
+*
+* @param[in] session_id, The secure channel index
+*
+* @param[in] stream, The stream started by cc_sec_chl_enclave_stream_decrypt_init
+*
+* @param[in] chunk, The encrypted chunk
+*
+* @param[in] chunk_len, The length of encrypted chunk
+*
+* @param[out] plain, The buf to store decrypt data, cleared on error
+*
+* @param[in/out] plain_len, The length of plain buf, and the length of decrypt data on return. If plain_len is
+* not enough, will return error, and assign the needed length to plain_len
+*
+* @param[out] is_last, Whether the chunk is the last one of the stream
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+int cc_sec_chl_enclave_stream_decrypt(size_t session_id, cc_sec_chl_stream_t *stream, void *chunk, size_t chunk_len,
+    void *plain, size_t *plain_len, bool *is_last);
+
+/**
+* This function will release the stream, which may stop at any chunk
+*
+* @param[in] stream, The stream
+*/
+void cc_sec_chl_enclave_stream_fini(cc_sec_chl_stream_t *stream);
+
+/**
+* This function will set the handler of batched msgs, which is called by cc_sec_chl_enclave_process_batch
+*
+* @param[in] handler, The handler, NULL to disable batches
+*/
+void cc_sec_chl_enclave_set_batch_handler(cc_sec_chl_batch_handler_t handler);
+
+/**
+* This function will handle the records of a batch one by one in a single ecall: decrypt the msg in place, pass it
+* to the batch handler and encrypt the reply in place. The ecall sec_chl_process_batch of secure_channel.edl calls
+* it, an enclave with switchless calls enabled may call it from its own switchless ecall as well
+*
+* @param[in/out] batch, The packed records in enclave memory, see cc_sec_chl_batch_rec_t
+*
+* @param[in] batch_len, The length of batch
+*
+* @param[in] rec_num, The number of records, at most CC_SEC_CHL_BATCH_MAX_REC_NUM
+*
+* @retval On success, 0 is returned and each record holds its own result. On error, cc_enclave_result_t is returned,
+* a malformed batch is rejected as a whole before any record is handled
+*/
+int cc_sec_chl_enclave_process_batch(void *batch, size_t batch_len, size_t rec_num);
+
 # ifdef  __cplusplus
 }
 # endif
@@ -138,6 +138,22 @@ static int sec_chl_set_enc_key(cc_enclave_t *context, sec_chl_msg_t *msg,
     return CC_SUCCESS;
 }
 
+// switch the session to the cipher suite proposed by the client, the default suite needs no ecall
+static int sec_chl_set_algo(cc_enclave_t *context, size_t session_id, int32_t algo)
+{
+    int res;
+
+    if (algo == CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM) {
+        return CC_SUCCESS;
+    }
+    cc_enclave_result_t ret_val = set_session_algo(context, &res, session_id, algo);
+    if (ret_val != CC_SUCCESS || res != (int)CC_SUCCESS) {
+        print_error_term("set session algo %d error!\n", algo);
+        return ret_val != CC_SUCCESS ? (int)CC_FAIL : res;
+    }
+    return CC_SUCCESS;
+}
+
 static int sec_chl_get_svr_exch_param(cc_enclave_t *context, sec_chl_msg_t *msg,
     sec_chl_msg_t **rsp_msg, size_t *rsp_msg_len)
 {
@@ -147,6 +163,15 @@ static int sec_chl_get_svr_exch_param(cc_enclave_t *context, sec_chl_msg_t *msg,
     size_t  exch_param_len = 0;
     size_t  session_id = msg->session_id;
 
+    if (msg->data_len == sizeof(int32_t)) {
+        int32_t algo;
+        memcpy(&algo, msg->data, sizeof(algo));
+        res = sec_chl_set_algo(context, session_id, algo);
+        if (res != CC_SUCCESS) {
+            return res;
+        }
+    }
+
     ret_val = get_enclave_exch_param_len(context, &res, session_id, &exch_param_len);
     if (ret_val != CC_SUCCESS || res != (int)CC_SUCCESS || exch_param_len == 0) {
         print_error_term("call enclave get exch param len error!\n");
@@ -193,13 +218,106 @@ static int sec_chl_set_client_exch_param(cc_enclave_t *context, sec_chl_msg_t *m
         return CC_FAIL;
     }
 
-    sec_chl_msg_t *rsp = (sec_chl_msg_t *)calloc(1, sizeof(sec_chl_msg_t));
+    sec_chl_msg_t *rsp = (sec_chl_msg_t *)calloc(1, sizeof(sec_chl_msg_t) + SEC_CHL_TICKET_LEN);
     if (rsp == NULL) {
         return CC_ERROR_SEC_CHL_MEMORY;
     }
+    // piggyback a resumption ticket on the response, the handshake succeeds without it
+    ret_val = get_enclave_ticket(context, &res, session_id, rsp->data, SEC_CHL_TICKET_LEN);
+    if (ret_val == CC_SUCCESS && res == (int)CC_SUCCESS) {
+        rsp->data_len = SEC_CHL_TICKET_LEN;
+    } else {
+        print_warning("get enclave ticket failed\n");
+    }
 
     *rsp_msg = rsp;
-    *rsp_msg_len = sizeof(sec_chl_msg_t);
+    *rsp_msg_len = sizeof(sec_chl_msg_t) + rsp->data_len;
+
+    return CC_SUCCESS;
+}
+
+// the second round trip of the compact handshake, see sec_chl_compact_msg_t for the layout of request and response
+static int sec_chl_compact_finish(cc_enclave_t *context, sec_chl_msg_t *msg,
+    sec_chl_msg_t **rsp_msg, size_t *rsp_msg_len)
+{
+    int res;
+    cc_enclave_result_t ret_val;
+    size_t session_id = msg->session_id;
+    sec_chl_compact_msg_t *req = (sec_chl_compact_msg_t *)msg->data;
+
+    if (msg->data_len < sizeof(sec_chl_compact_msg_t) ||
+        req->len >= msg->data_len - sizeof(sec_chl_compact_msg_t)) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    size_t cli_param_len = msg->data_len - sizeof(sec_chl_compact_msg_t) - req->len;
+    res = sec_chl_set_algo(context, session_id, req->algo);
+    if (res != CC_SUCCESS) {
+        return res;
+    }
+    if (req->len > 0) {
+        ret_val = set_enc_key(context, &res, session_id, req->data, req->len);
+        if (ret_val != CC_SUCCESS || res != (int)CC_SUCCESS) {
+            print_error_term("set enc key error!\n");
+            return CC_FAIL;
+        }
+    }
+
+    size_t rsp_data_len = sizeof(sec_chl_compact_msg_t) + SEC_CHL_EXCH_PARAM_MAX_LEN + SEC_CHL_TICKET_LEN;
+    sec_chl_msg_t *rsp = (sec_chl_msg_t *)calloc(1, sizeof(sec_chl_msg_t) + rsp_data_len);
+    if (rsp == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    sec_chl_compact_msg_t *rsp_data = (sec_chl_compact_msg_t *)rsp->data;
+    rsp_data->algo = req->algo;
+    ret_val = compact_set_peer_exch_param(context, &res, session_id, req->data + req->len, cli_param_len,
+        rsp_data->data, SEC_CHL_EXCH_PARAM_MAX_LEN, &rsp_data->len);
+    if (ret_val != CC_SUCCESS || res != (int)CC_SUCCESS || rsp_data->len > SEC_CHL_EXCH_PARAM_MAX_LEN) {
+        free(rsp);
+        print_error_term("compact set peer exch param error!\n");
+        return CC_FAIL;
+    }
+    rsp->data_len = sizeof(sec_chl_compact_msg_t) + rsp_data->len;
+
+    // the ticket follows the exch param, the handshake succeeds without it
+    ret_val = get_enclave_ticket(context, &res, session_id, rsp->data + rsp->data_len, SEC_CHL_TICKET_LEN);
+    if (ret_val == CC_SUCCESS && res == (int)CC_SUCCESS) {
+        rsp->data_len += SEC_CHL_TICKET_LEN;
+    } else {
+        print_warning("get enclave ticket failed\n");
+    }
+
+    *rsp_msg = rsp;
+    *rsp_msg_len = sizeof(sec_chl_msg_t) + rsp->data_len;
+
+    return CC_SUCCESS;
+}
+
+static int sec_chl_resume(cc_enclave_t *context, sec_chl_msg_t *msg, sec_chl_msg_t **rsp_msg, size_t *rsp_msg_len)
+{
+    int res;
+    cc_enclave_result_t ret_val;
+    size_t session_id = 0;
+
+    if (msg->data_len != sizeof(sec_chl_resume_msg_t)) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    sec_chl_msg_t *rsp = (sec_chl_msg_t *)calloc(1, sizeof(sec_chl_msg_t) + sizeof(sec_chl_resume_msg_t));
+    if (rsp == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+
+    ret_val = resume_session(context, &res, &session_id, msg->data, msg->data_len,
+        rsp->data, sizeof(sec_chl_resume_msg_t));
+    if (ret_val != CC_SUCCESS || res != (int)CC_SUCCESS) {
+        free(rsp);
+        print_error_term("resume session error!\n");
+        return ret_val != CC_SUCCESS ? CC_FAIL : (cc_enclave_result_t)res;
+    }
+    rsp->session_id = session_id;
+    rsp->data_len = sizeof(sec_chl_resume_msg_t);
+
+    *rsp_msg = rsp;
+    *rsp_msg_len = sizeof(sec_chl_msg_t) + rsp->data_len;
 
     return CC_SUCCESS;
 }
@@ -239,15 +357,29 @@ static int init_timer_interval(int timerfd)
     return timerfd_settime(timerfd, 0, &new_value, NULL);
 }
 
-static void handle_timer(cc_sec_chl_svr_ctx_t *ctx)
+typedef struct {
+    uint64_t elapsed;  // timer intervals since the last check of the enclave
+    uint64_t interval;  // timer intervals the enclave has nothing due
+} sec_chl_timer_state_t;
+
+/* the enclave only gets an ecall when some session may time out */
+static void handle_timer(cc_sec_chl_svr_ctx_t *ctx, sec_chl_timer_state_t *state)
 {
     uint64_t exp = 0;
     int timerfd = ctx->timer.timerfd;
 
     int ret = read(timerfd, &exp, sizeof(uint64_t));
-    if (ret == sizeof(uint64_t)) {
-        (void)enclave_check_session_timeout(ctx->enclave_ctx);
+    if (ret != sizeof(uint64_t)) {
+        return;
+    }
+    state->elapsed += exp;
+    if (state->elapsed < state->interval) {
+        return;
     }
+    int interval = 1;
+    cc_enclave_result_t ret_val = enclave_check_session_timeout(ctx->enclave_ctx, &interval, state->elapsed);
+    state->elapsed = 0;
+    state->interval = (ret_val == CC_SUCCESS && interval > 0) ? (uint64_t)interval : 1;
     return;
 }
 
@@ -261,14 +393,15 @@ static void handle_exit_event(int eventfd, bool *is_continue)
     return;
 }
 
-static void handle_events(cc_sec_chl_svr_ctx_t *ctx, int nfd, struct epoll_event* events, bool *is_continue)
+static void handle_events(cc_sec_chl_svr_ctx_t *ctx, sec_chl_timer_state_t *state, int nfd,
+    struct epoll_event* events, bool *is_continue)
 {
     int timerfd = ctx->timer.timerfd;
     int eventfd = ctx->timer.eventfd;
 
     for (int i = 0; i < nfd && i < TIMER_MAX_EVENTS; i++) {
         if (events[i].data.fd == timerfd) {
-            handle_timer(ctx);
+            handle_timer(ctx, state);
         } else if (events[i].data.fd == eventfd) {
             handle_exit_event(eventfd, is_continue);
         }
@@ -304,6 +437,7 @@ void *check_session_timeout(void *arg)
     epoll_ctl(epollfd, EPOLL_CTL_ADD, eventfd, &ep_event);
 
     struct epoll_event events[TIMER_MAX_EVENTS];
+    sec_chl_timer_state_t state = {0, 1};
 
     bool flag = true;
     while (flag) {
@@ -311,7 +445,7 @@ void *check_session_timeout(void *arg)
         if (nfd <= 0) {
             continue;
         }
-        handle_events(ctx, nfd, events, &flag);
+        handle_events(ctx, &state, nfd, events, &flag);
     }
     close(epollfd);
 
@@ -380,7 +514,7 @@ cc_enclave_result_t cc_sec_chl_svr_init(cc_sec_chl_svr_ctx_t *ctx)
         }
     }
 
-    ret_val = enclave_start_sec_chl(ctx->enclave_ctx, &res);
+    ret_val = enclave_start_sec_chl(ctx->enclave_ctx, &res, ctx->max_session_num, ctx->max_session_bytes);
     if (ret_val != CC_SUCCESS || res != CC_SUCCESS) {
         return CC_ERROR_SEC_CHL_SVR_INIT;
     }
@@ -409,6 +543,43 @@ cc_enclave_result_t cc_sec_chl_svr_fini(cc_sec_chl_svr_ctx_t *ctx)
     return CC_SUCCESS;
 }
 
+cc_enclave_result_t cc_sec_chl_svr_process_batch(cc_sec_chl_svr_ctx_t *ctx, void *batch, size_t batch_len,
+    size_t rec_num)
+{
+    int res;
+    if (ctx == NULL || ctx->enclave_ctx == NULL || batch == NULL || rec_num == 0 ||
+        rec_num > CC_SEC_CHL_BATCH_MAX_REC_NUM) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (!ctx->is_init) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    cc_enclave_result_t ret_val = sec_chl_process_batch(ctx->enclave_ctx, &res, batch, batch_len, rec_num);
+    if (ret_val != CC_SUCCESS) {
+        print_error_term("sec chl process batch ecall failed, ret:%x\n", ret_val);
+        return ret_val;
+    }
+    return (cc_enclave_result_t)res;
+}
+
+cc_enclave_result_t cc_sec_chl_svr_get_stats(cc_sec_chl_svr_ctx_t *ctx, cc_sec_chl_svr_stats_t *stats)
+{
+    int res;
+    if (ctx == NULL || ctx->enclave_ctx == NULL || stats == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (!ctx->is_init) {
+        return CC_ERROR_SEC_CHL_NOTREADY;
+    }
+    cc_enclave_result_t ret_val = get_session_stats(ctx->enclave_ctx, &res, (uint8_t *)stats,
+        sizeof(cc_sec_chl_svr_stats_t));
+    if (ret_val != CC_SUCCESS) {
+        print_error_term("sec chl get session stats ecall failed, ret:%x\n", ret_val);
+        return ret_val;
+    }
+    return (cc_enclave_result_t)res;
+}
+
 static cc_enclave_result_t handle_recv_msg(cc_enclave_t *context, sec_chl_msg_t *msg,
     sec_chl_msg_t **rsp_msg, size_t *rsp_msg_len)
 {
@@ -426,9 +597,15 @@ static cc_enclave_result_t handle_recv_msg(cc_enclave_t *context, sec_chl_msg_t
         case SEC_CHL_MSG_SEND_CLI_EXCH_PARAM:
             ret = sec_chl_set_client_exch_param(context, msg, rsp_msg, rsp_msg_len);
             break;
+        case SEC_CHL_MSG_COMPACT_FINISH:
+            ret = sec_chl_compact_finish(context, msg, rsp_msg, rsp_msg_len);
+            break;
         case SEC_CHL_MSG_DESTROY:
             ret = sec_chl_destroy(context, msg, rsp_msg, rsp_msg_len);
             break;
+        case SEC_CHL_MSG_RESUME:
+            ret = sec_chl_resume(context, msg, rsp_msg, rsp_msg_len);
+            break;
         default:
             print_error_term("error msg type:%d\n", msg->msg_type);
             break;
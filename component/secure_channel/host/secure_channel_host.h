@@ -26,6 +26,8 @@ typedef struct {
 
 typedef struct {
     cc_enclave_t *enclave_ctx;
+    size_t max_session_num;  // max sessions at the same time, 0 means the default 1031
+    size_t max_session_bytes;  // memory budget of the sessions in the enclave, 0 means no budget
     sec_chl_timer_t timer;
     bool is_init;
 } cc_sec_chl_svr_ctx_t;
@@ -64,6 +66,32 @@ cc_enclave_result_t cc_sec_chl_svr_fini(cc_sec_chl_svr_ctx_t *ctx);
 */
 cc_enclave_result_t cc_sec_chl_svr_callback(cc_sec_chl_conn_ctx_t *ctx, void *buf, size_t buf_len);
 
+/**
+* hand the encrypted msgs of many sessions to the enclave in one ecall, the enclave decrypts each of them, passes it
+* to the handler set by cc_sec_chl_enclave_set_batch_handler and encrypts the reply back into the record
+* @param[in] ctx, The pointer of secure channel context
+*
+* @param[in/out] batch, The packed records, see cc_sec_chl_batch_rec_t
+* @param[in] batch_len, The length of batch
+* @param[in] rec_num, The number of records, at most CC_SEC_CHL_BATCH_MAX_REC_NUM
+*
+* @retval On success, 0 is returned, and the result of each record is in the record.
+*         On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_svr_process_batch(cc_sec_chl_svr_ctx_t *ctx, void *batch, size_t batch_len,
+    size_t rec_num);
+
+/**
+* get the counters of the session store in the enclave. A new session beyond max_session_num or max_session_bytes
+* evicts the least recently active session, it is rejected if all sessions got a msg in the current timer tick
+* @param[in] ctx, The pointer of secure channel context
+*
+* @param[out] stats, The counters
+*
+* @retval On success, 0 is returned. On error, cc_enclave_result_t is returned.
+*/
+cc_enclave_result_t cc_sec_chl_svr_get_stats(cc_sec_chl_svr_ctx_t *ctx, cc_sec_chl_svr_stats_t *stats);
+
 # ifdef  __cplusplus
 }
 # endif
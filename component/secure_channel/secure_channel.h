@@ -14,11 +14,80 @@
 #define SECURE_CHANNEL_H
 
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #ifdef  __cplusplus
 extern "C" {
 #endif
 
+/*
+ * Cipher suites of the secure channel, the client proposes one in the handshake and the server accepts it if its
+ * crypto library supports it. The tag of any suite is CC_SEC_CHL_GCM_TAG_LEN bytes.
+ */
+typedef enum {
+    CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM,   // international Data Encryption Algorithm suite
+    CC_SEC_CHL_ALGO_RSA_ECDH_CHACHA20_POLY1305,  // for cores without aes instructions
+    CC_SEC_CHL_ALGO_RSA_SM2_ECDH_SM4_GCM,  // shang mi suite, ecdh on the sm2 curve, needs openssl with sm4-gcm
+    // some algos suite to implement below
+    // CC_SEC_CHL_ALGO_RSA,                // RSA public private key
+    // CC_SEC_CHL_ALGO_SM2,                // SM2 public private key
+    CC_SEC_CHL_ALGO_MAX
+} cc_sec_chl_algo_t;
+
+/* Counters of the session store of the server enclave */
+typedef struct {
+    uint64_t session_num;    // sessions in the store
+    uint64_t session_bytes;  // approximate memory held by the sessions
+    uint64_t evictions;      // idle sessions evicted to make room for new ones
+    uint64_t rejections;     // new sessions refused, since the store is full of sessions active in the current tick
+} cc_sec_chl_svr_stats_t;
+
+/* one segment of the plain data of the scatter-gather encrypt and decrypt interfaces */
+typedef struct cc_sec_chl_iovec {
+    void *base;
+    size_t len;
+} cc_sec_chl_iovec_t;
+
+/*
+ * An encrypted msg is the header followed by the encrypted data, which is as long as the plain data. The header
+ * carries session id, data length, msg counter and gcm tag. The in-place interfaces expect the caller to reserve
+ * CC_SEC_CHL_HEADER_LEN bytes in front of the data.
+ */
+#define CC_SEC_CHL_GCM_TAG_LEN 16
+#define CC_SEC_CHL_HEADER_LEN (sizeof(size_t) + sizeof(size_t) + sizeof(uint64_t) + CC_SEC_CHL_GCM_TAG_LEN)
+
+/*
+ * A stream carries a large payload as a series of chunks, each of them is authenticated on its own, so the receiver
+ * releases plain data chunk by chunk with constant memory. The stream starts with a header of
+ * CC_SEC_CHL_STREAM_HEADER_LEN bytes. A chunk is the uint32_t length of its data, flags, gcm tag and the encrypted
+ * data, CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN + length bytes in all. The last chunk authenticates the total length,
+ * the payload is complete only once it is verified.
+ */
+typedef struct cc_sec_chl_stream cc_sec_chl_stream_t;
+#define CC_SEC_CHL_STREAM_HEADER_LEN (sizeof(size_t) + sizeof(uint64_t))
+#define CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN (sizeof(uint32_t) + sizeof(uint32_t) + CC_SEC_CHL_GCM_TAG_LEN)
+#define CC_SEC_CHL_STREAM_MAX_CHUNK_LEN (16 * 1024 * 1024)
+
+/*
+ * A batch carries the msgs of many sessions through one ecall. Records are packed back to back, a record is a
+ * cc_sec_chl_batch_rec_t followed by data_cap bytes of data, CC_SEC_CHL_BATCH_REC_SIZE(data_cap) bytes in all.
+ * On input data holds an encrypted msg of the session, on output it holds the encrypted reply, if any.
+ */
+typedef struct {
+    size_t   session_id;
+    size_t   data_len;  // in: length of encrypted msg; out: length of encrypted reply, 0 if there is none
+    size_t   data_cap;  // capacity of data
+    int32_t  result;    // out: cc_enclave_result_t of the record
+    uint32_t reserved;
+    uint8_t  data[];
+} cc_sec_chl_batch_rec_t;
+#define CC_SEC_CHL_BATCH_REC_ALIGN 8
+#define CC_SEC_CHL_BATCH_REC_SIZE(data_cap) \
+    ((sizeof(cc_sec_chl_batch_rec_t) + (data_cap) + CC_SEC_CHL_BATCH_REC_ALIGN - 1) & \
+    ~(size_t)(CC_SEC_CHL_BATCH_REC_ALIGN - 1))
+#define CC_SEC_CHL_BATCH_MAX_REC_NUM 1024
+
 /* network transmission connection */
 /**
 * network transmission connection read/write function type
@@ -19,10 +19,10 @@
 #include "status.h"
 
 typedef struct _aes_algorithm_param {
-    uint8_t *plain;
-    int plain_len;
+    const cc_sec_chl_iovec_t *plain;  // segments of plain data
+    size_t plain_cnt;
     uint8_t *cipher;
-    int cipher_len;
+    size_t cipher_len;
     uint8_t *aad;
     int aad_len;
     uint8_t *key;
@@ -128,180 +128,390 @@ static int drive_key_hkdf(uint8_t *secret, size_t secret_len, uint8_t *salt, siz
     return CC_SUCCESS;
 }
 
-#define KEY_LEN_128 (128 / 8)
-#define KEY_LEN_192 (192 / 8)
-#define KEY_LEN_256 (256 / 8)
-static const EVP_CIPHER *get_cipher(int key_len)
+/*
+ * Every suite uses an aead cipher with a 12 bytes nonce and a 16 bytes tag. The keys are SECURE_KEY_LEN bytes, a
+ * cipher with a shorter key such as sm4 uses the head of them. Sm4-gcm is only provided by openssl 3.2 or later.
+ */
+static const char *g_algo_cipher_name[CC_SEC_CHL_ALGO_MAX] = {
+    [CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM] = "AES-256-GCM",
+    [CC_SEC_CHL_ALGO_RSA_ECDH_CHACHA20_POLY1305] = "ChaCha20-Poly1305",
+    [CC_SEC_CHL_ALGO_RSA_SM2_ECDH_SM4_GCM] = "SM4-GCM",
+};
+
+static EVP_CIPHER *fetch_cipher(cc_sec_chl_algo_t algo)
 {
-    const EVP_CIPHER *cipher = NULL;
-    if (key_len == KEY_LEN_128) {
-        cipher = EVP_aes_128_gcm();
-    } else if (key_len == KEY_LEN_192) {
-        cipher = EVP_aes_192_gcm();
-    } else if (key_len == KEY_LEN_256) {
-        cipher = EVP_aes_256_gcm();
-    } else {
-        cipher = NULL;
-    }
+    if (algo < 0 || algo >= CC_SEC_CHL_ALGO_MAX) {
+        return NULL;
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_CIPHER_fetch(NULL, g_algo_cipher_name[algo], NULL);
+#else
+    return (EVP_CIPHER *)EVP_get_cipherbyname(g_algo_cipher_name[algo]);
+#endif
+}
 
-    return cipher;
+static void free_cipher(EVP_CIPHER *cipher)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_CIPHER_free(cipher);
+#else
+    (void)cipher;
+#endif
 }
 
-#define AES_BATCH_LEN 128
-static int aes_gcm_encrypt(aes_param_t *aes_enc)
+int get_sec_chl_algo_ec_nid(cc_sec_chl_algo_t algo)
 {
-    int howmany;
-    int len = 0;
-    const EVP_CIPHER *cipher = NULL;
-    EVP_CIPHER_CTX *ctx = NULL;
-    const int batch_len = AES_BATCH_LEN; // bytes
-    int res = 0;
+    return algo == CC_SEC_CHL_ALGO_RSA_SM2_ECDH_SM4_GCM ? NID_sm2 : SEC_CHL_DEFAULT_EC_NID;
+}
 
-    cipher = get_cipher(aes_enc->key_len);
-    if (cipher == NULL || aes_enc->tag == NULL || aes_enc->tag_len == 0) {
-        return SECURE_CHANNEL_ERROR;
+bool is_sec_chl_algo_supported(cc_sec_chl_algo_t algo)
+{
+    EVP_CIPHER *cipher = fetch_cipher(algo);
+    if (cipher == NULL) {
+        return false;
+    }
+    free_cipher(cipher);
+    EC_GROUP *group = EC_GROUP_new_by_curve_name(get_sec_chl_algo_ec_nid(algo));
+    if (group == NULL) {
+        return false;
     }
+    EC_GROUP_free(group);
+    return true;
+}
 
-    ctx = EVP_CIPHER_CTX_new();
-    if (ctx == NULL)
-        return SECURE_CHANNEL_ERROR;
+static EVP_CIPHER_CTX *new_keyed_cipher_ctx(cc_sec_chl_algo_t algo, const uint8_t *key, int is_enc)
+{
+    EVP_CIPHER *cipher = fetch_cipher(algo);
+    if (cipher == NULL) {
+        return NULL;
+    }
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL) {
+        free_cipher(cipher);
+        return NULL;
+    }
+    // the ctx keeps its own reference of the cipher
+    if (EVP_CipherInit_ex(ctx, cipher, NULL, NULL, NULL, is_enc) <= 0 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, SEC_CHL_NONCE_LEN, NULL) <= 0 ||
+        EVP_CipherInit_ex(ctx, NULL, NULL, key, NULL, is_enc) <= 0) {
+        EVP_CIPHER_CTX_free(ctx);
+        ctx = NULL;
+    }
+    free_cipher(cipher);
+    return ctx;
+}
 
-    if (EVP_EncryptInit_ex(ctx, cipher, NULL, NULL, NULL) <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto enc_out;
+/*
+ * Every 2^SEC_CHL_REKEY_SHIFT messages a direction moves to the key of the next epoch. The key of epoch 0 is the
+ * direction key, later ones are derived from it, so both sides derive the key of an epoch on their own.
+ */
+static int get_epoch_key(sec_chl_direction_t *dir, uint64_t epoch, uint8_t *key)
+{
+    uint8_t label[] = "rekey\0\0\0\0\0\0\0\0";
+    size_t prefix_len = strlen("rekey");
+
+    if (epoch == 0) {
+        memcpy(key, dir->key, SECURE_KEY_LEN);
+        return CC_SUCCESS;
     }
-    // set aes_enc->key & aes_enc->iv
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, aes_enc->iv_len, NULL) <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto enc_out;
+    num_to_buf(epoch, label + prefix_len, sizeof(epoch));
+    return drive_key_hkdf(dir->key, SECURE_KEY_LEN, dir->salt, SEC_CHL_SALT_LEN, label, prefix_len + sizeof(epoch),
+        key, SECURE_KEY_LEN);
+}
+
+static int key_cipher_ctx(sec_chl_direction_t *dir, int is_enc, uint64_t epoch, EVP_CIPHER_CTX **ctx)
+{
+    uint8_t key[SECURE_KEY_LEN];
+    int ret = CC_SUCCESS;
+
+    if (get_epoch_key(dir, epoch, key) != CC_SUCCESS) {
+        return CC_FAIL;
     }
-    if (EVP_EncryptInit_ex(ctx, NULL, NULL, aes_enc->key, aes_enc->iv) <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto enc_out;
+    if (*ctx == NULL) {
+        *ctx = new_keyed_cipher_ctx(dir->algo, key, is_enc);
+        ret = *ctx == NULL ? CC_FAIL : CC_SUCCESS;
+    } else if (EVP_CipherInit_ex(*ctx, NULL, NULL, key, NULL, is_enc) <= 0) {
+        ret = CC_FAIL;
     }
+    memset(key, 0, sizeof(key));
+    return ret;
+}
 
-    if (aes_enc->aad && aes_enc->aad_len > 0) {
-        if (EVP_EncryptUpdate(ctx, NULL, &howmany, aes_enc->aad, aes_enc->aad_len) <= 0) {
-            res = SECURE_CHANNEL_ERROR;
-            goto enc_out;
+/*
+ * A direction keeps a few cipher ctxs, keyed once with the key of the current epoch, each message only sets a new
+ * nonce. A thread takes a free ctx of the pool, which is created on first use. When all of them are busy, or the
+ * epoch is not yet the current one, it falls back to a temporary ctx.
+ */
+static EVP_CIPHER_CTX *acquire_cipher_ctx(sec_chl_direction_t *dir, int is_enc, uint64_t epoch, bool use_pool,
+    int *slot)
+{
+    sec_chl_cipher_pool_t *pool = &dir->pool;
+    EVP_CIPHER_CTX *ctx = NULL;
+
+    for (int i = 0; use_pool && i < SEC_CHL_CIPHER_CTX_NUM; i++) {
+        if (__atomic_exchange_n(&pool->busy[i], 1, __ATOMIC_ACQUIRE) != 0) {
+            continue;
+        }
+        if (pool->ctx[i] == NULL || pool->epoch[i] != epoch) {
+            if (key_cipher_ctx(dir, is_enc, epoch, &pool->ctx[i]) != CC_SUCCESS) {
+                __atomic_store_n(&pool->busy[i], 0, __ATOMIC_RELEASE);
+                return NULL;
+            }
+            pool->epoch[i] = epoch;
         }
+        *slot = i;
+        return pool->ctx[i];
+    }
+    *slot = -1;
+    if (key_cipher_ctx(dir, is_enc, epoch, &ctx) != CC_SUCCESS) {
+        EVP_CIPHER_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static void release_cipher_ctx(sec_chl_direction_t *dir, EVP_CIPHER_CTX *ctx, int slot)
+{
+    if (slot < 0) {
+        EVP_CIPHER_CTX_free(ctx);
+        return;
     }
-    while (len <= aes_enc->plain_len - batch_len) {
-        if (EVP_EncryptUpdate(ctx, aes_enc->cipher + len, &howmany, aes_enc->plain + len, batch_len) <= 0) {
-            res = SECURE_CHANNEL_ERROR;
-            goto enc_out;
+    __atomic_store_n(&dir->pool.busy[slot], 0, __ATOMIC_RELEASE);
+}
+
+/* No thread may use the pools, the ctxs are keyed again on next use */
+static void free_session_cipher_ctx(sec_chl_ecdh_ctx_t *ecdh_ctx)
+{
+    for (int i = 0; i < SEC_CHL_CIPHER_CTX_NUM; i++) {
+        EVP_CIPHER_CTX_free(ecdh_ctx->send.pool.ctx[i]);
+        ecdh_ctx->send.pool.ctx[i] = NULL;
+        EVP_CIPHER_CTX_free(ecdh_ctx->recv.pool.ctx[i]);
+        ecdh_ctx->recv.pool.ctx[i] = NULL;
+    }
+}
+
+/* nonce = salt of the direction | message counter in big endian */
+static void get_nonce(const sec_chl_direction_t *dir, uint64_t seq, uint8_t *nonce)
+{
+    memcpy(nonce, dir->salt, SEC_CHL_SALT_LEN);
+    num_to_buf(seq, nonce + SEC_CHL_SALT_LEN, sizeof(seq));
+}
+
+static void replay_lock(sec_chl_direction_t *dir)
+{
+    while (__atomic_exchange_n(&dir->lock, 1, __ATOMIC_ACQUIRE) != 0) {
+        // the lock is held for a few instructions, wait for it to be released before trying again
+        while (__atomic_load_n(&dir->lock, __ATOMIC_RELAXED) != 0) {
+#if defined(__aarch64__)
+            __asm__ __volatile__("yield" ::: "memory");
+#elif defined(__x86_64__)
+            __asm__ __volatile__("pause" ::: "memory");
+#else
+            __asm__ __volatile__("" ::: "memory");
+#endif
         }
-        len += batch_len;
-        aes_enc->cipher_len += howmany;
     }
-    if (EVP_EncryptUpdate(ctx, aes_enc->cipher + len, &howmany, aes_enc->plain + len, (aes_enc->plain_len - len)) <=
-        0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto enc_out;
+}
+
+static void replay_unlock(sec_chl_direction_t *dir)
+{
+    __atomic_store_n(&dir->lock, 0, __ATOMIC_RELEASE);
+}
+
+#define REPLAY_WORD_BITS 64
+#define REPLAY_WORD_NUM (SEC_CHL_REPLAY_WINDOW / REPLAY_WORD_BITS)
+
+/* The caller holds the replay lock. Bit i of the window is set if message max_seq - i has been accepted. */
+static bool replay_check(const sec_chl_direction_t *dir, uint64_t seq)
+{
+    if (!dir->has_recv || seq > dir->seq) {
+        return true;
     }
-    aes_enc->cipher_len += howmany;
+    uint64_t diff = dir->seq - seq;
+    if (diff >= SEC_CHL_REPLAY_WINDOW) {
+        return false;
+    }
+    return (dir->window[diff / REPLAY_WORD_BITS] & (1ULL << (diff % REPLAY_WORD_BITS))) == 0;
+}
 
-    if (EVP_EncryptFinal_ex(ctx, aes_enc->cipher + aes_enc->plain_len, &howmany) <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto enc_out;
+static void replay_window_shift(uint64_t *window, uint64_t shift)
+{
+    if (shift >= SEC_CHL_REPLAY_WINDOW) {
+        memset(window, 0, REPLAY_WORD_NUM * sizeof(uint64_t));
+        return;
     }
-    aes_enc->cipher_len += howmany;
+    size_t words = shift / REPLAY_WORD_BITS;
+    size_t bits = shift % REPLAY_WORD_BITS;
+    for (size_t i = REPLAY_WORD_NUM; i-- > 0;) {
+        uint64_t v = 0;
+        if (i >= words) {
+            v = window[i - words] << bits;
+            if (bits != 0 && i > words) {
+                v |= window[i - words - 1] >> (REPLAY_WORD_BITS - bits);
+            }
+        }
+        window[i] = v;
+    }
+}
 
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, aes_enc->tag_len, aes_enc->tag) <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto enc_out;
+/*
+ * The caller holds the replay lock. The epoch of a received message comes from its counter before the tag is
+ * verified, so it may be at most SEC_CHL_MAX_EPOCH_JUMP ahead of the epoch of the messages accepted, and only the
+ * key of the accepted epoch is kept in the pool. The pool moves to the next epoch once a message of it is accepted.
+ */
+#define SEC_CHL_MAX_EPOCH_JUMP 1
+static uint64_t replay_epoch(const sec_chl_direction_t *dir)
+{
+    return dir->has_recv ? dir->seq >> SEC_CHL_REKEY_SHIFT : 0;
+}
+
+/* The caller holds the replay lock and has checked seq */
+static void replay_update(sec_chl_direction_t *dir, uint64_t seq)
+{
+    if (!dir->has_recv || seq > dir->seq) {
+        replay_window_shift(dir->window, dir->has_recv ? seq - dir->seq : SEC_CHL_REPLAY_WINDOW);
+        dir->seq = seq;
+        dir->has_recv = true;
     }
+    uint64_t diff = dir->seq - seq;
+    dir->window[diff / REPLAY_WORD_BITS] |= 1ULL << (diff % REPLAY_WORD_BITS);
+}
+
+// EVP update takes an int length, so long segments are fed in pieces
+#define SEC_CHL_UPDATE_MAX_LEN (1U << 30)
+static int cipher_update(EVP_CIPHER_CTX *ctx, uint8_t *out, const uint8_t *in, size_t len)
+{
+    int howmany;
 
-    res = 0;
-enc_out:
-    EVP_CIPHER_CTX_free(ctx);
-    if (res < 0) {
-        return res;
+    while (len > 0) {
+        size_t chunk = len > SEC_CHL_UPDATE_MAX_LEN ? SEC_CHL_UPDATE_MAX_LEN : len;
+        int n = (int)chunk;
+        if (EVP_CipherUpdate(ctx, out, &howmany, in, n) <= 0 || howmany != n) {
+            return SECURE_CHANNEL_ERROR;
+        }
+        out += chunk;
+        in += chunk;
+        len -= chunk;
     }
-    return (int)aes_enc->cipher_len;
+    return CC_SUCCESS;
 }
 
-static int aes_gcm_decrypt(aes_param_t *aes_dec)
+/* ctx is keyed already, aes_enc->key is not used. The plain segments are encrypted into cipher one after another. */
+static int aead_encrypt(EVP_CIPHER_CTX *ctx, aes_param_t *aes_enc)
 {
     int howmany;
-    int len = 0;
-    const EVP_CIPHER *cipher;
-    EVP_CIPHER_CTX *ctx = NULL;
-    const int batch_len = AES_BATCH_LEN; // bytes
-    int res = 0;
 
-    cipher = get_cipher(aes_dec->key_len);
-    if (cipher == NULL || aes_dec->tag == NULL || aes_dec->tag_len == 0) {
+    if (aes_enc->tag == NULL || aes_enc->tag_len == 0 || aes_enc->iv_len != SEC_CHL_NONCE_LEN) {
+        return SECURE_CHANNEL_ERROR;
+    }
+    if (EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, aes_enc->iv) <= 0) {
         return SECURE_CHANNEL_ERROR;
     }
-    ctx = EVP_CIPHER_CTX_new();
-    if (ctx == NULL)
+
+    if (aes_enc->aad && aes_enc->aad_len > 0) {
+        if (EVP_EncryptUpdate(ctx, NULL, &howmany, aes_enc->aad, aes_enc->aad_len) <= 0) {
+            return SECURE_CHANNEL_ERROR;
+        }
+    }
+    for (size_t i = 0; i < aes_enc->plain_cnt; i++) {
+        if (cipher_update(ctx, aes_enc->cipher + aes_enc->cipher_len, aes_enc->plain[i].base,
+            aes_enc->plain[i].len) != CC_SUCCESS) {
+            return SECURE_CHANNEL_ERROR;
+        }
+        aes_enc->cipher_len += aes_enc->plain[i].len;
+    }
+
+    if (EVP_EncryptFinal_ex(ctx, aes_enc->cipher + aes_enc->cipher_len, &howmany) <= 0) {
         return SECURE_CHANNEL_ERROR;
+    }
 
-    if (EVP_DecryptInit_ex(ctx, cipher, NULL, NULL, NULL) <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto dec_out;
+    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, aes_enc->tag_len, aes_enc->tag) <= 0) {
+        return SECURE_CHANNEL_ERROR;
     }
 
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, aes_dec->iv_len, NULL) <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto dec_out;
+    return CC_SUCCESS;
+}
+
+/*
+ * ctx is keyed already, aes_dec->key is not used. cipher is decrypted into the plain segments one after another,
+ * they must hold cipher_len bytes. The plain data is not authentic unless CC_SUCCESS is returned.
+ */
+static int aead_decrypt(EVP_CIPHER_CTX *ctx, aes_param_t *aes_dec)
+{
+    int howmany;
+    size_t done = 0;
+
+    if (aes_dec->tag == NULL || aes_dec->tag_len == 0 || aes_dec->iv_len != SEC_CHL_NONCE_LEN) {
+        return SECURE_CHANNEL_ERROR;
     }
-    if (EVP_DecryptInit_ex(ctx, NULL, NULL, aes_dec->key, aes_dec->iv) <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto dec_out;
+    if (EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, aes_dec->iv) <= 0) {
+        return SECURE_CHANNEL_ERROR;
     }
 
     if (aes_dec->aad != NULL && aes_dec->aad_len > 0) {
         if (EVP_DecryptUpdate(ctx, NULL, &howmany, aes_dec->aad, aes_dec->aad_len) <= 0) {
-            res = SECURE_CHANNEL_ERROR;
-            goto dec_out;
+            return SECURE_CHANNEL_ERROR;
         }
     }
-    while (len <= aes_dec->cipher_len - batch_len) {
-        if (EVP_DecryptUpdate(ctx, aes_dec->plain + len, &howmany, aes_dec->cipher + len, batch_len) <= 0) {
-            res = SECURE_CHANNEL_ERROR;
-            goto dec_out;
+    for (size_t i = 0; i < aes_dec->plain_cnt && done < aes_dec->cipher_len; i++) {
+        size_t n = aes_dec->cipher_len - done;
+        n = n < aes_dec->plain[i].len ? n : aes_dec->plain[i].len;
+        if (cipher_update(ctx, aes_dec->plain[i].base, aes_dec->cipher + done, n) != CC_SUCCESS) {
+            return SECURE_CHANNEL_ERROR;
         }
-        len += batch_len;
-        aes_dec->plain_len += howmany;
+        done += n;
     }
-    if (EVP_DecryptUpdate(ctx, aes_dec->plain + len, &howmany, aes_dec->cipher + len, (aes_dec->cipher_len - len)) <=
-        0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto dec_out;
+    if (done != aes_dec->cipher_len) {
+        return SECURE_CHANNEL_ERROR;
     }
-    aes_dec->plain_len += howmany;
 
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, aes_dec->tag_len, aes_dec->tag) <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto dec_out;
+    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, aes_dec->tag_len, aes_dec->tag) <= 0) {
+        return SECURE_CHANNEL_ERROR;
     }
-    res = EVP_DecryptFinal_ex(ctx, aes_dec->plain + aes_dec->cipher_len, &howmany);
-    aes_dec->plain_len += howmany;
-
-    if (res <= 0) {
-        res = SECURE_CHANNEL_ERROR;
-        goto dec_out;
+    if (EVP_DecryptFinal_ex(ctx, NULL, &howmany) <= 0) {
+        return SECURE_CHANNEL_ERROR;
     }
 
-    res = 0;
-dec_out:
-    EVP_CIPHER_CTX_free(ctx);
-    if (res < 0) {
-        return res;
-    }
-    return aes_dec->plain_len;
+    return CC_SUCCESS;
 }
 
 typedef struct {
     size_t      session_id;
     size_t      data_len;
-    uint8_t     iv[SECURE_IV_LEN];
+    uint64_t    seq;              // message counter of the sender, makes up the gcm nonce with the direction salt
     uint8_t     gcm_tag[GCM_TAG_LEN];
     uint8_t     data[0];          // encrypted data, len is data_len
 } sec_chl_encrypt_data_t;
 
+// the header length is part of the in-place interfaces
+typedef char sec_chl_header_len_check_t[(sizeof(sec_chl_encrypt_data_t) == CC_SEC_CHL_HEADER_LEN) ? 1 : -1];
+
+bool get_iovec_len(const cc_sec_chl_iovec_t *iov, size_t iov_cnt, size_t *len)
+{
+    size_t total = 0;
+
+    if (iov == NULL && iov_cnt != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < iov_cnt; i++) {
+        if ((iov[i].base == NULL && iov[i].len != 0) || total + iov[i].len < total) {
+            return false;
+        }
+        total += iov[i].len;
+    }
+    *len = total;
+    return true;
+}
+
+static void clear_iovec(const cc_sec_chl_iovec_t *iov, size_t iov_cnt)
+{
+    for (size_t i = 0; i < iov_cnt; i++) {
+        if (iov[i].base != NULL) {
+            memset(iov[i].base, 0, iov[i].len);
+        }
+    }
+}
+
 size_t get_encrypted_buf_len(size_t plain_len)
 {
     return sizeof(sec_chl_encrypt_data_t) + plain_len;
@@ -311,6 +521,9 @@ size_t get_plain_buf_len(uint8_t *encrypt, size_t encrypt_len)
 {
     sec_chl_encrypt_data_t tmp = {0};
 
+    if (encrypt_len < sizeof(sec_chl_encrypt_data_t)) {
+        return 0;
+    }
     size_t expect_plain_len = encrypt_len - sizeof(sec_chl_encrypt_data_t);
     size_t real_plain_len = 0;
     memcpy(&real_plain_len, encrypt + sizeof(tmp.session_id), sizeof(tmp.data_len));
@@ -320,21 +533,31 @@ size_t get_plain_buf_len(uint8_t *encrypt, size_t encrypt_len)
     return real_plain_len;
 }
 
-int sec_chl_decrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *recv_buf, int recv_buf_len,
-    uint8_t *out_buf, size_t *out_buf_len)
+int sec_chl_decryptv(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *recv_buf, size_t recv_buf_len,
+    const cc_sec_chl_iovec_t *plain, size_t plain_cnt, size_t *plain_len)
 {
-    int out_len;
-    uint8_t iv[SECURE_IV_LEN];
+    uint8_t nonce[SEC_CHL_NONCE_LEN];
     uint8_t *p_buf = recv_buf;
     uint8_t *aad = NULL;
     uint8_t *cipher = NULL;
     uint8_t *tag = NULL;
     int aad_len;
     size_t data_len;
+    size_t plain_cap = 0;
+    uint64_t seq;
+    uint64_t epoch;
+    bool is_new;
     aes_param_t aes_dec;
+    sec_chl_direction_t *dir = &ecdh_ctx->recv;
 
-    (void)recv_buf_len;
-    aes_dec.key = ecdh_ctx->session_key;
+    data_len = get_plain_buf_len(recv_buf, recv_buf_len);
+    if (data_len == 0) {
+        return CC_ERROR_SEC_CHL_ENCRYPTED_LEN_INVALID;
+    }
+    if (!get_iovec_len(plain, plain_cnt, &plain_cap) || plain_cap < data_len) {
+        *plain_len = data_len;
+        return CC_ERROR_SEC_CHL_LEN_NOT_ENOUGH;
+    }
 
     size_t real_session_id;
     memcpy(&real_session_id, p_buf, sizeof(real_session_id));
@@ -344,54 +567,107 @@ int sec_chl_decrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *re
         return CC_ERROR_SEC_CHL_DECRYPT_SESSIONID_INVALID;
     }
 
-    memcpy(&data_len, p_buf, sizeof(data_len));
     p_buf += sizeof(data_len);
 
-    memcpy(iv, p_buf, SECURE_IV_LEN);
-    p_buf += SECURE_IV_LEN;
+    memcpy(&seq, p_buf, sizeof(seq));
+    p_buf += sizeof(seq);
+
+    // drop replayed messages before paying for the decryption, the window only moves once the tag is verified
+    replay_lock(dir);
+    is_new = replay_check(dir, seq);
+    epoch = replay_epoch(dir);
+    replay_unlock(dir);
+    if (!is_new) {
+        return CC_ERROR_SEC_CHL_REPLAY;
+    }
+    if ((seq >> SEC_CHL_REKEY_SHIFT) > epoch + SEC_CHL_MAX_EPOCH_JUMP) {
+        return CC_ERROR_SEC_CHL_DECRYPT;
+    }
+    get_nonce(dir, seq, nonce);
+
+    aad = recv_buf; // session_id、data_len、seq作为附加信息，使用tag保护附加信息的完整性
+    aad_len = sizeof(session_id) + sizeof(data_len) + sizeof(seq);
 
-    aad = recv_buf; // session_id和data_len作为附加信息，使用tag保护附加信息的完整性
-    aad_len = sizeof(session_id) + sizeof(data_len) + SECURE_IV_LEN;
-    
     tag = p_buf;
     p_buf += GCM_TAG_LEN;
 
     cipher = p_buf;
 
-    aes_dec.plain = out_buf;
-    aes_dec.plain_len = 0;
+    aes_dec.plain = plain;
+    aes_dec.plain_cnt = plain_cnt;
     aes_dec.cipher = cipher;
     aes_dec.cipher_len = data_len;
     aes_dec.aad = aad;
     aes_dec.aad_len = aad_len;
+    aes_dec.key = NULL;
     aes_dec.key_len = SECURE_KEY_LEN;
-    aes_dec.iv = iv;
-    aes_dec.iv_len = SECURE_IV_LEN;
+    aes_dec.iv = nonce;
+    aes_dec.iv_len = SEC_CHL_NONCE_LEN;
     aes_dec.tag = tag;
     aes_dec.tag_len = GCM_TAG_LEN;
-    out_len = aes_gcm_decrypt(&aes_dec);
+    int slot;
+    // the key of another epoch goes to a temporary ctx until the tag shows the message is authentic
+    EVP_CIPHER_CTX *ctx = acquire_cipher_ctx(dir, 0, seq >> SEC_CHL_REKEY_SHIFT, (seq >> SEC_CHL_REKEY_SHIFT) == epoch,
+        &slot);
+    if (ctx == NULL) {
+        memset(&aes_dec, 0, sizeof(aes_param_t));
+        return CC_ERROR_SEC_CHL_DECRYPT;
+    }
+    int ret = aead_decrypt(ctx, &aes_dec);
+    release_cipher_ctx(dir, ctx, slot);
     memset(&aes_dec, 0, sizeof(aes_param_t));
-    if (out_len <= 0 || out_len != (int)data_len) {
+    if (ret != CC_SUCCESS) {
+        // never leave unauthenticated plain data to the caller
+        clear_iovec(plain, plain_cnt);
         return CC_ERROR_SEC_CHL_DECRYPT;
     }
-    *out_buf_len =  out_len;
+
+    // another thread may have accepted the same message meanwhile
+    replay_lock(dir);
+    is_new = replay_check(dir, seq);
+    if (is_new) {
+        replay_update(dir, seq);
+    }
+    replay_unlock(dir);
+    if (!is_new) {
+        clear_iovec(plain, plain_cnt);
+        return CC_ERROR_SEC_CHL_REPLAY;
+    }
+    *plain_len = data_len;
 
     return CC_SUCCESS;
 }
 
-int sec_chl_encrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *plain, size_t plain_len,
+int sec_chl_decrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *recv_buf, int recv_buf_len,
     uint8_t *out_buf, size_t *out_buf_len)
+{
+    cc_sec_chl_iovec_t plain = {out_buf, *out_buf_len};
+
+    return sec_chl_decryptv(ecdh_ctx, session_id, recv_buf, (size_t)recv_buf_len, &plain, 1, out_buf_len);
+}
+
+int sec_chl_encryptv(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, const cc_sec_chl_iovec_t *plain,
+    size_t plain_cnt, uint8_t *out_buf, size_t *out_buf_len)
 {
     uint8_t *p_buf = out_buf;
     uint8_t *aad = NULL;
-    uint8_t *iv = NULL;
+    uint8_t nonce[SEC_CHL_NONCE_LEN];
     uint8_t *enc = NULL;
     uint8_t *tag = NULL;
     int aad_len;
-    int enc_len;
+    size_t plain_len = 0;
     aes_param_t aes_enc;
+    sec_chl_direction_t *dir = &ecdh_ctx->send;
 
-    aes_enc.key = ecdh_ctx->session_key;
+    if (!get_iovec_len(plain, plain_cnt, &plain_len) || plain_len == 0) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    // a nonce must never repeat under one key, the counter stops far before wrapping around
+    uint64_t seq = __atomic_fetch_add(&dir->seq, 1, __ATOMIC_RELAXED);
+    if (seq >= SEC_CHL_MAX_SEQ) {
+        return CC_ERROR_SEC_CHL_ENCRYPT;
+    }
+    get_nonce(dir, seq, nonce);
 
     memcpy(p_buf, &session_id, sizeof(session_id));
     p_buf += sizeof(session_id);
@@ -399,15 +675,11 @@ int sec_chl_encrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *pl
     memcpy(p_buf, &plain_len, sizeof(plain_len));
     p_buf += sizeof(plain_len);
 
-    iv = p_buf;
-    int ret = RAND_priv_bytes(iv, SECURE_IV_LEN);
-    if (ret != 1) {
-        return CC_ERROR_SEC_CHL_GEN_RANDOM;
-    }
-    p_buf += SECURE_IV_LEN;
+    memcpy(p_buf, &seq, sizeof(seq));
+    p_buf += sizeof(seq);
 
-    aad = out_buf; // session_id、data_len、iv作为附加信息，使用tag保护附加信息的完整性
-    aad_len = sizeof(session_id) + sizeof(plain_len) + SECURE_IV_LEN;
+    aad = out_buf; // session_id、data_len、seq作为附加信息，使用tag保护附加信息的完整性
+    aad_len = sizeof(session_id) + sizeof(plain_len) + sizeof(seq);
 
     tag = p_buf;
     p_buf += GCM_TAG_LEN;
@@ -415,27 +687,271 @@ int sec_chl_encrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *pl
     enc = p_buf;
 
     aes_enc.plain = plain;
-    aes_enc.plain_len = plain_len;
+    aes_enc.plain_cnt = plain_cnt;
     aes_enc.cipher = enc;
     aes_enc.cipher_len = 0;
     aes_enc.aad = aad;
     aes_enc.aad_len = aad_len;
+    aes_enc.key = NULL;
     aes_enc.key_len = SECURE_KEY_LEN;
-    aes_enc.iv = iv;
-    aes_enc.iv_len = SECURE_IV_LEN;
+    aes_enc.iv = nonce;
+    aes_enc.iv_len = SEC_CHL_NONCE_LEN;
     aes_enc.tag = tag;
     aes_enc.tag_len = GCM_TAG_LEN;
-    enc_len = aes_gcm_encrypt(&aes_enc);
+    int slot;
+    EVP_CIPHER_CTX *ctx = acquire_cipher_ctx(dir, 1, seq >> SEC_CHL_REKEY_SHIFT, true, &slot);
+    if (ctx == NULL) {
+        memset(&aes_enc, 0, sizeof(aes_param_t));
+        return CC_ERROR_SEC_CHL_ENCRYPT;
+    }
+    int ret = aead_encrypt(ctx, &aes_enc);
+    release_cipher_ctx(dir, ctx, slot);
     memset(&aes_enc, 0, sizeof(aes_param_t));
-    if (enc_len <= 0 || enc_len != (int)plain_len) {
+    if (ret != CC_SUCCESS) {
         return CC_ERROR_SEC_CHL_ENCRYPT;
     }
 
-    *out_buf_len = get_encrypted_buf_len(enc_len);
+    *out_buf_len = get_encrypted_buf_len(plain_len);
+
+    return CC_SUCCESS;
+}
+
+int sec_chl_encrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *plain, size_t plain_len,
+    uint8_t *out_buf, size_t *out_buf_len)
+{
+    cc_sec_chl_iovec_t iov = {plain, plain_len};
+
+    return sec_chl_encryptv(ecdh_ctx, session_id, &iov, 1, out_buf, out_buf_len);
+}
+
+/*
+ * A stream takes one msg counter of the direction, the stream key is derived from the direction key and that
+ * counter, so it is never the key of a msg or of another stream. The nonce of a chunk is its index followed by
+ * its flags, a chunk can neither be reordered nor turned into the last one.
+ */
+#define SEC_CHL_STREAM_FLAG_LAST 0x1
+struct cc_sec_chl_stream {
+    EVP_CIPHER_CTX *ctx;   // keyed with the stream key
+    size_t   session_id;
+    uint64_t seq;          // msg counter taken by the stream
+    uint64_t chunk_idx;    // index of the next chunk
+    uint64_t total_len;    // plain data length of the chunks so far
+    bool     is_encrypt;
+    bool     is_accepted;  // decrypt: the first chunk is verified and the stream passed the replay window
+    bool     is_done;      // the last chunk is processed
+    bool     is_failed;    // a chunk failed, the stream can not go on
+};
+
+static void get_stream_nonce(uint64_t chunk_idx, uint32_t flags, uint8_t *nonce)
+{
+    num_to_buf(chunk_idx, nonce, sizeof(chunk_idx));
+    num_to_buf(flags, nonce + sizeof(chunk_idx), sizeof(flags));
+}
+
+// aad = session_id | seq | data_len | flags, and the total length for the last chunk
+static int get_stream_aad(const cc_sec_chl_stream_t *stream, uint32_t data_len, uint32_t flags, uint8_t *aad)
+{
+    uint8_t *p = aad;
+    memcpy(p, &stream->session_id, sizeof(stream->session_id));
+    p += sizeof(stream->session_id);
+    memcpy(p, &stream->seq, sizeof(stream->seq));
+    p += sizeof(stream->seq);
+    memcpy(p, &data_len, sizeof(data_len));
+    p += sizeof(data_len);
+    memcpy(p, &flags, sizeof(flags));
+    p += sizeof(flags);
+    if (flags & SEC_CHL_STREAM_FLAG_LAST) {
+        uint64_t total_len = stream->total_len + data_len;
+        memcpy(p, &total_len, sizeof(total_len));
+        p += sizeof(total_len);
+    }
+    return (int)(p - aad);
+}
+
+#define SEC_CHL_STREAM_AAD_MAX_LEN (sizeof(size_t) + sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2)
+
+int sec_chl_stream_init(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, bool is_encrypt, uint8_t *header,
+    cc_sec_chl_stream_t **stream)
+{
+    uint8_t key[SECURE_KEY_LEN];
+    uint8_t label[] = "stream\0\0\0\0\0\0\0\0";
+    size_t prefix_len = strlen("stream");
+    sec_chl_direction_t *dir = is_encrypt ? &ecdh_ctx->send : &ecdh_ctx->recv;
+    uint64_t seq;
+
+    if (is_encrypt) {
+        seq = __atomic_fetch_add(&dir->seq, 1, __ATOMIC_RELAXED);
+        if (seq >= SEC_CHL_MAX_SEQ) {
+            return CC_ERROR_SEC_CHL_ENCRYPT;
+        }
+        memcpy(header, &session_id, sizeof(session_id));
+        memcpy(header + sizeof(session_id), &seq, sizeof(seq));
+    } else {
+        size_t real_session_id;
+        memcpy(&real_session_id, header, sizeof(real_session_id));
+        if (real_session_id != session_id) {
+            return CC_ERROR_SEC_CHL_DECRYPT_SESSIONID_INVALID;
+        }
+        memcpy(&seq, header + sizeof(session_id), sizeof(seq));
+        replay_lock(dir);
+        bool is_new = replay_check(dir, seq);
+        uint64_t epoch = replay_epoch(dir);
+        replay_unlock(dir);
+        if (!is_new) {
+            return CC_ERROR_SEC_CHL_REPLAY;
+        }
+        if ((seq >> SEC_CHL_REKEY_SHIFT) > epoch + SEC_CHL_MAX_EPOCH_JUMP) {
+            return CC_ERROR_SEC_CHL_DECRYPT;
+        }
+    }
+
+    cc_sec_chl_stream_t *tmp = (cc_sec_chl_stream_t *)calloc(1, sizeof(cc_sec_chl_stream_t));
+    if (tmp == NULL) {
+        return CC_ERROR_SEC_CHL_MEMORY;
+    }
+    num_to_buf(seq, label + prefix_len, sizeof(seq));
+    if (drive_key_hkdf(dir->key, SECURE_KEY_LEN, dir->salt, SEC_CHL_SALT_LEN, label, prefix_len + sizeof(seq),
+        key, SECURE_KEY_LEN) == CC_SUCCESS) {
+        tmp->ctx = new_keyed_cipher_ctx(dir->algo, key, is_encrypt ? 1 : 0);
+    }
+    memset(key, 0, sizeof(key));
+    if (tmp->ctx == NULL) {
+        free(tmp);
+        return is_encrypt ? CC_ERROR_SEC_CHL_ENCRYPT : CC_ERROR_SEC_CHL_DECRYPT;
+    }
+    tmp->session_id = session_id;
+    tmp->seq = seq;
+    tmp->is_encrypt = is_encrypt;
+    *stream = tmp;
+    return CC_SUCCESS;
+}
+
+int sec_chl_stream_encrypt(cc_sec_chl_stream_t *stream, uint8_t *plain, size_t plain_len, bool is_last,
+    uint8_t *chunk, size_t *chunk_len)
+{
+    uint8_t nonce[SEC_CHL_NONCE_LEN];
+    uint8_t aad[SEC_CHL_STREAM_AAD_MAX_LEN];
+    uint32_t data_len = (uint32_t)plain_len;
+    uint32_t flags = is_last ? SEC_CHL_STREAM_FLAG_LAST : 0;
+    aes_param_t aes_enc = {0};
+    cc_sec_chl_iovec_t iov = {plain, plain_len};
+
+    if (!stream->is_encrypt || stream->is_done || stream->is_failed) {
+        return CC_ERROR_BAD_STATE;
+    }
+    memcpy(chunk, &data_len, sizeof(data_len));
+    memcpy(chunk + sizeof(data_len), &flags, sizeof(flags));
+    get_stream_nonce(stream->chunk_idx, flags, nonce);
+
+    aes_enc.plain = &iov;
+    aes_enc.plain_cnt = 1;
+    aes_enc.cipher = chunk + CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN;
+    aes_enc.aad = aad;
+    aes_enc.aad_len = get_stream_aad(stream, data_len, flags, aad);
+    aes_enc.key_len = SECURE_KEY_LEN;
+    aes_enc.iv = nonce;
+    aes_enc.iv_len = SEC_CHL_NONCE_LEN;
+    aes_enc.tag = chunk + sizeof(data_len) + sizeof(flags);
+    aes_enc.tag_len = GCM_TAG_LEN;
+    if (aead_encrypt(stream->ctx, &aes_enc) != CC_SUCCESS) {
+        stream->is_failed = true;
+        return CC_ERROR_SEC_CHL_ENCRYPT;
+    }
 
+    stream->chunk_idx++;
+    stream->total_len += plain_len;
+    stream->is_done = is_last;
+    *chunk_len = CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN + plain_len;
     return CC_SUCCESS;
 }
 
+size_t get_stream_plain_len(uint8_t *chunk, size_t chunk_len)
+{
+    uint32_t data_len;
+
+    if (chunk_len < CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN) {
+        return SIZE_MAX;
+    }
+    memcpy(&data_len, chunk, sizeof(data_len));
+    if (data_len > CC_SEC_CHL_STREAM_MAX_CHUNK_LEN || chunk_len != CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN + data_len) {
+        return SIZE_MAX;
+    }
+    return data_len;
+}
+
+/* The caller has checked the chunk length by get_stream_plain_len and the plain buffer is large enough */
+int sec_chl_stream_decrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, cc_sec_chl_stream_t *stream, uint8_t *chunk,
+    uint8_t *plain, size_t *plain_len, bool *is_last)
+{
+    uint8_t nonce[SEC_CHL_NONCE_LEN];
+    uint8_t aad[SEC_CHL_STREAM_AAD_MAX_LEN];
+    uint32_t data_len;
+    uint32_t flags;
+    aes_param_t aes_dec = {0};
+
+    if (stream->is_encrypt || stream->is_done || stream->is_failed) {
+        return CC_ERROR_BAD_STATE;
+    }
+    memcpy(&data_len, chunk, sizeof(data_len));
+    memcpy(&flags, chunk + sizeof(data_len), sizeof(flags));
+    if ((flags & ~SEC_CHL_STREAM_FLAG_LAST) != 0) {
+        stream->is_failed = true;
+        return CC_ERROR_SEC_CHL_DECRYPT;
+    }
+    cc_sec_chl_iovec_t iov = {plain, data_len};
+    get_stream_nonce(stream->chunk_idx, flags, nonce);
+
+    aes_dec.plain = &iov;
+    aes_dec.plain_cnt = 1;
+    aes_dec.cipher = chunk + CC_SEC_CHL_STREAM_CHUNK_HEADER_LEN;
+    aes_dec.cipher_len = data_len;
+    aes_dec.aad = aad;
+    aes_dec.aad_len = get_stream_aad(stream, data_len, flags, aad);
+    aes_dec.key_len = SECURE_KEY_LEN;
+    aes_dec.iv = nonce;
+    aes_dec.iv_len = SEC_CHL_NONCE_LEN;
+    aes_dec.tag = chunk + sizeof(data_len) + sizeof(flags);
+    aes_dec.tag_len = GCM_TAG_LEN;
+    if (aead_decrypt(stream->ctx, &aes_dec) != CC_SUCCESS) {
+        clear_iovec(&iov, 1);
+        stream->is_failed = true;
+        return CC_ERROR_SEC_CHL_DECRYPT;
+    }
+
+    // the header is not authentic on its own, the replay window only moves once a chunk is verified
+    if (!stream->is_accepted) {
+        sec_chl_direction_t *dir = &ecdh_ctx->recv;
+        replay_lock(dir);
+        bool is_new = replay_check(dir, stream->seq);
+        if (is_new) {
+            replay_update(dir, stream->seq);
+        }
+        replay_unlock(dir);
+        if (!is_new) {
+            clear_iovec(&iov, 1);
+            stream->is_failed = true;
+            return CC_ERROR_SEC_CHL_REPLAY;
+        }
+        stream->is_accepted = true;
+    }
+
+    stream->chunk_idx++;
+    stream->total_len += data_len;
+    stream->is_done = (flags & SEC_CHL_STREAM_FLAG_LAST) != 0;
+    *plain_len = data_len;
+    *is_last = stream->is_done;
+    return CC_SUCCESS;
+}
+
+void sec_chl_stream_free(cc_sec_chl_stream_t *stream)
+{
+    if (stream == NULL) {
+        return;
+    }
+    EVP_CIPHER_CTX_free(stream->ctx);
+    free(stream);
+}
+
 void del_ecdh_ctx(sec_chl_ecdh_ctx_t *ecdh_ctx)
 {
     if (ecdh_ctx->svr_rsa_key != NULL) {
@@ -453,10 +969,35 @@ void del_ecdh_ctx(sec_chl_ecdh_ctx_t *ecdh_ctx)
     if (ecdh_ctx->svr_exch_param_buf != NULL) {
         free(ecdh_ctx->svr_exch_param_buf);
     }
+    free_session_cipher_ctx(ecdh_ctx);
     free(ecdh_ctx);
     return;
 }
 
+void free_handshake_state(sec_chl_ecdh_ctx_t *ecdh_ctx)
+{
+    if (ecdh_ctx->svr_rsa_key != NULL) {
+        RSA_free(ecdh_ctx->svr_rsa_key);
+        ecdh_ctx->svr_rsa_key = NULL;
+    }
+    if (ecdh_ctx->ecdh_key != NULL) {
+        EC_KEY_free(ecdh_ctx->ecdh_key);
+        ecdh_ctx->ecdh_key = NULL;
+    }
+    if (ecdh_ctx->shared_key != NULL) {
+        memset(ecdh_ctx->shared_key, 0, ecdh_ctx->shared_key_len);
+        free(ecdh_ctx->shared_key);
+        ecdh_ctx->shared_key = NULL;
+        ecdh_ctx->shared_key_len = 0;
+    }
+    free(ecdh_ctx->local_exch_param_buf);
+    ecdh_ctx->local_exch_param_buf = NULL;
+    ecdh_ctx->local_exch_param_buf_len = 0;
+    free(ecdh_ctx->svr_exch_param_buf);
+    ecdh_ctx->svr_exch_param_buf = NULL;
+    ecdh_ctx->svr_exch_param_buf_len = 0;
+}
+
 #define ECC_POINT_COMPRESSED_MULTIPLY 2
 #define MAX_ECC_PUBKEY_LEN 255
 static int get_key_len(sec_chl_ecdh_ctx_t *ecdh_ctx)
@@ -661,24 +1202,90 @@ fail:
     return NULL;
 }
 
+static cc_enclave_result_t drive_direction_key(sec_chl_ecdh_ctx_t *ecdh_ctx, uint8_t *salt, uint8_t *label,
+    sec_chl_direction_t *dir)
+{
+    uint8_t material[SECURE_KEY_LEN + SEC_CHL_SALT_LEN];
+
+    if (drive_key_hkdf(ecdh_ctx->session_key, SECURE_KEY_LEN, salt, RANDOM_LEN, label, strlen((char *)label),
+        material, sizeof(material)) != CC_SUCCESS) {
+        return CC_ERROR_DRIVE_SESSIONKEY;
+    }
+    memcpy(dir->key, material, SECURE_KEY_LEN);
+    memcpy(dir->salt, material + SECURE_KEY_LEN, SEC_CHL_SALT_LEN);
+    dir->algo = ecdh_ctx->algo;
+    memset(material, 0, sizeof(material));
+    dir->seq = 0;
+    dir->has_recv = false;
+    memset(dir->window, 0, sizeof(dir->window));
+    return CC_SUCCESS;
+}
+
+// each direction has its own key and nonce salt, so the two sides never use a nonce twice under one key
+static cc_enclave_result_t drive_traffic_key(sec_chl_ecdh_ctx_t *ecdh_ctx, uint8_t *salt, bool is_client)
+{
+    uint8_t c2s_label[] = "client to server";
+    uint8_t s2c_label[] = "server to client";
+    cc_enclave_result_t ret = drive_direction_key(ecdh_ctx, salt, is_client ? c2s_label : s2c_label,
+        &ecdh_ctx->send);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    return drive_direction_key(ecdh_ctx, salt, is_client ? s2c_label : c2s_label, &ecdh_ctx->recv);
+}
+
 static cc_enclave_result_t drive_session_key(sec_chl_ecdh_ctx_t *ecdh_ctx, sec_chl_exch_param_t *local_exch_param,
-    sec_chl_exch_param_t *peer_exch_param)
+    sec_chl_exch_param_t *peer_exch_param, bool is_client)
 {
     uint8_t salt[RANDOM_LEN];
-    uint8_t key_label[] = "sessionkey";
+    uint8_t key_label[] = "sessionkey\0";
+    size_t label_len = strlen((char *)key_label);
 
     for (int i = 0; i < RANDOM_LEN; i++) {
         salt[i] = local_exch_param->random[i] ^ peer_exch_param->random[i];
     }
+    // bind the suite to the key, so that the two sides never run different suites with one key
+    if (ecdh_ctx->algo != CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM) {
+        key_label[label_len++] = (uint8_t)ecdh_ctx->algo;
+    }
     if (drive_key_hkdf(ecdh_ctx->shared_key, ecdh_ctx->shared_key_len, salt, sizeof(salt), key_label,
-        strlen((char *)key_label), ecdh_ctx->session_key, SECURE_KEY_LEN) != CC_SUCCESS) {
+        label_len, ecdh_ctx->session_key, SECURE_KEY_LEN) != CC_SUCCESS) {
+        return CC_ERROR_DRIVE_SESSIONKEY;
+    }
+    return drive_traffic_key(ecdh_ctx, salt, is_client);
+}
+
+cc_enclave_result_t get_resume_secret(sec_chl_ecdh_ctx_t *ecdh_ctx, uint8_t *secret)
+{
+    uint8_t salt[RANDOM_LEN] = {0};
+    uint8_t label[] = "resumption";
+
+    if (drive_key_hkdf(ecdh_ctx->session_key, SECURE_KEY_LEN, salt, sizeof(salt), label, strlen((char *)label),
+        secret, SECURE_KEY_LEN) != CC_SUCCESS) {
         return CC_ERROR_DRIVE_SESSIONKEY;
     }
     return CC_SUCCESS;
 }
 
+cc_enclave_result_t compute_resume_session_key(sec_chl_ecdh_ctx_t *ecdh_ctx, uint8_t *resume_secret,
+    uint8_t *cli_random, uint8_t *svr_random, bool is_client)
+{
+    uint8_t salt[RANDOM_LEN];
+    uint8_t key_label[] = "resumed sessionkey";
+
+    for (int i = 0; i < RANDOM_LEN; i++) {
+        salt[i] = cli_random[i] ^ svr_random[i];
+    }
+    if (drive_key_hkdf(resume_secret, SECURE_KEY_LEN, salt, sizeof(salt), key_label, strlen((char *)key_label),
+        ecdh_ctx->session_key, SECURE_KEY_LEN) != CC_SUCCESS) {
+        return CC_ERROR_DRIVE_SESSIONKEY;
+    }
+    free_session_cipher_ctx(ecdh_ctx);
+    return drive_traffic_key(ecdh_ctx, salt, is_client);
+}
+
 cc_enclave_result_t compute_session_key(sec_chl_ecdh_ctx_t *ecdh_ctx, sec_chl_exch_param_t *local_exch_param,
-    sec_chl_exch_param_t *peer_exch_param)
+    sec_chl_exch_param_t *peer_exch_param, bool is_client)
 {
     const EC_GROUP *group = NULL;
     EC_KEY *ecdh_key = ecdh_ctx->ecdh_key;
@@ -696,7 +1303,9 @@ cc_enclave_result_t compute_session_key(sec_chl_ecdh_ctx_t *ecdh_ctx, sec_chl_ex
     if (!ECDH_compute_key(ecdh_ctx->shared_key, ecdh_ctx->shared_key_len, peer_point, ecdh_key, NULL)) {
         goto end;
     }
-    ret = drive_session_key(ecdh_ctx, local_exch_param, peer_exch_param);
+    // drop ctxs keyed with a previous key
+    free_session_cipher_ctx(ecdh_ctx);
+    ret = drive_session_key(ecdh_ctx, local_exch_param, peer_exch_param, is_client);
     if (ret != CC_SUCCESS) {
         goto end;
     }
@@ -708,8 +1317,15 @@ end:
     return ret;
 }
 
+/* random | ec_nid | ecdh_pubkey_len in front of the ecdh public key of an exch param buf */
+#define SEC_CHL_EXCH_HEAD_LEN (RANDOM_LEN + sizeof(int) + sizeof(size_t))
+
 cc_enclave_result_t get_exch_param_from_buf(uint8_t *exch_buf, size_t buf_len, sec_chl_exch_param_t **exch_param)
 {
+    // the buf may come from the peer
+    if (exch_buf == NULL || buf_len < SEC_CHL_EXCH_HEAD_LEN) {
+        return CC_ERROR_SEC_CHL_INVALID_EXCH_BUF;
+    }
     sec_chl_exch_param_t *msg = (sec_chl_exch_param_t *)calloc(1, sizeof(sec_chl_exch_param_t));
     if (msg == NULL) {
         return CC_ERROR_SEC_CHL_MEMORY;
@@ -726,7 +1342,7 @@ cc_enclave_result_t get_exch_param_from_buf(uint8_t *exch_buf, size_t buf_len, s
     memcpy(&msg->ecdh_pubkey_len, p_buf, sizeof(msg->ecdh_pubkey_len));
     p_buf += sizeof(msg->ecdh_pubkey_len);
 
-    if (p_buf - exch_buf + msg->ecdh_pubkey_len > buf_len) {
+    if (msg->ecdh_pubkey_len > buf_len - SEC_CHL_EXCH_HEAD_LEN) {
         del_exch_param(msg);
         return CC_ERROR_SEC_CHL_INVALID_EXCH_BUF;
     }
@@ -743,12 +1359,16 @@ cc_enclave_result_t get_exch_param_from_buf(uint8_t *exch_buf, size_t buf_len, s
     return CC_SUCCESS;
 }
 
-cc_enclave_result_t verify_signature(RSA *rsa_pubkey, uint8_t *exch_buf, size_t buf_len)
+/* is_required rejects an exch param without signature, which the full handshake accepts for compatibility */
+cc_enclave_result_t verify_signature(RSA *rsa_pubkey, uint8_t *exch_buf, size_t buf_len, bool is_required)
 {
     size_t ecdh_pubkey_len;
     size_t signature_len;
     uint8_t *p_buf = exch_buf;
 
+    if (exch_buf == NULL || buf_len < SEC_CHL_EXCH_HEAD_LEN) {
+        return CC_ERROR_SEC_CHL_INVALID_EXCH_BUF;
+    }
     p_buf += RANDOM_LEN;
 
     p_buf += sizeof(int); // ec_nid
@@ -756,19 +1376,25 @@ cc_enclave_result_t verify_signature(RSA *rsa_pubkey, uint8_t *exch_buf, size_t
     memcpy(&ecdh_pubkey_len, p_buf, sizeof(ecdh_pubkey_len));
     p_buf += sizeof(ecdh_pubkey_len);
 
-    if (p_buf - exch_buf + ecdh_pubkey_len > buf_len) {
+    if (ecdh_pubkey_len > buf_len - SEC_CHL_EXCH_HEAD_LEN) {
         return CC_ERROR_SEC_CHL_INVALID_EXCH_BUF;
     }
 
     p_buf += ecdh_pubkey_len;
+    size_t remain_len = buf_len - SEC_CHL_EXCH_HEAD_LEN - ecdh_pubkey_len;
 
-    memcpy(&signature_len, p_buf, sizeof(signature_len));
-    p_buf += sizeof(signature_len);
+    // an exch param without signature ends with the ecdh public key
+    signature_len = 0;
+    if (remain_len >= sizeof(signature_len)) {
+        memcpy(&signature_len, p_buf, sizeof(signature_len));
+        p_buf += sizeof(signature_len);
+        remain_len -= sizeof(signature_len);
+    }
 
     if (signature_len == 0) {
-        return CC_SUCCESS;
+        return is_required ? CC_ERROR_SEC_CHL_VERIFY_PEER_EXCH_BUF_SIGNATURE : CC_SUCCESS;
     }
-    if (p_buf - exch_buf + signature_len > buf_len) {
+    if (signature_len > remain_len) {
         return CC_ERROR_SEC_CHL_INVALID_EXCH_BUF;
     }
 
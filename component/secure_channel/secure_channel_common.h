@@ -17,22 +17,54 @@
 #include <stdlib.h>
 #include <string.h>
 #include <openssl/rsa.h>
+#include <openssl/evp.h>
 
 #include "status.h"
+#include "secure_channel.h"
 
 #define SECURE_CHANNEL_ERROR (-1)
 
 #define SECURE_KEY_LEN 32
 #define SECURE_IV_LEN 16
+#define SEC_CHL_CIPHER_CTX_NUM 4
+typedef struct {
+    EVP_CIPHER_CTX *ctx[SEC_CHL_CIPHER_CTX_NUM];  // created on first use, then reused by each message
+    uint64_t epoch[SEC_CHL_CIPHER_CTX_NUM];       // key epoch the ctx is keyed with
+    int busy[SEC_CHL_CIPHER_CTX_NUM];             // set while a thread uses the ctx
+} sec_chl_cipher_pool_t;
+
+/*
+ * The gcm nonce of a message is the salt of the direction followed by the message counter of the sender. The key
+ * changes every 2^SEC_CHL_REKEY_SHIFT messages, the receiver drops messages out of its replay window.
+ */
+#define SEC_CHL_NONCE_LEN 12
+#define SEC_CHL_SALT_LEN 4
+#define SEC_CHL_REKEY_SHIFT 32
+#define SEC_CHL_MAX_SEQ (UINT64_MAX >> 1)
+#define SEC_CHL_REPLAY_WINDOW 256  // bits, a multiple of 64
+typedef struct {
+    uint8_t  key[SECURE_KEY_LEN];     // key of epoch 0, the keys of later epochs are derived from it
+    uint8_t  salt[SEC_CHL_SALT_LEN];
+    uint64_t seq;                     // send: counter of the next message; recv: max counter accepted
+    uint64_t window[SEC_CHL_REPLAY_WINDOW / 64];  // recv: bit i is set if message seq - i was accepted
+    bool     has_recv;                // recv: any message accepted
+    int      lock;                    // recv: protects seq and window
+    cc_sec_chl_algo_t algo;           // cipher suite of the session
+    sec_chl_cipher_pool_t pool;
+} sec_chl_direction_t;
+
 typedef struct sec_chl_ecdh_ctx {
     RSA     *svr_rsa_key;      // svr use private key sign exch msg; client use pubkey verify exch msg signature
     size_t  signature_len;      // RSA_size(svr_rsa_key);
+    cc_sec_chl_algo_t algo;     // cipher suite, selects the curve and the aead cipher
     int     ec_nid;             // Elliptic Curve nid
     EC_KEY  *ecdh_key;          // generate from ec_nid; include ecdh pubkey and privatekey
     size_t  ecdh_pubkey_len;    // calucate from ecdh_key
     size_t  shared_key_len;
     uint8_t *shared_key;        // ecdh output shared secret
     uint8_t session_key[SECURE_KEY_LEN];  // derived from shared key, used to encrypt/decrypt user data
+    sec_chl_direction_t send;  // keys and counters of the messages sent
+    sec_chl_direction_t recv;  // keys and replay window of the messages received
     size_t  local_exch_param_buf_len;
     uint8_t *local_exch_param_buf;
     size_t  svr_exch_param_buf_len;
@@ -56,6 +88,10 @@ typedef enum {
     SEC_CHL_MSG_SEND_CLI_EXCH_PARAM_RSP,
     SEC_CHL_MSG_DESTROY,
     SEC_CHL_MSG_DESTROY_RSP,
+    SEC_CHL_MSG_RESUME,
+    SEC_CHL_MSG_RESUME_RSP,
+    SEC_CHL_MSG_COMPACT_FINISH,
+    SEC_CHL_MSG_COMPACT_FINISH_RSP,
     SEC_CHL_MSG_MAX,
 } sec_chl_msg_type_t;
 
@@ -94,15 +130,57 @@ typedef struct {
     // uint8_t *signature;
 } sec_chl_exch_param_t;
 
+/*
+ * A resumption ticket is the ticket state of a session sealed with aes-256-gcm under a key which never leaves the
+ * enclave: nonce | tag | sealed state. The state is the resumption secret of the session, the tick of the full
+ * handshake it descends from and the cipher suite, which the resumed session keeps. The client keeps the ticket
+ * together with the resumption secret, which it derives from its own session key, and presents the ticket in
+ * SEC_CHL_MSG_RESUME instead of a full handshake.
+ */
+#define SEC_CHL_TICKET_STATE_LEN (sizeof(uint64_t) + SECURE_KEY_LEN + sizeof(int32_t))
+#define SEC_CHL_TICKET_LEN (SEC_CHL_NONCE_LEN + GCM_TAG_LEN + SEC_CHL_TICKET_STATE_LEN)
+typedef struct {
+    uint8_t random[RANDOM_LEN];
+    uint8_t ticket[SEC_CHL_TICKET_LEN];  // request: ticket presented; response: ticket for the resumed session
+} sec_chl_resume_msg_t;
+
+/*
+ * The compact handshake takes two round trips instead of four. The first one is SEC_CHL_MSG_GET_SVR_PUBKEY as in
+ * the full handshake. The client then sends its exchange param on the default curve, together with the enc key of
+ * the report if any, in SEC_CHL_MSG_COMPACT_FINISH: enc_key_len | enc key | client exch param. The server answers
+ * with its exch param freshly signed by the key the client has verified, and a resumption ticket if it issues one:
+ * exch_param_len | server exch param | ticket. Both carry the cipher suite of the session.
+ */
+#define SEC_CHL_DEFAULT_EC_NID NID_brainpoolP256r1
+#define SEC_CHL_EXCH_PARAM_MAX_LEN 2048
+typedef struct {
+    int32_t algo;  // cc_sec_chl_algo_t
+    size_t len;  // enc_key_len of the request, exch_param_len of the response
+    uint8_t data[];
+} sec_chl_compact_msg_t;
+
+/*
+ * The full handshake proposes a cipher suite other than the default one in SEC_CHL_MSG_GET_SVR_EXCH_PARAM, whose
+ * data is then the int32_t suite. The server generates its exch param on the curve of the suite, an old server
+ * ignores the proposal and the session keys do not match, as the suite is part of their derivation.
+ */
+bool is_sec_chl_algo_supported(cc_sec_chl_algo_t algo);
+int get_sec_chl_algo_ec_nid(cc_sec_chl_algo_t algo);
+
 size_t buf_to_num(uint8_t *buf, size_t len);
 void num_to_buf(size_t num, uint8_t *buf, size_t len);
 
 sec_chl_ecdh_ctx_t *new_local_ecdh_ctx(int ec_nid);
 void del_ecdh_ctx(sec_chl_ecdh_ctx_t *ecdh_ctx);
+/* Once the session key is computed, drop the rsa key reference, the ecdh key and the exch params of the handshake */
+void free_handshake_state(sec_chl_ecdh_ctx_t *ecdh_ctx);
 cc_enclave_result_t compute_session_key(sec_chl_ecdh_ctx_t *ecdh_ctx, sec_chl_exch_param_t *local_exch_param,
-    sec_chl_exch_param_t *peer_exch_param);
+    sec_chl_exch_param_t *peer_exch_param, bool is_client);
+cc_enclave_result_t get_resume_secret(sec_chl_ecdh_ctx_t *ecdh_ctx, uint8_t *secret);
+cc_enclave_result_t compute_resume_session_key(sec_chl_ecdh_ctx_t *ecdh_ctx, uint8_t *resume_secret,
+    uint8_t *cli_random, uint8_t *svr_random, bool is_client);
 cc_enclave_result_t get_exch_param_from_buf(uint8_t *exch_buf, size_t buf_len, sec_chl_exch_param_t **exch_param);
-cc_enclave_result_t verify_signature(RSA *rsa_pubkey, uint8_t *exch_buf, size_t buf_len);
+cc_enclave_result_t verify_signature(RSA *rsa_pubkey, uint8_t *exch_buf, size_t buf_len, bool is_required);
 int get_exch_buf_len(sec_chl_ecdh_ctx_t *ecdh_ctx);
 int get_exch_buf(sec_chl_ecdh_ctx_t *ecdh_ctx, uint8_t *exch_param, size_t exch_param_len);
 void del_exch_param(sec_chl_exch_param_t *exch_param);
@@ -111,6 +189,27 @@ int sec_chl_encrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *pl
 int sec_chl_decrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *recv_buf, int recv_buf_len,
     uint8_t *out_buf, size_t *out_buf_len);
 
+/*
+ * The plain data may be split into several segments. An output segment may be the same buffer as the
+ * encrypted data of the msg, then the msg is encrypted or decrypted in place.
+ */
+bool get_iovec_len(const cc_sec_chl_iovec_t *iov, size_t iov_cnt, size_t *len);
+int sec_chl_encryptv(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, const cc_sec_chl_iovec_t *plain,
+    size_t plain_cnt, uint8_t *out_buf, size_t *out_buf_len);
+int sec_chl_decryptv(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, uint8_t *recv_buf, size_t recv_buf_len,
+    const cc_sec_chl_iovec_t *plain, size_t plain_cnt, size_t *plain_len);
+
+// header is output for encrypt and input for decrypt, it holds CC_SEC_CHL_STREAM_HEADER_LEN bytes
+int sec_chl_stream_init(sec_chl_ecdh_ctx_t *ecdh_ctx, size_t session_id, bool is_encrypt, uint8_t *header,
+    cc_sec_chl_stream_t **stream);
+int sec_chl_stream_encrypt(cc_sec_chl_stream_t *stream, uint8_t *plain, size_t plain_len, bool is_last,
+    uint8_t *chunk, size_t *chunk_len);
+// return SIZE_MAX if the chunk is malformed
+size_t get_stream_plain_len(uint8_t *chunk, size_t chunk_len);
+int sec_chl_stream_decrypt(sec_chl_ecdh_ctx_t *ecdh_ctx, cc_sec_chl_stream_t *stream, uint8_t *chunk,
+    uint8_t *plain, size_t *plain_len, bool *is_last);
+void sec_chl_stream_free(cc_sec_chl_stream_t *stream);
+
 int gen_local_exch_buf(sec_chl_ecdh_ctx_t *ecdh_ctx);
 
 size_t get_encrypted_buf_len(size_t plain_len);
@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include "enclave.h"
+#include "status.h"
+#include "secure_channel_host.h"
+#include "secure_channel_client.h"
+#include "sc_demo_u.h"
+
+// 服务端与客户端运行在同一进程内，消息发送钩子直接调用对端的回调函数，不经过网络，测试结果只反映安全通道本身的开销
+#define MAXBUF 12800
+#define ENCLAVE_BUF_LEN 1024  // sc_demo.edl中enclave加解密缓冲区的长度
+#define MSG_LEN 64
+#define DEFAULT_CLIENT_NUM 8
+#define DEFAULT_HANDSHAKE_NUM 100
+#define DEFAULT_MSG_NUM 10000
+#define NS_PER_SEC 1000000000ULL
+
+typedef struct {
+    cc_sec_chl_ctx_t ctx;          // 客户端安全通道上下文
+    cc_sec_chl_conn_ctx_t svr_conn;  // 服务端为该客户端连接维护的上下文
+    uint8_t rsp[MAXBUF];           // 服务端响应消息
+    size_t rsp_len;
+} loopback_conn_t;
+
+// 分别计时的操作，服务端的解密和加密各是一次ecall
+typedef enum {
+    STEP_HANDSHAKE,
+    STEP_ROUND_TRIP,
+    STEP_CLIENT_ENCRYPT,
+    STEP_SERVER_DECRYPT,
+    STEP_SERVER_ENCRYPT,
+    STEP_CLIENT_DECRYPT,
+    STEP_NUM
+} step_t;
+
+static const char *g_step_name[STEP_NUM] = {
+    "handshakes", "round trips", "client encrypt", "server decrypt", "server encrypt", "client decrypt"
+};
+
+// 所有客户端线程创建成功后才放行，否则已创建的线程直接退出
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool is_started;
+    bool is_aborted;
+} start_gate_t;
+
+typedef struct {
+    cc_enclave_t *enclave;
+    cc_sec_chl_svr_ctx_t *svr_ctx;
+    char *basevalue;
+    start_gate_t *gate;
+    pthread_barrier_t *barrier;
+    long handshake_num;
+    long msg_num;
+    uint64_t *lat[STEP_NUM];  // 每次操作的耗时，单位ns
+    long handshake_done;
+    long msg_done;
+} worker_arg_t;
+
+// 服务端发送钩子：保存响应消息，由客户端发送钩子交给客户端回调处理
+static int loopback_svr_send(void *conn, void *buf, size_t count)
+{
+    loopback_conn_t *lb = (loopback_conn_t *)conn;
+    if (count > MAXBUF) {
+        return -1;
+    }
+    memcpy(lb->rsp, buf, count);
+    lb->rsp_len = count;
+    return (int)count;
+}
+
+// 客户端发送钩子：同步调用服务端回调处理请求，再调用客户端回调处理响应
+static int loopback_cli_send(void *conn, void *buf, size_t count)
+{
+    loopback_conn_t *lb = (loopback_conn_t *)conn;
+    lb->rsp_len = 0;
+    (void)cc_sec_chl_svr_callback(&lb->svr_conn, buf, count);
+    if (lb->rsp_len == 0) {
+        return -1;
+    }
+    return cc_sec_chl_client_callback(&lb->ctx, lb->rsp, lb->rsp_len);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static cc_enclave_result_t loopback_connect(worker_arg_t *arg, loopback_conn_t *lb)
+{
+    memset(lb, 0, sizeof(loopback_conn_t));
+    lb->svr_conn.svr_ctx = arg->svr_ctx;
+    lb->svr_conn.conn_kit.send = (void *)loopback_svr_send;
+    lb->svr_conn.conn_kit.conn = lb;
+    lb->ctx.conn_kit.send = (void *)loopback_cli_send;
+    lb->ctx.conn_kit.conn = lb;
+    lb->ctx.basevalue = arg->basevalue;
+    return cc_sec_chl_client_init(CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM, &lb->ctx);
+}
+
+// 一次消息往返：客户端加密，enclave解密后加密处理结果，客户端解密，每一步分别计时
+static int round_trip(worker_arg_t *arg, loopback_conn_t *lb)
+{
+    uint8_t plain[MSG_LEN] = {0};
+    uint8_t encrypted[ENCLAVE_BUF_LEN] = {0};
+    size_t encrypt_len = sizeof(encrypted);
+    uint8_t result[ENCLAVE_BUF_LEN] = {0};
+    size_t result_len = sizeof(result);
+    uint8_t decrypted[ENCLAVE_BUF_LEN] = {0};
+    size_t decrypt_len = sizeof(decrypted);
+    int ret_val = 0;
+    long i = arg->msg_done;
+
+    uint64_t start = now_ns();
+    if (cc_sec_chl_client_encrypt(&lb->ctx, plain, sizeof(plain), encrypted, &encrypt_len) != CC_SUCCESS) {
+        return -1;
+    }
+    uint64_t end = now_ns();
+    arg->lat[STEP_CLIENT_ENCRYPT][i] = end - start;
+
+    start = end;
+    int ret = sec_chl_recv_client_data(arg->enclave, &ret_val, lb->ctx.session_id, encrypted, encrypt_len);
+    if (ret != CC_SUCCESS || ret_val != 0) {
+        return -1;
+    }
+    end = now_ns();
+    arg->lat[STEP_SERVER_DECRYPT][i] = end - start;
+
+    start = end;
+    ret = sec_chl_get_client_data_handle_result(arg->enclave, &ret_val, lb->ctx.session_id, result, &result_len);
+    if (ret != CC_SUCCESS || ret_val != 0) {
+        return -1;
+    }
+    end = now_ns();
+    arg->lat[STEP_SERVER_ENCRYPT][i] = end - start;
+
+    start = end;
+    if (cc_sec_chl_client_decrypt(&lb->ctx, result, result_len, decrypted, &decrypt_len) != CC_SUCCESS) {
+        return -1;
+    }
+    arg->lat[STEP_CLIENT_DECRYPT][i] = now_ns() - start;
+    return 0;
+}
+
+// 等待主线程放行，返回false表示有客户端线程创建失败
+static bool wait_start(start_gate_t *gate)
+{
+    pthread_mutex_lock(&gate->lock);
+    while (!gate->is_started && !gate->is_aborted) {
+        pthread_cond_wait(&gate->cond, &gate->lock);
+    }
+    bool is_started = gate->is_started;
+    pthread_mutex_unlock(&gate->lock);
+    return is_started;
+}
+
+static void open_start_gate(start_gate_t *gate, bool is_started)
+{
+    pthread_mutex_lock(&gate->lock);
+    gate->is_started = is_started;
+    gate->is_aborted = !is_started;
+    pthread_cond_broadcast(&gate->cond);
+    pthread_mutex_unlock(&gate->lock);
+}
+
+static void *worker(void *data)
+{
+    worker_arg_t *arg = (worker_arg_t *)data;
+    if (!wait_start(arg->gate)) {
+        return NULL;
+    }
+    loopback_conn_t *lb = calloc(1, sizeof(loopback_conn_t));
+    if (lb == NULL) {
+        pthread_barrier_wait(arg->barrier);
+        pthread_barrier_wait(arg->barrier);
+        pthread_barrier_wait(arg->barrier);
+        return NULL;
+    }
+
+    // 阶段1：握手，每次握手建立安全通道后立即销毁
+    for (; arg->handshake_done < arg->handshake_num; arg->handshake_done++) {
+        uint64_t start = now_ns();
+        cc_enclave_result_t ret = loopback_connect(arg, lb);
+        arg->lat[STEP_HANDSHAKE][arg->handshake_done] = now_ns() - start;
+        cc_sec_chl_client_fini(&lb->ctx);
+        if (ret != CC_SUCCESS) {
+            printf("secure channel init failed:%u\n", ret);
+            break;
+        }
+    }
+    pthread_barrier_wait(arg->barrier);
+
+    // 阶段2：所有客户端各建立一条安全通道后，由主线程统计enclave内每个会话占用的内存
+    cc_enclave_result_t ret = loopback_connect(arg, lb);
+    if (ret != CC_SUCCESS) {
+        printf("secure channel init failed:%u\n", ret);
+    }
+    pthread_barrier_wait(arg->barrier);
+    pthread_barrier_wait(arg->barrier);
+
+    // 阶段3：消息往返
+    for (; ret == CC_SUCCESS && arg->msg_done < arg->msg_num; arg->msg_done++) {
+        uint64_t start = now_ns();
+        if (round_trip(arg, lb) != 0) {
+            printf("secure channel message round trip failed\n");
+            break;
+        }
+        arg->lat[STEP_ROUND_TRIP][arg->msg_done] = now_ns() - start;
+    }
+    cc_sec_chl_client_fini(&lb->ctx);
+    free(lb);
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/*
+ * 合并各线程的耗时并排序，输出每秒操作数与p50/p99耗时。cost_ns为0时按该操作本身的耗时计算每秒操作数，
+ * 即所有客户端线程都只执行该操作时的每秒次数
+ */
+static void report(worker_arg_t *args, int client_num, step_t step, uint64_t cost_ns)
+{
+    long total = 0;
+    for (int i = 0; i < client_num; i++) {
+        total += step == STEP_HANDSHAKE ? args[i].handshake_done : args[i].msg_done;
+    }
+    if (total == 0) {
+        printf("%s: no data\n", g_step_name[step]);
+        return;
+    }
+    uint64_t *lat = calloc(total, sizeof(uint64_t));
+    if (lat == NULL) {
+        return;
+    }
+    long n = 0;
+    uint64_t busy_ns = 0;
+    for (int i = 0; i < client_num; i++) {
+        long done = step == STEP_HANDSHAKE ? args[i].handshake_done : args[i].msg_done;
+        memcpy(lat + n, args[i].lat[step], done * sizeof(uint64_t));
+        n += done;
+    }
+    for (long i = 0; i < total; i++) {
+        busy_ns += lat[i];
+    }
+    if (cost_ns == 0) {
+        cost_ns = busy_ns / (uint64_t)client_num;
+    }
+    qsort(lat, total, sizeof(uint64_t), cmp_u64);
+    double cost = (double)cost_ns / NS_PER_SEC;
+    printf("%s: %ld in %.3f s, %.1f/s, p50 %.1f us, p99 %.1f us\n", g_step_name[step], total, cost,
+        cost > 0 ? total / cost : 0, lat[total * 50 / 100] / 1e3, lat[total * 99 / 100] / 1e3);
+    free(lat);
+}
+
+static void report_memory(cc_sec_chl_svr_ctx_t *svr_ctx)
+{
+    cc_sec_chl_svr_stats_t stats = {0};
+    if (cc_sec_chl_svr_get_stats(svr_ctx, &stats) != CC_SUCCESS || stats.session_num == 0) {
+        printf("get secure channel server stats failed\n");
+        return;
+    }
+    printf("sessions: %llu, enclave memory %llu bytes, %llu bytes/session\n",
+        (unsigned long long)stats.session_num, (unsigned long long)stats.session_bytes,
+        (unsigned long long)(stats.session_bytes / stats.session_num));
+}
+
+static int run_benchmark(cc_enclave_t *enclave, cc_sec_chl_svr_ctx_t *svr_ctx, char *basevalue,
+    int client_num, long handshake_num, long msg_num)
+{
+    int ret_val = -1;
+    pthread_barrier_t barrier;
+    start_gate_t gate = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false, false };
+    pthread_t *tids = calloc(client_num, sizeof(pthread_t));
+    worker_arg_t *args = calloc(client_num, sizeof(worker_arg_t));
+    if (tids == NULL || args == NULL) {
+        goto end;
+    }
+    for (int i = 0; i < client_num; i++) {
+        args[i].enclave = enclave;
+        args[i].svr_ctx = svr_ctx;
+        args[i].basevalue = basevalue;
+        args[i].gate = &gate;
+        args[i].barrier = &barrier;
+        args[i].handshake_num = handshake_num;
+        args[i].msg_num = msg_num;
+        for (int step = 0; step < STEP_NUM; step++) {
+            args[i].lat[step] = calloc(step == STEP_HANDSHAKE ? handshake_num : msg_num, sizeof(uint64_t));
+            if (args[i].lat[step] == NULL) {
+                goto end;
+            }
+        }
+    }
+
+    int created = 0;
+    for (; created < client_num; created++) {
+        if (pthread_create(&tids[created], NULL, worker, &args[created]) != 0) {
+            break;
+        }
+    }
+    if (created < client_num) {
+        printf("create client thread failed\n");
+        open_start_gate(&gate, false);
+        for (int i = 0; i < created; i++) {
+            pthread_join(tids[i], NULL);
+        }
+        goto end;
+    }
+    pthread_barrier_init(&barrier, NULL, client_num + 1);
+    uint64_t start = now_ns();
+    open_start_gate(&gate, true);
+    pthread_barrier_wait(&barrier);
+    report(args, client_num, STEP_HANDSHAKE, now_ns() - start);
+    pthread_barrier_wait(&barrier);
+    report_memory(svr_ctx);
+    start = now_ns();
+    pthread_barrier_wait(&barrier);
+    for (int i = 0; i < client_num; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    report(args, client_num, STEP_ROUND_TRIP, now_ns() - start);
+    for (int step = STEP_CLIENT_ENCRYPT; step < STEP_NUM; step++) {
+        report(args, client_num, (step_t)step, 0);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    ret_val = 0;
+    for (int i = 0; i < client_num; i++) {
+        if (args[i].handshake_done != handshake_num || args[i].msg_done != msg_num) {
+            ret_val = -1;
+        }
+    }
+end:
+    for (int i = 0; args != NULL && i < client_num; i++) {
+        for (int step = 0; step < STEP_NUM; step++) {
+            free(args[i].lat[step]);
+        }
+    }
+    free(args);
+    free(tids);
+    return ret_val;
+}
+
+int main(int argc, char **argv)
+{
+    // ./sc_benchmark [client_num] [handshake_num] [msg_num]
+    // 并发client_num个客户端，每个客户端先握手handshake_num次，再在一条安全通道上完成msg_num次消息往返
+    int client_num = argc > 1 ? atoi(argv[1]) : DEFAULT_CLIENT_NUM;
+    long handshake_num = argc > 2 ? strtol(argv[2], NULL, 10) : DEFAULT_HANDSHAKE_NUM;
+    long msg_num = argc > 3 ? strtol(argv[3], NULL, 10) : DEFAULT_MSG_NUM;
+    if (client_num <= 0 || handshake_num <= 0 || msg_num <= 0) {
+        printf("usage: %s [client_num] [handshake_num] [msg_num]\n", argv[0]);
+        return -1;
+    }
+
+    char *ta_basevalue_file = "../basevalue.txt";
+    char basevalue_real_path[PATH_MAX] = {0};
+    if (realpath(ta_basevalue_file, basevalue_real_path) == NULL) {
+        printf("ta basevalue file path error\n");
+        return -1;
+    }
+
+    cc_enclave_t context = {0};
+    char *path = PATH;
+    int ret = cc_enclave_create(path, AUTO_ENCLAVE_TYPE, 0, SECGEAR_DEBUG_FLAG, NULL, 0, &context);
+    if (ret != CC_SUCCESS) {
+        printf("create enclave error %x!\n", ret);
+        return -1;
+    }
+
+    cc_sec_chl_svr_ctx_t svr_ctx = {0};
+    svr_ctx.enclave_ctx = &context;
+    svr_ctx.max_session_num = (size_t)client_num;
+    ret = cc_sec_chl_svr_init(&svr_ctx);
+    if (ret != CC_SUCCESS) {
+        printf("secure channel server init failed:%x\n", ret);
+        cc_enclave_destroy(&context);
+        return -1;
+    }
+    printf("clients: %d, handshakes per client: %ld, round trips per client: %ld, msg len: %d bytes\n",
+        client_num, handshake_num, msg_num, MSG_LEN);
+
+    ret = run_benchmark(&context, &svr_ctx, basevalue_real_path, client_num, handshake_num, msg_num);
+
+    cc_sec_chl_svr_fini(&svr_ctx);
+    cc_enclave_destroy(&context);
+    return ret;
+}
@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <openssl/ec.h>
 #include <string.h>
+#include <time.h>
 #include "status.h"
 
 #include "usr_msg.h"
@@ -41,13 +42,185 @@ int socket_write_and_read(void *conn, void *buf, size_t count)
     return cc_sec_chl_client_callback(&g_ctx, sc_msg, usr_msg->len);
 }
 
+static int connect_server(void)
+{
+    struct sockaddr_in svr_addr;
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd == -1) {
+        printf("create socket failed\n");
+        return -1;
+    }
+    bzero(&svr_addr, sizeof(svr_addr));
+    svr_addr.sin_family = AF_INET;
+    svr_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    svr_addr.sin_port = htons(12306); // test server port 12306
+
+    if (connect(sockfd, (struct sockaddr *)&svr_addr, sizeof(svr_addr)) != 0) {
+        printf("connet to server failed\n");
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+static double elapsed_seconds(struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// 握手性能测试：每次握手新建连接，完成安全通道建立后立即销毁
+#define TICKET_BUF_LEN 1024
+static int benchmark_handshake(char *basevalue, long handshake_num)
+{
+    struct timespec start;
+    long done = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (; done < handshake_num; done++) {
+        int sockfd = connect_server();
+        if (sockfd < 0) {
+            break;
+        }
+        memset(&g_ctx, 0, sizeof(g_ctx));
+        g_ctx.conn_kit.send = (void *)socket_write_and_read;
+        g_ctx.conn_kit.conn = &sockfd;
+        g_ctx.basevalue = basevalue;
+        cc_enclave_result_t ret = cc_sec_chl_client_init(CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM, &g_ctx);
+        cc_sec_chl_client_fini(&g_ctx);
+        close(sockfd);
+        if (ret != CC_SUCCESS) {
+            printf("secure channel init failed:%u\n", ret);
+            break;
+        }
+    }
+    double cost = elapsed_seconds(&start);
+    printf("%ld handshakes cost %.3f s, %.1f handshakes/s\n", done, cost, cost > 0 ? done / cost : 0);
+    return done == handshake_num ? 0 : -1;
+}
+
+// 会话恢复性能测试：首次完整握手后导出票据，之后每次新建连接用票据恢复会话，只需一次往返
+static int resume_with_ticket(char *basevalue, uint8_t *ticket, size_t *ticket_len)
+{
+    int sockfd = connect_server();
+    if (sockfd < 0) {
+        return -1;
+    }
+    memset(&g_ctx, 0, sizeof(g_ctx));
+    g_ctx.conn_kit.send = (void *)socket_write_and_read;
+    g_ctx.conn_kit.conn = &sockfd;
+    g_ctx.basevalue = basevalue;
+    cc_enclave_result_t ret = *ticket_len == 0 ?
+        cc_sec_chl_client_init(CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM, &g_ctx) :
+        cc_sec_chl_client_resume(CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM, &g_ctx, ticket, *ticket_len);
+    if (ret == CC_SUCCESS) {
+        // 每次恢复都会得到新票据
+        *ticket_len = TICKET_BUF_LEN;
+        ret = cc_sec_chl_client_export_ticket(&g_ctx, ticket, ticket_len);
+        cc_sec_chl_client_fini(&g_ctx);
+    }
+    close(sockfd);
+    if (ret != CC_SUCCESS) {
+        printf("secure channel resume failed:%u\n", ret);
+        return -1;
+    }
+    return 0;
+}
+
+static int benchmark_resume(char *basevalue, long resume_num)
+{
+    uint8_t ticket[TICKET_BUF_LEN];
+    size_t ticket_len = 0;
+    struct timespec start;
+    long done = 0;
+
+    if (resume_with_ticket(basevalue, ticket, &ticket_len) != 0) {
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (; done < resume_num; done++) {
+        if (resume_with_ticket(basevalue, ticket, &ticket_len) != 0) {
+            break;
+        }
+    }
+    double cost = elapsed_seconds(&start);
+    printf("%ld resumptions cost %.3f s, %.1f resumptions/s\n", done, cost, cost > 0 ? done / cost : 0);
+    return done == resume_num ? 0 : -1;
+}
+
+// 消息性能测试：每种密码套件分别建立安全通道后，按不同消息长度分别测试每秒加密的消息数和吞吐量。
+// 两个方向的密钥不同且接收端有防重放窗口，客户端不能解密自己加密的消息
+static int benchmark_suite_message(char *basevalue, cc_sec_chl_algo_t algo, long msg_num)
+{
+    size_t msg_sizes[] = {64, 1024, 64 * 1024};
+    int ret_val = -1;
+
+    int sockfd = connect_server();
+    if (sockfd < 0) {
+        return -1;
+    }
+    memset(&g_ctx, 0, sizeof(g_ctx));
+    g_ctx.conn_kit.send = (void *)socket_write_and_read;
+    g_ctx.conn_kit.conn = &sockfd;
+    g_ctx.basevalue = basevalue;
+    cc_enclave_result_t ret = cc_sec_chl_client_init(algo, &g_ctx);
+    if (ret == CC_ERROR_SEC_CHL_ALGO_NOT_SUPPORTED) {
+        printf("suite %d: not supported by client or server\n", algo);
+        close(sockfd);
+        return 0;
+    }
+    if (ret != CC_SUCCESS) {
+        printf("secure channel init failed:%u\n", ret);
+        close(sockfd);
+        return -1;
+    }
+
+    size_t max_size = msg_sizes[sizeof(msg_sizes) / sizeof(msg_sizes[0]) - 1];
+    uint8_t *plain = calloc(1, max_size);
+    uint8_t *encrypted = calloc(1, max_size + 1024); // 1024 bytes is enough for the header of encrypted msg
+    if (plain == NULL || encrypted == NULL) {
+        goto end;
+    }
+    for (size_t i = 0; i < sizeof(msg_sizes) / sizeof(msg_sizes[0]); i++) {
+        struct timespec start;
+        size_t encrypt_len = max_size + 1024;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (long j = 0; j < msg_num; j++) {
+            encrypt_len = max_size + 1024;
+            if (cc_sec_chl_client_encrypt(&g_ctx, plain, msg_sizes[i], encrypted, &encrypt_len) != CC_SUCCESS) {
+                printf("client encrypt failed\n");
+                goto end;
+            }
+        }
+        double enc_cost = elapsed_seconds(&start);
+        printf("suite %d, msg len %zu bytes: encrypt %.0f msgs/s, %.1f MB/s\n", algo, msg_sizes[i],
+            enc_cost > 0 ? msg_num / enc_cost : 0, enc_cost > 0 ? msg_num * msg_sizes[i] / enc_cost / 1e6 : 0);
+    }
+    ret_val = 0;
+end:
+    free(plain);
+    free(encrypted);
+    cc_sec_chl_client_fini(&g_ctx);
+    close(sockfd);
+    return ret_val;
+}
+
+static int benchmark_message(char *basevalue, long msg_num)
+{
+    for (int algo = 0; algo < CC_SEC_CHL_ALGO_MAX; algo++) {
+        if (benchmark_suite_message(basevalue, (cc_sec_chl_algo_t)algo, msg_num) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
-    (void)argc;
-    (void)argv;
     int sockfd;
     cc_enclave_result_t ret;
-    struct sockaddr_in svr_addr;
 
     char *ta_basevalue_file = "../basevalue.txt";
     char basevalue_real_path[PATH_MAX] = {0};
@@ -56,19 +229,29 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd == -1) {
-        printf("create socket failed\n");
+    // ./sc_client handshake <num> 测试每秒握手次数; ./sc_client resume <num> 测试每秒会话恢复次数;
+    // ./sc_client message <num> 测试每秒加密消息数
+    if (argc > 1) {
+        long num = argc > 2 ? strtol(argv[2], NULL, 10) : 0;
+        if (num <= 0) {
+            printf("usage: %s [handshake|resume|message <num>]\n", argv[0]);
+            return -1;
+        }
+        if (strcmp(argv[1], "handshake") == 0) {
+            return benchmark_handshake(basevalue_real_path, num);
+        }
+        if (strcmp(argv[1], "resume") == 0) {
+            return benchmark_resume(basevalue_real_path, num);
+        }
+        if (strcmp(argv[1], "message") == 0) {
+            return benchmark_message(basevalue_real_path, num);
+        }
+        printf("usage: %s [handshake|resume|message <num>]\n", argv[0]);
         return -1;
     }
-    bzero(&svr_addr, sizeof(svr_addr));
-    svr_addr.sin_family = AF_INET;
-    svr_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-    svr_addr.sin_port = htons(12306); // test server port 12306
 
-    if (connect(sockfd, (struct sockaddr *)&svr_addr, sizeof(svr_addr)) != 0) {
-        printf("connet to server failed\n");
-        close(sockfd);
+    sockfd = connect_server();
+    if (sockfd < 0) {
         return -1;
     }
     printf("connect server success\n");
@@ -13,6 +13,9 @@
 #include <stdio.h>
 #include <string.h>
 #include "switchless_t.h"
+#ifdef GP_ENCLAVE
+#include "secgear_tchannel.h"
+#endif
 
 
 void test_toupper(char *buf, int len)
@@ -112,3 +115,57 @@ int ecall_empty_switchless2(char *buf1, int len1, char *buf2, int len2)
 
     return 2;
 }
+
+static uint64_t g_record_checksum = 0;
+
+void ecall_consume_record_switchless(char *record, int len)
+{
+    if (record == NULL || len <= 0) {
+        return;
+    }
+    g_record_checksum += (unsigned char)record[0];
+}
+
+#define CHANNEL_BATCH 32
+// the geometry of the channel created by the host, attach rejects any other
+#define CHANNEL_CAPACITY 1024
+#define CHANNEL_RECORD_MAX_SIZE 64
+
+int ecall_consume_channel(uint64_t host_addr, size_t len, uint64_t nrecords)
+{
+// channels are only supported by GP
+#ifdef GP_ENCLAVE
+    cc_channel_t *channel = NULL;
+    char records[CHANNEL_BATCH][CHANNEL_RECORD_MAX_SIZE];
+    void *bufs[CHANNEL_BATCH];
+    uint32_t lens[CHANNEL_BATCH];
+    uint64_t consumed = 0;
+
+    if (cc_channel_attach(host_addr, len, CHANNEL_CAPACITY, CHANNEL_RECORD_MAX_SIZE, &channel) != CC_SUCCESS) {
+        return -1;
+    }
+    for (int i = 0; i < CHANNEL_BATCH; ++i) {
+        bufs[i] = records[i];
+    }
+
+    while (consumed < nrecords) {
+        uint32_t received = 0;
+        uint32_t count = nrecords - consumed < CHANNEL_BATCH ? (uint32_t)(nrecords - consumed) : CHANNEL_BATCH;
+        if (cc_channel_recv_batch(channel, bufs, lens, count, &received) != CC_SUCCESS) {
+            break;
+        }
+        for (uint32_t i = 0; i < received; ++i) {
+            g_record_checksum += (unsigned char)records[i][0];
+        }
+        consumed += received;
+    }
+
+    cc_channel_detach(channel);
+    return consumed == nrecords ? 0 : -1;
+#else
+    (void)host_addr;
+    (void)len;
+    (void)nrecords;
+    return -1;
+#endif
+}
@@ -19,6 +19,8 @@
 #include "string.h"
 #include "secgear_uswitchless.h"
 #include "secgear_shared_memory.h"
+#include "secgear_channel.h"
+#include <pthread.h>
 #include <sys/time.h>
 
 cc_enclave_t g_enclave;
@@ -706,6 +708,207 @@ void onetime_normal(void)
     printf("buf2:%s, retval:%d\n", buf2, retval);
 }
 
+#define ARENA_BENCHMARK_SIZE (64 * 1024 * 1024)
+#define ALLOC_BENCHMARK_MIN_SIZE 64
+#define ALLOC_BENCHMARK_MAX_SIZE (1024 * 1024)
+
+void benchmark_shared_memory_alloc(bool use_arena, cc_shared_memory_arena_t *arena, size_t size,
+    unsigned long nrepeats)
+{
+    struct timeval tval_before;
+    struct timeval tval_after;
+    struct timeval duration;
+    unsigned long failed = 0;
+
+    gettimeofday(&tval_before, NULL);
+    for (unsigned long i = 0; i < nrepeats; ++i) {
+        void *buf = use_arena ? cc_arena_malloc_shared_memory(arena, size) : cc_malloc_shared_memory(&g_enclave, size);
+        if (buf == NULL) {
+            ++failed;
+            continue;
+        }
+        (void)(use_arena ? cc_arena_free_shared_memory(arena, buf) : cc_free_shared_memory(&g_enclave, buf));
+    }
+    gettimeofday(&tval_after, NULL);
+    timersub(&tval_after, &tval_before, &duration);
+
+    printf("%s alloc/free %7zu bytes for %lu times takes %ld.%06lds, failed:%lu\n",
+        use_arena ? "[  arena   ]" : "[ ordinary ]", size, nrepeats, (long)duration.tv_sec, (long)duration.tv_usec,
+        failed);
+}
+
+void benchmark_shared_memory_arena(unsigned long nrepeats)
+{
+    cc_shared_memory_arena_t *arena = NULL;
+    cc_enclave_result_t ret = cc_create_shared_memory_arena(&g_enclave, ARENA_BENCHMARK_SIZE, &arena);
+    if (ret != CC_SUCCESS) {
+        printf("Error: create shared memory arena failed:%x.\n", ret);
+        return;
+    }
+
+    for (size_t size = ALLOC_BENCHMARK_MIN_SIZE; size <= ALLOC_BENCHMARK_MAX_SIZE; size <<= 1) {
+        benchmark_shared_memory_alloc(false, NULL, size, nrepeats);
+        benchmark_shared_memory_alloc(true, arena, size, nrepeats);
+    }
+
+    ret = cc_destroy_shared_memory_arena(arena);
+    if (ret != CC_SUCCESS) {
+        printf("Error: destroy shared memory arena failed:%x.\n", ret);
+    }
+}
+
+#define BANDWIDTH_BENCHMARK_SIZE (64 * 1024 * 1024)
+#define BANDWIDTH_BENCHMARK_CHUNK (1024 * 1024)
+#define BANDWIDTH_BENCHMARK_ROUNDS 16
+
+void benchmark_shared_memory_bandwidth_once(const cc_shared_memory_attr_t *attr)
+{
+    struct timeval tval_before;
+    struct timeval tval_after;
+    struct timeval duration;
+
+    char *buf = (char *)cc_malloc_shared_memory_with_attr(&g_enclave, BANDWIDTH_BENCHMARK_SIZE, attr);
+    if (buf == NULL) {
+        printf("Error: malloc shared memory with attr failed.\n");
+        return;
+    }
+    (void)memset(buf, 'a', BANDWIDTH_BENCHMARK_SIZE);
+
+    gettimeofday(&tval_before, NULL);
+    for (int round = 0; round < BANDWIDTH_BENCHMARK_ROUNDS; ++round) {
+        for (size_t off = 0; off < BANDWIDTH_BENCHMARK_SIZE; off += BANDWIDTH_BENCHMARK_CHUNK) {
+            test_toupper(&g_enclave, buf + off, BANDWIDTH_BENCHMARK_CHUNK);
+        }
+    }
+    gettimeofday(&tval_after, NULL);
+    timersub(&tval_after, &tval_before, &duration);
+
+    double seconds = (double)duration.tv_sec + (double)duration.tv_usec / 1000000;
+    double mbytes = (double)BANDWIDTH_BENCHMARK_SIZE * BANDWIDTH_BENCHMARK_ROUNDS / (1024 * 1024);
+    printf("%s streaming %d MB takes %ld.%06lds, %.1f MB/s\n", attr == NULL ? "[ default  ]" : "[huge, numa]",
+        (int)mbytes, (long)duration.tv_sec, (long)duration.tv_usec, seconds > 0 ? mbytes / seconds : 0);
+
+    cc_enclave_result_t ret = cc_free_shared_memory(&g_enclave, buf);
+    if (ret != CC_SUCCESS) {
+        printf("Error: free shared memory failed:%x.\n", ret);
+    }
+}
+
+void benchmark_shared_memory_bandwidth(void)
+{
+    cc_shared_memory_attr_t attr = {
+        .flags = CC_SHARED_MEMORY_FLAG_HUGE_PAGE | CC_SHARED_MEMORY_FLAG_NUMA_BIND,
+        .numa_node = 0
+    };
+
+    benchmark_shared_memory_bandwidth_once(NULL);
+    benchmark_shared_memory_bandwidth_once(&attr);
+}
+
+#define CHANNEL_BENCHMARK_RECORDS 1000000
+#define CHANNEL_BENCHMARK_CAPACITY 1024
+#define CHANNEL_RECORD_SIZE 64
+#define CHANNEL_SEND_BATCH 32
+
+typedef struct {
+    uint64_t host_addr;
+    size_t len;
+    int retval;
+    cc_enclave_result_t ret;
+    volatile bool done;
+} channel_consumer_arg_t;
+
+static void *channel_consumer(void *data)
+{
+    channel_consumer_arg_t *arg = (channel_consumer_arg_t *)data;
+    arg->ret = ecall_consume_channel(&g_enclave, &arg->retval, arg->host_addr, arg->len, CHANNEL_BENCHMARK_RECORDS);
+    __atomic_store_n(&arg->done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void print_records_rate(const char *name, struct timeval *duration)
+{
+    double seconds = (double)duration->tv_sec + (double)duration->tv_usec / 1000000;
+    printf("%s %d records of %d bytes take %ld.%06lds, %.0f records/s\n", name, CHANNEL_BENCHMARK_RECORDS,
+        CHANNEL_RECORD_SIZE, (long)duration->tv_sec, (long)duration->tv_usec,
+        seconds > 0 ? CHANNEL_BENCHMARK_RECORDS / seconds : 0);
+}
+
+void benchmark_records_switchless(void)
+{
+    struct timeval tval_before;
+    struct timeval tval_after;
+    struct timeval duration;
+    char record[CHANNEL_RECORD_SIZE];
+
+    (void)memset(record, 'a', sizeof(record));
+    gettimeofday(&tval_before, NULL);
+    for (int i = 0; i < CHANNEL_BENCHMARK_RECORDS; ++i) {
+        ecall_consume_record_switchless(&g_enclave, record, sizeof(record));
+    }
+    gettimeofday(&tval_after, NULL);
+    timersub(&tval_after, &tval_before, &duration);
+
+    print_records_rate("[switchless]", &duration);
+}
+
+void benchmark_records_channel(void)
+{
+    struct timeval tval_before;
+    struct timeval tval_after;
+    struct timeval duration;
+    cc_channel_t *channel = NULL;
+    channel_consumer_arg_t arg = {0};
+    pthread_t tid;
+    char record[CHANNEL_RECORD_SIZE];
+    const void *records[CHANNEL_SEND_BATCH];
+    uint32_t lens[CHANNEL_SEND_BATCH];
+    void *addr = NULL;
+
+    cc_enclave_result_t ret = cc_channel_create(&g_enclave, CHANNEL_BENCHMARK_CAPACITY, CHANNEL_RECORD_SIZE, 0,
+        &channel);
+    if (ret != CC_SUCCESS) {
+        printf("Error: create channel failed:%x.\n", ret);
+        return;
+    }
+    (void)cc_channel_get_shared_memory(channel, &addr, &arg.len);
+    arg.host_addr = (uint64_t)(uintptr_t)addr;
+
+    (void)memset(record, 'a', sizeof(record));
+    for (int i = 0; i < CHANNEL_SEND_BATCH; ++i) {
+        records[i] = record;
+        lens[i] = sizeof(record);
+    }
+
+    gettimeofday(&tval_before, NULL);
+    if (pthread_create(&tid, NULL, channel_consumer, &arg) != 0) {
+        printf("Error: create consumer thread failed.\n");
+        goto end;
+    }
+    // Stop early if the consumer gave up, the channel would stay full forever
+    for (int sent_total = 0; sent_total < CHANNEL_BENCHMARK_RECORDS && !__atomic_load_n(&arg.done, __ATOMIC_ACQUIRE);) {
+        uint32_t sent = 0;
+        uint32_t count = CHANNEL_BENCHMARK_RECORDS - sent_total < CHANNEL_SEND_BATCH ?
+            (uint32_t)(CHANNEL_BENCHMARK_RECORDS - sent_total) : CHANNEL_SEND_BATCH;
+        (void)cc_channel_send_batch(channel, records, lens, count, &sent);
+        sent_total += (int)sent;
+    }
+    (void)pthread_join(tid, NULL);
+    gettimeofday(&tval_after, NULL);
+    timersub(&tval_after, &tval_before, &duration);
+
+    if (arg.ret != CC_SUCCESS || arg.retval != 0) {
+        printf("Error: consume channel failed:%x, retval:%d.\n", arg.ret, arg.retval);
+    } else {
+        print_records_rate("[ channel  ]", &duration);
+    }
+end:
+    ret = cc_channel_destroy(channel);
+    if (ret != CC_SUCCESS) {
+        printf("Error: destroy channel failed:%x.\n", ret);
+    }
+}
+
 int main(void)
 {
     cc_sl_config_t sl_cfg = CC_USWITCHLESS_CONFIG_INITIALIZER;
@@ -734,6 +937,16 @@ int main(void)
     printf("\n3. normal ecall\n");
     onetime_normal();
 
+    printf("\n4. Running a benchmark that compares [ordinary] and [arena] shared memory alloc/free\n");
+    benchmark_shared_memory_arena(nrepeats);
+
+    printf("\n5. Running a benchmark that compares [default] and [huge page, numa bound] shared memory bandwidth\n");
+    benchmark_shared_memory_bandwidth();
+
+    printf("\n6. Running a benchmark that compares [switchless] ecall and [channel] records per second\n");
+    benchmark_records_switchless();
+    benchmark_records_channel();
+
     fini_enclave(&g_enclave);
 
 #if 1
@@ -47,6 +47,11 @@ typedef struct {
     void *enclave; // refer to cc_enclave_t
     pthread_t register_tid;
     list_node_t node;
+    void *region; // refer to the host side region that the block is carved from, NULL for a standalone block
+    size_t buf_len; // usable length of a block carved from a region
+    bool is_used; // whether a block carved from a region is allocated
+    list_node_t region_node; // links the blocks of a region in address order
+    list_node_t free_node; // links a free block carved from a region into the free list of its size class
 } gp_shared_memory_t;
 
 #define GP_SHARED_MEMORY_ENTRY(ptr) \
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef __SECGEAR_CHANNEL_DEFS_H__
+#define __SECGEAR_CHANNEL_DEFS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *   channel_ring_hdr_t                                       slot[0]            slot[capacity - 1]
+ *   |                                                        |                  |
+ *   v                                                        v                  v
+ *   +----------+--------------+--------------+-----------+---+--------+---------+---+--------+
+ *   | geometry | prod.head    | cons.head    | doorbell  |len| record |   ...   |len| record |   shared memory
+ *   |          | prod.tail    | cons.tail    | waiters   |   |        |         |   |        |
+ *   +----------+--------------+--------------+-----------+---+--------+---------+---+--------+
+ *    cache line  cache line     cache line     cache line
+ *
+ * The ring works like a bounded multi-producer/multi-consumer queue with separate head and tail indices per side:
+ * a side first moves its head to reserve a range of slots, copies the records, then moves its tail to publish
+ * them. With a single producer (consumer) the head is moved by a plain store, otherwise by CAS, and the tail is
+ * published in reservation order. Indices are free running 32-bit counters, capacity is a power of two.
+ *
+ * Both the host and the enclave keep a private channel_ring_t with the geometry read once at attach time, and each
+ * side attaches with the geometry it expects, so a peer that tampers with the shared header can make records wrong
+ * but never makes the other side write outside of the ring or of its receive buffers.
+ */
+#define CHANNEL_RING_MAGIC          0x4c4e4843U /* "CHNL" */
+#define CHANNEL_CACHE_LINE_SIZE     64
+#define CHANNEL_MAX_CAPACITY        ((uint32_t)1 << 30)
+#define CHANNEL_MAX_SLOT_SIZE       (1024 * 1024)
+#define CHANNEL_SLOT_ALIGN          8
+
+#define CHANNEL_FLAG_MULTI_PRODUCER 0x1
+#define CHANNEL_FLAG_MULTI_CONSUMER 0x2
+#define CHANNEL_FLAG_MASK           (CHANNEL_FLAG_MULTI_PRODUCER | CHANNEL_FLAG_MULTI_CONSUMER)
+
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+} __attribute__((aligned(CHANNEL_CACHE_LINE_SIZE))) channel_ring_index_t;
+
+typedef struct {
+    volatile uint32_t seq; // bumped by any side that makes progress while someone waits
+    volatile uint32_t waiters;
+} __attribute__((aligned(CHANNEL_CACHE_LINE_SIZE))) channel_doorbell_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t slot_size; // max record length
+    uint32_t slot_stride; // distance between slots, includes the length field
+    uint32_t flags;
+    channel_ring_index_t prod __attribute__((aligned(CHANNEL_CACHE_LINE_SIZE)));
+    channel_ring_index_t cons;
+    channel_doorbell_t doorbell;
+} channel_ring_hdr_t;
+
+typedef struct {
+    uint32_t len;
+    char data[0];
+} channel_slot_t;
+
+typedef struct {
+    channel_ring_hdr_t *hdr;
+    char *slots;
+    uint32_t mask;
+    uint32_t capacity;
+    uint32_t slot_size;
+    uint32_t slot_stride;
+    uint32_t flags;
+} channel_ring_t;
+
+#define CHANNEL_SLOT_STRIDE(slot_size) \
+    (((uint32_t)sizeof(channel_slot_t) + (slot_size) + CHANNEL_SLOT_ALIGN - 1) & ~(uint32_t)(CHANNEL_SLOT_ALIGN - 1))
+
+#define CHANNEL_RING_SIZE(capacity, slot_size) \
+    (sizeof(channel_ring_hdr_t) + (size_t)(capacity) * CHANNEL_SLOT_STRIDE(slot_size))
+
+static inline void channel_cpu_relax(void)
+{
+#if defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#elif defined(__x86_64__)
+    __asm__ __volatile__("pause" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static inline bool channel_ring_geometry_valid(uint32_t capacity, uint32_t slot_size, uint32_t flags)
+{
+    return capacity != 0 && capacity <= CHANNEL_MAX_CAPACITY && (capacity & (capacity - 1)) == 0 &&
+        slot_size != 0 && slot_size <= CHANNEL_MAX_SLOT_SIZE && (flags & ~CHANNEL_FLAG_MASK) == 0;
+}
+
+/* Lay out a new ring in buf, which holds at least CHANNEL_RING_SIZE(capacity, slot_size) bytes */
+static inline void channel_ring_format(void *buf, uint32_t capacity, uint32_t slot_size, uint32_t flags)
+{
+    channel_ring_hdr_t *hdr = (channel_ring_hdr_t *)buf;
+
+    (void)memset(hdr, 0, sizeof(channel_ring_hdr_t));
+    hdr->capacity = capacity;
+    hdr->slot_size = slot_size;
+    hdr->slot_stride = CHANNEL_SLOT_STRIDE(slot_size);
+    hdr->flags = flags;
+    __atomic_store_n(&hdr->magic, CHANNEL_RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+/*
+ * Attach the ring in buf, buf_len is the length of the shared buffer. The geometry is read once and must be the one
+ * the caller expects, the private copy is used from then on.
+ */
+static inline bool channel_ring_attach(channel_ring_t *ring, void *buf, size_t buf_len, uint32_t capacity,
+    uint32_t slot_size)
+{
+    channel_ring_hdr_t *hdr = (channel_ring_hdr_t *)buf;
+
+    if (buf_len < sizeof(channel_ring_hdr_t) || __atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != CHANNEL_RING_MAGIC) {
+        return false;
+    }
+    uint32_t flags = __atomic_load_n(&hdr->flags, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&hdr->capacity, __ATOMIC_RELAXED) != capacity ||
+        __atomic_load_n(&hdr->slot_size, __ATOMIC_RELAXED) != slot_size ||
+        !channel_ring_geometry_valid(capacity, slot_size, flags) || buf_len < CHANNEL_RING_SIZE(capacity, slot_size)) {
+        return false;
+    }
+
+    ring->hdr = hdr;
+    ring->slots = (char *)buf + sizeof(channel_ring_hdr_t);
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    ring->slot_size = slot_size;
+    ring->slot_stride = CHANNEL_SLOT_STRIDE(slot_size);
+    ring->flags = flags;
+    return true;
+}
+
+static inline channel_slot_t *channel_ring_slot(const channel_ring_t *ring, uint32_t idx)
+{
+    return (channel_slot_t *)(ring->slots + (size_t)(idx & ring->mask) * ring->slot_stride);
+}
+
+/*
+ * Reserve up to n slots on one side of the ring. For the producer, the free slots are those between the consumer
+ * tail and the producer head; for the consumer, the full slots are those between the producer tail and the
+ * consumer head. Returns the number of reserved slots, which start at *old_head.
+ */
+static inline uint32_t channel_ring_move_head(const channel_ring_t *ring, bool is_prod, uint32_t n, uint32_t *old_head)
+{
+    channel_ring_index_t *self = is_prod ? &ring->hdr->prod : &ring->hdr->cons;
+    channel_ring_index_t *peer = is_prod ? &ring->hdr->cons : &ring->hdr->prod;
+    bool is_multi = (ring->flags & (is_prod ? CHANNEL_FLAG_MULTI_PRODUCER : CHANNEL_FLAG_MULTI_CONSUMER)) != 0;
+    uint32_t head = __atomic_load_n(&self->head, __ATOMIC_ACQUIRE);
+    uint32_t entries;
+
+    do {
+        uint32_t peer_tail = __atomic_load_n(&peer->tail, __ATOMIC_ACQUIRE);
+        entries = is_prod ? ring->capacity + peer_tail - head : peer_tail - head;
+        // Indices written by a misbehaving peer must not let us reserve more than the ring holds
+        if (entries > ring->capacity) {
+            return 0;
+        }
+        if (n > entries) {
+            n = entries;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        if (!is_multi) {
+            __atomic_store_n(&self->head, head + n, __ATOMIC_RELAXED);
+            break;
+        }
+    } while (!__atomic_compare_exchange_n(&self->head, &head, head + n, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    *old_head = head;
+    return n;
+}
+
+/* Publish the reserved slots, other reservations of the same side are published in order */
+static inline void channel_ring_update_tail(const channel_ring_t *ring, bool is_prod, uint32_t old_head, uint32_t n)
+{
+    channel_ring_index_t *self = is_prod ? &ring->hdr->prod : &ring->hdr->cons;
+
+    if (ring->flags & (is_prod ? CHANNEL_FLAG_MULTI_PRODUCER : CHANNEL_FLAG_MULTI_CONSUMER)) {
+        while (__atomic_load_n(&self->tail, __ATOMIC_RELAXED) != old_head) {
+            channel_cpu_relax();
+        }
+    }
+    __atomic_store_n(&self->tail, old_head + n, __ATOMIC_RELEASE);
+}
+
+/* Enqueue up to count records, lens[i] must not exceed slot_size. Returns the number of enqueued records. */
+static inline uint32_t channel_ring_enqueue(const channel_ring_t *ring, const void *const *records,
+    const uint32_t *lens, uint32_t count)
+{
+    uint32_t head = 0;
+    uint32_t n = channel_ring_move_head(ring, true, count, &head);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        channel_slot_t *slot = channel_ring_slot(ring, head + i);
+        slot->len = lens[i];
+        (void)memcpy(slot->data, records[i], lens[i]);
+    }
+    if (n != 0) {
+        channel_ring_update_tail(ring, true, head, n);
+    }
+    return n;
+}
+
+/*
+ * Dequeue up to count records into bufs, each of which holds at least slot_size bytes. The length of each record
+ * is stored in lens. Returns the number of dequeued records.
+ */
+static inline uint32_t channel_ring_dequeue(const channel_ring_t *ring, void *const *bufs, uint32_t *lens,
+    uint32_t count)
+{
+    uint32_t head = 0;
+    uint32_t n = channel_ring_move_head(ring, false, count, &head);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        channel_slot_t *slot = channel_ring_slot(ring, head + i);
+        uint32_t len = slot->len;
+        lens[i] = len > ring->slot_size ? ring->slot_size : len;
+        (void)memcpy(bufs[i], slot->data, lens[i]);
+    }
+    if (n != 0) {
+        channel_ring_update_tail(ring, false, head, n);
+    }
+    return n;
+}
+
+/* Ring the doorbell after making progress, returns true if anyone waits and must be woken */
+static inline bool channel_ring_doorbell(const channel_ring_t *ring)
+{
+    channel_doorbell_t *doorbell = &ring->hdr->doorbell;
+
+    // Order the publication of the tail before the check, a waiter orders them the other way round
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&doorbell->waiters, __ATOMIC_SEQ_CST) == 0) {
+        return false;
+    }
+    (void)__atomic_add_fetch(&doorbell->seq, 1, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,6 +21,16 @@
 #define SEAL_DATA_FN(in, inl, out, outl, aad, aadl) itrustee_seal_data(in, inl, out, outl, aad, aadl)
 #define UNSEAL_DATA_FN(in, out, outl, aad, aadl) itrustee_unseal_data(in, out, outl, aad, aadl)
 #define GET_SEALED_DATA_SIZE(len1, len2) itrustee_sealed_data_size(len1, len2)
+#define SEAL_CTX_CREATE_FN(num, ctx) itrustee_seal_ctx_create(num, ctx)
+#define SEAL_CTX_DESTROY_FN(ctx) itrustee_seal_ctx_destroy(ctx)
+#define SEAL_DATA_CTX_FN(ctx, in, inl, out, outl, aad, aadl) itrustee_seal_data_ctx(ctx, in, inl, out, outl, aad, aadl)
+#define UNSEAL_DATA_CTX_FN(ctx, in, out, outl, aad, aadl) itrustee_unseal_data_ctx(ctx, in, out, outl, aad, aadl)
+#define SEAL_AEAD_INIT_FN(key, aead) itrustee_seal_aead_init(key, aead)
+#define SEAL_AEAD_FREE_FN(aead) itrustee_seal_aead_free(aead)
+#define SEAL_AEAD_ENCRYPT_FN(aead, nonce, aad, aadl, in, inl, out, tag) \
+    itrustee_seal_aead_encrypt(aead, nonce, aad, aadl, in, inl, out, tag)
+#define SEAL_AEAD_DECRYPT_FN(aead, nonce, aad, aadl, in, inl, out, tag) \
+    itrustee_seal_aead_decrypt(aead, nonce, aad, aadl, in, inl, out, tag)
 
 
 #define SEAL_KEY_LEN 32
@@ -30,6 +40,12 @@
 #define SEAL_DATA_TAG_BIT_LEN SEAL_DATA_TAG_LEN*8
 #define SEAL_DATA_NONCE_LEN 12
 #define SEAL_MAX_OBJ_LEN 256
+/* records sealed by a sealing context before it derives a new key from a new salt */
+#define SEAL_CTX_DEFAULT_MAX_SEAL_NUM (1U << 20)
+/* keys of recently seen salts cached by a sealing context for unseal */
+#define SEAL_CTX_UNSEAL_KEY_NUM 4
+/* data key of a sealed stream */
+#define SEAL_STREAM_KEY_LEN 32
 
 
 typedef struct _itrustee_seal_data {
@@ -55,6 +71,31 @@ TEE_Result itrustee_unseal_data(void *cc_enclave_sealed_data, uint8_t *decrypted
 TEE_Result aes_seal_unseal_data(uint8_t *key_buf, uint32_t key_len, uint8_t *nonce, uint32_t nonce_len, uint32_t mode,
     uint8_t *src_data, uint32_t src_len, uint8_t *dest_data, uint32_t *dest_len, uint8_t *tag, uint32_t *tag_len);
 
+struct _enclave_seal_ctx;
+
+TEE_Result itrustee_seal_ctx_create(uint32_t max_seal_num, struct _enclave_seal_ctx **ctx);
+
+void itrustee_seal_ctx_destroy(struct _enclave_seal_ctx *ctx);
+
+TEE_Result itrustee_seal_data_ctx(struct _enclave_seal_ctx *ctx, uint8_t *seal_data, uint32_t seal_data_len,
+    void *sealed_data, uint32_t sealed_data_len, uint8_t *mac_data, uint32_t mac_data_len);
+
+TEE_Result itrustee_unseal_data_ctx(struct _enclave_seal_ctx *ctx, void *sealed_data, uint8_t *decrypted_data,
+    uint32_t *decrypted_data_len, uint8_t *mac_data, uint32_t *mac_data_len);
+
+/* AES-GCM with a 12 bytes nonce and a 16 bytes tag, used by sealed streams */
+struct _enclave_seal_aead;
+
+TEE_Result itrustee_seal_aead_init(uint8_t *key, struct _enclave_seal_aead **aead);
+
+void itrustee_seal_aead_free(struct _enclave_seal_aead *aead);
+
+TEE_Result itrustee_seal_aead_encrypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad, uint32_t aad_len,
+    uint8_t *src, uint32_t src_len, uint8_t *dest, uint8_t *tag);
+
+TEE_Result itrustee_seal_aead_decrypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad, uint32_t aad_len,
+    uint8_t *src, uint32_t src_len, uint8_t *dest, uint8_t *tag);
+
 
 
 
@@ -18,6 +18,18 @@
 
 #define SEAL_DATA_FN(in, inl, out, outl, aad, aadl) penglai_seal_data(in, inl, out, outl, aad, aadl)
 #define UNSEAL_DATA_FN(in, out, outl, aad, aadl) penglai_unseal_data(in, out, outl, aad, aadl)
+#define SEAL_CTX_CREATE_FN(num, ctx) penglai_seal_ctx_create(num, ctx)
+#define SEAL_CTX_DESTROY_FN(ctx) penglai_seal_ctx_destroy(ctx)
+#define SEAL_DATA_CTX_FN(ctx, in, inl, out, outl, aad, aadl) penglai_seal_data(in, inl, out, outl, aad, aadl)
+#define UNSEAL_DATA_CTX_FN(ctx, in, out, outl, aad, aadl) penglai_unseal_data(in, out, outl, aad, aadl)
+#define SEAL_AEAD_INIT_FN(key, aead) penglai_seal_aead_init(key, aead)
+#define SEAL_AEAD_FREE_FN(aead) penglai_seal_aead_free(aead)
+#define SEAL_AEAD_ENCRYPT_FN(aead, nonce, aad, aadl, in, inl, out, tag) \
+        penglai_seal_aead_crypt(aead, nonce, aad, aadl, in, inl, out, tag)
+#define SEAL_AEAD_DECRYPT_FN(aead, nonce, aad, aadl, in, inl, out, tag) \
+        penglai_seal_aead_crypt(aead, nonce, aad, aadl, in, inl, out, tag)
+
+#define SEAL_STREAM_KEY_LEN 32
 
 uint32_t get_sealed_data_size_ex(uint32_t seal_data_len, uint32_t aad_len);
 uint32_t get_encrypted_text_size_ex(const void *sealed_data);
@@ -28,4 +40,14 @@ uint32_t penglai_seal_data(uint8_t *seal_data, uint32_t seal_data_len, void *sea
 uint32_t penglai_unseal_data(void *sealed_data, uint8_t *decrypted_data, uint32_t *decrypted_data_len,
                 uint8_t *mac_data, uint32_t *mac_data_len);
 
+struct _enclave_seal_ctx;
+uint32_t penglai_seal_ctx_create(uint32_t max_seal_num, struct _enclave_seal_ctx **ctx);
+void penglai_seal_ctx_destroy(struct _enclave_seal_ctx *ctx);
+
+struct _enclave_seal_aead;
+uint32_t penglai_seal_aead_init(uint8_t *key, struct _enclave_seal_aead **aead);
+void penglai_seal_aead_free(struct _enclave_seal_aead *aead);
+uint32_t penglai_seal_aead_crypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad, uint32_t aad_len,
+                uint8_t *src, uint32_t src_len, uint8_t *dest, uint8_t *tag);
+
 #endif
@@ -41,6 +41,81 @@ cc_enclave_result_t cc_enclave_seal_data(uint8_t *seal_data, uint32_t seal_data_
 cc_enclave_result_t cc_enclave_unseal_data(cc_enclave_sealed_data_t *sealed_data, uint8_t *decrypted_data,
     uint32_t *decrypted_data_len, uint8_t *additional_text, uint32_t *additional_text_len);
 
+/*
+ * A sealing context caches the derived seal keys, so that sealing and unsealing many records costs one AEAD pass
+ * per record instead of a key derivation. Records sealed with or without a context can be unsealed either way.
+ * Calls on the same context are serialized, use a context per thread for parallel sealing.
+ */
+typedef struct _enclave_seal_ctx cc_enclave_seal_ctx_t;
+
+cc_enclave_result_t cc_enclave_seal_ctx_create(uint32_t max_seal_num, cc_enclave_seal_ctx_t **ctx);
+void cc_enclave_seal_ctx_destroy(cc_enclave_seal_ctx_t *ctx);
+
+cc_enclave_result_t cc_enclave_seal_data_with_ctx(cc_enclave_seal_ctx_t *ctx, uint8_t *seal_data,
+    uint32_t seal_data_len, cc_enclave_sealed_data_t *sealed_data, uint32_t sealed_data_len,
+    uint8_t *additional_text, uint32_t additional_text_len);
+
+cc_enclave_result_t cc_enclave_unseal_data_with_ctx(cc_enclave_seal_ctx_t *ctx, cc_enclave_sealed_data_t *sealed_data,
+    uint8_t *decrypted_data, uint32_t *decrypted_data_len, uint8_t *additional_text, uint32_t *additional_text_len);
+
+/*
+ * Batch sealing packs the sealed records one after another into a single buffer, each starting at a multiple of
+ * CC_SEAL_BATCH_ALIGN, and reports a status per record. All records of a batch share the key setup of the sealing
+ * context, a temporary context is used for the batch if ctx is NULL.
+ */
+#define CC_SEAL_BATCH_ALIGN 8
+
+typedef struct {
+    uint8_t *data;                 // plain text; for unseal, buffer of the plain text
+    uint32_t data_len;             // plain text length; for unseal, buffer size in and plain text length out
+    uint8_t *additional_text;      // additional text; for unseal, buffer of the additional text
+    uint32_t additional_text_len;  // additional text length; for unseal, buffer size in and text length out
+} cc_enclave_seal_record_t;
+
+cc_enclave_result_t cc_enclave_seal_data_batch(cc_enclave_seal_ctx_t *ctx, cc_enclave_seal_record_t *records,
+    uint32_t rec_num, uint8_t *sealed_buf, uint32_t *sealed_buf_len, uint32_t *offsets, cc_enclave_result_t *status);
+
+cc_enclave_result_t cc_enclave_unseal_data_batch(cc_enclave_seal_ctx_t *ctx, uint8_t *sealed_buf,
+    uint32_t sealed_buf_len, uint32_t *offsets, uint32_t rec_num, cc_enclave_seal_record_t *records,
+    cc_enclave_result_t *status);
+
+/*
+ * A sealed stream is a header, then chunks of chunk_size plain text bytes each sealed with its own tag, the last one
+ * may be shorter, then a trailer. The chunks are sealed under a random data key which is sealed into the header,
+ * the trailer carries a tag chained over all chunk tags, so that a missing, reordered or truncated chunk fails
+ * cc_enclave_unseal_stream_final. A stream is used by one thread at a time.
+ *
+ *   +--------+-------------------+-------------------+-----+---------------------+---------+
+ *   | header | chunk 0 |   tag   | chunk 1 |   tag   | ... | last chunk |  tag   | trailer |
+ *   +--------+-------------------+-------------------+-----+---------------------+---------+
+ */
+#define CC_SEAL_STREAM_TAG_LEN 16
+#define CC_SEAL_STREAM_TRAILER_LEN 32
+#define CC_SEAL_STREAM_MAX_CHUNK_SIZE (1U << 30)
+
+typedef struct _enclave_seal_stream cc_enclave_seal_stream_t;
+
+uint32_t cc_enclave_get_seal_stream_header_size(void);
+
+cc_enclave_result_t cc_enclave_seal_stream_init(uint32_t chunk_size, uint8_t *header, uint32_t header_len,
+    cc_enclave_seal_stream_t **stream);
+cc_enclave_result_t cc_enclave_seal_stream_update(cc_enclave_seal_stream_t *stream, uint8_t *plain,
+    uint32_t plain_len, uint8_t *sealed, uint32_t *sealed_len);
+cc_enclave_result_t cc_enclave_seal_stream_final(cc_enclave_seal_stream_t *stream, uint8_t *trailer,
+    uint32_t trailer_len);
+
+cc_enclave_result_t cc_enclave_unseal_stream_init(uint8_t *header, uint32_t header_len,
+    cc_enclave_seal_stream_t **stream);
+cc_enclave_result_t cc_enclave_unseal_stream_update(cc_enclave_seal_stream_t *stream, uint8_t *sealed,
+    uint32_t sealed_len, uint8_t *plain, uint32_t *plain_len);
+cc_enclave_result_t cc_enclave_unseal_stream_chunk(cc_enclave_seal_stream_t *stream, uint64_t index,
+    uint8_t *sealed, uint32_t sealed_len, uint8_t *plain, uint32_t *plain_len);
+cc_enclave_result_t cc_enclave_unseal_stream_final(cc_enclave_seal_stream_t *stream, uint8_t *trailer,
+    uint32_t trailer_len);
+
+uint32_t cc_enclave_seal_stream_get_chunk_size(const cc_enclave_seal_stream_t *stream);
+void cc_enclave_seal_stream_free(cc_enclave_seal_stream_t *stream);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef __SECGEAR_TCHANNEL_H__
+#define __SECGEAR_TCHANNEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Enclave side of a channel created by cc_channel_create on the host. The enclave never blocks on a channel, it
+ * polls, and every successful operation rings the doorbell so that a host thread sleeping on the channel wakes up.
+ */
+typedef struct _cc_channel cc_channel_t;
+
+/*
+ * Summary: Attach a channel, the shared memory must stay registered until the channel is detached.
+ * Parameters:
+ *      host_addr: host address of the shared memory returned by cc_channel_get_shared_memory, passed as an integer
+ *      len: length of the shared memory returned by cc_channel_get_shared_memory
+ *      capacity: number of slots the enclave expects, as passed to cc_channel_create
+ *      slot_size: max record length the enclave expects, as passed to cc_channel_create
+ *      channel: the attached channel
+ * Return: CC_SUCCESS, success; CC_ERROR_BAD_FORMAT, the channel has another geometry; others failed.
+ */
+cc_enclave_result_t cc_channel_attach(uint64_t host_addr, size_t len, uint32_t capacity, uint32_t slot_size,
+    cc_channel_t **channel);
+
+/*
+ * Summary: Detach the channel.
+ * Parameters:
+ *      channel: channel
+ * Return: None
+ */
+void cc_channel_detach(cc_channel_t *channel);
+
+/*
+ * Summary: Send up to count records.
+ * Parameters:
+ *      channel: channel
+ *      records: records to send
+ *      lens: length of each record, no more than the slot size
+ *      count: number of records
+ *      sent: number of records actually sent, less than count if the channel is full
+ * Return: CC_SUCCESS, success; others failed.
+ */
+cc_enclave_result_t cc_channel_send_batch(cc_channel_t *channel, const void *const *records, const uint32_t *lens,
+    uint32_t count, uint32_t *sent);
+
+/*
+ * Summary: Receive up to count records.
+ * Parameters:
+ *      channel: channel
+ *      bufs: buffers to receive the records, each of them holds at least the slot_size passed to cc_channel_attach
+ *      lens: length of each received record
+ *      count: number of buffers
+ *      received: number of records actually received, less than count if the channel is empty
+ * Return: CC_SUCCESS, success; others failed.
+ */
+cc_enclave_result_t cc_channel_recv_batch(cc_channel_t *channel, void *const *bufs, uint32_t *lens, uint32_t count,
+    uint32_t *received);
+
+/*
+ * Summary: Send one record.
+ * Parameters:
+ *      channel: channel
+ *      record: record to send
+ *      len: record length, no more than the slot size
+ * Return: CC_SUCCESS, success; CC_ERROR_BUSY, the channel is full; others failed.
+ */
+cc_enclave_result_t cc_channel_send(cc_channel_t *channel, const void *record, uint32_t len);
+
+/*
+ * Summary: Receive one record.
+ * Parameters:
+ *      channel: channel
+ *      buf: buffer to receive the record
+ *      buf_len: buffer length, no less than the slot size
+ *      len: length of the received record
+ * Return: CC_SUCCESS, success; CC_ERROR_BUSY, the channel is empty; others failed.
+ */
+cc_enclave_result_t cc_channel_recv(cc_channel_t *channel, void *buf, uint32_t buf_len, uint32_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
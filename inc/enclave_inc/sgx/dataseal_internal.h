@@ -14,12 +14,28 @@
 #define _SGX_SEAL_H_
 #include "sgx_tseal.h"
 #include "sgx_utils.h"
+#include "sgx_tcrypto.h"
 #include "string.h"
 
 #define SEAL_DATA_FN(in, inl, out, outl, aad, aadl) \
         internel_sgx_seal_data(in, inl, out, outl, aad, aadl)
 #define UNSEAL_DATA_FN(in, out, outl, aad, aadl) \
         internel_sgx_unseal_data(in, out, outl, aad, aadl)
+#define SEAL_CTX_CREATE_FN(num, ctx) internel_sgx_seal_ctx_create(num, ctx)
+#define SEAL_CTX_DESTROY_FN(ctx) internel_sgx_seal_ctx_destroy(ctx)
+#define SEAL_DATA_CTX_FN(ctx, in, inl, out, outl, aad, aadl) \
+        internel_sgx_seal_data(in, inl, out, outl, aad, aadl)
+#define UNSEAL_DATA_CTX_FN(ctx, in, out, outl, aad, aadl) \
+        internel_sgx_unseal_data(in, out, outl, aad, aadl)
+#define SEAL_AEAD_INIT_FN(key, aead) internel_sgx_seal_aead_init(key, aead)
+#define SEAL_AEAD_FREE_FN(aead) internel_sgx_seal_aead_free(aead)
+#define SEAL_AEAD_ENCRYPT_FN(aead, nonce, aad, aadl, in, inl, out, tag) \
+        internel_sgx_seal_aead_encrypt(aead, nonce, aad, aadl, in, inl, out, tag)
+#define SEAL_AEAD_DECRYPT_FN(aead, nonce, aad, aadl, in, inl, out, tag) \
+        internel_sgx_seal_aead_decrypt(aead, nonce, aad, aadl, in, inl, out, tag)
+
+/* data key of a sealed stream, sgx_tcrypto provides AES-128-GCM */
+#define SEAL_STREAM_KEY_LEN 16
 
 uint32_t get_sealed_data_size_ex(uint32_t seal_data_len, uint32_t aad_len);
 uint32_t get_encrypted_text_size_ex(const void *sealed_data);
@@ -30,4 +46,18 @@ sgx_status_t internel_sgx_seal_data(uint8_t *seal_data, uint32_t seal_data_len,
 sgx_status_t internel_sgx_unseal_data(void *sealed_data, uint8_t *decrypted_data, uint32_t *decrypted_data_len,
                                       uint8_t *mac_data, uint32_t *mac_data_len);
 
+struct _enclave_seal_ctx;
+sgx_status_t internel_sgx_seal_ctx_create(uint32_t max_seal_num, struct _enclave_seal_ctx **ctx);
+void internel_sgx_seal_ctx_destroy(struct _enclave_seal_ctx *ctx);
+
+struct _enclave_seal_aead;
+sgx_status_t internel_sgx_seal_aead_init(uint8_t *key, struct _enclave_seal_aead **aead);
+void internel_sgx_seal_aead_free(struct _enclave_seal_aead *aead);
+sgx_status_t internel_sgx_seal_aead_encrypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad,
+                                            uint32_t aad_len, uint8_t *src, uint32_t src_len, uint8_t *dest,
+                                            uint8_t *tag);
+sgx_status_t internel_sgx_seal_aead_decrypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad,
+                                            uint32_t aad_len, uint8_t *src, uint32_t src_len, uint8_t *dest,
+                                            uint8_t *tag);
+
 #endif
@@ -15,6 +15,7 @@
 
 #include <pthread.h>
 #include "enclave.h"
+#include "secgear_shared_memory.h"
 
 #ifdef  __cplusplus
 extern "C" {
@@ -78,6 +79,8 @@ struct cc_enclave_ops {
     cc_enclave_result_t (*cc_free_shared_memory)(cc_enclave_t *enclave, void *ptr);
     cc_enclave_result_t (*cc_register_shared_memory)(cc_enclave_t *enclave, void *ptr);
     cc_enclave_result_t (*cc_unregister_shared_memory)(cc_enclave_t *enclave, void *ptr);
+    void *(*cc_malloc_shared_memory_with_attr)(cc_enclave_t *enclave, size_t size,
+        const cc_shared_memory_attr_t *attr);
 };
 
 struct cc_enclave_ops_desc {
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef __SECGEAR_CHANNEL_H__
+#define __SECGEAR_CHANNEL_H__
+
+#include <stdint.h>
+#include "status.h"
+#include "enclave.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A channel is a ring of fixed size slots in registered shared memory. Records are passed between the host and the
+ * enclave without any ecall: hand the shared memory of the channel to the enclave once, through a switchless ecall
+ * parameter, and attach it there with cc_channel_attach from secgear_tchannel.h, which checks that the channel
+ * has the capacity and slot size the enclave expects.
+ */
+typedef struct _cc_channel cc_channel_t;
+
+typedef enum {
+    CC_CHANNEL_FLAG_MULTI_PRODUCER = 0x1, /* several threads may send concurrently */
+    CC_CHANNEL_FLAG_MULTI_CONSUMER = 0x2, /* several threads may receive concurrently */
+} cc_channel_flag_t;
+
+#define CC_CHANNEL_MAX_CAPACITY (1U << 30)
+#define CC_CHANNEL_MAX_SLOT_SIZE (1024 * 1024)
+#define CC_CHANNEL_WAIT_FOREVER UINT32_MAX
+
+/*
+ * Summary: Create a channel in registered shared memory.
+ * Parameters:
+ *      enclave: enclave, it must outlive the channel
+ *      capacity: number of slots, a power of two no more than CC_CHANNEL_MAX_CAPACITY
+ *      slot_size: max record length, no more than CC_CHANNEL_MAX_SLOT_SIZE
+ *      flags: bitwise or of cc_channel_flag_t, 0 for a single producer and a single consumer
+ *      channel: the created channel
+ * Return: CC_SUCCESS, success; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_channel_create(cc_enclave_t *enclave, uint32_t capacity, uint32_t slot_size,
+    uint32_t flags, cc_channel_t **channel);
+
+/*
+ * Summary: Destroy the channel, the enclave must no longer use it.
+ * Parameters:
+ *      channel: channel
+ * Return: CC_SUCCESS, success; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_channel_destroy(cc_channel_t *channel);
+
+/*
+ * Summary: Get the shared memory of the channel, which is to be handed to the enclave.
+ * Parameters:
+ *      channel: channel
+ *      addr: start address of the shared memory
+ *      len: length of the shared memory
+ * Return: CC_SUCCESS, success; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_channel_get_shared_memory(cc_channel_t *channel, void **addr, size_t *len);
+
+/*
+ * Summary: Send up to count records without blocking.
+ * Parameters:
+ *      channel: channel
+ *      records: records to send
+ *      lens: length of each record, no more than the slot size
+ *      count: number of records
+ *      sent: number of records actually sent, less than count if the channel is full
+ * Return: CC_SUCCESS, success; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_channel_send_batch(cc_channel_t *channel, const void *const *records,
+    const uint32_t *lens, uint32_t count, uint32_t *sent);
+
+/*
+ * Summary: Receive up to count records without blocking.
+ * Parameters:
+ *      channel: channel
+ *      bufs: buffers to receive the records, each of them holds at least the slot size
+ *      lens: length of each received record
+ *      count: number of buffers
+ *      received: number of records actually received, less than count if the channel is empty
+ * Return: CC_SUCCESS, success; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_channel_recv_batch(cc_channel_t *channel, void *const *bufs, uint32_t *lens,
+    uint32_t count, uint32_t *received);
+
+/*
+ * Summary: Send one record, waiting up to timeout_ms while the channel is full. The waiting thread spins first and
+ *          then sleeps on the doorbell of the channel.
+ * Parameters:
+ *      channel: channel
+ *      record: record to send
+ *      len: record length, no more than the slot size
+ *      timeout_ms: 0 returns at once, CC_CHANNEL_WAIT_FOREVER never times out
+ * Return: CC_SUCCESS, success; CC_ERROR_BUSY, the channel is full; CC_ERROR_TIMEOUT, timed out; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_channel_send(cc_channel_t *channel, const void *record, uint32_t len,
+    uint32_t timeout_ms);
+
+/*
+ * Summary: Receive one record, waiting up to timeout_ms while the channel is empty.
+ * Parameters:
+ *      channel: channel
+ *      buf: buffer to receive the record
+ *      buf_len: buffer length, no less than the slot size
+ *      len: length of the received record
+ *      timeout_ms: 0 returns at once, CC_CHANNEL_WAIT_FOREVER never times out
+ * Return: CC_SUCCESS, success; CC_ERROR_BUSY, the channel is empty; CC_ERROR_TIMEOUT, timed out; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_channel_recv(cc_channel_t *channel, void *buf, uint32_t buf_len, uint32_t *len,
+    uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
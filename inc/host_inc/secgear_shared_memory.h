@@ -22,6 +22,19 @@ extern "C" {
 #endif
 
 
+typedef enum {
+    CC_SHARED_MEMORY_FLAG_HUGE_PAGE = 0x1, /* back the buffer with 2 MiB pages */
+    CC_SHARED_MEMORY_FLAG_NUMA_BIND = 0x2, /* bind the buffer to the NUMA node in numa_node */
+} cc_shared_memory_flag_t;
+
+#define CC_SHARED_MEMORY_FLAG_MASK (CC_SHARED_MEMORY_FLAG_HUGE_PAGE | CC_SHARED_MEMORY_FLAG_NUMA_BIND)
+#define CC_SHARED_MEMORY_MAX_NUMA_NODE 1023
+
+typedef struct _cc_shared_memory_attr {
+    uint32_t flags; /* bitwise or of cc_shared_memory_flag_t */
+    int numa_node; /* only valid with CC_SHARED_MEMORY_FLAG_NUMA_BIND */
+} cc_shared_memory_attr_t;
+
 /*
  * Summary: Allocate size bytes and returns a pointer to the allocated memory.
  * Parameters:
@@ -32,7 +45,20 @@ extern "C" {
 CC_API_SPEC void *cc_malloc_shared_memory(cc_enclave_t *enclave, size_t size);
 
 /*
- * Summary: Frees the memory space pointed to by ptr, which must have been returned by cc_malloc_shared_memory.
+ * Summary: Allocate size bytes with the backing described by attr. The memory is allocated by secGear and
+ *          registered to the driver where the driver permits, otherwise the attributes are best effort.
+ * Parameters:
+ *      enclave: enclave
+ *      size: buffer length
+ *      attr: backing attributes, NULL is the same as cc_malloc_shared_memory
+ * Return: A pointer to the allocated memory On error, return NULL.
+ */
+CC_API_SPEC void *cc_malloc_shared_memory_with_attr(cc_enclave_t *enclave, size_t size,
+    const cc_shared_memory_attr_t *attr);
+
+/*
+ * Summary: Frees the memory space pointed to by ptr, which must have been returned by cc_malloc_shared_memory or
+ *          cc_malloc_shared_memory_with_attr.
  * Parameters:
  *     enclave: enclave
  *     ptr: buffer address
@@ -40,6 +66,65 @@ CC_API_SPEC void *cc_malloc_shared_memory(cc_enclave_t *enclave, size_t size);
  */
 CC_API_SPEC cc_enclave_result_t cc_free_shared_memory(cc_enclave_t *enclave, void *ptr);
 
+/*
+ * A shared memory arena is one large buffer allocated and registered by cc_malloc_shared_memory once. Small buffers
+ * are then served from per-thread power-of-two size classes (64 B to 1 MiB) inside it without any lock or ecall,
+ * because the enclave already knows the whole arena.
+ */
+typedef struct _shared_memory_arena cc_shared_memory_arena_t;
+
+#define CC_SHARED_MEMORY_ARENA_MAX_ALLOC_SIZE (1024 * 1024)
+
+/*
+ * Summary: Allocate and register an arena of at least size bytes.
+ * Parameters:
+ *      enclave: enclave, it must outlive the arena
+ *      size: arena length
+ *      arena: the created arena
+ * Return: CC_SUCCESS, success; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_create_shared_memory_arena(cc_enclave_t *enclave, size_t size,
+    cc_shared_memory_arena_t **arena);
+
+/*
+ * Summary: Same as cc_create_shared_memory_arena, the arena is backed as described by attr.
+ * Parameters:
+ *      enclave: enclave, it must outlive the arena
+ *      size: arena length
+ *      attr: backing attributes, may be NULL
+ *      arena: the created arena
+ * Return: CC_SUCCESS, success; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_create_shared_memory_arena_with_attr(cc_enclave_t *enclave, size_t size,
+    const cc_shared_memory_attr_t *attr, cc_shared_memory_arena_t **arena);
+
+/*
+ * Summary: Release the arena, all buffers allocated from it become invalid. No other thread may use the arena
+ *          while it is destroyed.
+ * Parameters:
+ *      arena: arena
+ * Return: CC_SUCCESS, success; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_destroy_shared_memory_arena(cc_shared_memory_arena_t *arena);
+
+/*
+ * Summary: Allocate size bytes of registered shared memory from the arena.
+ * Parameters:
+ *      arena: arena
+ *      size: buffer length, no more than CC_SHARED_MEMORY_ARENA_MAX_ALLOC_SIZE
+ * Return: A pointer to the allocated memory. On error or if the arena is exhausted, return NULL.
+ */
+CC_API_SPEC void *cc_arena_malloc_shared_memory(cc_shared_memory_arena_t *arena, size_t size);
+
+/*
+ * Summary: Frees the memory space pointed to by ptr, which must have been returned by cc_arena_malloc_shared_memory.
+ * Parameters:
+ *      arena: arena
+ *      ptr: buffer address
+ * Return: CC_SUCCESS, success; others failed.
+ */
+CC_API_SPEC cc_enclave_result_t cc_arena_free_shared_memory(cc_shared_memory_arena_t *arena, void *ptr);
+
 
 #ifdef __cplusplus
 }
@@ -123,6 +123,9 @@ typedef enum _enclave_result_t
     CC_ERROR_SEC_CHL_ENCLAVE_UNSEAL_ENC_KEY,
     CC_ERROR_SEC_CHL_INVALID_SESSION,
     CC_ERROR_SEC_CHL_INIT_SESSEION,
+    CC_ERROR_SEC_CHL_REPLAY,                /* the message has been received or is older than the replay window */
+    CC_ERROR_SEC_CHL_TICKET_INVALID,        /* the resumption ticket is expired or not issued by the enclave */
+    CC_ERROR_SEC_CHL_ALGO_NOT_SUPPORTED,    /* the cipher suite is not supported by the crypto library of either side */
 
     CC_ERROR_OTRP_BASE = 0x80000100,  /* sec file config source is not inconsistent with the loading mode. */
     CC_ERROR_STORAGE_EIO        = 0x80001001, /* *<安全存储I/O错误 */
@@ -40,6 +40,7 @@ cc_enclave_result_t conversion_res_status(uint32_t enclave_res)
         if (enclave_res < sizeof(result_table1) / sizeof(cc_enclave_result_t)) {
             return result_table1[enclave_res];
         }
+        return enclave_res;
     } else if (enclave_res < res_table3_begin) {
         return CC_ERROR_OTRP_BASE;
     } else if (enclave_res > res_table4_begin && enclave_res < res_table5_begin) {
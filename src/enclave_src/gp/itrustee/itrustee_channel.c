@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "secgear_tchannel.h"
+
+#include <stdlib.h>
+#include "tee_log.h"
+#include "secgear_channel_defs.h"
+#include "itrustee_shared_memory.h"
+
+struct _cc_channel {
+    channel_ring_t ring;
+};
+
+cc_enclave_result_t cc_channel_attach(uint64_t host_addr, size_t len, uint32_t capacity, uint32_t slot_size,
+    cc_channel_t **channel)
+{
+    if (host_addr == 0 || channel == NULL || !channel_ring_geometry_valid(capacity, slot_size, 0)) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    // The whole ring must lie inside memory registered by the host, or the host could point it at the TA
+    void *buf = (void *)addr_host_range_to_enclave((size_t)host_addr, len);
+    if (buf == NULL) {
+        SLogError("The channel is not inside registered shared memory");
+        return CC_ERROR_SHARED_MEMORY_NOT_REGISTERED;
+    }
+
+    cc_channel_t *tmp = (cc_channel_t *)calloc(1, sizeof(cc_channel_t));
+    if (tmp == NULL) {
+        return CC_ERROR_OUT_OF_MEMORY;
+    }
+    // The receive buffers of the caller are sized by the geometry it expects, not by what the host advertises
+    if (!channel_ring_attach(&tmp->ring, buf, len, capacity, slot_size)) {
+        SLogError("The channel does not have the expected geometry");
+        free(tmp);
+        return CC_ERROR_BAD_FORMAT;
+    }
+
+    *channel = tmp;
+    return CC_SUCCESS;
+}
+
+void cc_channel_detach(cc_channel_t *channel)
+{
+    free(channel);
+}
+
+cc_enclave_result_t cc_channel_send_batch(cc_channel_t *channel, const void *const *records, const uint32_t *lens,
+    uint32_t count, uint32_t *sent)
+{
+    if (channel == NULL || records == NULL || lens == NULL || sent == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        if (records[i] == NULL || lens[i] > channel->ring.slot_size) {
+            return CC_ERROR_BAD_PARAMETERS;
+        }
+    }
+
+    *sent = channel_ring_enqueue(&channel->ring, records, lens, count);
+    if (*sent != 0) {
+        (void)channel_ring_doorbell(&channel->ring);
+    }
+    return CC_SUCCESS;
+}
+
+cc_enclave_result_t cc_channel_recv_batch(cc_channel_t *channel, void *const *bufs, uint32_t *lens, uint32_t count,
+    uint32_t *received)
+{
+    if (channel == NULL || bufs == NULL || lens == NULL || received == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        if (bufs[i] == NULL) {
+            return CC_ERROR_BAD_PARAMETERS;
+        }
+    }
+
+    *received = channel_ring_dequeue(&channel->ring, bufs, lens, count);
+    if (*received != 0) {
+        (void)channel_ring_doorbell(&channel->ring);
+    }
+    return CC_SUCCESS;
+}
+
+cc_enclave_result_t cc_channel_send(cc_channel_t *channel, const void *record, uint32_t len)
+{
+    uint32_t sent = 0;
+
+    cc_enclave_result_t ret = cc_channel_send_batch(channel, &record, &len, 1, &sent);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    return sent == 1 ? CC_SUCCESS : CC_ERROR_BUSY;
+}
+
+cc_enclave_result_t cc_channel_recv(cc_channel_t *channel, void *buf, uint32_t buf_len, uint32_t *len)
+{
+    uint32_t received = 0;
+
+    if (channel == NULL || buf_len < channel->ring.slot_size) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    cc_enclave_result_t ret = cc_channel_recv_batch(channel, &buf, len, 1, &received);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    return received == 1 ? CC_SUCCESS : CC_ERROR_BUSY;
+}
@@ -11,6 +11,8 @@
  */
 
 #include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
 #include "tee_mem_mgmt_api.h"
 #include "tee_crypto_api.h"
 #include "dataseal_internal.h"
@@ -100,28 +102,15 @@ TEE_Result itrustee_seal_data(uint8_t *seal_data, uint32_t seal_data_len, void *
 {
     TEE_Result result;
     itrustee_seal_data_t *tmp_sealed_data = (itrustee_seal_data_t *)sealed_data;
-    uint8_t *key_buf = NULL;
-    uint8_t *salt = NULL;
-    key_buf = (uint8_t *)TEE_Malloc(SEAL_KEY_LEN, 0);
-    if (key_buf == NULL) {
-        return TEE_ERROR_OUT_OF_MEMORY;
-    }
-    salt = (uint8_t *)TEE_Malloc(SEAL_KEY_SALT_LEN, 0);
-    if (salt == NULL) {
-        result = TEE_ERROR_OUT_OF_MEMORY;
-        goto error2;
-    }
+    uint8_t key_buf[SEAL_KEY_LEN];
+    uint8_t salt[SEAL_KEY_SALT_LEN];
+    uint8_t nonce[SEAL_DATA_NONCE_LEN];
+
     TEE_GenerateRandom(salt, SEAL_KEY_SALT_LEN);
     result = TEE_EXT_DeriveTARootKey((const uint8_t *)salt, SEAL_KEY_SALT_LEN, key_buf, SEAL_KEY_LEN);
     if (result != TEE_SUCCESS) {
         SLogError("DeriveTARootKey failed");
-        goto error1;
-    }
-    uint8_t *nonce = NULL;
-    nonce = (uint8_t *)TEE_Malloc(SEAL_DATA_NONCE_LEN, 0);
-    if (nonce == NULL) {
-        result = TEE_ERROR_OUT_OF_MEMORY;
-        goto error1;
+        goto done;
     }
     TEE_GenerateRandom(nonce, SEAL_DATA_NONCE_LEN);
 
@@ -133,50 +122,63 @@ TEE_Result itrustee_seal_data(uint8_t *seal_data, uint32_t seal_data_len, void *
                     (uint8_t *)&(tmp_sealed_data->tag), (uint32_t *)&(tmp_sealed_data->tag_len));
     if (result != TEE_SUCCESS) {
         SLogError("aes_seal_unseal_data failed");
-        goto error0;
+        goto done;
     }
 
     result = data_copy(tmp_sealed_data, salt, nonce, mac_data, mac_data_len);
 
-error0:
+done:
     explicit_bzero(nonce, SEAL_DATA_NONCE_LEN);
-    TEE_Free(nonce);
-error1:
     explicit_bzero(salt, SEAL_KEY_SALT_LEN);
-    TEE_Free(salt);
-error2:
     explicit_bzero(key_buf, SEAL_KEY_LEN);
-    TEE_Free(key_buf);
     return result;
 }
 
-TEE_Result aes_seal_unseal_data(uint8_t *key_buf, uint32_t key_len, uint8_t *nonce, uint32_t nonce_len, uint32_t mode,
-    uint8_t *src_data, uint32_t src_len, uint8_t *dest_data, uint32_t *dest_len, uint8_t *tag, uint32_t *tag_len)
+/* allocate an AES-GCM operation of the mode and set the key into it, the key buffer is no longer needed after */
+static TEE_Result alloc_keyed_operation(uint8_t *key_buf, uint32_t key_len, uint32_t mode,
+    TEE_OperationHandle *crypto_ops)
 {
     TEE_Result ret;
     TEE_ObjectHandle key_object;
-    TEE_OperationHandle crypto_ops = NULL;
     key_object = generate_obj(key_buf, key_len);
     if (NULL == key_object) {
         SLogError("importKey failed\n");
         return TEE_ERROR_BAD_PARAMETERS;
     }
 
-    ret = TEE_AllocateOperation(&crypto_ops, TEE_ALG_AES_GCM, mode, SEAL_MAX_OBJ_LEN);
+    ret = TEE_AllocateOperation(crypto_ops, TEE_ALG_AES_GCM, mode, SEAL_MAX_OBJ_LEN);
     if (TEE_SUCCESS != ret) {
         SLogError("TEE_AllocateOperation, fail %x\n", ret);
         goto error;
     }
 
-    ret = TEE_SetOperationKey(crypto_ops, key_object);
+    ret = TEE_SetOperationKey(*crypto_ops, key_object);
     if (TEE_SUCCESS != ret) {
         SLogError("TEE_SetOperationKey, fail %x\n", ret);
-        goto error2;
+        TEE_FreeOperation(*crypto_ops);
+        *crypto_ops = NULL;
     }
-    ret = TEE_AEInit(crypto_ops, nonce, nonce_len, SEAL_DATA_TAG_BIT_LEN, 0, src_len);
+
+error:
+    TEE_FreeTransientObject(key_object);
+    return ret;
+}
+
+/*
+ * one AEAD pass with a keyed operation, which is back in its initial state with the key set afterwards,
+ * so that it serves the next record after TEE_AEInit with a new nonce
+ */
+static TEE_Result aes_gcm_final(TEE_OperationHandle crypto_ops, uint8_t *nonce, uint32_t nonce_len, uint32_t mode,
+    uint8_t *aad, uint32_t aad_len, uint8_t *src_data, uint32_t src_len, uint8_t *dest_data, uint32_t *dest_len,
+    uint8_t *tag, uint32_t *tag_len)
+{
+    TEE_Result ret = TEE_AEInit(crypto_ops, nonce, nonce_len, SEAL_DATA_TAG_BIT_LEN, aad_len, src_len);
     if (TEE_SUCCESS != ret) {
         SLogError("TEE_AEInit failed, ret %x\n", ret);
-        goto error2;
+        return ret;
+    }
+    if (aad_len != 0) {
+        TEE_AEUpdateAAD(crypto_ops, aad, aad_len);
     }
 
     size_t temp_dest_len = *dest_len;
@@ -186,27 +188,52 @@ TEE_Result aes_seal_unseal_data(uint8_t *key_buf, uint32_t key_len, uint8_t *non
         if (TEE_SUCCESS != ret) {
             SLogError("TEE_AEEncryptFinal failed, ret %x\n", ret);
             *dest_len = 0;
-            goto error2;
         }
     } else if (TEE_MODE_DECRYPT == mode) {
         ret = TEE_AEDecryptFinal(crypto_ops, src_data, src_len, dest_data, &temp_dest_len, tag, temp_tag_len);
         if (TEE_SUCCESS != ret) {
             SLogError("TEE_AEDecryptFinal failed, ret %x\n", ret);
             *dest_len = 0;
-            goto error2;
         }
     } else {
         SLogError("invalid mode %d\n", mode);
         ret = TEE_ERROR_BAD_PARAMETERS;
     }
+    return ret;
+}
+
+TEE_Result aes_seal_unseal_data(uint8_t *key_buf, uint32_t key_len, uint8_t *nonce, uint32_t nonce_len, uint32_t mode,
+    uint8_t *src_data, uint32_t src_len, uint8_t *dest_data, uint32_t *dest_len, uint8_t *tag, uint32_t *tag_len)
+{
+    TEE_OperationHandle crypto_ops = NULL;
+    TEE_Result ret = alloc_keyed_operation(key_buf, key_len, mode, &crypto_ops);
+    if (ret != TEE_SUCCESS) {
+        return ret;
+    }
 
-error2:
+    ret = aes_gcm_final(crypto_ops, nonce, nonce_len, mode, NULL, 0, src_data, src_len, dest_data, dest_len,
+        tag, tag_len);
     TEE_FreeOperation(crypto_ops);
-error:
-    TEE_FreeTransientObject(key_object);
     return ret;
 }
 
+/* copy out the additional text after the encrypted data of an unsealed record */
+static TEE_Result copy_mac_data(itrustee_seal_data_t *tmp_sealed_data, uint8_t *mac_data, uint32_t *mac_data_len)
+{
+    uint32_t temp_mac_len = *mac_data_len;
+    if (temp_mac_len < tmp_sealed_data->aad_len) {
+        return TEE_ERROR_WRITE_DATA;
+    }
+    if (mac_data != NULL) {
+        uint32_t encrypted_data_len = tmp_sealed_data->encrypted_data_len;
+        if (*mac_data_len  >= tmp_sealed_data->aad_len) {
+            memcpy(mac_data, &(tmp_sealed_data->payload_data[encrypted_data_len]), tmp_sealed_data->aad_len);
+        }
+        *mac_data_len = tmp_sealed_data->aad_len;
+    }
+    return TEE_SUCCESS;
+}
+
 TEE_Result itrustee_unseal_data(void *sealed_data, uint8_t *decrypted_data, uint32_t *decrypted_data_len,
     uint8_t *mac_data, uint32_t *mac_data_len)
 {
@@ -214,13 +241,8 @@ TEE_Result itrustee_unseal_data(void *sealed_data, uint8_t *decrypted_data, uint
     itrustee_seal_data_t *tmp_sealed_data = (itrustee_seal_data_t *)sealed_data;
 
     uint8_t *salt = (uint8_t *)&(tmp_sealed_data->salt);
-    char *key_buf = NULL;
+    uint8_t key_buf[SEAL_KEY_LEN];
     uint32_t key_len = SEAL_KEY_LEN;
-    key_buf = (char *)TEE_Malloc(key_len, 0);
-    if (key_buf == NULL) {
-        SLogError("malloc key_buf failed\n");
-        return TEE_ERROR_OUT_OF_MEMORY;
-    }
     result = TEE_EXT_DeriveTARootKey(salt, SEAL_KEY_SALT_LEN, key_buf, key_len);
     if (result != TEE_SUCCESS) {
         SLogError("DeriveTARootKey failed");
@@ -237,21 +259,219 @@ TEE_Result itrustee_unseal_data(void *sealed_data, uint8_t *decrypted_data, uint
         goto done;
     }
 
-    uint32_t temp_mac_len = *mac_data_len;
-    if (temp_mac_len < tmp_sealed_data->aad_len) {
-        result = TEE_ERROR_WRITE_DATA;
-        goto done;
+    result = copy_mac_data(tmp_sealed_data, mac_data, mac_data_len);
+
+done:
+    explicit_bzero(key_buf, SEAL_KEY_LEN);
+    return result;
+}
+
+typedef struct {
+    uint8_t salt[SEAL_KEY_SALT_LEN];
+    TEE_OperationHandle crypto_ops; // keyed by the key derived from salt, NULL if the slot is empty
+} itrustee_seal_key_t;
+
+/*
+ * A sealing context derives the TA root key once per salt and keeps it inside a keyed operation, so a seal or an
+ * unseal is one AEAD pass. The salt of sealing is renewed after max_seal_num records to bound the use of a key
+ * under random nonces, the salts of unsealing are the most recently seen ones. The sealed format is unchanged.
+ */
+struct _enclave_seal_ctx {
+    pthread_mutex_t lock;
+    uint32_t max_seal_num;
+    uint32_t seal_num; // records sealed by the current key
+    itrustee_seal_key_t seal_key;
+    itrustee_seal_key_t unseal_keys[SEAL_CTX_UNSEAL_KEY_NUM];
+    uint32_t unseal_cursor; // next slot to replace
+};
+
+static TEE_Result derive_seal_key(itrustee_seal_key_t *seal_key, uint8_t *salt, uint32_t mode)
+{
+    uint8_t key_buf[SEAL_KEY_LEN];
+    TEE_Result result = TEE_EXT_DeriveTARootKey(salt, SEAL_KEY_SALT_LEN, key_buf, SEAL_KEY_LEN);
+    if (result != TEE_SUCCESS) {
+        SLogError("DeriveTARootKey failed");
+        explicit_bzero(key_buf, SEAL_KEY_LEN);
+        return result;
     }
-    if (mac_data != NULL) {
-        uint32_t encrypted_data_len = tmp_sealed_data->encrypted_data_len;
-        if (*mac_data_len  >= tmp_sealed_data->aad_len) {
-            memcpy(mac_data, &(tmp_sealed_data->payload_data[encrypted_data_len]), tmp_sealed_data->aad_len);
+    result = alloc_keyed_operation(key_buf, SEAL_KEY_LEN, mode, &seal_key->crypto_ops);
+    explicit_bzero(key_buf, SEAL_KEY_LEN);
+    if (result != TEE_SUCCESS) {
+        return result;
+    }
+    memcpy(seal_key->salt, salt, SEAL_KEY_SALT_LEN);
+    return TEE_SUCCESS;
+}
+
+static void free_seal_key(itrustee_seal_key_t *seal_key)
+{
+    if (seal_key->crypto_ops != NULL) {
+        TEE_FreeOperation(seal_key->crypto_ops);
+        seal_key->crypto_ops = NULL;
+    }
+    explicit_bzero(seal_key->salt, SEAL_KEY_SALT_LEN);
+}
+
+TEE_Result itrustee_seal_ctx_create(uint32_t max_seal_num, struct _enclave_seal_ctx **ctx)
+{
+    struct _enclave_seal_ctx *tmp = (struct _enclave_seal_ctx *)TEE_Malloc(sizeof(struct _enclave_seal_ctx), 0);
+    if (tmp == NULL) {
+        return TEE_ERROR_OUT_OF_MEMORY;
+    }
+    if (pthread_mutex_init(&tmp->lock, NULL) != 0) {
+        TEE_Free(tmp);
+        return TEE_ERROR_GENERIC;
+    }
+    tmp->max_seal_num = max_seal_num == 0 ? SEAL_CTX_DEFAULT_MAX_SEAL_NUM : max_seal_num;
+    *ctx = tmp;
+    return TEE_SUCCESS;
+}
+
+void itrustee_seal_ctx_destroy(struct _enclave_seal_ctx *ctx)
+{
+    free_seal_key(&ctx->seal_key);
+    for (uint32_t i = 0; i < SEAL_CTX_UNSEAL_KEY_NUM; i++) {
+        free_seal_key(&ctx->unseal_keys[i]);
+    }
+    (void)pthread_mutex_destroy(&ctx->lock);
+    TEE_Free(ctx);
+}
+
+TEE_Result itrustee_seal_data_ctx(struct _enclave_seal_ctx *ctx, uint8_t *seal_data, uint32_t seal_data_len,
+    void *sealed_data, uint32_t sealed_data_len, uint8_t *mac_data, uint32_t mac_data_len)
+{
+    (void)sealed_data_len;
+    TEE_Result result = TEE_SUCCESS;
+    itrustee_seal_data_t *tmp_sealed_data = (itrustee_seal_data_t *)sealed_data;
+    uint8_t nonce[SEAL_DATA_NONCE_LEN];
+    uint8_t salt[SEAL_KEY_SALT_LEN];
+
+    TEE_GenerateRandom(nonce, SEAL_DATA_NONCE_LEN);
+    tmp_sealed_data->encrypted_data_len = seal_data_len;
+    tmp_sealed_data->tag_len = SEAL_DATA_TAG_LEN;
+
+    (void)pthread_mutex_lock(&ctx->lock);
+    if (ctx->seal_key.crypto_ops == NULL || ctx->seal_num >= ctx->max_seal_num) {
+        free_seal_key(&ctx->seal_key);
+        TEE_GenerateRandom(salt, SEAL_KEY_SALT_LEN);
+        result = derive_seal_key(&ctx->seal_key, salt, TEE_MODE_ENCRYPT);
+        ctx->seal_num = 0;
+    }
+    if (result == TEE_SUCCESS) {
+        ctx->seal_num++;
+        memcpy(salt, ctx->seal_key.salt, SEAL_KEY_SALT_LEN);
+        result = aes_gcm_final(ctx->seal_key.crypto_ops, nonce, SEAL_DATA_NONCE_LEN, TEE_MODE_ENCRYPT, NULL, 0,
+            seal_data, seal_data_len, (uint8_t *)&(tmp_sealed_data->payload_data),
+            (uint32_t *)&(tmp_sealed_data->encrypted_data_len), (uint8_t *)&(tmp_sealed_data->tag),
+            (uint32_t *)&(tmp_sealed_data->tag_len));
+        if (result != TEE_SUCCESS) {
+            // the state of a failed operation is unknown, derive again for the next record
+            free_seal_key(&ctx->seal_key);
         }
-        *mac_data_len = tmp_sealed_data->aad_len;
     }
+    (void)pthread_mutex_unlock(&ctx->lock);
 
-done:
-    explicit_bzero(key_buf, SEAL_KEY_LEN);
-    TEE_Free(key_buf);
+    if (result == TEE_SUCCESS) {
+        result = data_copy(tmp_sealed_data, salt, nonce, mac_data, mac_data_len);
+    }
+    explicit_bzero(nonce, SEAL_DATA_NONCE_LEN);
+    explicit_bzero(salt, SEAL_KEY_SALT_LEN);
     return result;
 }
+
+static itrustee_seal_key_t *get_unseal_key(struct _enclave_seal_ctx *ctx, uint8_t *salt, TEE_Result *result)
+{
+    for (uint32_t i = 0; i < SEAL_CTX_UNSEAL_KEY_NUM; i++) {
+        itrustee_seal_key_t *key = &ctx->unseal_keys[i];
+        if (key->crypto_ops != NULL && memcmp(key->salt, salt, SEAL_KEY_SALT_LEN) == 0) {
+            return key;
+        }
+    }
+
+    itrustee_seal_key_t *key = &ctx->unseal_keys[ctx->unseal_cursor];
+    ctx->unseal_cursor = (ctx->unseal_cursor + 1) % SEAL_CTX_UNSEAL_KEY_NUM;
+    free_seal_key(key);
+    *result = derive_seal_key(key, salt, TEE_MODE_DECRYPT);
+    return *result == TEE_SUCCESS ? key : NULL;
+}
+
+TEE_Result itrustee_unseal_data_ctx(struct _enclave_seal_ctx *ctx, void *sealed_data, uint8_t *decrypted_data,
+    uint32_t *decrypted_data_len, uint8_t *mac_data, uint32_t *mac_data_len)
+{
+    TEE_Result result = TEE_SUCCESS;
+    itrustee_seal_data_t *tmp_sealed_data = (itrustee_seal_data_t *)sealed_data;
+
+    *decrypted_data_len = tmp_sealed_data->encrypted_data_len;
+    *mac_data_len = tmp_sealed_data->aad_len;
+
+    (void)pthread_mutex_lock(&ctx->lock);
+    itrustee_seal_key_t *key = get_unseal_key(ctx, (uint8_t *)&(tmp_sealed_data->salt), &result);
+    if (key != NULL) {
+        result = aes_gcm_final(key->crypto_ops, (uint8_t *)&(tmp_sealed_data->nonce), SEAL_DATA_NONCE_LEN,
+            TEE_MODE_DECRYPT, NULL, 0, (uint8_t *)&(tmp_sealed_data->payload_data), tmp_sealed_data->encrypted_data_len,
+            decrypted_data, decrypted_data_len, (uint8_t *)&(tmp_sealed_data->tag),
+            (uint32_t *)&(tmp_sealed_data->tag_len));
+        if (result != TEE_SUCCESS) {
+            free_seal_key(key);
+        }
+    }
+    (void)pthread_mutex_unlock(&ctx->lock);
+    if (result != TEE_SUCCESS) {
+        SLogError("AES unseal data failed\n");
+        return result;
+    }
+
+    return copy_mac_data(tmp_sealed_data, mac_data, mac_data_len);
+}
+
+/* AES-GCM under a data key, both directions keep a keyed operation */
+struct _enclave_seal_aead {
+    TEE_OperationHandle enc_ops;
+    TEE_OperationHandle dec_ops;
+};
+
+TEE_Result itrustee_seal_aead_init(uint8_t *key, struct _enclave_seal_aead **aead)
+{
+    struct _enclave_seal_aead *tmp = (struct _enclave_seal_aead *)TEE_Malloc(sizeof(struct _enclave_seal_aead), 0);
+    if (tmp == NULL) {
+        return TEE_ERROR_OUT_OF_MEMORY;
+    }
+    TEE_Result result = alloc_keyed_operation(key, SEAL_STREAM_KEY_LEN, TEE_MODE_ENCRYPT, &tmp->enc_ops);
+    if (result != TEE_SUCCESS) {
+        TEE_Free(tmp);
+        return result;
+    }
+    result = alloc_keyed_operation(key, SEAL_STREAM_KEY_LEN, TEE_MODE_DECRYPT, &tmp->dec_ops);
+    if (result != TEE_SUCCESS) {
+        TEE_FreeOperation(tmp->enc_ops);
+        TEE_Free(tmp);
+        return result;
+    }
+    *aead = tmp;
+    return TEE_SUCCESS;
+}
+
+void itrustee_seal_aead_free(struct _enclave_seal_aead *aead)
+{
+    TEE_FreeOperation(aead->enc_ops);
+    TEE_FreeOperation(aead->dec_ops);
+    TEE_Free(aead);
+}
+
+TEE_Result itrustee_seal_aead_encrypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad, uint32_t aad_len,
+    uint8_t *src, uint32_t src_len, uint8_t *dest, uint8_t *tag)
+{
+    uint32_t dest_len = src_len;
+    uint32_t tag_len = SEAL_DATA_TAG_LEN;
+    return aes_gcm_final(aead->enc_ops, nonce, SEAL_DATA_NONCE_LEN, TEE_MODE_ENCRYPT, aad, aad_len, src, src_len,
+        dest, &dest_len, tag, &tag_len);
+}
+
+TEE_Result itrustee_seal_aead_decrypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad, uint32_t aad_len,
+    uint8_t *src, uint32_t src_len, uint8_t *dest, uint8_t *tag)
+{
+    uint32_t dest_len = src_len;
+    uint32_t tag_len = SEAL_DATA_TAG_LEN;
+    return aes_gcm_final(aead->dec_ops, nonce, SEAL_DATA_NONCE_LEN, TEE_MODE_DECRYPT, aad, aad_len, src, src_len,
+        dest, &dest_len, tag, &tag_len);
+}
@@ -14,10 +14,12 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <sched.h>
 #include "gp.h"
 #include "status.h"
 #include "secgear_log.h"
 #include "itrustee_tswitchless.h"
+#include "itrustee_shared_memory.h"
 #include "gp_shared_memory_defs.h"
 #include "secgear_list.h"
 #include "secgear_defs.h"
@@ -39,6 +41,152 @@ static list_node_t g_shared_memory_list = {
     .prev = &g_shared_memory_list
 };
 
+/*
+ * Read-mostly copy of the list sorted by host address, so that a translation is a binary search without any lock.
+ * Writers rebuild and publish a new index under the list write lock, and free the old one once no reader slot
+ * refers to it any more. A NULL index makes readers fall back to walking the list under the read lock.
+ */
+typedef struct {
+    size_t host_addr;
+    size_t enclave_addr;
+    size_t buf_len;
+} shared_memory_range_t;
+
+typedef struct {
+    size_t num;
+    shared_memory_range_t ranges[];
+} shared_memory_index_t;
+
+#define MAX_INDEX_READER_SLOTS 64
+#define CACHE_LINE_SIZE 64
+
+typedef struct {
+    shared_memory_index_t *index; // index in use by the owner thread, NULL when idle
+    bool in_use;
+} __attribute__((aligned(CACHE_LINE_SIZE))) index_reader_slot_t;
+
+static shared_memory_index_t *g_shared_memory_index = NULL;
+static index_reader_slot_t g_index_reader_slots[MAX_INDEX_READER_SLOTS];
+static pthread_key_t g_index_reader_key;
+static pthread_once_t g_index_reader_key_once = PTHREAD_ONCE_INIT;
+static bool g_index_reader_key_valid = false;
+
+static void release_index_reader_slot(void *slot)
+{
+    __atomic_store_n(&((index_reader_slot_t *)slot)->in_use, false, __ATOMIC_RELEASE);
+}
+
+static void create_index_reader_key(void)
+{
+    g_index_reader_key_valid = (pthread_key_create(&g_index_reader_key, release_index_reader_slot) == 0);
+}
+
+static index_reader_slot_t *get_index_reader_slot(void)
+{
+    (void)pthread_once(&g_index_reader_key_once, create_index_reader_key);
+    if (!g_index_reader_key_valid) {
+        return NULL;
+    }
+
+    index_reader_slot_t *slot = (index_reader_slot_t *)pthread_getspecific(g_index_reader_key);
+    if (slot != NULL) {
+        return slot;
+    }
+
+    for (size_t i = 0; i < MAX_INDEX_READER_SLOTS; ++i) {
+        bool expected = false;
+        slot = &g_index_reader_slots[i];
+        if (__atomic_compare_exchange_n(&slot->in_use, &expected, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            if (pthread_setspecific(g_index_reader_key, slot) != 0) {
+                release_index_reader_slot(slot);
+                return NULL;
+            }
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static int compare_shared_memory_range(const void *a, const void *b)
+{
+    size_t addr_a = ((const shared_memory_range_t *)a)->host_addr;
+    size_t addr_b = ((const shared_memory_range_t *)b)->host_addr;
+    return (addr_a > addr_b) - (addr_a < addr_b);
+}
+
+/* Must be called with the list write lock held */
+static void rebuild_shared_memory_index(void)
+{
+    list_node_t *cur = NULL;
+    shared_memory_block_t *mem_block = NULL;
+    size_t num = 0;
+
+    list_for_each(cur, &g_shared_memory_list) {
+        ++num;
+    }
+
+    shared_memory_index_t *new_index = NULL;
+    if (num > 0) {
+        new_index = malloc(sizeof(shared_memory_index_t) + num * sizeof(shared_memory_range_t));
+    }
+    if (new_index != NULL) {
+        new_index->num = 0;
+        list_for_each(cur, &g_shared_memory_list) {
+            mem_block = list_entry(cur, shared_memory_block_t, node);
+            new_index->ranges[new_index->num].host_addr = mem_block->host_addr;
+            new_index->ranges[new_index->num].enclave_addr = mem_block->enclave_addr;
+            new_index->ranges[new_index->num].buf_len = mem_block->buf_len;
+            ++new_index->num;
+        }
+        qsort(new_index->ranges, new_index->num, sizeof(shared_memory_range_t), compare_shared_memory_range);
+    }
+
+    shared_memory_index_t *old_index = __atomic_exchange_n(&g_shared_memory_index, new_index, __ATOMIC_SEQ_CST);
+    if (old_index == NULL) {
+        return;
+    }
+
+    // Grace period: wait until no reader still holds the old index
+    for (size_t i = 0; i < MAX_INDEX_READER_SLOTS; ++i) {
+        while (__atomic_load_n(&g_index_reader_slots[i].index, __ATOMIC_SEQ_CST) == old_index) {
+            (void)sched_yield();
+        }
+    }
+    free(old_index);
+}
+
+/* A range lies inside a block if it starts inside and does not run past its end */
+static bool is_range_in_block(size_t block_addr, size_t block_len, size_t host_addr, size_t len)
+{
+    return host_addr >= block_addr && host_addr - block_addr < block_len && len <= block_len - (host_addr - block_addr);
+}
+
+static size_t lookup_shared_memory_index(const shared_memory_index_t *index, size_t host_addr, size_t len)
+{
+    size_t low = 0;
+    size_t high = index->num;
+
+    // Find the last range which starts at or below host_addr
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (index->ranges[mid].host_addr <= host_addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == 0) {
+        return 0;
+    }
+
+    const shared_memory_range_t *range = &index->ranges[low - 1];
+    if (is_range_in_block(range->host_addr, range->buf_len, host_addr, len)) {
+        return range->enclave_addr + (host_addr - range->host_addr);
+    }
+    return 0;
+}
+
 static shared_memory_block_t *create_shared_memory_block(void *host_buf, size_t host_buf_len, const void *register_buf)
 {
     shared_memory_block_t *shared_mem = calloc(1, sizeof(shared_memory_block_t));
@@ -70,6 +218,7 @@ static void add_shared_memory_block_to_list(const shared_memory_block_t *shared_
 {
     CC_RWLOCK_LOCK_WR(&g_shared_memory_list_lock);
     list_add_after(&shared_mem->node, &g_shared_memory_list);
+    rebuild_shared_memory_index();
     CC_RWLOCK_UNLOCK(&g_shared_memory_list_lock);
 }
 
@@ -77,6 +226,7 @@ static void remove_shared_memory_block_from_list(const shared_memory_block_t *sh
 {
     CC_RWLOCK_LOCK_WR(&g_shared_memory_list_lock);
     list_remove(&shared_mem->node);
+    rebuild_shared_memory_index();
     CC_RWLOCK_UNLOCK(&g_shared_memory_list_lock);
 }
 
@@ -156,17 +306,35 @@ cc_enclave_result_t ecall_register_shared_memory(uint8_t *in_buf,
     return CC_SUCCESS;
 }
 
-size_t addr_host_to_enclave(size_t host_addr)
+size_t addr_host_range_to_enclave(size_t host_addr, size_t len)
 {
     list_node_t *cur = NULL;
     shared_memory_block_t *mem_block = NULL;
+    shared_memory_index_t *index = NULL;
     size_t ptr = 0;
 
+    index_reader_slot_t *slot = get_index_reader_slot();
+    if (slot != NULL) {
+        // Announce the index before using it, and retry if it was replaced in between
+        do {
+            index = __atomic_load_n(&g_shared_memory_index, __ATOMIC_ACQUIRE);
+            __atomic_store_n(&slot->index, index, __ATOMIC_SEQ_CST);
+        } while (index != __atomic_load_n(&g_shared_memory_index, __ATOMIC_SEQ_CST));
+
+        if (index != NULL) {
+            ptr = lookup_shared_memory_index(index, host_addr, len);
+            __atomic_store_n(&slot->index, NULL, __ATOMIC_RELEASE);
+            return ptr;
+        }
+        __atomic_store_n(&slot->index, NULL, __ATOMIC_RELEASE);
+    }
+
+    /* Too many reader threads or no index was built, walk the list instead */
     CC_RWLOCK_LOCK_RD(&g_shared_memory_list_lock);
 
     list_for_each(cur, &g_shared_memory_list) {
         mem_block = list_entry(cur, shared_memory_block_t, node);
-        if ((host_addr >= mem_block->host_addr) && (host_addr < (mem_block->host_addr + mem_block->buf_len))) {
+        if (is_range_in_block(mem_block->host_addr, mem_block->buf_len, host_addr, len)) {
             ptr = mem_block->enclave_addr + (host_addr - mem_block->host_addr);
             break;
         }
@@ -177,6 +345,11 @@ size_t addr_host_to_enclave(size_t host_addr)
     return ptr;
 }
 
+size_t addr_host_to_enclave(size_t host_addr)
+{
+    return addr_host_range_to_enclave(host_addr, 1);
+}
+
 static cc_enclave_result_t itrustee_unregister_shared_memory(size_t host_addr)
 {
     cc_enclave_result_t ret = CC_ERROR_ITEM_NOT_FOUND;
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef __ITRUSTEE_SHARED_MEMORY_H__
+#define __ITRUSTEE_SHARED_MEMORY_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Summary: Translate a host address inside registered shared memory to the TA side address
+ * Parameters:
+ *     host_addr: memory address on the CA side
+ * Return: TA side address, 0 if the address is not inside registered shared memory
+ */
+size_t addr_host_to_enclave(size_t host_addr);
+
+/*
+ * Summary: Translate a host memory range which lies within one registered shared memory to the TA side address
+ * Parameters:
+ *     host_addr: start address of the range on the CA side
+ *     len: length of the range
+ * Return: TA side address of the range, 0 if the range is not inside one registered shared memory
+ */
+size_t addr_host_range_to_enclave(size_t host_addr, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -47,3 +47,33 @@ uint32_t penglai_unseal_data(void *sealed_data, uint8_t *decrypted_data,
     return CC_ERROR_NOT_SUPPORTED;
 }
 
+uint32_t penglai_seal_ctx_create(uint32_t max_seal_num, struct _enclave_seal_ctx **ctx)
+{
+    /* Penglai does not support this API now */
+    return CC_ERROR_NOT_SUPPORTED;
+}
+
+void penglai_seal_ctx_destroy(struct _enclave_seal_ctx *ctx)
+{
+    /* Penglai does not support this API now */
+    return;
+}
+
+uint32_t penglai_seal_aead_init(uint8_t *key, struct _enclave_seal_aead **aead)
+{
+    /* Penglai does not support this API now */
+    return CC_ERROR_NOT_SUPPORTED;
+}
+
+void penglai_seal_aead_free(struct _enclave_seal_aead *aead)
+{
+    /* Penglai does not support this API now */
+    return;
+}
+
+uint32_t penglai_seal_aead_crypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad, uint32_t aad_len,
+    uint8_t *src, uint32_t src_len, uint8_t *dest, uint8_t *tag)
+{
+    /* Penglai does not support this API now */
+    return CC_ERROR_NOT_SUPPORTED;
+}
@@ -69,6 +69,31 @@ uint32_t cc_enclave_get_add_text_size(const cc_enclave_sealed_data_t *sealed_dat
     return get_add_text_size_ex(sealed_data->data_body);
 }
 
+static cc_enclave_result_t check_seal_param(uint8_t *seal_data, uint32_t seal_data_len,
+    cc_enclave_sealed_data_t *sealed_data, uint32_t sealed_data_len, uint8_t *additional_text,
+    uint32_t additional_text_len, uint32_t *real_sealed_data_len)
+{
+    /* check parameters */
+    if (seal_data == NULL || seal_data_len == 0) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (sealed_data == NULL || sealed_data_len == 0) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (additional_text == NULL && additional_text_len != 0) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (sealed_data->data_body == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    *real_sealed_data_len = cc_enclave_get_sealed_data_size(additional_text_len, seal_data_len);
+    if (*real_sealed_data_len > sealed_data_len) {
+        return CC_ERROR_SHORT_BUFFER;
+    }
+    return CC_SUCCESS;
+}
+
 /*
  * cc_enclave_seal_data seal the plain text and storage to sealed_data
  * buffer with the additional text
@@ -87,23 +112,10 @@ cc_enclave_result_t cc_enclave_seal_data(uint8_t *seal_data, uint32_t seal_data_
     cc_enclave_result_t ret;
     uint32_t ret_ex;
     uint32_t real_sealed_data_len;
-    /* check parameters */
-    if (seal_data == NULL || seal_data_len == 0) {
-        return CC_ERROR_BAD_PARAMETERS;
-    }
-    if (sealed_data == NULL || sealed_data_len == 0) {
-        return CC_ERROR_BAD_PARAMETERS;
-    }
-    if (additional_text == NULL && additional_text_len != 0) {
-        return CC_ERROR_BAD_PARAMETERS;
-    }
-    if (sealed_data->data_body == NULL) {
-        return CC_ERROR_BAD_PARAMETERS;
-    }
-
-    real_sealed_data_len = cc_enclave_get_sealed_data_size(additional_text_len, seal_data_len);
-    if (real_sealed_data_len > sealed_data_len) {
-        return CC_ERROR_SHORT_BUFFER;
+    ret = check_seal_param(seal_data, seal_data_len, sealed_data, sealed_data_len, additional_text,
+        additional_text_len, &real_sealed_data_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
     }
     memset(sealed_data, 0, real_sealed_data_len);
     ret_ex = SEAL_DATA_FN(seal_data, seal_data_len, sealed_data->data_body,
@@ -117,11 +129,9 @@ cc_enclave_result_t cc_enclave_seal_data(uint8_t *seal_data, uint32_t seal_data_
     return ret;
 }
 
-
-cc_enclave_result_t cc_enclave_unseal_data(cc_enclave_sealed_data_t *sealed_data, uint8_t *decrypted_data,
+static cc_enclave_result_t check_unseal_param(cc_enclave_sealed_data_t *sealed_data, uint8_t *decrypted_data,
     uint32_t *decrypted_data_len, uint8_t *additional_text, uint32_t *additional_text_len)
 {
-    cc_enclave_result_t ret;
     if (sealed_data == NULL) {
         return CC_ERROR_BAD_PARAMETERS;
     }
@@ -141,6 +151,17 @@ cc_enclave_result_t cc_enclave_unseal_data(cc_enclave_sealed_data_t *sealed_data
     if (*additional_text_len < real_add_text_len) {
         return CC_ERROR_SHORT_BUFFER;
     }
+    return CC_SUCCESS;
+}
+
+cc_enclave_result_t cc_enclave_unseal_data(cc_enclave_sealed_data_t *sealed_data, uint8_t *decrypted_data,
+    uint32_t *decrypted_data_len, uint8_t *additional_text, uint32_t *additional_text_len)
+{
+    cc_enclave_result_t ret;
+    ret = check_unseal_param(sealed_data, decrypted_data, decrypted_data_len, additional_text, additional_text_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
     ret = UNSEAL_DATA_FN(sealed_data->data_body, decrypted_data, decrypted_data_len, additional_text,
         additional_text_len);
     if (ret != CC_SUCCESS) {
@@ -148,3 +169,218 @@ cc_enclave_result_t cc_enclave_unseal_data(cc_enclave_sealed_data_t *sealed_data
     }
     return ret;
 }
+
+/*
+ * cc_enclave_seal_ctx_create create a sealing context
+ *
+ * param max_seal_num	[IN] records sealed by one key before a new key is derived, 0 for the default
+ * param ctx	[OUT] the created sealing context
+ */
+cc_enclave_result_t cc_enclave_seal_ctx_create(uint32_t max_seal_num, cc_enclave_seal_ctx_t **ctx)
+{
+    if (ctx == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    return conversion_res_status(SEAL_CTX_CREATE_FN(max_seal_num, ctx));
+}
+
+void cc_enclave_seal_ctx_destroy(cc_enclave_seal_ctx_t *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+    SEAL_CTX_DESTROY_FN(ctx);
+}
+
+/*
+ * cc_enclave_seal_data_with_ctx works as cc_enclave_seal_data, with the key cached by the sealing context
+ *
+ * param ctx	[IN] sealing context
+ */
+cc_enclave_result_t cc_enclave_seal_data_with_ctx(cc_enclave_seal_ctx_t *ctx, uint8_t *seal_data,
+    uint32_t seal_data_len, cc_enclave_sealed_data_t *sealed_data, uint32_t sealed_data_len,
+    uint8_t *additional_text, uint32_t additional_text_len)
+{
+    cc_enclave_result_t ret;
+    uint32_t real_sealed_data_len;
+    if (ctx == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    ret = check_seal_param(seal_data, seal_data_len, sealed_data, sealed_data_len, additional_text,
+        additional_text_len, &real_sealed_data_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    memset(sealed_data, 0, real_sealed_data_len);
+    ret = conversion_res_status(SEAL_DATA_CTX_FN(ctx, seal_data, seal_data_len, sealed_data->data_body,
+        real_sealed_data_len - (uint32_t)sizeof(cc_enclave_sealed_data_t), additional_text, additional_text_len));
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    sealed_data->data_body_len = real_sealed_data_len;
+
+    return ret;
+}
+
+/*
+ * cc_enclave_unseal_data_with_ctx works as cc_enclave_unseal_data, with the keys cached by the sealing context
+ *
+ * param ctx	[IN] sealing context
+ */
+cc_enclave_result_t cc_enclave_unseal_data_with_ctx(cc_enclave_seal_ctx_t *ctx, cc_enclave_sealed_data_t *sealed_data,
+    uint8_t *decrypted_data, uint32_t *decrypted_data_len, uint8_t *additional_text, uint32_t *additional_text_len)
+{
+    cc_enclave_result_t ret;
+    if (ctx == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    ret = check_unseal_param(sealed_data, decrypted_data, decrypted_data_len, additional_text, additional_text_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    return conversion_res_status(UNSEAL_DATA_CTX_FN(ctx, sealed_data->data_body, decrypted_data, decrypted_data_len,
+        additional_text, additional_text_len));
+}
+
+#define SEAL_BATCH_ALIGN_UP(len) (((len) + CC_SEAL_BATCH_ALIGN - 1) & ~(uint32_t)(CC_SEAL_BATCH_ALIGN - 1))
+
+/* total length of the packed sealed records, UINT32_MAX on overflow */
+static uint32_t get_sealed_batch_size(cc_enclave_seal_record_t *records, uint32_t rec_num)
+{
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < rec_num; i++) {
+        uint32_t len = cc_enclave_get_sealed_data_size(records[i].additional_text_len, records[i].data_len);
+        if (len >= UINT32_MAX - CC_SEAL_BATCH_ALIGN || SEAL_BATCH_ALIGN_UP(len) >= UINT32_MAX - total) {
+            return UINT32_MAX;
+        }
+        total += SEAL_BATCH_ALIGN_UP(len);
+    }
+    return total;
+}
+
+/*
+ * cc_enclave_seal_data_batch seal an array of records into one buffer
+ *
+ * param ctx	[IN] sealing context, NULL for a temporary one
+ * param records	[IN] records to seal
+ * param rec_num	[IN] number of records
+ * param sealed_buf	[OUT] buffer of the packed sealed records
+ * param sealed_buf_len	[IN/OUT] size of sealed_buf, returns the length of the packed records,
+ *                               or the required size with CC_ERROR_SHORT_BUFFER
+ * param offsets	[OUT] offset of each sealed record in sealed_buf
+ * param status	[OUT] result of each record
+ *
+ * retval CC_SUCCESS	means all records are sealed, otherwise the status of the first failed record
+ */
+cc_enclave_result_t cc_enclave_seal_data_batch(cc_enclave_seal_ctx_t *ctx, cc_enclave_seal_record_t *records,
+    uint32_t rec_num, uint8_t *sealed_buf, uint32_t *sealed_buf_len, uint32_t *offsets, cc_enclave_result_t *status)
+{
+    cc_enclave_result_t ret = CC_SUCCESS;
+    cc_enclave_seal_ctx_t *tmp_ctx = ctx;
+    if (records == NULL || rec_num == 0 || sealed_buf == NULL || sealed_buf_len == NULL || offsets == NULL ||
+        status == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    uint32_t total = get_sealed_batch_size(records, rec_num);
+    if (total == UINT32_MAX) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (*sealed_buf_len < total) {
+        *sealed_buf_len = total;
+        return CC_ERROR_SHORT_BUFFER;
+    }
+    if (tmp_ctx == NULL) {
+        ret = cc_enclave_seal_ctx_create(0, &tmp_ctx);
+        if (ret != CC_SUCCESS) {
+            return ret;
+        }
+    }
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < rec_num; i++) {
+        uint32_t len = cc_enclave_get_sealed_data_size(records[i].additional_text_len, records[i].data_len);
+        offsets[i] = offset;
+        status[i] = cc_enclave_seal_data_with_ctx(tmp_ctx, records[i].data, records[i].data_len,
+            (cc_enclave_sealed_data_t *)(sealed_buf + offset), len, records[i].additional_text,
+            records[i].additional_text_len);
+        if (status[i] != CC_SUCCESS && ret == CC_SUCCESS) {
+            ret = status[i];
+        }
+        offset += SEAL_BATCH_ALIGN_UP(len);
+    }
+    *sealed_buf_len = offset;
+
+    if (ctx == NULL) {
+        cc_enclave_seal_ctx_destroy(tmp_ctx);
+    }
+    return ret;
+}
+
+static cc_enclave_result_t check_batch_record(uint8_t *sealed_buf, uint32_t sealed_buf_len, uint32_t offset)
+{
+    if (offset % CC_SEAL_BATCH_ALIGN != 0 || offset >= sealed_buf_len ||
+        sealed_buf_len - offset < (uint32_t)sizeof(cc_enclave_sealed_data_t)) {
+        return CC_ERROR_BAD_FORMAT;
+    }
+    // the fixed header of the platform, which holds the lengths read below, must lie inside the record
+    uint32_t header_len = cc_enclave_get_sealed_data_size(0, 0);
+    cc_enclave_sealed_data_t *sealed_data = (cc_enclave_sealed_data_t *)(sealed_buf + offset);
+    if (header_len == UINT32_MAX || sealed_buf_len - offset < header_len || sealed_data->data_body_len < header_len ||
+        sealed_data->data_body_len > sealed_buf_len - offset) {
+        return CC_ERROR_BAD_FORMAT;
+    }
+    // the lengths inside the record must not reach beyond the record
+    uint32_t real_len = cc_enclave_get_sealed_data_size(cc_enclave_get_add_text_size(sealed_data),
+        cc_enclave_get_encrypted_text_size(sealed_data));
+    if (real_len > sealed_data->data_body_len) {
+        return CC_ERROR_BAD_FORMAT;
+    }
+    return CC_SUCCESS;
+}
+
+/*
+ * cc_enclave_unseal_data_batch unseal an array of records packed in one buffer
+ *
+ * param ctx	[IN] sealing context, NULL for a temporary one
+ * param sealed_buf	[IN] buffer of the packed sealed records
+ * param sealed_buf_len	[IN] length of sealed_buf
+ * param offsets	[IN] offset of each sealed record in sealed_buf
+ * param rec_num	[IN] number of records
+ * param records	[IN/OUT] buffers of the unsealed records
+ * param status	[OUT] result of each record
+ *
+ * retval CC_SUCCESS	means all records are unsealed, otherwise the status of the first failed record
+ */
+cc_enclave_result_t cc_enclave_unseal_data_batch(cc_enclave_seal_ctx_t *ctx, uint8_t *sealed_buf,
+    uint32_t sealed_buf_len, uint32_t *offsets, uint32_t rec_num, cc_enclave_seal_record_t *records,
+    cc_enclave_result_t *status)
+{
+    cc_enclave_result_t ret = CC_SUCCESS;
+    cc_enclave_seal_ctx_t *tmp_ctx = ctx;
+    if (sealed_buf == NULL || offsets == NULL || rec_num == 0 || records == NULL || status == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (tmp_ctx == NULL) {
+        ret = cc_enclave_seal_ctx_create(0, &tmp_ctx);
+        if (ret != CC_SUCCESS) {
+            return ret;
+        }
+    }
+
+    for (uint32_t i = 0; i < rec_num; i++) {
+        status[i] = check_batch_record(sealed_buf, sealed_buf_len, offsets[i]);
+        if (status[i] == CC_SUCCESS) {
+            status[i] = cc_enclave_unseal_data_with_ctx(tmp_ctx,
+                (cc_enclave_sealed_data_t *)(sealed_buf + offsets[i]), records[i].data, &records[i].data_len,
+                records[i].additional_text, &records[i].additional_text_len);
+        }
+        if (status[i] != CC_SUCCESS && ret == CC_SUCCESS) {
+            ret = status[i];
+        }
+    }
+
+    if (ctx == NULL) {
+        cc_enclave_seal_ctx_destroy(tmp_ctx);
+    }
+    return ret;
+}
@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ * http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "secgear_dataseal.h"
+#include "secgear_random.h"
+#include "dataseal_internal.h"
+#include "error_conversion.h"
+
+#define SEAL_STREAM_MAGIC 0x54535353U /* "SSST" */
+#define SEAL_STREAM_VERSION 1
+#define SEAL_STREAM_NONCE_LEN 12
+#define SEAL_STREAM_CHUNK_AAD_LEN 16
+
+/* the nonce is a domain followed by an index, so that chunk, chain and final tags never share a nonce */
+typedef enum {
+    SEAL_STREAM_NONCE_CHUNK = 0,
+    SEAL_STREAM_NONCE_CHAIN,
+    SEAL_STREAM_NONCE_FINAL,
+} seal_stream_nonce_domain_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunk_size;
+    uint32_t wrapped_key_len;
+    uint8_t wrapped_key[]; // data key sealed by cc_enclave_seal_data
+} seal_stream_header_t;
+
+struct _enclave_seal_stream {
+    struct _enclave_seal_aead *aead;
+    bool is_seal;
+    bool is_last; // a chunk shorter than chunk_size was processed, no more chunk may follow
+    uint32_t chunk_size;
+    uint64_t chunk_num;
+    uint64_t total_len;
+    uint8_t chain[CC_SEAL_STREAM_TAG_LEN]; // tag chained over the tags of the processed chunks
+};
+
+static void put_u32(uint8_t *buf, uint32_t val)
+{
+    for (int i = 0; i < (int)sizeof(uint32_t); i++) {
+        buf[i] = (uint8_t)(val >> (i * 8));
+    }
+}
+
+static void put_u64(uint8_t *buf, uint64_t val)
+{
+    for (int i = 0; i < (int)sizeof(uint64_t); i++) {
+        buf[i] = (uint8_t)(val >> (i * 8));
+    }
+}
+
+static uint64_t get_u64(const uint8_t *buf)
+{
+    uint64_t val = 0;
+    for (int i = (int)sizeof(uint64_t) - 1; i >= 0; i--) {
+        val = (val << 8) | buf[i];
+    }
+    return val;
+}
+
+static void make_nonce(uint8_t *nonce, seal_stream_nonce_domain_t domain, uint64_t index)
+{
+    put_u32(nonce, (uint32_t)domain);
+    put_u64(nonce + sizeof(uint32_t), index);
+}
+
+/* a chunk is bound to its position and to the geometry of the stream */
+static void make_chunk_aad(uint8_t *aad, uint32_t chunk_size, uint64_t index)
+{
+    put_u32(aad, SEAL_STREAM_VERSION);
+    put_u32(aad + sizeof(uint32_t), chunk_size);
+    put_u64(aad + sizeof(uint32_t) * 2, index);
+}
+
+static uint32_t get_wrapped_key_len(void)
+{
+    return cc_enclave_get_sealed_data_size(0, SEAL_STREAM_KEY_LEN);
+}
+
+/* chain = GMAC(chain || tag of the chunk) */
+static cc_enclave_result_t update_chain(cc_enclave_seal_stream_t *stream, uint8_t *tag)
+{
+    uint8_t nonce[SEAL_STREAM_NONCE_LEN];
+    uint8_t aad[CC_SEAL_STREAM_TAG_LEN * 2];
+
+    make_nonce(nonce, SEAL_STREAM_NONCE_CHAIN, stream->chunk_num);
+    memcpy(aad, stream->chain, CC_SEAL_STREAM_TAG_LEN);
+    memcpy(aad + CC_SEAL_STREAM_TAG_LEN, tag, CC_SEAL_STREAM_TAG_LEN);
+    return conversion_res_status(SEAL_AEAD_ENCRYPT_FN(stream->aead, nonce, aad, sizeof(aad), NULL, 0, NULL,
+        stream->chain));
+}
+
+/* aad of the final tag: chain || total_len || chunk_num */
+static void make_final_aad(cc_enclave_seal_stream_t *stream, uint8_t *aad, uint64_t total_len, uint64_t chunk_num)
+{
+    memcpy(aad, stream->chain, CC_SEAL_STREAM_TAG_LEN);
+    put_u64(aad + CC_SEAL_STREAM_TAG_LEN, total_len);
+    put_u64(aad + CC_SEAL_STREAM_TAG_LEN + sizeof(uint64_t), chunk_num);
+}
+
+static cc_enclave_result_t new_stream(uint8_t *key, uint32_t chunk_size, bool is_seal,
+    cc_enclave_seal_stream_t **stream)
+{
+    cc_enclave_seal_stream_t *tmp = (cc_enclave_seal_stream_t *)calloc(1, sizeof(cc_enclave_seal_stream_t));
+    if (tmp == NULL) {
+        return CC_ERROR_OUT_OF_MEMORY;
+    }
+    cc_enclave_result_t ret = conversion_res_status(SEAL_AEAD_INIT_FN(key, &tmp->aead));
+    if (ret != CC_SUCCESS) {
+        free(tmp);
+        return ret;
+    }
+    tmp->is_seal = is_seal;
+    tmp->chunk_size = chunk_size;
+    *stream = tmp;
+    return CC_SUCCESS;
+}
+
+/*
+ * cc_enclave_get_seal_stream_header_size used to get the size of
+ * the header of a sealed stream
+ *
+ * retval UINT32_MAX    means function fails
+ * retvel others        means function success
+ */
+uint32_t cc_enclave_get_seal_stream_header_size(void)
+{
+    uint32_t wrapped_key_len = get_wrapped_key_len();
+    if (wrapped_key_len >= UINT32_MAX - (uint32_t)sizeof(seal_stream_header_t)) {
+        return UINT32_MAX;
+    }
+    return (uint32_t)sizeof(seal_stream_header_t) + wrapped_key_len;
+}
+
+/*
+ * cc_enclave_seal_stream_init start sealing a stream under a new data key
+ *
+ * param chunk_size	[IN] plain text length of each chunk, no more than CC_SEAL_STREAM_MAX_CHUNK_SIZE
+ * param header	[OUT] buffer of the stream header
+ * param header_len	[IN] size of the header buffer, at least cc_enclave_get_seal_stream_header_size()
+ * param stream	[OUT] the sealing stream
+ */
+cc_enclave_result_t cc_enclave_seal_stream_init(uint32_t chunk_size, uint8_t *header, uint32_t header_len,
+    cc_enclave_seal_stream_t **stream)
+{
+    uint8_t key[SEAL_STREAM_KEY_LEN];
+    if (chunk_size == 0 || chunk_size > CC_SEAL_STREAM_MAX_CHUNK_SIZE || header == NULL || stream == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    uint32_t real_header_len = cc_enclave_get_seal_stream_header_size();
+    if (real_header_len == UINT32_MAX) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (header_len < real_header_len) {
+        return CC_ERROR_SHORT_BUFFER;
+    }
+
+    cc_enclave_result_t ret = cc_enclave_generate_random(key, SEAL_STREAM_KEY_LEN);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    seal_stream_header_t *hdr = (seal_stream_header_t *)header;
+    hdr->magic = SEAL_STREAM_MAGIC;
+    hdr->version = SEAL_STREAM_VERSION;
+    hdr->chunk_size = chunk_size;
+    hdr->wrapped_key_len = get_wrapped_key_len();
+    ret = cc_enclave_seal_data(key, SEAL_STREAM_KEY_LEN, (cc_enclave_sealed_data_t *)hdr->wrapped_key,
+        hdr->wrapped_key_len, NULL, 0);
+    if (ret == CC_SUCCESS) {
+        ret = new_stream(key, chunk_size, true, stream);
+    }
+    memset(key, 0, SEAL_STREAM_KEY_LEN);
+    return ret;
+}
+
+/*
+ * cc_enclave_seal_stream_update seal the next chunk, every chunk but the last one
+ * holds exactly chunk_size bytes
+ *
+ * param stream	[IN] the sealing stream
+ * param plain	[IN] plain text of the chunk
+ * param plain_len	[IN] plain text length, no more than chunk_size
+ * param sealed	[OUT] buffer of the sealed chunk
+ * param sealed_len	[IN/OUT] size of the sealed buffer, at least plain_len + CC_SEAL_STREAM_TAG_LEN,
+ *                           returns the length of the sealed chunk
+ */
+cc_enclave_result_t cc_enclave_seal_stream_update(cc_enclave_seal_stream_t *stream, uint8_t *plain,
+    uint32_t plain_len, uint8_t *sealed, uint32_t *sealed_len)
+{
+    uint8_t nonce[SEAL_STREAM_NONCE_LEN];
+    uint8_t aad[SEAL_STREAM_CHUNK_AAD_LEN];
+    if (stream == NULL || plain == NULL || plain_len == 0 || sealed == NULL || sealed_len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (!stream->is_seal || stream->is_last || plain_len > stream->chunk_size) {
+        return CC_ERROR_BAD_STATE;
+    }
+    if (*sealed_len < plain_len + CC_SEAL_STREAM_TAG_LEN) {
+        *sealed_len = plain_len + CC_SEAL_STREAM_TAG_LEN;
+        return CC_ERROR_SHORT_BUFFER;
+    }
+
+    make_nonce(nonce, SEAL_STREAM_NONCE_CHUNK, stream->chunk_num);
+    make_chunk_aad(aad, stream->chunk_size, stream->chunk_num);
+    uint8_t *tag = sealed + plain_len;
+    cc_enclave_result_t ret = conversion_res_status(SEAL_AEAD_ENCRYPT_FN(stream->aead, nonce, aad, sizeof(aad),
+        plain, plain_len, sealed, tag));
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    ret = update_chain(stream, tag);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    stream->chunk_num++;
+    stream->total_len += plain_len;
+    stream->is_last = plain_len < stream->chunk_size;
+    *sealed_len = plain_len + CC_SEAL_STREAM_TAG_LEN;
+    return CC_SUCCESS;
+}
+
+/*
+ * cc_enclave_seal_stream_final finish sealing the stream with the trailer
+ *
+ * param stream	[IN] the sealing stream, no more chunk can be sealed afterwards
+ * param trailer	[OUT] buffer of the trailer
+ * param trailer_len	[IN] size of the trailer buffer, at least CC_SEAL_STREAM_TRAILER_LEN
+ */
+cc_enclave_result_t cc_enclave_seal_stream_final(cc_enclave_seal_stream_t *stream, uint8_t *trailer,
+    uint32_t trailer_len)
+{
+    uint8_t nonce[SEAL_STREAM_NONCE_LEN];
+    uint8_t aad[CC_SEAL_STREAM_TAG_LEN + sizeof(uint64_t) * 2];
+    if (stream == NULL || trailer == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (!stream->is_seal) {
+        return CC_ERROR_BAD_STATE;
+    }
+    if (trailer_len < CC_SEAL_STREAM_TRAILER_LEN) {
+        return CC_ERROR_SHORT_BUFFER;
+    }
+
+    make_nonce(nonce, SEAL_STREAM_NONCE_FINAL, 0);
+    make_final_aad(stream, aad, stream->total_len, stream->chunk_num);
+    cc_enclave_result_t ret = conversion_res_status(SEAL_AEAD_ENCRYPT_FN(stream->aead, nonce, aad, sizeof(aad),
+        NULL, 0, NULL, trailer + sizeof(uint64_t) * 2));
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    put_u64(trailer, stream->total_len);
+    put_u64(trailer + sizeof(uint64_t), stream->chunk_num);
+    stream->is_last = true;
+    return CC_SUCCESS;
+}
+
+/*
+ * cc_enclave_unseal_stream_init start unsealing a stream by its header
+ *
+ * param header	[IN] the stream header
+ * param header_len	[IN] size of the header
+ * param stream	[OUT] the unsealing stream
+ */
+cc_enclave_result_t cc_enclave_unseal_stream_init(uint8_t *header, uint32_t header_len,
+    cc_enclave_seal_stream_t **stream)
+{
+    uint8_t key[SEAL_STREAM_KEY_LEN];
+    uint32_t key_len = SEAL_STREAM_KEY_LEN;
+    uint32_t add_len = 0;
+    if (header == NULL || stream == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    uint32_t real_header_len = cc_enclave_get_seal_stream_header_size();
+    if (real_header_len == UINT32_MAX || header_len < real_header_len) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    seal_stream_header_t *hdr = (seal_stream_header_t *)header;
+    if (hdr->magic != SEAL_STREAM_MAGIC || hdr->version != SEAL_STREAM_VERSION || hdr->chunk_size == 0 ||
+        hdr->chunk_size > CC_SEAL_STREAM_MAX_CHUNK_SIZE || hdr->wrapped_key_len != get_wrapped_key_len()) {
+        return CC_ERROR_BAD_FORMAT;
+    }
+
+    cc_enclave_result_t ret = cc_enclave_unseal_data((cc_enclave_sealed_data_t *)hdr->wrapped_key, key, &key_len,
+        NULL, &add_len);
+    if (ret == CC_SUCCESS && key_len != SEAL_STREAM_KEY_LEN) {
+        ret = CC_ERROR_BAD_FORMAT;
+    }
+    if (ret == CC_SUCCESS) {
+        ret = new_stream(key, hdr->chunk_size, false, stream);
+    }
+    memset(key, 0, SEAL_STREAM_KEY_LEN);
+    return ret;
+}
+
+static cc_enclave_result_t unseal_chunk(cc_enclave_seal_stream_t *stream, uint64_t index, uint8_t *sealed,
+    uint32_t sealed_len, uint8_t *plain, uint32_t *plain_len)
+{
+    uint8_t nonce[SEAL_STREAM_NONCE_LEN];
+    uint8_t aad[SEAL_STREAM_CHUNK_AAD_LEN];
+    if (sealed_len <= CC_SEAL_STREAM_TAG_LEN || sealed_len - CC_SEAL_STREAM_TAG_LEN > stream->chunk_size) {
+        return CC_ERROR_BAD_FORMAT;
+    }
+    uint32_t len = sealed_len - CC_SEAL_STREAM_TAG_LEN;
+    if (*plain_len < len) {
+        *plain_len = len;
+        return CC_ERROR_SHORT_BUFFER;
+    }
+
+    make_nonce(nonce, SEAL_STREAM_NONCE_CHUNK, index);
+    make_chunk_aad(aad, stream->chunk_size, index);
+    cc_enclave_result_t ret = conversion_res_status(SEAL_AEAD_DECRYPT_FN(stream->aead, nonce, aad, sizeof(aad),
+        sealed, len, plain, sealed + len));
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    *plain_len = len;
+    return CC_SUCCESS;
+}
+
+/*
+ * cc_enclave_unseal_stream_update unseal the next chunk in order
+ *
+ * param stream	[IN] the unsealing stream
+ * param sealed	[IN] the sealed chunk
+ * param sealed_len	[IN] length of the sealed chunk
+ * param plain	[OUT] buffer of the plain text
+ * param plain_len	[IN/OUT] size of the plain text buffer, returns the plain text length
+ */
+cc_enclave_result_t cc_enclave_unseal_stream_update(cc_enclave_seal_stream_t *stream, uint8_t *sealed,
+    uint32_t sealed_len, uint8_t *plain, uint32_t *plain_len)
+{
+    if (stream == NULL || sealed == NULL || plain == NULL || plain_len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (stream->is_seal || stream->is_last) {
+        return CC_ERROR_BAD_STATE;
+    }
+
+    cc_enclave_result_t ret = unseal_chunk(stream, stream->chunk_num, sealed, sealed_len, plain, plain_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    ret = update_chain(stream, sealed + *plain_len);
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    stream->chunk_num++;
+    stream->total_len += *plain_len;
+    stream->is_last = *plain_len < stream->chunk_size;
+    return CC_SUCCESS;
+}
+
+/*
+ * cc_enclave_unseal_stream_chunk unseal any chunk by its index, without the other chunks.
+ * Only the chunk itself is authenticated, the completeness of the stream is checked by
+ * the in order unsealing up to cc_enclave_unseal_stream_final
+ *
+ * param stream	[IN] the unsealing stream
+ * param index	[IN] index of the chunk, which starts at header size + index * (chunk_size + CC_SEAL_STREAM_TAG_LEN)
+ * param sealed	[IN] the sealed chunk
+ * param sealed_len	[IN] length of the sealed chunk
+ * param plain	[OUT] buffer of the plain text
+ * param plain_len	[IN/OUT] size of the plain text buffer, returns the plain text length
+ */
+cc_enclave_result_t cc_enclave_unseal_stream_chunk(cc_enclave_seal_stream_t *stream, uint64_t index,
+    uint8_t *sealed, uint32_t sealed_len, uint8_t *plain, uint32_t *plain_len)
+{
+    if (stream == NULL || sealed == NULL || plain == NULL || plain_len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (stream->is_seal) {
+        return CC_ERROR_BAD_STATE;
+    }
+    return unseal_chunk(stream, index, sealed, sealed_len, plain, plain_len);
+}
+
+/*
+ * cc_enclave_unseal_stream_final check the trailer against the chunks unsealed in order
+ *
+ * param stream	[IN] the unsealing stream
+ * param trailer	[IN] the trailer
+ * param trailer_len	[IN] length of the trailer
+ *
+ * retval CC_SUCCESS	means all chunks of the stream are unsealed in order
+ */
+cc_enclave_result_t cc_enclave_unseal_stream_final(cc_enclave_seal_stream_t *stream, uint8_t *trailer,
+    uint32_t trailer_len)
+{
+    uint8_t nonce[SEAL_STREAM_NONCE_LEN];
+    uint8_t aad[CC_SEAL_STREAM_TAG_LEN + sizeof(uint64_t) * 2];
+    if (stream == NULL || trailer == NULL || trailer_len < CC_SEAL_STREAM_TRAILER_LEN) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    if (stream->is_seal) {
+        return CC_ERROR_BAD_STATE;
+    }
+    if (get_u64(trailer) != stream->total_len || get_u64(trailer + sizeof(uint64_t)) != stream->chunk_num) {
+        return CC_ERROR_MAC_INVALID;
+    }
+
+    make_nonce(nonce, SEAL_STREAM_NONCE_FINAL, 0);
+    make_final_aad(stream, aad, stream->total_len, stream->chunk_num);
+    cc_enclave_result_t ret = conversion_res_status(SEAL_AEAD_DECRYPT_FN(stream->aead, nonce, aad, sizeof(aad),
+        NULL, 0, NULL, trailer + sizeof(uint64_t) * 2));
+    if (ret != CC_SUCCESS) {
+        return ret;
+    }
+    stream->is_last = true;
+    return CC_SUCCESS;
+}
+
+uint32_t cc_enclave_seal_stream_get_chunk_size(const cc_enclave_seal_stream_t *stream)
+{
+    if (stream == NULL) {
+        return 0;
+    }
+    return stream->chunk_size;
+}
+
+void cc_enclave_seal_stream_free(cc_enclave_seal_stream_t *stream)
+{
+    if (stream == NULL) {
+        return;
+    }
+    SEAL_AEAD_FREE_FN(stream->aead);
+    memset(stream, 0, sizeof(cc_enclave_seal_stream_t));
+    free(stream);
+}
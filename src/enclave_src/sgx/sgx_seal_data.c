@@ -10,6 +10,7 @@
  * See the Mulan PSL v2 for more details.
  */
 #include <stdint.h>
+#include <stdlib.h>
 #include "dataseal_internal.h"
 
 
@@ -49,3 +50,65 @@ sgx_status_t internel_sgx_unseal_data(void *sealed_data, uint8_t *decrypted_data
     return result;
 }
 
+/*
+ * sgx_seal_data derives the seal key from a fresh key id inside the sealed data for every record, so there is
+ * nothing to cache, the context only makes the sealing context interface available under SGX
+ */
+struct _enclave_seal_ctx {
+    uint32_t max_seal_num;
+};
+
+sgx_status_t internel_sgx_seal_ctx_create(uint32_t max_seal_num, struct _enclave_seal_ctx **ctx)
+{
+    struct _enclave_seal_ctx *tmp = (struct _enclave_seal_ctx *)calloc(1, sizeof(struct _enclave_seal_ctx));
+    if (tmp == NULL) {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+    tmp->max_seal_num = max_seal_num;
+    *ctx = tmp;
+    return SGX_SUCCESS;
+}
+
+void internel_sgx_seal_ctx_destroy(struct _enclave_seal_ctx *ctx)
+{
+    free(ctx);
+}
+
+#define SEAL_AEAD_NONCE_LEN 12
+
+struct _enclave_seal_aead {
+    sgx_aes_gcm_128bit_key_t key;
+};
+
+sgx_status_t internel_sgx_seal_aead_init(uint8_t *key, struct _enclave_seal_aead **aead)
+{
+    struct _enclave_seal_aead *tmp = (struct _enclave_seal_aead *)calloc(1, sizeof(struct _enclave_seal_aead));
+    if (tmp == NULL) {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(tmp->key, key, SEAL_STREAM_KEY_LEN);
+    *aead = tmp;
+    return SGX_SUCCESS;
+}
+
+void internel_sgx_seal_aead_free(struct _enclave_seal_aead *aead)
+{
+    memset_s(aead->key, sizeof(aead->key), 0, sizeof(aead->key));
+    free(aead);
+}
+
+sgx_status_t internel_sgx_seal_aead_encrypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad,
+                                            uint32_t aad_len, uint8_t *src, uint32_t src_len, uint8_t *dest,
+                                            uint8_t *tag)
+{
+    return sgx_rijndael128GCM_encrypt(&aead->key, src, src_len, dest, nonce, SEAL_AEAD_NONCE_LEN, aad, aad_len,
+                                      (sgx_aes_gcm_128bit_tag_t *)tag);
+}
+
+sgx_status_t internel_sgx_seal_aead_decrypt(struct _enclave_seal_aead *aead, uint8_t *nonce, uint8_t *aad,
+                                            uint32_t aad_len, uint8_t *src, uint32_t src_len, uint8_t *dest,
+                                            uint8_t *tag)
+{
+    return sgx_rijndael128GCM_decrypt(&aead->key, src, src_len, dest, nonce, SEAL_AEAD_NONCE_LEN, aad, aad_len,
+                                      (const sgx_aes_gcm_128bit_tag_t *)tag);
+}
@@ -346,6 +346,8 @@ static cc_enclave_result_t malloc_and_init_context(gp_context_t **gp_context,
         print_error_term("GP context initialize failure\n");
         goto cleanup;
     }
+    gp_region_mgr_init(&(*gp_context)->region_mgr);
+    gp_shared_mem_set_init(&(*gp_context)->shared_mem_set);
     return CC_SUCCESS;
 cleanup:
     free(*gp_context);
@@ -359,6 +361,9 @@ static void fini_context(gp_context_t *gp_context)
         TEEC_CloseSession(&gp_context->session);
         TEEC_FinalizeContext(&(gp_context->ctx));
         free(gp_context->sl_task_pool);
+        CC_MUTEX_DESTROY(&gp_context->region_mgr.lock);
+        CC_COND_DESTROY(&gp_context->region_mgr.cond);
+        gp_shared_mem_set_fini(&gp_context->shared_mem_set);
         free(gp_context);
     }
 }
@@ -536,6 +541,9 @@ cc_enclave_result_t _gp_destroy(cc_enclave_t *context)
     gp_context_t *tmp = (gp_context_t*)context->private_data;
     TEEC_CloseSession(&tmp->session);
     TEEC_FinalizeContext(&tmp->ctx);
+    CC_MUTEX_DESTROY(&tmp->region_mgr.lock);
+    CC_COND_DESTROY(&tmp->region_mgr.cond);
+    gp_shared_mem_set_fini(&tmp->shared_mem_set);
 
     /* free enclave engine context memory */
     free(tmp);
@@ -906,7 +914,8 @@ const struct cc_enclave_ops g_ops = {
     .cc_malloc_shared_memory = gp_malloc_shared_memory,
     .cc_free_shared_memory = gp_free_shared_memory,
     .cc_register_shared_memory = gp_register_shared_memory,
-    .cc_unregister_shared_memory = gp_unregister_shared_memory
+    .cc_unregister_shared_memory = gp_unregister_shared_memory,
+    .cc_malloc_shared_memory_with_attr = gp_malloc_shared_memory_with_attr
 };
 
 struct cc_enclave_ops_desc g_name = {
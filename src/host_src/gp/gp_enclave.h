@@ -17,6 +17,8 @@
 #include "switchless_defs.h"
 #include "enclave.h"
 #include "enclave_internal.h"
+#include "gp_shared_memory_region.h"
+#include "gp_shared_memory.h"
 
 enum
 {
@@ -28,6 +30,8 @@ typedef struct _gp_context {
     TEEC_Context ctx;
     TEEC_Session session;
     sl_task_pool_t *sl_task_pool;
+    gp_shared_memory_region_mgr_t region_mgr;
+    gp_shared_memory_set_t shared_mem_set;
 } gp_context_t;
 
 typedef struct _thread_param {
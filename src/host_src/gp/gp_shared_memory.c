@@ -20,6 +20,7 @@
 #include "enclave_internal.h"
 #include "gp_enclave.h"
 #include "gp_uswitchless.h"
+#include "gp_shared_memory_region.h"
 #include "secgear_list.h"
 #include "enclave_log.h"
 #include "status.h"
@@ -27,29 +28,96 @@
 #define TEEC_SHARED_MEMORY_ENTRY(ptr) \
     ((TEEC_SharedMemory *)((char *)(ptr) - sizeof(gp_shared_memory_t)))
 
-static pthread_rwlock_t g_shared_mem_list_lock = PTHREAD_RWLOCK_INITIALIZER;
-static list_node_t g_shared_mem_list = {
-    .next = &g_shared_mem_list,
-    .prev = &g_shared_mem_list
-};
+#define SET_HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
 
-static void gp_remove_shared_mem_from_list(gp_shared_memory_t *shared_mem)
+static gp_shared_memory_bucket_t *gp_get_shared_mem_bucket(cc_enclave_t *enclave, const void *ptr)
 {
-    CC_RWLOCK_LOCK_WR(&g_shared_mem_list_lock);
-    list_remove(&shared_mem->node);
-    CC_RWLOCK_UNLOCK(&g_shared_mem_list_lock);
+    gp_shared_memory_set_t *set = &((gp_context_t *)enclave->private_data)->shared_mem_set;
+    // Start addresses are at least 8-byte aligned, drop the low bits before mixing
+    uint64_t hash = ((uint64_t)(size_t)ptr >> 3) * SET_HASH_MULTIPLIER;
+    return &set->buckets[hash >> (64 - GP_SHARED_MEM_SET_BUCKET_BITS)];
 }
 
-static void gp_add_shared_mem_to_list(gp_shared_memory_t *shared_mem)
+void gp_shared_mem_set_init(gp_shared_memory_set_t *set)
 {
-    CC_RWLOCK_LOCK_WR(&g_shared_mem_list_lock);
-    list_add_after(&shared_mem->node, &g_shared_mem_list);
-    CC_RWLOCK_UNLOCK(&g_shared_mem_list_lock);
+    for (size_t i = 0; i < GP_SHARED_MEM_SET_BUCKET_NUM; ++i) {
+        CC_IGNORE(pthread_rwlock_init(&set->buckets[i].lock, NULL));
+        list_init(&set->buckets[i].head);
+    }
+}
+
+void gp_shared_mem_set_fini(gp_shared_memory_set_t *set)
+{
+    for (size_t i = 0; i < GP_SHARED_MEM_SET_BUCKET_NUM; ++i) {
+        CC_IGNORE(pthread_rwlock_destroy(&set->buckets[i].lock));
+    }
+}
+
+static void gp_add_shared_mem_to_set(cc_enclave_t *enclave, gp_shared_memory_t *shared_mem)
+{
+    gp_shared_memory_bucket_t *bucket = gp_get_shared_mem_bucket(enclave, (char *)shared_mem +
+        sizeof(gp_shared_memory_t));
+
+    CC_RWLOCK_LOCK_WR(&bucket->lock);
+    list_add_after(&shared_mem->node, &bucket->head);
+    CC_RWLOCK_UNLOCK(&bucket->lock);
+}
+
+static gp_shared_memory_t *gp_lookup_in_bucket(const gp_shared_memory_bucket_t *bucket, const void *ptr)
+{
+    list_node_t *cur = NULL;
+    gp_shared_memory_t *mem = NULL;
+
+    list_for_each(cur, &bucket->head) {
+        mem = list_entry(cur, gp_shared_memory_t, node);
+        if ((char *)mem + sizeof(gp_shared_memory_t) == (const char *)ptr) {
+            return mem;
+        }
+    }
+    return NULL;
+}
+
+/* Return the meta data if ptr is the start address of a shared memory of the enclave, otherwise NULL */
+static gp_shared_memory_t *gp_find_shared_mem(cc_enclave_t *enclave, const void *ptr)
+{
+    gp_shared_memory_bucket_t *bucket = gp_get_shared_mem_bucket(enclave, ptr);
+
+    CC_RWLOCK_LOCK_RD(&bucket->lock);
+    gp_shared_memory_t *mem = gp_lookup_in_bucket(bucket, ptr);
+    CC_RWLOCK_UNLOCK(&bucket->lock);
+
+    return mem;
+}
+
+/* Look up and remove in one step, so that concurrent frees of the same address cannot both succeed */
+static gp_shared_memory_t *gp_remove_shared_mem_from_set(cc_enclave_t *enclave, const void *ptr)
+{
+    gp_shared_memory_bucket_t *bucket = gp_get_shared_mem_bucket(enclave, ptr);
+
+    CC_RWLOCK_LOCK_WR(&bucket->lock);
+    gp_shared_memory_t *mem = gp_lookup_in_bucket(bucket, ptr);
+    if (mem != NULL) {
+        list_remove(&mem->node);
+    }
+    CC_RWLOCK_UNLOCK(&bucket->lock);
+
+    return mem;
 }
 
 void *gp_malloc_shared_memory(cc_enclave_t *context, size_t size, bool is_control_buf)
 {
     gp_context_t *gp_context = (gp_context_t *)context->private_data;
+
+    // User data buffers are carved from registered regions, only control buffers own a TEEC shared memory
+    if (!is_control_buf) {
+        gp_shared_memory_t *block = gp_region_alloc_block(context, size, NULL);
+        if (block == NULL) {
+            return NULL;
+        }
+        gp_add_shared_mem_to_set(context, block);
+        return (char *)block + sizeof(gp_shared_memory_t);
+    }
+
     gp_shared_memory_t gp_shared_mem = {
         .is_control_buf = is_control_buf,
         .is_registered = false,
@@ -68,45 +136,33 @@ void *gp_malloc_shared_memory(cc_enclave_t *context, size_t size, bool is_contro
     // save meta data
     (void)memcpy(teec_shared_mem->buffer, &gp_shared_mem, sizeof(gp_shared_mem));
 
-    gp_add_shared_mem_to_list((gp_shared_memory_t *)teec_shared_mem->buffer);
+    gp_add_shared_mem_to_set(context, (gp_shared_memory_t *)teec_shared_mem->buffer);
     return (char *)teec_shared_mem->buffer + sizeof(gp_shared_mem);
 }
 
-static bool gp_is_shared_mem_start_addr(const void *ptr)
+void *gp_malloc_shared_memory_with_attr(cc_enclave_t *context, size_t size, const cc_shared_memory_attr_t *attr)
 {
-    size_t addr = (size_t)ptr;
-    bool isExist = false;
-    list_node_t *cur = NULL;
-    gp_shared_memory_t *mem = NULL;
-
-    CC_RWLOCK_LOCK_RD(&g_shared_mem_list_lock);
-    list_for_each(cur, &g_shared_mem_list) {
-        mem = list_entry(cur, gp_shared_memory_t, node);
-        if (addr == (size_t)((char *)mem + sizeof(gp_shared_memory_t))) {
-            isExist = true;
-            break;
-        }
+    gp_shared_memory_t *block = gp_region_alloc_block(context, size, attr);
+    if (block == NULL) {
+        return NULL;
     }
-    CC_RWLOCK_UNLOCK(&g_shared_mem_list_lock);
-
-    return isExist;
+    gp_add_shared_mem_to_set(context, block);
+    return (char *)block + sizeof(gp_shared_memory_t);
 }
 
 cc_enclave_result_t gp_free_shared_memory(cc_enclave_t *enclave, void *ptr)
 {
-    CC_IGNORE(enclave);
-
-    if (!gp_is_shared_mem_start_addr(ptr)) {
+    gp_shared_memory_t *gp_shared_mem = gp_remove_shared_mem_from_set(enclave, ptr);
+    if (gp_shared_mem == NULL) {
         print_error_term("GP free shared memory failed: invalid shared memory start address.\n");
         return CC_ERROR_SHARED_MEMORY_NOT_REGISTERED;
     }
 
-    if (GP_SHARED_MEMORY_ENTRY(ptr)->enclave != enclave) {
-        return CC_ERROR_INVALID_HANDLE;
+    if (gp_shared_mem->region != NULL) {
+        gp_region_free_block(enclave, gp_shared_mem);
+        return CC_SUCCESS;
     }
 
-    gp_remove_shared_mem_from_list(GP_SHARED_MEMORY_ENTRY(ptr));
-
     TEEC_SharedMemory sharedMem = *TEEC_SHARED_MEMORY_ENTRY(ptr);
     TEEC_ReleaseSharedMemory(&sharedMem);
 
@@ -121,22 +177,10 @@ cc_enclave_result_t gp_free_shared_memory(cc_enclave_t *enclave, void *ptr)
     size_t offset_var_name = cur_param_offset; \
     cur_param_offset += (cur_param_size)
 
-cc_enclave_result_t gp_register_shared_memory(cc_enclave_t *enclave, void *ptr)
+cc_enclave_result_t gp_register_teec_shared_memory(cc_enclave_t *enclave, gp_shared_memory_t *gp_shared_mem)
 {
     uint32_t ms = TEE_SECE_AGENT_ID;
-
-    if (!gp_is_shared_mem_start_addr(ptr)) {
-        return CC_ERROR_SHARED_MEMORY_START_ADDR_INVALID;
-    }
-
-    gp_shared_memory_t *gp_shared_mem = GP_SHARED_MEMORY_ENTRY(ptr);
-    if (!gp_shared_mem->is_control_buf && !uswitchless_is_switchless_enabled(enclave)) {
-        return CC_ERROR_SWITCHLESS_DISABLED;
-    }
-
-    if (GP_SHARED_MEMORY_ENTRY(ptr)->enclave != enclave) {
-        return CC_ERROR_INVALID_HANDLE;
-    }
+    void *ptr = (char *)gp_shared_mem + sizeof(gp_shared_memory_t);
 
     if (__atomic_load_n(&gp_shared_mem->is_registered, __ATOMIC_ACQUIRE)) {
         return CC_ERROR_SHARED_MEMORY_REPEAT_REGISTER;
@@ -195,7 +239,24 @@ cc_enclave_result_t gp_register_shared_memory(cc_enclave_t *enclave, void *ptr)
     return CC_SUCCESS;
 }
 
-cc_enclave_result_t unregister_shared_memory(cc_enclave_t *enclave, gp_shared_memory_t* gp_shared_mem)
+cc_enclave_result_t gp_register_shared_memory(cc_enclave_t *enclave, void *ptr)
+{
+    gp_shared_memory_t *gp_shared_mem = gp_find_shared_mem(enclave, ptr);
+    if (gp_shared_mem == NULL) {
+        return CC_ERROR_SHARED_MEMORY_START_ADDR_INVALID;
+    }
+
+    if (!gp_shared_mem->is_control_buf && !uswitchless_is_switchless_enabled(enclave)) {
+        return CC_ERROR_SWITCHLESS_DISABLED;
+    }
+
+    if (gp_shared_mem->region != NULL) {
+        return gp_region_register_block(enclave, gp_shared_mem);
+    }
+    return gp_register_teec_shared_memory(enclave, gp_shared_mem);
+}
+
+cc_enclave_result_t gp_unregister_teec_shared_memory(cc_enclave_t *enclave, gp_shared_memory_t* gp_shared_mem)
 {
     uint32_t ms = TEE_SECE_AGENT_ID;
 
@@ -254,45 +315,67 @@ cc_enclave_result_t unregister_shared_memory(cc_enclave_t *enclave, gp_shared_me
     free(param_buf);
     return CC_SUCCESS;
 }
+
 cc_enclave_result_t gp_unregister_shared_memory(cc_enclave_t *enclave, void* ptr)
 {
-
-    if (!gp_is_shared_mem_start_addr(ptr)) {
+    gp_shared_memory_t *gp_shared_mem = gp_find_shared_mem(enclave, ptr);
+    if (gp_shared_mem == NULL) {
         return CC_ERROR_SHARED_MEMORY_START_ADDR_INVALID;
     }
 
-    if (GP_SHARED_MEMORY_ENTRY(ptr)->enclave != enclave) {
-        return CC_ERROR_INVALID_HANDLE;
+    if (gp_shared_mem->region != NULL) {
+        return gp_region_unregister_block(enclave, gp_shared_mem);
     }
-
-    gp_shared_memory_t *gp_shared_mem = GP_SHARED_MEMORY_ENTRY(ptr);
-    return unregister_shared_memory(enclave, gp_shared_mem);
+    return gp_unregister_teec_shared_memory(enclave, gp_shared_mem);
 }
 
 cc_enclave_result_t gp_release_all_shared_memory(cc_enclave_t *enclave)
 {
+    gp_shared_memory_set_t *set = &((gp_context_t *)enclave->private_data)->shared_mem_set;
     list_node_t *cur = NULL;
     list_node_t *tmp = NULL;
+    list_head_t release_list;
     gp_shared_memory_t *mem = NULL;
     cc_enclave_result_t step_ret;
     cc_enclave_result_t ret = CC_SUCCESS;
 
-    CC_RWLOCK_LOCK_RD(&g_shared_mem_list_lock);
-    list_for_each_safe(cur, tmp, &g_shared_mem_list) {
-        mem = list_entry(cur, gp_shared_memory_t, node);
-        if (mem->is_control_buf) {
-            continue;
+    // Only unlink under the bucket locks, the unregister ecall waits for the parked session to return
+    list_init(&release_list);
+    for (size_t i = 0; i < GP_SHARED_MEM_SET_BUCKET_NUM; ++i) {
+        gp_shared_memory_bucket_t *bucket = &set->buckets[i];
+        CC_RWLOCK_LOCK_WR(&bucket->lock);
+        list_for_each_safe(cur, tmp, &bucket->head) {
+            mem = list_entry(cur, gp_shared_memory_t, node);
+            if (mem->is_control_buf) {
+                continue;
+            }
+            list_remove(&mem->node);
+            // Blocks go away together with their regions
+            if (mem->region == NULL) {
+                list_add_after(&mem->node, &release_list);
+            }
         }
-        step_ret = unregister_shared_memory(enclave, mem);
+        CC_RWLOCK_UNLOCK(&bucket->lock);
+    }
+
+    list_for_each_safe(cur, tmp, &release_list) {
+        mem = list_entry(cur, gp_shared_memory_t, node);
+        list_remove(&mem->node);
+        step_ret = gp_unregister_teec_shared_memory(enclave, mem);
         if (step_ret != CC_SUCCESS) {
+            // Keep what the enclave may still use
             ret = step_ret;
+            gp_add_shared_mem_to_set(enclave, mem);
             continue;
         }
-        list_remove(&mem->node);
         TEEC_SharedMemory sharedMem = *(TEEC_SharedMemory *)mem;
         TEEC_ReleaseSharedMemory(&sharedMem);
     }
-    CC_RWLOCK_UNLOCK(&g_shared_mem_list_lock);
 
-    return ret; 
+    step_ret = gp_region_mgr_fini(enclave);
+    if (step_ret != CC_SUCCESS) {
+        ret = step_ret;
+    }
+
+    return ret;
 }
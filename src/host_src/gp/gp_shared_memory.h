@@ -16,13 +16,32 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <pthread.h>
 #include "enclave.h"
 #include "status.h"
+#include "secgear_shared_memory.h"
+#include "gp_shared_memory_defs.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define GP_SHARED_MEM_SET_BUCKET_BITS 7
+#define GP_SHARED_MEM_SET_BUCKET_NUM (1U << GP_SHARED_MEM_SET_BUCKET_BITS)
+
+typedef struct {
+    pthread_rwlock_t lock;
+    list_head_t head;
+} gp_shared_memory_bucket_t;
+
+/* Shared memory of one enclave, hashed by start address with one lock per bucket */
+typedef struct {
+    gp_shared_memory_bucket_t buckets[GP_SHARED_MEM_SET_BUCKET_NUM];
+} gp_shared_memory_set_t;
+
+void gp_shared_mem_set_init(gp_shared_memory_set_t *set);
+void gp_shared_mem_set_fini(gp_shared_memory_set_t *set);
+
 /*
  * Summary: Allocates size bytes and returns a pointer to the allocated memory.
  * Parameters:
@@ -33,6 +52,16 @@ extern "C" {
  */
 void *gp_malloc_shared_memory(cc_enclave_t *context, size_t size, bool is_control_buf);
 
+/*
+ * Summary: Allocates a data buffer of size bytes in a region of its own, which is backed as described by attr.
+ * Parameters:
+ *     context: enclave
+ *     size: buffer length
+ *     attr: backing attributes
+ * Return: A pointer to the allocated memory. On error, return NULL.
+ */
+void *gp_malloc_shared_memory_with_attr(cc_enclave_t *context, size_t size, const cc_shared_memory_attr_t *attr);
+
 /*
  * Summary: Frees the memory space pointed to by ptr, which must have been returned by gp_malloc_shared_memory.
  * Parameters:
@@ -60,6 +89,24 @@ cc_enclave_result_t gp_register_shared_memory(cc_enclave_t *enclave, void *ptr);
  */
 cc_enclave_result_t gp_unregister_shared_memory(cc_enclave_t *enclave, void *ptr);
 cc_enclave_result_t gp_release_all_shared_memory(cc_enclave_t *enclave);
+
+/*
+ * Summary: Register a standalone TEEC shared memory, a session stays parked in the enclave until it is unregistered.
+ * Parameters:
+ *     enclave: enclave
+ *     gp_shared_mem: meta data in front of the shared memory
+ * Return: CC_SUCCESS, success; others failed.
+ */
+cc_enclave_result_t gp_register_teec_shared_memory(cc_enclave_t *enclave, gp_shared_memory_t *gp_shared_mem);
+
+/*
+ * Summary: Unregister a standalone TEEC shared memory and wait for its parked session to return.
+ * Parameters:
+ *     enclave: enclave
+ *     gp_shared_mem: meta data in front of the shared memory
+ * Return: CC_SUCCESS, success; others failed.
+ */
+cc_enclave_result_t gp_unregister_teec_shared_memory(cc_enclave_t *enclave, gp_shared_memory_t *gp_shared_mem);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "gp_shared_memory_region.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <tee_client_type.h>
+#include "secgear_defs.h"
+#include "gp_enclave.h"
+#include "gp_shared_memory.h"
+#include "enclave_log.h"
+
+#define BLOCK_HEAD_SIZE sizeof(gp_shared_memory_t)
+#define ALIGN_UP(x, align) (((x) + (align) - 1) & ~((size_t)(align) - 1))
+
+#define REGION_MGR(enclave) (&((gp_context_t *)(enclave)->private_data)->region_mgr)
+
+/* Total length occupied by a block in its region, including the meta data in front of it */
+#define BLOCK_SPAN(block) ((block)->buf_len + BLOCK_HEAD_SIZE)
+
+#define GP_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define GP_PAGE_SIZE 4096
+#define GP_MPOL_BIND 2
+#define GP_MPOL_MF_MOVE (1 << 1)
+#define BITS_PER_ULONG (sizeof(unsigned long) * 8)
+
+void gp_region_mgr_init(gp_shared_memory_region_mgr_t *mgr)
+{
+    CC_MUTEX_INIT(&mgr->lock, NULL);
+    CC_COND_INIT(&mgr->cond, NULL);
+    list_init(&mgr->regions);
+    for (size_t i = 0; i < GP_SHARED_MEMORY_FREE_LIST_NUM; ++i) {
+        list_init(&mgr->free_lists[i]);
+    }
+}
+
+static size_t span_class(size_t span)
+{
+    size_t units = span / GP_SHARED_MEMORY_BLOCK_ALIGN;
+    size_t k = sizeof(unsigned long) * 8 - 1 - (size_t)__builtin_clzl((unsigned long)units);
+    return k < GP_SHARED_MEMORY_FREE_LIST_NUM ? k : GP_SHARED_MEMORY_FREE_LIST_NUM - 1;
+}
+
+// A dedicated region serves a single allocation, its free blocks are never handed out
+static void add_free_block(gp_shared_memory_region_mgr_t *mgr, gp_shared_memory_t *block)
+{
+    if (!((gp_shared_memory_region_t *)block->region)->is_dedicated) {
+        list_add_after(&block->free_node, &mgr->free_lists[span_class(BLOCK_SPAN(block))]);
+    }
+}
+
+static void remove_free_block(gp_shared_memory_t *block)
+{
+    if (!((gp_shared_memory_region_t *)block->region)->is_dedicated) {
+        list_remove(&block->free_node);
+    }
+}
+
+static void init_block(gp_shared_memory_t *block, gp_shared_memory_region_t *region, size_t span)
+{
+    (void)memset(block, 0, BLOCK_HEAD_SIZE);
+    block->enclave = region->head->enclave;
+    block->region = region;
+    block->buf_len = span - BLOCK_HEAD_SIZE;
+}
+
+static int bind_numa_node(void *addr, size_t len, int node)
+{
+    unsigned long node_mask[(CC_SHARED_MEMORY_MAX_NUMA_NODE + 1) / BITS_PER_ULONG] = {0};
+    node_mask[(size_t)node / BITS_PER_ULONG] |= 1UL << ((size_t)node % BITS_PER_ULONG);
+
+    // The kernel reads maxnode - 1 bits of the mask
+    return (int)syscall(SYS_mbind, addr, len, GP_MPOL_BIND, node_mask, sizeof(node_mask) * 8 + 1, GP_MPOL_MF_MOVE);
+}
+
+/* Map memory backed as described by attr, the attributes are best effort except for the mapping itself */
+static void *map_user_memory(size_t len, const cc_shared_memory_attr_t *attr)
+{
+    void *addr = MAP_FAILED;
+
+    if (attr->flags & CC_SHARED_MEMORY_FLAG_HUGE_PAGE) {
+        addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (addr == MAP_FAILED) {
+        addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            return NULL;
+        }
+        // No huge page is reserved, fall back to transparent huge pages
+        if (attr->flags & CC_SHARED_MEMORY_FLAG_HUGE_PAGE) {
+            (void)madvise(addr, len, MADV_HUGEPAGE);
+        }
+    }
+
+    // Bind before the first touch, so that the pages are allocated on the node right away
+    if ((attr->flags & CC_SHARED_MEMORY_FLAG_NUMA_BIND) && bind_numa_node(addr, len, attr->numa_node) != 0) {
+        print_warning("Failed to bind shared memory to numa node %d\n", attr->numa_node);
+    }
+    return addr;
+}
+
+static TEEC_Result alloc_region_memory(gp_context_t *gp_context, gp_shared_memory_region_t *region,
+    TEEC_SharedMemory *teec_shared_mem, const cc_shared_memory_attr_t *attr)
+{
+    if (attr != NULL) {
+        size_t page_size = (attr->flags & CC_SHARED_MEMORY_FLAG_HUGE_PAGE) ? GP_HUGE_PAGE_SIZE : GP_PAGE_SIZE;
+        size_t map_len = ALIGN_UP(teec_shared_mem->size, page_size);
+        void *map_addr = map_user_memory(map_len, attr);
+        if (map_addr != NULL) {
+            teec_shared_mem->buffer = map_addr;
+            if (TEEC_RegisterSharedMemory(&gp_context->ctx, teec_shared_mem) == TEEC_SUCCESS) {
+                region->user_mem = map_addr;
+                region->user_mem_len = map_len;
+                return TEEC_SUCCESS;
+            }
+            (void)munmap(map_addr, map_len);
+            teec_shared_mem->buffer = NULL;
+        }
+        print_warning("The driver does not permit registering user memory, the shared memory attributes are "
+            "ignored\n");
+    }
+
+    return TEEC_AllocateSharedMemory(&gp_context->ctx, teec_shared_mem);
+}
+
+static gp_shared_memory_region_t *create_region(cc_enclave_t *enclave, size_t size,
+    const cc_shared_memory_attr_t *attr)
+{
+    gp_context_t *gp_context = (gp_context_t *)enclave->private_data;
+    gp_shared_memory_region_t *region = (gp_shared_memory_region_t *)calloc(1, sizeof(gp_shared_memory_region_t));
+    if (region == NULL) {
+        return NULL;
+    }
+
+    gp_shared_memory_t head = {
+        .is_control_buf = false,
+        .is_registered = false,
+        .enclave = (void *)enclave,
+        .register_tid = 0
+    };
+    TEEC_SharedMemory *teec_shared_mem = (TEEC_SharedMemory *)(&head.shared_mem);
+    teec_shared_mem->size = size + BLOCK_HEAD_SIZE;
+    teec_shared_mem->flags = TEEC_MEM_SHARED_INOUT;
+
+    TEEC_Result result = alloc_region_memory(gp_context, region, teec_shared_mem, attr);
+    if (result != TEEC_SUCCESS) {
+        free(region);
+        return NULL;
+    }
+    (void)memcpy(teec_shared_mem->buffer, &head, sizeof(head));
+    region->is_dedicated = (attr != NULL);
+
+    region->head = (gp_shared_memory_t *)teec_shared_mem->buffer;
+    region->size = size;
+    list_init(&region->blocks);
+
+    // The whole region starts as one free block
+    gp_shared_memory_t *block = (gp_shared_memory_t *)((char *)region->head + BLOCK_HEAD_SIZE);
+    init_block(block, region, size);
+    list_add_before(&block->region_node, &region->blocks);
+    add_free_block(REGION_MGR(enclave), block);
+
+    list_add_after(&region->node, &REGION_MGR(enclave)->regions);
+    return region;
+}
+
+/*
+ * The region is unlinked from the manager, so its release may wait for the parked session without the lock. A region
+ * which fails to unregister may still be mapped into the TA, so it is not released.
+ */
+static cc_enclave_result_t destroy_region(cc_enclave_t *enclave, gp_shared_memory_region_t *region)
+{
+    if (__atomic_load_n(&region->head->is_registered, __ATOMIC_ACQUIRE)) {
+        cc_enclave_result_t ret = gp_unregister_teec_shared_memory(enclave, region->head);
+        if (ret != CC_SUCCESS) {
+            print_error_term("Failed to unregister shared memory region, ret=%x\n", ret);
+            return ret;
+        }
+    }
+
+    TEEC_SharedMemory sharedMem = *(TEEC_SharedMemory *)region->head;
+    TEEC_ReleaseSharedMemory(&sharedMem);
+    if (region->user_mem != NULL) {
+        (void)munmap(region->user_mem, region->user_mem_len);
+    }
+    free(region);
+
+    return CC_SUCCESS;
+}
+
+/* Give a region which could not be released back to the manager, the caller holds the lock of the regions */
+static void relink_region(gp_shared_memory_region_mgr_t *mgr, gp_shared_memory_region_t *region)
+{
+    list_node_t *cur = NULL;
+
+    list_add_after(&region->node, &mgr->regions);
+    list_for_each(cur, &region->blocks) {
+        gp_shared_memory_t *block = list_entry(cur, gp_shared_memory_t, region_node);
+        if (!block->is_used) {
+            add_free_block(mgr, block);
+        }
+    }
+}
+
+/* Take span bytes from the front of a free block, the rest stays free if it is large enough to hold another block */
+static void take_free_block(gp_shared_memory_region_mgr_t *mgr, gp_shared_memory_t *block, size_t span)
+{
+    gp_shared_memory_region_t *region = (gp_shared_memory_region_t *)block->region;
+
+    remove_free_block(block);
+    if (BLOCK_SPAN(block) - span >= BLOCK_HEAD_SIZE + GP_SHARED_MEMORY_BLOCK_ALIGN) {
+        gp_shared_memory_t *tail = (gp_shared_memory_t *)((char *)block + span);
+        init_block(tail, region, BLOCK_SPAN(block) - span);
+        list_add_after(&tail->region_node, &block->region_node);
+        block->buf_len = span - BLOCK_HEAD_SIZE;
+        add_free_block(mgr, tail);
+    }
+
+    block->is_used = true;
+    ++region->used_cnt;
+}
+
+/* Only the class of span and the open last class may hold blocks that are too short, elsewhere the first one fits */
+static gp_shared_memory_t *find_free_block(gp_shared_memory_region_mgr_t *mgr, size_t span)
+{
+    list_node_t *cur = NULL;
+
+    for (size_t k = span_class(span); k < GP_SHARED_MEMORY_FREE_LIST_NUM; ++k) {
+        list_for_each(cur, &mgr->free_lists[k]) {
+            gp_shared_memory_t *block = list_entry(cur, gp_shared_memory_t, free_node);
+            if (BLOCK_SPAN(block) >= span) {
+                return block;
+            }
+        }
+    }
+    return NULL;
+}
+
+gp_shared_memory_t *gp_region_alloc_block(cc_enclave_t *enclave, size_t size, const cc_shared_memory_attr_t *attr)
+{
+    gp_shared_memory_region_mgr_t *mgr = REGION_MGR(enclave);
+    gp_shared_memory_t *block = NULL;
+
+    if (size == 0 || size > SIZE_MAX - BLOCK_HEAD_SIZE - 2 * GP_SHARED_MEMORY_REGION_SIZE) {
+        return NULL;
+    }
+    size_t span = ALIGN_UP(size + BLOCK_HEAD_SIZE, GP_SHARED_MEMORY_BLOCK_ALIGN);
+
+    CC_MUTEX_LOCK(&mgr->lock);
+    size_t region_size = span;
+    if (attr == NULL) {
+        block = find_free_block(mgr, span);
+        if (block != NULL) {
+            take_free_block(mgr, block, span);
+            goto end;
+        }
+        // An oversized request gets a region of whole default regions, the rest of it is shared
+        region_size = ALIGN_UP(span, GP_SHARED_MEMORY_REGION_SIZE);
+    }
+
+    gp_shared_memory_region_t *region = create_region(enclave, region_size, attr);
+    if (region != NULL) {
+        block = list_entry(region->blocks.next, gp_shared_memory_t, region_node);
+        take_free_block(mgr, block, span);
+    }
+
+end:
+    CC_MUTEX_UNLOCK(&mgr->lock);
+    return block;
+}
+
+void gp_region_free_block(cc_enclave_t *enclave, gp_shared_memory_t *block)
+{
+    gp_shared_memory_region_mgr_t *mgr = REGION_MGR(enclave);
+    gp_shared_memory_region_t *region = (gp_shared_memory_region_t *)block->region;
+    gp_shared_memory_region_t *empty_region = NULL;
+
+    CC_MUTEX_LOCK(&mgr->lock);
+    __atomic_store_n(&block->is_registered, false, __ATOMIC_RELEASE);
+    block->is_used = false;
+    --region->used_cnt;
+
+    // Merge with the free neighbours, which leave their free lists
+    if (block->region_node.next != &region->blocks) {
+        gp_shared_memory_t *next = list_entry(block->region_node.next, gp_shared_memory_t, region_node);
+        if (!next->is_used) {
+            remove_free_block(next);
+            block->buf_len += BLOCK_SPAN(next);
+            list_remove(&next->region_node);
+        }
+    }
+    if (block->region_node.prev != &region->blocks) {
+        gp_shared_memory_t *prev = list_entry(block->region_node.prev, gp_shared_memory_t, region_node);
+        if (!prev->is_used) {
+            remove_free_block(prev);
+            prev->buf_len += BLOCK_SPAN(block);
+            list_remove(&block->region_node);
+            block = prev;
+        }
+    }
+    add_free_block(mgr, block);
+
+    // Keep one default sized region cached, so that the next allocation does not pay for a registration again
+    bool is_last = (mgr->regions.next == &region->node) && (mgr->regions.prev == &region->node);
+    if (region->used_cnt == 0 &&
+        (region->is_dedicated || !is_last || region->size != GP_SHARED_MEMORY_REGION_SIZE)) {
+        remove_free_block(block);
+        list_remove(&region->node);
+        empty_region = region;
+    }
+    CC_MUTEX_UNLOCK(&mgr->lock);
+
+    if (empty_region != NULL && destroy_region(enclave, empty_region) != CC_SUCCESS) {
+        CC_MUTEX_LOCK(&mgr->lock);
+        relink_region(mgr, empty_region);
+        CC_MUTEX_UNLOCK(&mgr->lock);
+    }
+}
+
+cc_enclave_result_t gp_region_register_block(cc_enclave_t *enclave, gp_shared_memory_t *block)
+{
+    gp_shared_memory_region_mgr_t *mgr = REGION_MGR(enclave);
+    gp_shared_memory_region_t *region = (gp_shared_memory_region_t *)block->region;
+    cc_enclave_result_t ret = CC_SUCCESS;
+
+    CC_MUTEX_LOCK(&mgr->lock);
+    while (region->is_registering) {
+        CC_COND_WAIT(&mgr->cond, &mgr->lock);
+    }
+    if (__atomic_load_n(&block->is_registered, __ATOMIC_ACQUIRE)) {
+        ret = CC_ERROR_SHARED_MEMORY_REPEAT_REGISTER;
+        goto end;
+    }
+
+    // The ecall parks a session in the TA, the blocks of other regions do not wait for it
+    if (!__atomic_load_n(&region->head->is_registered, __ATOMIC_ACQUIRE)) {
+        region->is_registering = true;
+        CC_MUTEX_UNLOCK(&mgr->lock);
+        ret = gp_register_teec_shared_memory(enclave, region->head);
+        CC_MUTEX_LOCK(&mgr->lock);
+        region->is_registering = false;
+        CC_COND_BROADCAST(&mgr->cond);
+        if (ret != CC_SUCCESS) {
+            goto end;
+        }
+    }
+    __atomic_store_n(&block->is_registered, true, __ATOMIC_RELEASE);
+
+end:
+    CC_MUTEX_UNLOCK(&mgr->lock);
+    return ret;
+}
+
+cc_enclave_result_t gp_region_unregister_block(cc_enclave_t *enclave, gp_shared_memory_t *block)
+{
+    CC_IGNORE(enclave);
+
+    bool expected = true;
+    if (!__atomic_compare_exchange_n(&block->is_registered, &expected, false, false,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return CC_ERROR_SHARED_MEMORY_NOT_REGISTERED;
+    }
+    return CC_SUCCESS;
+}
+
+cc_enclave_result_t gp_region_mgr_fini(cc_enclave_t *enclave)
+{
+    gp_shared_memory_region_mgr_t *mgr = REGION_MGR(enclave);
+    list_node_t *cur = NULL;
+    list_node_t *tmp = NULL;
+    list_head_t regions;
+    cc_enclave_result_t step_ret;
+    cc_enclave_result_t ret = CC_SUCCESS;
+
+    list_init(&regions);
+    CC_MUTEX_LOCK(&mgr->lock);
+    list_for_each_safe(cur, tmp, &mgr->regions) {
+        list_remove(cur);
+        list_add_before(cur, &regions);
+    }
+    for (size_t i = 0; i < GP_SHARED_MEMORY_FREE_LIST_NUM; ++i) {
+        list_init(&mgr->free_lists[i]);
+    }
+    CC_MUTEX_UNLOCK(&mgr->lock);
+
+    list_for_each_safe(cur, tmp, &regions) {
+        gp_shared_memory_region_t *region = list_entry(cur, gp_shared_memory_region_t, node);
+        list_remove(cur);
+        step_ret = destroy_region(enclave, region);
+        if (step_ret != CC_SUCCESS) {
+            // Keep what the enclave may still use
+            ret = step_ret;
+            CC_MUTEX_LOCK(&mgr->lock);
+            relink_region(mgr, region);
+            CC_MUTEX_UNLOCK(&mgr->lock);
+        }
+    }
+
+    return ret;
+}
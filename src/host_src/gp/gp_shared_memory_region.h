@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef __GP_SHARED_MEMORY_REGION_H__
+#define __GP_SHARED_MEMORY_REGION_H__
+
+#include <stddef.h>
+#include <pthread.h>
+#include "enclave.h"
+#include "status.h"
+#include "secgear_list.h"
+#include "secgear_shared_memory.h"
+#include "gp_shared_memory_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A GP memref is only mapped into the TA while the command that carries it is executing, so every registered
+ * buffer keeps one session parked inside the TA. User data buffers are therefore carved from a few large regions:
+ * a region is registered once, and registering a block inside it is pure host side bookkeeping.
+ *
+ * The TA sees a region as one memref, so a block can not span two regions. A block larger than a default region
+ * gets a region of its own, rounded up to whole default regions, and the rest of it serves other blocks until the
+ * block is freed.
+ *
+ * The free blocks of all shared regions are kept in size classes, class k holds the blocks spanning
+ * [2^k, 2^(k+1)) units of GP_SHARED_MEMORY_BLOCK_ALIGN, the last class is open ended.
+ */
+#define GP_SHARED_MEMORY_REGION_SIZE    (4 * 1024 * 1024)
+#define GP_SHARED_MEMORY_BLOCK_ALIGN    64
+#define GP_SHARED_MEMORY_FREE_LIST_NUM  20
+
+typedef struct {
+    list_node_t node; // links the regions of an enclave
+    list_head_t blocks; // free and used blocks of the region in address order
+    gp_shared_memory_t *head; // meta data in front of the TEEC shared memory of the region
+    size_t size; // length of the region available for blocks
+    size_t used_cnt; // number of allocated blocks
+    bool is_dedicated; // serves a single allocation with backing attributes, released once it is freed
+    bool is_registering; // the registration ecall of the region runs without the lock of the regions
+    void *user_mem; // memory mapped by secGear and registered to the driver, NULL if allocated by the driver
+    size_t user_mem_len;
+} gp_shared_memory_region_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond; // signaled when the registration of a region ends
+    list_head_t regions;
+    list_head_t free_lists[GP_SHARED_MEMORY_FREE_LIST_NUM]; // free blocks of the shared regions by size class
+} gp_shared_memory_region_mgr_t;
+
+void gp_region_mgr_init(gp_shared_memory_region_mgr_t *mgr);
+
+/*
+ * Summary: Unregister and release all regions of the enclave, the blocks carved from them become invalid. A region
+ *          which fails to unregister may still be mapped into the TA, it stays with the enclave and is not released.
+ * Parameters:
+ *     enclave: enclave
+ * Return: CC_SUCCESS, success; others failed.
+ */
+cc_enclave_result_t gp_region_mgr_fini(cc_enclave_t *enclave);
+
+/*
+ * Summary: Carve a block of at least size bytes from the regions of the enclave, a new region is created if needed.
+ *          With attr, the block gets a dedicated region backed by huge pages or bound to a NUMA node, which is
+ *          registered through TEEC_RegisterSharedMemory where the driver permits.
+ * Parameters:
+ *     enclave: enclave
+ *     size: buffer length
+ *     attr: backing attributes, NULL for the default backing
+ * Return: meta data of the block. On error, return NULL.
+ */
+gp_shared_memory_t *gp_region_alloc_block(cc_enclave_t *enclave, size_t size, const cc_shared_memory_attr_t *attr);
+
+/*
+ * Summary: Return a block to its region, an empty region which is not the last one is released after the lock of
+ *          the regions is dropped. If it fails to unregister, it stays with the enclave.
+ * Parameters:
+ *     enclave: enclave
+ *     block: meta data of the block
+ * Return: None
+ */
+void gp_region_free_block(cc_enclave_t *enclave, gp_shared_memory_t *block);
+
+/*
+ * Summary: Register a block, only the first block of a region costs an ecall which registers the whole region.
+ *          The ecall runs without the lock of the regions, the other blocks of the region wait for it to end.
+ * Parameters:
+ *     enclave: enclave
+ *     block: meta data of the block
+ * Return: CC_SUCCESS, success; others failed.
+ */
+cc_enclave_result_t gp_region_register_block(cc_enclave_t *enclave, gp_shared_memory_t *block);
+
+/*
+ * Summary: Unregister a block, the region stays registered for the other blocks.
+ * Parameters:
+ *     enclave: enclave
+ *     block: meta data of the block
+ * Return: CC_SUCCESS, success; others failed.
+ */
+cc_enclave_result_t gp_region_unregister_block(cc_enclave_t *enclave, gp_shared_memory_t *block);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "secgear_channel.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "secgear_shared_memory.h"
+#include "secgear_channel_defs.h"
+
+#define CHANNEL_SPIN_COUNT 2000
+/*
+ * The enclave cannot wake a futex of the host, so a sleeping host thread wakes up at least this often to look at
+ * the doorbell, which the enclave rings by bumping its sequence.
+ */
+#define CHANNEL_DOORBELL_POLL_NS (1000 * 1000)
+#define NS_PER_MS (1000 * 1000)
+#define NS_PER_SEC (1000 * 1000 * 1000)
+
+struct _cc_channel {
+    channel_ring_t ring;
+    cc_enclave_t *enclave;
+    void *shared_buf;
+    size_t shared_len;
+};
+
+cc_enclave_result_t cc_channel_create(cc_enclave_t *enclave, uint32_t capacity, uint32_t slot_size,
+    uint32_t flags, cc_channel_t **channel)
+{
+    if (enclave == NULL || channel == NULL || !channel_ring_geometry_valid(capacity, slot_size, flags)) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    cc_channel_t *tmp = (cc_channel_t *)calloc(1, sizeof(cc_channel_t));
+    if (tmp == NULL) {
+        return CC_ERROR_OUT_OF_MEMORY;
+    }
+
+    tmp->shared_len = CHANNEL_RING_SIZE(capacity, slot_size);
+    tmp->shared_buf = cc_malloc_shared_memory(enclave, tmp->shared_len);
+    if (tmp->shared_buf == NULL) {
+        free(tmp);
+        return CC_ERROR_OUT_OF_MEMORY;
+    }
+    tmp->enclave = enclave;
+
+    channel_ring_format(tmp->shared_buf, capacity, slot_size, flags);
+    (void)channel_ring_attach(&tmp->ring, tmp->shared_buf, tmp->shared_len, capacity, slot_size);
+
+    *channel = tmp;
+    return CC_SUCCESS;
+}
+
+cc_enclave_result_t cc_channel_destroy(cc_channel_t *channel)
+{
+    if (channel == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    cc_enclave_result_t ret = cc_free_shared_memory(channel->enclave, channel->shared_buf);
+    free(channel);
+    return ret;
+}
+
+cc_enclave_result_t cc_channel_get_shared_memory(cc_channel_t *channel, void **addr, size_t *len)
+{
+    if (channel == NULL || addr == NULL || len == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    *addr = channel->shared_buf;
+    *len = channel->shared_len;
+    return CC_SUCCESS;
+}
+
+static void wake_waiters(cc_channel_t *channel)
+{
+    if (channel_ring_doorbell(&channel->ring)) {
+        (void)syscall(SYS_futex, &channel->ring.hdr->doorbell.seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+cc_enclave_result_t cc_channel_send_batch(cc_channel_t *channel, const void *const *records,
+    const uint32_t *lens, uint32_t count, uint32_t *sent)
+{
+    if (channel == NULL || records == NULL || lens == NULL || sent == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        if (records[i] == NULL || lens[i] > channel->ring.slot_size) {
+            return CC_ERROR_BAD_PARAMETERS;
+        }
+    }
+
+    *sent = channel_ring_enqueue(&channel->ring, records, lens, count);
+    if (*sent != 0) {
+        wake_waiters(channel);
+    }
+    return CC_SUCCESS;
+}
+
+cc_enclave_result_t cc_channel_recv_batch(cc_channel_t *channel, void *const *bufs, uint32_t *lens,
+    uint32_t count, uint32_t *received)
+{
+    if (channel == NULL || bufs == NULL || lens == NULL || received == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        if (bufs[i] == NULL) {
+            return CC_ERROR_BAD_PARAMETERS;
+        }
+    }
+
+    *received = channel_ring_dequeue(&channel->ring, bufs, lens, count);
+    if (*received != 0) {
+        wake_waiters(channel);
+    }
+    return CC_SUCCESS;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* Retry the transfer until it moves one record, spinning first and then sleeping on the doorbell */
+static cc_enclave_result_t wait_for_transfer(cc_channel_t *channel, bool is_send, const void *record,
+    void *buf, uint32_t *len, uint32_t timeout_ms)
+{
+    channel_doorbell_t *doorbell = &channel->ring.hdr->doorbell;
+    uint64_t deadline = timeout_ms == CC_CHANNEL_WAIT_FOREVER ? UINT64_MAX :
+        now_ns() + (uint64_t)timeout_ms * NS_PER_MS;
+    uint32_t moved = 0;
+
+    for (uint32_t spin = 0;; ++spin) {
+        moved = is_send ? channel_ring_enqueue(&channel->ring, &record, len, 1) :
+            channel_ring_dequeue(&channel->ring, &buf, len, 1);
+        if (moved != 0) {
+            break;
+        }
+        if (timeout_ms == 0) {
+            return CC_ERROR_BUSY;
+        }
+        if (spin < CHANNEL_SPIN_COUNT) {
+            channel_cpu_relax();
+            continue;
+        }
+
+        uint64_t now = now_ns();
+        if (now >= deadline) {
+            return CC_ERROR_TIMEOUT;
+        }
+        uint64_t sleep_ns = deadline - now < CHANNEL_DOORBELL_POLL_NS ? deadline - now : CHANNEL_DOORBELL_POLL_NS;
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = (long)sleep_ns };
+
+        // Announce the waiter before the last check, so that the peer either sees it or we see the peer's progress
+        uint32_t seq = __atomic_load_n(&doorbell->seq, __ATOMIC_SEQ_CST);
+        (void)__atomic_add_fetch(&doorbell->waiters, 1, __ATOMIC_SEQ_CST);
+        moved = is_send ? channel_ring_enqueue(&channel->ring, &record, len, 1) :
+            channel_ring_dequeue(&channel->ring, &buf, len, 1);
+        if (moved == 0) {
+            (void)syscall(SYS_futex, &doorbell->seq, FUTEX_WAIT_PRIVATE, seq, &ts, NULL, 0);
+        }
+        (void)__atomic_sub_fetch(&doorbell->waiters, 1, __ATOMIC_SEQ_CST);
+        if (moved != 0) {
+            break;
+        }
+    }
+
+    wake_waiters(channel);
+    return CC_SUCCESS;
+}
+
+cc_enclave_result_t cc_channel_send(cc_channel_t *channel, const void *record, uint32_t len, uint32_t timeout_ms)
+{
+    if (channel == NULL || record == NULL || len > channel->ring.slot_size) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    return wait_for_transfer(channel, true, record, NULL, &len, timeout_ms);
+}
+
+cc_enclave_result_t cc_channel_recv(cc_channel_t *channel, void *buf, uint32_t buf_len, uint32_t *len,
+    uint32_t timeout_ms)
+{
+    if (channel == NULL || buf == NULL || len == NULL || buf_len < channel->ring.slot_size) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    return wait_for_transfer(channel, false, NULL, buf, len, timeout_ms);
+}
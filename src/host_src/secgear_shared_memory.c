@@ -25,8 +25,11 @@
     (enclave)->list_ops_node->ops_desc->ops->cc_register_shared_memory
 #define FUNC_UNREGISTER_SHARED_MEM(enclave) \
     (enclave)->list_ops_node->ops_desc->ops->cc_unregister_shared_memory
+#define FUNC_CREATE_SHARED_MEM_WITH_ATTR(enclave) \
+    (enclave)->list_ops_node->ops_desc->ops->cc_malloc_shared_memory_with_attr
 
-void *cc_malloc_shared_memory(cc_enclave_t *enclave, size_t size)
+static void *malloc_and_register_shared_memory(cc_enclave_t *enclave, size_t size,
+    const cc_shared_memory_attr_t *attr)
 {
     if (enclave == NULL || size == 0 || !enclave->used_flag) {
         return NULL;
@@ -35,12 +38,14 @@ void *cc_malloc_shared_memory(cc_enclave_t *enclave, size_t size)
     CC_RWLOCK_LOCK_RD(&enclave->rwlock);
 
     if (enclave->list_ops_node == NULL || FUNC_CREATE_SHARED_MEM(enclave) == NULL ||
-        FUNC_REGISTER_SHARED_MEM(enclave) == NULL || FUNC_FREE_SHARED_MEM(enclave) == NULL) {
+        FUNC_REGISTER_SHARED_MEM(enclave) == NULL || FUNC_FREE_SHARED_MEM(enclave) == NULL ||
+        (attr != NULL && FUNC_CREATE_SHARED_MEM_WITH_ATTR(enclave) == NULL)) {
         CC_RWLOCK_UNLOCK(&enclave->rwlock);
         return NULL;
     }
 
-    void *ptr = FUNC_CREATE_SHARED_MEM(enclave)(enclave, size, false);
+    void *ptr = attr != NULL ? FUNC_CREATE_SHARED_MEM_WITH_ATTR(enclave)(enclave, size, attr) :
+        FUNC_CREATE_SHARED_MEM(enclave)(enclave, size, false);
     if (ptr == NULL) {
         CC_RWLOCK_UNLOCK(&enclave->rwlock);
         return NULL;
@@ -58,6 +63,26 @@ void *cc_malloc_shared_memory(cc_enclave_t *enclave, size_t size)
     return ptr;
 }
 
+void *cc_malloc_shared_memory(cc_enclave_t *enclave, size_t size)
+{
+    return malloc_and_register_shared_memory(enclave, size, NULL);
+}
+
+void *cc_malloc_shared_memory_with_attr(cc_enclave_t *enclave, size_t size, const cc_shared_memory_attr_t *attr)
+{
+    if (attr != NULL && ((attr->flags & ~(uint32_t)CC_SHARED_MEMORY_FLAG_MASK) != 0 ||
+        ((attr->flags & CC_SHARED_MEMORY_FLAG_NUMA_BIND) &&
+        (attr->numa_node < 0 || attr->numa_node > CC_SHARED_MEMORY_MAX_NUMA_NODE)))) {
+        return NULL;
+    }
+
+    // Without any flag this is a plain allocation, which every engine supports
+    if (attr != NULL && attr->flags == 0) {
+        attr = NULL;
+    }
+    return malloc_and_register_shared_memory(enclave, size, attr);
+}
+
 cc_enclave_result_t cc_free_shared_memory(cc_enclave_t *enclave, void *ptr)
 {
     if (enclave == NULL || ptr == NULL) {
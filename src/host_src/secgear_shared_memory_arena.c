@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "secgear_shared_memory.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "status.h"
+#include "secgear_defs.h"
+#include "secgear_list.h"
+
+/*
+ * The arena is cut into pages. A page serves objects of one size class, classes larger than a page take several
+ * consecutive pages for one object. Every class has a lock-free global free stack, and every thread keeps a small
+ * cache of free objects per class, so the common path touches no shared cache line at all.
+ */
+#define ARENA_MIN_SHIFT         6   /* 64 B */
+#define ARENA_MAX_SHIFT         20  /* 1 MiB */
+#define ARENA_CLASS_NUM         (ARENA_MAX_SHIFT - ARENA_MIN_SHIFT + 1)
+#define ARENA_PAGE_SHIFT        16  /* 64 KiB */
+#define ARENA_PAGE_SIZE         ((size_t)1 << ARENA_PAGE_SHIFT)
+#define ARENA_CACHE_DEPTH       32
+#define ARENA_LARGE_CACHE_DEPTH 2
+#define ARENA_PAGE_UNUSED       0xff
+#define ARENA_ALIGN             ((size_t)1 << ARENA_MIN_SHIFT)
+
+#define ALIGN_UP(x, align) (((x) + (align) - 1) & ~((size_t)(align) - 1))
+#define CLASS_SIZE(cls) ((size_t)1 << ((cls) + ARENA_MIN_SHIFT))
+
+/* Free objects are linked by index (offset / ARENA_ALIGN + 1), the high half of a stack head is an ABA tag */
+#define STACK_TOP(head) ((uint32_t)(head))
+#define STACK_TAG(head) ((head) >> 32)
+#define STACK_HEAD(tag, top) (((uint64_t)(tag) << 32) | (top))
+
+struct _shared_memory_arena {
+    cc_enclave_t *enclave;
+    void *raw_buf; // buffer returned by cc_malloc_shared_memory
+    char *base; // aligned start of the pages
+    size_t page_num;
+    size_t next_page; // first page that has not been carved yet
+    uint8_t *page_class; // size class of each carved page
+    uint64_t free_stack[ARENA_CLASS_NUM];
+    pthread_key_t cache_key;
+    pthread_mutex_t cache_lock;
+    list_head_t caches;
+};
+
+typedef struct {
+    list_node_t node;
+    cc_shared_memory_arena_t *arena;
+    uint32_t cnt[ARENA_CLASS_NUM];
+    uint32_t objs[ARENA_CLASS_NUM][ARENA_CACHE_DEPTH];
+    size_t carve_cur[ARENA_CLASS_NUM]; // next object offset in the page being carved
+    size_t carve_end[ARENA_CLASS_NUM];
+} arena_thread_cache_t;
+
+static inline uint32_t size_to_class(size_t size)
+{
+    if (size <= ARENA_ALIGN) {
+        return 0;
+    }
+    uint32_t shift = (uint32_t)(sizeof(unsigned long) * 8) - (uint32_t)__builtin_clzl((unsigned long)(size - 1));
+    return shift - ARENA_MIN_SHIFT;
+}
+
+static inline uint32_t cache_limit(uint32_t cls)
+{
+    return CLASS_SIZE(cls) < ARENA_PAGE_SIZE ? ARENA_CACHE_DEPTH : ARENA_LARGE_CACHE_DEPTH;
+}
+
+static inline uint32_t *obj_link(const cc_shared_memory_arena_t *arena, uint32_t idx)
+{
+    return (uint32_t *)(arena->base + (size_t)(idx - 1) * ARENA_ALIGN);
+}
+
+static void stack_push(cc_shared_memory_arena_t *arena, uint32_t cls, uint32_t idx)
+{
+    uint64_t *head = &arena->free_stack[cls];
+    uint64_t old = __atomic_load_n(head, __ATOMIC_RELAXED);
+    uint64_t new_head;
+
+    do {
+        __atomic_store_n(obj_link(arena, idx), STACK_TOP(old), __ATOMIC_RELAXED);
+        new_head = STACK_HEAD(STACK_TAG(old) + 1, idx);
+    } while (!__atomic_compare_exchange_n(head, &old, new_head, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static uint32_t stack_pop(cc_shared_memory_arena_t *arena, uint32_t cls)
+{
+    uint64_t *head = &arena->free_stack[cls];
+    uint64_t old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+    uint64_t new_head;
+
+    do {
+        if (STACK_TOP(old) == 0) {
+            return 0;
+        }
+        // The object may be popped concurrently, the tag makes the CAS fail in that case
+        uint32_t next = __atomic_load_n(obj_link(arena, STACK_TOP(old)), __ATOMIC_RELAXED);
+        new_head = STACK_HEAD(STACK_TAG(old) + 1, next);
+    } while (!__atomic_compare_exchange_n(head, &old, new_head, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return STACK_TOP(old);
+}
+
+static bool reserve_pages(cc_shared_memory_arena_t *arena, size_t num, size_t *first)
+{
+    size_t cur = __atomic_load_n(&arena->next_page, __ATOMIC_RELAXED);
+
+    do {
+        if (cur + num > arena->page_num) {
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(&arena->next_page, &cur, cur + num, true,
+        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    *first = cur;
+    return true;
+}
+
+static uint32_t carve_obj(cc_shared_memory_arena_t *arena, arena_thread_cache_t *cache, uint32_t cls)
+{
+    size_t page;
+    size_t cls_size = CLASS_SIZE(cls);
+
+    if (cls_size >= ARENA_PAGE_SIZE) {
+        if (!reserve_pages(arena, cls_size >> ARENA_PAGE_SHIFT, &page)) {
+            return 0;
+        }
+        __atomic_store_n(&arena->page_class[page], (uint8_t)cls, __ATOMIC_RELAXED);
+        return (uint32_t)((page << ARENA_PAGE_SHIFT) / ARENA_ALIGN + 1);
+    }
+
+    if (cache->carve_cur[cls] == cache->carve_end[cls]) {
+        if (!reserve_pages(arena, 1, &page)) {
+            return 0;
+        }
+        __atomic_store_n(&arena->page_class[page], (uint8_t)cls, __ATOMIC_RELAXED);
+        cache->carve_cur[cls] = page << ARENA_PAGE_SHIFT;
+        cache->carve_end[cls] = cache->carve_cur[cls] + ARENA_PAGE_SIZE;
+    }
+
+    uint32_t idx = (uint32_t)(cache->carve_cur[cls] / ARENA_ALIGN + 1);
+    cache->carve_cur[cls] += cls_size;
+    return idx;
+}
+
+static void flush_thread_cache(cc_shared_memory_arena_t *arena, arena_thread_cache_t *cache)
+{
+    for (uint32_t cls = 0; cls < ARENA_CLASS_NUM; ++cls) {
+        while (cache->cnt[cls] > 0) {
+            stack_push(arena, cls, cache->objs[cls][--cache->cnt[cls]]);
+        }
+        // Hand the rest of a partially carved page to the other threads
+        while (cache->carve_cur[cls] < cache->carve_end[cls]) {
+            stack_push(arena, cls, (uint32_t)(cache->carve_cur[cls] / ARENA_ALIGN + 1));
+            cache->carve_cur[cls] += CLASS_SIZE(cls);
+        }
+    }
+}
+
+static void destroy_thread_cache(void *data)
+{
+    arena_thread_cache_t *cache = (arena_thread_cache_t *)data;
+    cc_shared_memory_arena_t *arena = cache->arena;
+
+    flush_thread_cache(arena, cache);
+
+    CC_MUTEX_LOCK(&arena->cache_lock);
+    list_remove(&cache->node);
+    CC_MUTEX_UNLOCK(&arena->cache_lock);
+    free(cache);
+}
+
+static arena_thread_cache_t *get_thread_cache(cc_shared_memory_arena_t *arena)
+{
+    arena_thread_cache_t *cache = (arena_thread_cache_t *)pthread_getspecific(arena->cache_key);
+    if (cache != NULL) {
+        return cache;
+    }
+
+    cache = (arena_thread_cache_t *)calloc(1, sizeof(arena_thread_cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->arena = arena;
+    if (pthread_setspecific(arena->cache_key, cache) != 0) {
+        free(cache);
+        return NULL;
+    }
+
+    CC_MUTEX_LOCK(&arena->cache_lock);
+    list_add_after(&cache->node, &arena->caches);
+    CC_MUTEX_UNLOCK(&arena->cache_lock);
+    return cache;
+}
+
+cc_enclave_result_t cc_create_shared_memory_arena(cc_enclave_t *enclave, size_t size,
+    cc_shared_memory_arena_t **arena)
+{
+    return cc_create_shared_memory_arena_with_attr(enclave, size, NULL, arena);
+}
+
+cc_enclave_result_t cc_create_shared_memory_arena_with_attr(cc_enclave_t *enclave, size_t size,
+    const cc_shared_memory_attr_t *attr, cc_shared_memory_arena_t **arena)
+{
+    cc_enclave_result_t ret = CC_ERROR_OUT_OF_MEMORY;
+
+    if (enclave == NULL || arena == NULL || size == 0 ||
+        size > ((size_t)UINT32_MAX - 1) * ARENA_ALIGN - ARENA_PAGE_SIZE) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+    size = ALIGN_UP(size, ARENA_PAGE_SIZE);
+
+    cc_shared_memory_arena_t *tmp = (cc_shared_memory_arena_t *)calloc(1, sizeof(cc_shared_memory_arena_t));
+    if (tmp == NULL) {
+        return CC_ERROR_OUT_OF_MEMORY;
+    }
+    tmp->enclave = enclave;
+    tmp->page_num = size >> ARENA_PAGE_SHIFT;
+    CC_MUTEX_INIT(&tmp->cache_lock, NULL);
+    list_init(&tmp->caches);
+
+    tmp->page_class = (uint8_t *)malloc(tmp->page_num);
+    if (tmp->page_class == NULL) {
+        goto cleanup;
+    }
+    (void)memset(tmp->page_class, ARENA_PAGE_UNUSED, tmp->page_num);
+
+    if (pthread_key_create(&tmp->cache_key, destroy_thread_cache) != 0) {
+        goto cleanup;
+    }
+
+    // Allocating and registering happen only once for the whole arena
+    tmp->raw_buf = cc_malloc_shared_memory_with_attr(enclave, size + ARENA_ALIGN, attr);
+    if (tmp->raw_buf == NULL) {
+        (void)pthread_key_delete(tmp->cache_key);
+        goto cleanup;
+    }
+    tmp->base = (char *)ALIGN_UP((size_t)tmp->raw_buf, ARENA_ALIGN);
+
+    *arena = tmp;
+    return CC_SUCCESS;
+
+cleanup:
+    free(tmp->page_class);
+    CC_MUTEX_DESTROY(&tmp->cache_lock);
+    free(tmp);
+    return ret;
+}
+
+cc_enclave_result_t cc_destroy_shared_memory_arena(cc_shared_memory_arena_t *arena)
+{
+    list_node_t *cur = NULL;
+    list_node_t *tmp = NULL;
+
+    if (arena == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    // Deleting the key does not run destructors, the caches are released here instead
+    (void)pthread_key_delete(arena->cache_key);
+    CC_MUTEX_LOCK(&arena->cache_lock);
+    list_for_each_safe(cur, tmp, &arena->caches) {
+        list_remove(cur);
+        free(list_entry(cur, arena_thread_cache_t, node));
+    }
+    CC_MUTEX_UNLOCK(&arena->cache_lock);
+
+    cc_enclave_result_t ret = cc_free_shared_memory(arena->enclave, arena->raw_buf);
+
+    free(arena->page_class);
+    CC_MUTEX_DESTROY(&arena->cache_lock);
+    free(arena);
+    return ret;
+}
+
+void *cc_arena_malloc_shared_memory(cc_shared_memory_arena_t *arena, size_t size)
+{
+    if (arena == NULL || size == 0 || size > CC_SHARED_MEMORY_ARENA_MAX_ALLOC_SIZE) {
+        return NULL;
+    }
+
+    arena_thread_cache_t *cache = get_thread_cache(arena);
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    uint32_t cls = size_to_class(size);
+    uint32_t idx = 0;
+    if (cache->cnt[cls] > 0) {
+        idx = cache->objs[cls][--cache->cnt[cls]];
+    } else {
+        // Refill half of the cache from the global stack before carving new pages
+        uint32_t refill = cache_limit(cls) / 2;
+        while (cache->cnt[cls] < refill) {
+            uint32_t obj = stack_pop(arena, cls);
+            if (obj == 0) {
+                break;
+            }
+            cache->objs[cls][cache->cnt[cls]++] = obj;
+        }
+        idx = cache->cnt[cls] > 0 ? cache->objs[cls][--cache->cnt[cls]] : carve_obj(arena, cache, cls);
+    }
+
+    return idx == 0 ? NULL : arena->base + (size_t)(idx - 1) * ARENA_ALIGN;
+}
+
+cc_enclave_result_t cc_arena_free_shared_memory(cc_shared_memory_arena_t *arena, void *ptr)
+{
+    if (arena == NULL || ptr == NULL) {
+        return CC_ERROR_BAD_PARAMETERS;
+    }
+
+    size_t offset = (size_t)((char *)ptr - arena->base);
+    if ((char *)ptr < arena->base || offset >= (arena->page_num << ARENA_PAGE_SHIFT)) {
+        return CC_ERROR_SHARED_MEMORY_START_ADDR_INVALID;
+    }
+
+    uint8_t cls = __atomic_load_n(&arena->page_class[offset >> ARENA_PAGE_SHIFT], __ATOMIC_RELAXED);
+    if (cls == ARENA_PAGE_UNUSED || (offset & (CLASS_SIZE(cls) < ARENA_PAGE_SIZE ?
+        CLASS_SIZE(cls) - 1 : ARENA_PAGE_SIZE - 1)) != 0) {
+        return CC_ERROR_SHARED_MEMORY_START_ADDR_INVALID;
+    }
+
+    arena_thread_cache_t *cache = get_thread_cache(arena);
+    uint32_t idx = (uint32_t)(offset / ARENA_ALIGN + 1);
+    if (cache == NULL) {
+        stack_push(arena, cls, idx);
+        return CC_SUCCESS;
+    }
+
+    // Return half of a full cache to the global stack, so that other threads can reuse them
+    uint32_t limit = cache_limit(cls);
+    if (cache->cnt[cls] == limit) {
+        while (cache->cnt[cls] > limit / 2) {
+            stack_push(arena, cls, cache->objs[cls][--cache->cnt[cls]]);
+        }
+    }
+    cache->objs[cls][cache->cnt[cls]++] = idx;
+    return CC_SUCCESS;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * The sealed key-value store against the host file store in one process, the ocalls are plain calls and the sealing
+ * of iTrustee runs on the stub TEE api.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/rand.h>
+
+#include "sealed_kv_enclave.h"
+#include "sealed_kv_host.h"
+#include "secgear_random.h"
+
+int g_llt_ocall_num = 0;
+
+cc_enclave_result_t cc_enclave_generate_random(void *buffer, size_t size)
+{
+    return RAND_bytes(buffer, (int)size) == 1 ? CC_SUCCESS : CC_FAIL;
+}
+
+#define LLT_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return -1; \
+        } \
+    } while (0)
+
+#define LLT_STORE "llt"
+#define LLT_KEY_NUM 100
+
+static char g_dir[] = "/tmp/sealed_kv_llt_XXXXXX";
+static char g_path[sizeof(g_dir) + sizeof("/" LLT_STORE CC_SEALED_KV_FILE_SUFFIX)];
+static char g_compact_path[sizeof(g_path) + sizeof(CC_SEALED_KV_COMPACT_SUFFIX)];
+
+static long file_size(void)
+{
+    struct stat st;
+    return stat(g_path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static cc_enclave_result_t put_str(cc_sealed_kv_t *kv, const char *key, const char *value)
+{
+    return cc_sealed_kv_put(kv, (const uint8_t *)key, (uint32_t)strlen(key), (const uint8_t *)value,
+        (uint32_t)strlen(value));
+}
+
+/* Whether key holds value */
+static int has_value(cc_sealed_kv_t *kv, const char *key, const char *value)
+{
+    char buf[64] = {0};
+    uint32_t len = sizeof(buf) - 1;
+
+    if (cc_sealed_kv_get(kv, (const uint8_t *)key, (uint32_t)strlen(key), (uint8_t *)buf, &len) != CC_SUCCESS) {
+        return 0;
+    }
+    return len == strlen(value) && memcmp(buf, value, len) == 0;
+}
+
+static int test_put_get(void)
+{
+    cc_sealed_kv_t *kv = NULL;
+    cc_sealed_kv_op_t ops[LLT_KEY_NUM];
+    char keys[LLT_KEY_NUM][16];
+    char values[LLT_KEY_NUM][32];
+
+    LLT_CHECK(cc_sealed_kv_open(LLT_STORE, NULL, &kv) == CC_SUCCESS);
+    for (int i = 0; i < LLT_KEY_NUM; i++) {
+        (void)snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+        (void)snprintf(values[i], sizeof(values[i]), "value%d", i);
+        ops[i] = (cc_sealed_kv_op_t){CC_SEALED_KV_OP_PUT, (uint8_t *)keys[i], (uint32_t)strlen(keys[i]),
+            (uint8_t *)values[i], (uint32_t)strlen(values[i])};
+    }
+    // a batch is one append, a lookup one read
+    g_llt_ocall_num = 0;
+    LLT_CHECK(cc_sealed_kv_write(kv, ops, LLT_KEY_NUM) == CC_SUCCESS);
+    LLT_CHECK(g_llt_ocall_num == 1);
+    g_llt_ocall_num = 0;
+    LLT_CHECK(has_value(kv, "key42", "value42"));
+    LLT_CHECK(g_llt_ocall_num == 1);
+
+    // a size probe costs no ocall
+    uint32_t len = 0;
+    g_llt_ocall_num = 0;
+    LLT_CHECK(cc_sealed_kv_get(kv, (const uint8_t *)"key1", 4, NULL, &len) == CC_SUCCESS && len == 6);
+    LLT_CHECK(g_llt_ocall_num == 0);
+    char buf[4];
+    len = sizeof(buf);
+    LLT_CHECK(cc_sealed_kv_get(kv, (const uint8_t *)"key1", 4, (uint8_t *)buf, &len) == CC_ERROR_SHORT_BUFFER &&
+        len == 6);
+    len = 1;
+    LLT_CHECK(cc_sealed_kv_get(kv, (const uint8_t *)"key1", 4, NULL, &len) == CC_ERROR_BAD_PARAMETERS);
+
+    LLT_CHECK(cc_sealed_kv_delete(kv, (const uint8_t *)"key1", 4) == CC_SUCCESS);
+    len = 0;
+    LLT_CHECK(cc_sealed_kv_get(kv, (const uint8_t *)"key1", 4, NULL, &len) == CC_ERROR_ITEM_NOT_FOUND);
+    LLT_CHECK(put_str(kv, "key2", "new2") == CC_SUCCESS);
+    cc_sealed_kv_close(kv);
+
+    // the index is rebuilt from the log
+    LLT_CHECK(cc_sealed_kv_open(LLT_STORE, NULL, &kv) == CC_SUCCESS);
+    cc_sealed_kv_stats_t stats;
+    LLT_CHECK(cc_sealed_kv_get_stats(kv, &stats) == CC_SUCCESS);
+    LLT_CHECK(stats.key_num == LLT_KEY_NUM - 1 && stats.log_bytes == (uint64_t)file_size());
+    LLT_CHECK(has_value(kv, "key2", "new2") && has_value(kv, "key99", "value99"));
+    LLT_CHECK(!has_value(kv, "key1", "value1"));
+    cc_sealed_kv_close(kv);
+    return 0;
+}
+
+static int test_torn_tail(void)
+{
+    cc_sealed_kv_t *kv = NULL;
+
+    LLT_CHECK(cc_sealed_kv_open(LLT_STORE, NULL, &kv) == CC_SUCCESS);
+    long good_len = file_size();
+    LLT_CHECK(put_str(kv, "torn", "lost") == CC_SUCCESS);
+    long full_len = file_size();
+    cc_sealed_kv_close(kv);
+
+    // a crash in the middle of the last append, the rest of the log survives
+    LLT_CHECK(truncate(g_path, full_len - 1) == 0);
+    LLT_CHECK(cc_sealed_kv_open(LLT_STORE, NULL, &kv) == CC_SUCCESS);
+    LLT_CHECK(file_size() == good_len);
+    LLT_CHECK(!has_value(kv, "torn", "lost") && has_value(kv, "key2", "new2"));
+    cc_sealed_kv_close(kv);
+
+    // the file grew before the data reached the disk
+    LLT_CHECK(truncate(g_path, good_len + 4096) == 0);
+    LLT_CHECK(cc_sealed_kv_open(LLT_STORE, NULL, &kv) == CC_SUCCESS);
+    LLT_CHECK(file_size() == good_len);
+    LLT_CHECK(put_str(kv, "torn", "bad") == CC_SUCCESS);
+    full_len = file_size();
+    cc_sealed_kv_close(kv);
+
+    // a complete last frame which does not verify is damage, not a torn write
+    long flip_pos = good_len + (full_len - good_len) / 2;
+    FILE *file = fopen(g_path, "r+");
+    LLT_CHECK(file != NULL);
+    LLT_CHECK(fseek(file, flip_pos, SEEK_SET) == 0);
+    int c = fgetc(file);
+    LLT_CHECK(fseek(file, flip_pos, SEEK_SET) == 0 && fputc(c ^ 1, file) != EOF);
+    LLT_CHECK(fclose(file) == 0);
+    LLT_CHECK(cc_sealed_kv_open(LLT_STORE, NULL, &kv) == CC_ERROR_CORRUPT_OBJECT);
+    LLT_CHECK(file_size() == full_len);
+
+    LLT_CHECK(truncate(g_path, good_len) == 0);
+    LLT_CHECK(cc_sealed_kv_open(LLT_STORE, NULL, &kv) == CC_SUCCESS);
+    cc_sealed_kv_close(kv);
+    return 0;
+}
+
+static int test_compact(void)
+{
+    cc_sealed_kv_t *kv = NULL;
+    cc_sealed_kv_config_t config = {4096, 2};
+    cc_sealed_kv_stats_t stats;
+    char value[16];
+
+    LLT_CHECK(cc_sealed_kv_open(LLT_STORE, &config, &kv) == CC_SUCCESS);
+    for (int i = 0; i < LLT_KEY_NUM; i++) {
+        (void)snprintf(value, sizeof(value), "hot%d", i);
+        LLT_CHECK(put_str(kv, "hot", value) == CC_SUCCESS);
+    }
+    // writes leave the compaction to the caller
+    LLT_CHECK(cc_sealed_kv_get_stats(kv, &stats) == CC_SUCCESS);
+    LLT_CHECK(stats.need_compact && stats.compact_num == 0);
+
+    // the host can not create the new log, the flag waits for the log to grow by compact_min_size
+    LLT_CHECK(mkdir(g_compact_path, S_IRWXU) == 0);
+    LLT_CHECK(cc_sealed_kv_compact(kv) != CC_SUCCESS);
+    LLT_CHECK(rmdir(g_compact_path) == 0);
+    LLT_CHECK(cc_sealed_kv_get_stats(kv, &stats) == CC_SUCCESS);
+    LLT_CHECK(!stats.need_compact && stats.compact_fail_num == 1 && stats.log_bytes == (uint64_t)file_size());
+    uint64_t fail_len = stats.log_bytes;
+    while (stats.log_bytes < fail_len + config.compact_min_size) {
+        LLT_CHECK(!stats.need_compact);
+        LLT_CHECK(put_str(kv, "hot", "hot99") == CC_SUCCESS);
+        LLT_CHECK(cc_sealed_kv_get_stats(kv, &stats) == CC_SUCCESS);
+    }
+    LLT_CHECK(stats.need_compact);
+
+    LLT_CHECK(cc_sealed_kv_compact(kv) == CC_SUCCESS);
+    LLT_CHECK(cc_sealed_kv_get_stats(kv, &stats) == CC_SUCCESS);
+    LLT_CHECK(stats.compact_num == 1 && !stats.need_compact && stats.log_bytes == (uint64_t)file_size());
+    LLT_CHECK(has_value(kv, "hot", "hot99") && has_value(kv, "key50", "value50"));
+    cc_sealed_kv_close(kv);
+
+    // the compacted log is a log of its own
+    LLT_CHECK(cc_sealed_kv_open(LLT_STORE, &config, &kv) == CC_SUCCESS);
+    LLT_CHECK(cc_sealed_kv_get_stats(kv, &stats) == CC_SUCCESS);
+    LLT_CHECK(stats.key_num == LLT_KEY_NUM);
+    LLT_CHECK(has_value(kv, "hot", "hot99") && has_value(kv, "key2", "new2") && !has_value(kv, "key1", "value1"));
+    cc_sealed_kv_close(kv);
+    return 0;
+}
+
+int main(void)
+{
+    if (mkdtemp(g_dir) == NULL || cc_sealed_kv_host_init(g_dir) != CC_SUCCESS) {
+        printf("failed to init the store directory\n");
+        return 1;
+    }
+    (void)snprintf(g_path, sizeof(g_path), "%s/%s%s", g_dir, LLT_STORE, CC_SEALED_KV_FILE_SUFFIX);
+    (void)snprintf(g_compact_path, sizeof(g_compact_path), "%s%s", g_path, CC_SEALED_KV_COMPACT_SUFFIX);
+
+    int ret = test_put_get();
+    printf("test_put_get %s\n", ret == 0 ? "success" : "failed");
+    if (ret == 0) {
+        ret = test_torn_tail();
+        printf("test_torn_tail %s\n", ret == 0 ? "success" : "failed");
+    }
+    if (ret == 0) {
+        ret = test_compact();
+        printf("test_compact %s\n", ret == 0 ? "success" : "failed");
+    }
+
+    cc_sealed_kv_host_fini();
+    (void)unlink(g_path);
+    (void)rmdir(g_dir);
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * The ocalls of sealed_kv.edl as the enclave calls them, each one calls the host function in place and counts the
+ * ocalls in g_llt_ocall_num.
+ */
+#ifndef SEALED_KV_T_H
+#define SEALED_KV_T_H
+
+#include "status.h"
+#include "sealed_kv_u.h"
+
+extern int g_llt_ocall_num;
+
+#define LLT_OCALL(retval, call) (g_llt_ocall_num++, *(retval) = (call), CC_SUCCESS)
+
+static inline cc_enclave_result_t llt_file_open(int *retval, char *name, size_t name_len, int *handle,
+    uint64_t *file_len)
+{
+    return LLT_OCALL(retval, sealed_kv_file_open(name, name_len, handle, file_len));
+}
+
+static inline cc_enclave_result_t llt_file_close(int *retval, int handle)
+{
+    return LLT_OCALL(retval, sealed_kv_file_close(handle));
+}
+
+static inline cc_enclave_result_t llt_file_append(int *retval, int handle, uint64_t file_len, uint8_t *buf, size_t len)
+{
+    return LLT_OCALL(retval, sealed_kv_file_append(handle, file_len, buf, len));
+}
+
+static inline cc_enclave_result_t llt_file_read(int *retval, int handle, uint64_t offset, uint8_t *buf, size_t len)
+{
+    return LLT_OCALL(retval, sealed_kv_file_read(handle, offset, buf, len));
+}
+
+static inline cc_enclave_result_t llt_file_truncate(int *retval, int handle, uint64_t file_len)
+{
+    return LLT_OCALL(retval, sealed_kv_file_truncate(handle, file_len));
+}
+
+static inline cc_enclave_result_t llt_file_compact_begin(int *retval, int handle)
+{
+    return LLT_OCALL(retval, sealed_kv_file_compact_begin(handle));
+}
+
+static inline cc_enclave_result_t llt_file_compact_append(int *retval, int handle, uint8_t *buf, size_t len)
+{
+    return LLT_OCALL(retval, sealed_kv_file_compact_append(handle, buf, len));
+}
+
+static inline cc_enclave_result_t llt_file_compact_end(int *retval, int handle, int is_commit)
+{
+    return LLT_OCALL(retval, sealed_kv_file_compact_end(handle, is_commit));
+}
+
+#define sealed_kv_file_open llt_file_open
+#define sealed_kv_file_close llt_file_close
+#define sealed_kv_file_append llt_file_append
+#define sealed_kv_file_read llt_file_read
+#define sealed_kv_file_truncate llt_file_truncate
+#define sealed_kv_file_compact_begin llt_file_compact_begin
+#define sealed_kv_file_compact_append llt_file_compact_append
+#define sealed_kv_file_compact_end llt_file_compact_end
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/* The ocalls of sealed_kv.edl as the host implements them, the llt runs the enclave and the host in one process */
+#ifndef SEALED_KV_U_H
+#define SEALED_KV_U_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+int sealed_kv_file_open(char *name, size_t name_len, int *handle, uint64_t *file_len);
+int sealed_kv_file_close(int handle);
+int sealed_kv_file_append(int handle, uint64_t file_len, uint8_t *buf, size_t len);
+int sealed_kv_file_read(int handle, uint64_t offset, uint8_t *buf, size_t len);
+int sealed_kv_file_truncate(int handle, uint64_t file_len);
+int sealed_kv_file_compact_begin(int handle);
+int sealed_kv_file_compact_append(int handle, uint8_t *buf, size_t len);
+int sealed_kv_file_compact_end(int handle, int is_commit);
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * The part of the iTrustee TA api used by the sealing of itrustee_seal_data.c, implemented on openssl by
+ * tee_stub.c. The key of the TA is derived from a fixed secret.
+ */
+#ifndef TEE_EXT_API_H
+#define TEE_EXT_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TEE_Result;
+typedef struct tee_stub_object *TEE_ObjectHandle;
+typedef struct tee_stub_operation *TEE_OperationHandle;
+
+typedef struct {
+    uint32_t attributeID;
+    void *buffer;
+    size_t length;
+} TEE_Attribute;
+
+#define TEE_SUCCESS 0x00000000
+#define TEE_ERROR_GENERIC 0xFFFF0000
+#define TEE_ERROR_BAD_PARAMETERS 0xFFFF0006
+#define TEE_ERROR_WRITE_DATA 0xFFFF0007
+#define TEE_ERROR_OUT_OF_MEMORY 0xFFFF000C
+#define TEE_ERROR_MAC_INVALID 0xFFFF3071
+
+#define TEE_TYPE_AES 0xA0000010
+#define TEE_ATTR_SECRET_VALUE 0xC0000000
+#define TEE_ALG_AES_GCM 0x40000810
+#define TEE_MODE_ENCRYPT 0
+#define TEE_MODE_DECRYPT 1
+
+TEE_Result TEE_AllocateTransientObject(uint32_t object_type, uint32_t max_object_size, TEE_ObjectHandle *object);
+void TEE_FreeTransientObject(TEE_ObjectHandle object);
+void TEE_InitRefAttribute(TEE_Attribute *attr, uint32_t attribute_id, void *buffer, size_t length);
+TEE_Result TEE_PopulateTransientObject(TEE_ObjectHandle object, TEE_Attribute *attrs, uint32_t attr_count);
+
+TEE_Result TEE_AllocateOperation(TEE_OperationHandle *operation, uint32_t algorithm, uint32_t mode,
+    uint32_t max_key_size);
+void TEE_FreeOperation(TEE_OperationHandle operation);
+TEE_Result TEE_SetOperationKey(TEE_OperationHandle operation, TEE_ObjectHandle key);
+TEE_Result TEE_AEInit(TEE_OperationHandle operation, void *nonce, size_t nonce_len, uint32_t tag_len,
+    size_t aad_len, size_t payload_len);
+void TEE_AEUpdateAAD(TEE_OperationHandle operation, void *aad, size_t aad_len);
+TEE_Result TEE_AEEncryptFinal(TEE_OperationHandle operation, void *src, size_t src_len, void *dest, size_t *dest_len,
+    void *tag, size_t *tag_len);
+TEE_Result TEE_AEDecryptFinal(TEE_OperationHandle operation, void *src, size_t src_len, void *dest, size_t *dest_len,
+    void *tag, size_t tag_len);
+
+void TEE_GenerateRandom(void *buffer, size_t size);
+TEE_Result TEE_EXT_DeriveTARootKey(const uint8_t *salt, uint32_t size, uint8_t *key, uint32_t key_size);
+
+void *TEE_Malloc(size_t size, uint32_t hint);
+void TEE_Free(void *buffer);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include "tee_ext_api.h"
+
+#define STUB_KEY_LEN 32
+#define STUB_NONCE_MAX_LEN 16
+#define STUB_AAD_MAX_LEN 256
+#define STUB_TAG_LEN 16
+
+struct tee_stub_object {
+    uint8_t key[STUB_KEY_LEN];
+};
+
+struct tee_stub_operation {
+    uint32_t mode;
+    uint8_t key[STUB_KEY_LEN];
+    uint8_t nonce[STUB_NONCE_MAX_LEN];
+    size_t nonce_len;
+    uint8_t aad[STUB_AAD_MAX_LEN];
+    size_t aad_len;
+};
+
+TEE_Result TEE_AllocateTransientObject(uint32_t object_type, uint32_t max_object_size, TEE_ObjectHandle *object)
+{
+    (void)object_type;
+    (void)max_object_size;
+    *object = calloc(1, sizeof(struct tee_stub_object));
+    return *object == NULL ? TEE_ERROR_OUT_OF_MEMORY : TEE_SUCCESS;
+}
+
+void TEE_FreeTransientObject(TEE_ObjectHandle object)
+{
+    free(object);
+}
+
+void TEE_InitRefAttribute(TEE_Attribute *attr, uint32_t attribute_id, void *buffer, size_t length)
+{
+    attr->attributeID = attribute_id;
+    attr->buffer = buffer;
+    attr->length = length;
+}
+
+TEE_Result TEE_PopulateTransientObject(TEE_ObjectHandle object, TEE_Attribute *attrs, uint32_t attr_count)
+{
+    if (attr_count != 1 || attrs[0].length != STUB_KEY_LEN) {
+        return TEE_ERROR_BAD_PARAMETERS;
+    }
+    (void)memcpy(object->key, attrs[0].buffer, STUB_KEY_LEN);
+    return TEE_SUCCESS;
+}
+
+TEE_Result TEE_AllocateOperation(TEE_OperationHandle *operation, uint32_t algorithm, uint32_t mode,
+    uint32_t max_key_size)
+{
+    (void)algorithm;
+    (void)max_key_size;
+    *operation = calloc(1, sizeof(struct tee_stub_operation));
+    if (*operation == NULL) {
+        return TEE_ERROR_OUT_OF_MEMORY;
+    }
+    (*operation)->mode = mode;
+    return TEE_SUCCESS;
+}
+
+void TEE_FreeOperation(TEE_OperationHandle operation)
+{
+    free(operation);
+}
+
+TEE_Result TEE_SetOperationKey(TEE_OperationHandle operation, TEE_ObjectHandle key)
+{
+    (void)memcpy(operation->key, key->key, STUB_KEY_LEN);
+    return TEE_SUCCESS;
+}
+
+TEE_Result TEE_AEInit(TEE_OperationHandle operation, void *nonce, size_t nonce_len, uint32_t tag_len,
+    size_t aad_len, size_t payload_len)
+{
+    (void)aad_len;
+    (void)payload_len;
+    if (nonce_len > STUB_NONCE_MAX_LEN || tag_len != STUB_TAG_LEN * 8) {
+        return TEE_ERROR_BAD_PARAMETERS;
+    }
+    (void)memcpy(operation->nonce, nonce, nonce_len);
+    operation->nonce_len = nonce_len;
+    operation->aad_len = 0;
+    return TEE_SUCCESS;
+}
+
+void TEE_AEUpdateAAD(TEE_OperationHandle operation, void *aad, size_t aad_len)
+{
+    if (aad_len <= STUB_AAD_MAX_LEN - operation->aad_len) {
+        (void)memcpy(operation->aad + operation->aad_len, aad, aad_len);
+        operation->aad_len += aad_len;
+    }
+}
+
+static TEE_Result aes_gcm(TEE_OperationHandle operation, int is_enc, void *src, size_t src_len, void *dest,
+    size_t *dest_len, void *tag)
+{
+    uint8_t final[STUB_TAG_LEN];
+    int len = 0;
+    int ok = 0;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+
+    if (ctx == NULL) {
+        return TEE_ERROR_OUT_OF_MEMORY;
+    }
+    if (EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL, is_enc) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)operation->nonce_len, NULL) != 1 ||
+        EVP_CipherInit_ex(ctx, NULL, NULL, operation->key, operation->nonce, is_enc) != 1 ||
+        (!is_enc && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, STUB_TAG_LEN, tag) != 1) ||
+        (operation->aad_len > 0 &&
+        EVP_CipherUpdate(ctx, NULL, &len, operation->aad, (int)operation->aad_len) != 1)) {
+        goto end;
+    }
+    *dest_len = 0;
+    if (src_len > 0) {
+        if (EVP_CipherUpdate(ctx, dest, &len, src, (int)src_len) != 1) {
+            goto end;
+        }
+        *dest_len = (size_t)len;
+    }
+    if (EVP_CipherFinal_ex(ctx, final, &len) != 1) {
+        goto end;
+    }
+    ok = !is_enc || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, STUB_TAG_LEN, tag) == 1;
+end:
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? TEE_SUCCESS : TEE_ERROR_MAC_INVALID;
+}
+
+TEE_Result TEE_AEEncryptFinal(TEE_OperationHandle operation, void *src, size_t src_len, void *dest, size_t *dest_len,
+    void *tag, size_t *tag_len)
+{
+    if (operation->mode != TEE_MODE_ENCRYPT || *tag_len < STUB_TAG_LEN) {
+        return TEE_ERROR_BAD_PARAMETERS;
+    }
+    *tag_len = STUB_TAG_LEN;
+    return aes_gcm(operation, 1, src, src_len, dest, dest_len, tag);
+}
+
+TEE_Result TEE_AEDecryptFinal(TEE_OperationHandle operation, void *src, size_t src_len, void *dest, size_t *dest_len,
+    void *tag, size_t tag_len)
+{
+    if (operation->mode != TEE_MODE_DECRYPT || tag_len != STUB_TAG_LEN) {
+        return TEE_ERROR_BAD_PARAMETERS;
+    }
+    return aes_gcm(operation, 0, src, src_len, dest, dest_len, tag);
+}
+
+void TEE_GenerateRandom(void *buffer, size_t size)
+{
+    (void)RAND_bytes(buffer, (int)size);
+}
+
+TEE_Result TEE_EXT_DeriveTARootKey(const uint8_t *salt, uint32_t size, uint8_t *key, uint32_t key_size)
+{
+    static const uint8_t root_secret[] = "sealed kv llt root secret";
+    unsigned int len = 0;
+    uint8_t digest[EVP_MAX_MD_SIZE];
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+
+    if (ctx == NULL || key_size > 32 || EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1 ||
+        EVP_DigestUpdate(ctx, root_secret, sizeof(root_secret)) != 1 || EVP_DigestUpdate(ctx, salt, size) != 1 ||
+        EVP_DigestFinal_ex(ctx, digest, &len) != 1) {
+        EVP_MD_CTX_free(ctx);
+        return TEE_ERROR_GENERIC;
+    }
+    EVP_MD_CTX_free(ctx);
+    (void)memcpy(key, digest, key_size);
+    return TEE_SUCCESS;
+}
+
+void *TEE_Malloc(size_t size, uint32_t hint)
+{
+    (void)hint;
+    return calloc(1, size);
+}
+
+void TEE_Free(void *buffer)
+{
+    free(buffer);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * The resumption ticket lifetime against the session timer driven by the host. The enclave code is built into the
+ * llt, so the ticket of a full handshake is sealed directly.
+ */
+#include "secure_channel_enclave.c"
+
+#include <stdio.h>
+#include <openssl/rand.h>
+
+cc_enclave_result_t cc_enclave_generate_random(void *buffer, size_t size)
+{
+    return RAND_bytes(buffer, (int)size) == 1 ? CC_SUCCESS : CC_FAIL;
+}
+
+#define LLT_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return -1; \
+        } \
+    } while (0)
+
+static int resume(sec_chl_resume_msg_t *req)
+{
+    sec_chl_resume_msg_t rsp;
+    size_t session_id = 0;
+
+    int ret = resume_session(&session_id, (uint8_t *)req, sizeof(*req), (uint8_t *)&rsp, sizeof(rsp));
+    if (ret == CC_SUCCESS) {
+        del_enclave_sec_chl(session_id);
+    }
+    return ret;
+}
+
+static int test_ticket_expire(void)
+{
+    uint8_t secret[SECURE_KEY_LEN] = {0};
+    sec_chl_resume_msg_t req = {0};
+
+    LLT_CHECK(enclave_start_sec_chl(0, 0) == CC_SUCCESS);
+    LLT_CHECK(seal_ticket(g_sec_chl_manager.tick, CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM, secret, req.ticket) ==
+        CC_SUCCESS);
+    LLT_CHECK(resume(&req) == CC_SUCCESS);
+
+    for (int i = 0; i < SEC_CHL_TICKET_LIFETIME_CNT; i++) {
+        (void)enclave_check_session_timeout(1);
+    }
+    LLT_CHECK(resume(&req) == CC_SUCCESS);
+    (void)enclave_check_session_timeout(1);
+    LLT_CHECK(resume(&req) == CC_ERROR_SEC_CHL_TICKET_INVALID);
+
+    enclave_stop_sec_chl();
+    return 0;
+}
+
+/* A huge elapsed from the host must not wrap the tick back into the lifetime of an expired ticket */
+static int test_huge_elapsed(void)
+{
+    uint8_t secret[SECURE_KEY_LEN] = {0};
+    sec_chl_resume_msg_t req = {0};
+
+    LLT_CHECK(enclave_start_sec_chl(0, 0) == CC_SUCCESS);
+    uint64_t ticket_tick = g_sec_chl_manager.tick;
+    LLT_CHECK(seal_ticket(ticket_tick, CC_SEC_CHL_ALGO_RSA_ECDH_AES_GCM, secret, req.ticket) == CC_SUCCESS);
+    for (int i = 0; i <= SEC_CHL_TICKET_LIFETIME_CNT; i++) {
+        (void)enclave_check_session_timeout(1);
+    }
+    LLT_CHECK(resume(&req) == CC_ERROR_SEC_CHL_TICKET_INVALID);
+
+    // the elapsed which would wrap the tick around to the tick of the ticket, or just behind it
+    for (uint64_t k = 0; k < 4; k++) {
+        uint64_t tick = g_sec_chl_manager.tick;
+        (void)enclave_check_session_timeout(0 - (tick - ticket_tick) + k);
+        LLT_CHECK(g_sec_chl_manager.tick > tick);
+        LLT_CHECK(resume(&req) == CC_ERROR_SEC_CHL_TICKET_INVALID);
+    }
+
+    enclave_stop_sec_chl();
+    return 0;
+}
+
+int main(void)
+{
+    int ret = test_ticket_expire();
+    printf("test_ticket_expire %s\n", ret == 0 ? "success" : "failed");
+    if (ret == 0) {
+        ret = test_huge_elapsed();
+        printf("test_huge_elapsed %s\n", ret == 0 ? "success" : "failed");
+    }
+    return ret == 0 ? 0 : 1;
+}
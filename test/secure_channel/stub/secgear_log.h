@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/* The enclave log of the llt, which runs the enclave code in a normal process */
+#ifndef SECGEAR_LOG_H
+#define SECGEAR_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#define PRINT_ERROR 0
+#define PRINT_WARNING 1
+#define PRINT_STRACE 2
+#define PRINT_DEBUG 3
+
+// the enclave code formats for the TEE log, which does not check the formats against the host ABI
+static inline void PrintInfo(int level, const char *fmt, ...)
+{
+    va_list args;
+
+    if (level > PRINT_WARNING) {
+        return;
+    }
+    va_start(args, fmt);
+    (void)vprintf(fmt, args);
+    va_end(args);
+}
+
+#endif
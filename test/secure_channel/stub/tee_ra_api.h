@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2020. All rights reserved.
+ * secGear is licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/* The part of the iTrustee ra api named by the secure channel enclave, the llt is built without GP_ENCLAVE */
+#ifndef TEE_RA_API_H
+#define TEE_RA_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TEE_Result;
+
+#define TEE_SUCCESS 0x00000000
+#define TEE_ALG_AES_GCM 0x40000810
+
+TEE_Result ra_unseal(uint8_t *cipher_data, size_t cipher_data_len, uint8_t *plain_data, size_t *plain_data_len,
+    uint32_t alg_id);
+
+#endif